@@ -4,36 +4,75 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
 
+# Frame format and the MLX90640 calibration code shared with the STM32 firmware
+INCLUDEPATH += ../Mikrokontroler/Testy/Core/Inc
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    acquisitionworker.cpp \
     camerawidget.cpp \
+    capturefile.cpp \
+    cpuprofile.cpp \
     camerawindow.cpp \
     datadisplay.cpp \
     datadisplaytext.cpp \
     datahandler.cpp \
     datatabledialog.cpp \
     dialog.cpp \
+    frameparser.cpp \
     gauss.cpp \
+    linkmonitor.cpp \
+    linkstatsdialog.cpp \
+    ../Mikrokontroler/Testy/Core/Src/MLX90640_API.c \
+    ../Mikrokontroler/Testy/Core/Src/MLX90640_Solver.c \
     main.cpp \
     mainwindow.cpp \
+    mlxframeassembler.cpp \
+    mlxsolver.cpp \
+    mlxsolver_avx.cpp \
+    profiledialog.cpp \
+    sensorcapabilities.cpp \
+    seriessummary.cpp \
     table.cpp \
     table_termo.cpp \
     tablechart.cpp \
     tablechartmlx.cpp
 
 HEADERS += \
+    acquisitionworker.h \
     camerawidget.h \
+    capturefile.h \
+    cpuprofile.h \
     camerawindow.h \
     datadisplay.h \
     datadisplaytext.h \
     datahandler.h \
     datatabledialog.h \
     dialog.h \
+    frameparser.h \
     gauss.h \
+    linkmonitor.h \
+    linkstatsdialog.h \
+    ../Mikrokontroler/Testy/Core/Inc/integrator_codec.h \
+    ../Mikrokontroler/Testy/Core/Inc/integrator_command.h \
+    ../Mikrokontroler/Testy/Core/Inc/integrator_crc16.h \
+    ../Mikrokontroler/Testy/Core/Inc/integrator_profile.h \
+    ../Mikrokontroler/Testy/Core/Inc/integrator_protocol.h \
+    ../Mikrokontroler/Testy/Core/Inc/integrator_series.h \
+    ../Mikrokontroler/Testy/Core/Inc/integrator_tof.h \
+    ../Mikrokontroler/Testy/Core/Inc/MLX90640_API.h \
+    ../Mikrokontroler/Testy/Core/Inc/MLX90640_Solver.h \
     mainwindow.h \
+    mlxframeassembler.h \
+    mlxkernel.h \
+    mlxsolver.h \
+    profiledialog.h \
+    sensorcapabilities.h \
+    seriessummary.h \
+    spscqueue.h \
     table.h \
     table_termo.h \
     tablechart.h \
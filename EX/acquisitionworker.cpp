@@ -0,0 +1,764 @@
+/**
+ * @file acquisitionworker.cpp
+ * @brief Implementation of the AcquisitionWorker class, the serial acquisition thread.
+ *
+ * The worker is moved to a dedicated QThread by MainWindow. All QSerialPort
+ * calls happen on that thread; the GUI only pops finished frames from the
+ * queue and sends commands through queued calls.
+ */
+
+#include "acquisitionworker.h"
+
+#include <QDebug>
+
+#include <cstring>
+
+namespace {
+
+const qint32 baudRates[INTEGRATOR_BAUD_RATE_COUNT] = INTEGRATOR_BAUD_RATES;
+
+// The firmware answers from its main loop, which may be busy for a few seconds
+const int BaudReplyTimeoutMs = 5000;
+
+// Acknowledgements also come from the main loop; a command without one by then is lost
+const int CommandAckTimeoutMs = 5000;
+
+// At maximum replay speed the event loop gets control back after this time
+const int ReplaySliceMs = 10;
+
+// Raw MLX90640 frames arriving without a calibration ask for it at most this often
+const qint64 MlxEepromRetryUs = 1000000;
+
+bool firmwareAtLeast(const IntegratorCapabilities &capabilities, int major, int minor)
+{
+    return capabilities.firmwareMajor > major
+            || (capabilities.firmwareMajor == major && capabilities.firmwareMinor >= minor);
+}
+
+} // namespace
+
+/**
+ * @brief Constructs the worker. The serial port is created later by openPort().
+ * @param parent Pointer to the parent object. Must be nullptr before moveToThread().
+ */
+
+AcquisitionWorker::AcquisitionWorker(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<IntegratorCapabilities>();
+    qRegisterMetaType<SeriesSummary>();
+    qRegisterMetaType<CpuProfile>();
+    m_clock.start();
+    m_parser.setFrameHandler([this](const SensorFrame &frame) {
+        int frameBytes = 0;
+        if (frame.tof.fields) {
+            const integrator_tof_layout layout = integrator_tof_get_layout(frame.tof.fields, frame.tof.targets,
+                                                                           frame.tof.zones);
+            frameBytes = INTEGRATOR_HEADER_SIZE + layout.size + INTEGRATOR_CRC_SIZE;
+        }
+        onFrame(frame, frameBytes);
+    });
+    m_parser.setControlHandler([this](char id, const uint8_t *payload, int length) {
+        onControlFrame(id, payload, length);
+    });
+    m_parser.setRawHandler([this](const SensorFrame &header, const uint8_t *payload, int length) {
+        onRawFrame(header, payload, length);
+    });
+}
+
+/**
+ * @brief Opens the serial port with the integrator settings (8N1, no flow control).
+ * @param name Device name, e.g. "/dev/ttyACM0".
+ * @param baudRate Baud rate.
+ */
+
+void AcquisitionWorker::openPort(const QString &name, qint32 baudRate)
+{
+    if (!m_port) {
+        m_port = new QSerialPort(this);
+        connect(m_port, &QSerialPort::readyRead, this, &AcquisitionWorker::readPort);
+        m_baudTimer = new QTimer(this);
+        m_baudTimer->setSingleShot(true);
+        connect(m_baudTimer, &QTimer::timeout, this, &AcquisitionWorker::baudTimeout);
+        m_commandTimer = new QTimer(this);
+        m_commandTimer->setSingleShot(true);
+        connect(m_commandTimer, &QTimer::timeout, this, &AcquisitionWorker::commandTimeout);
+    }
+    m_baudTimer->stop();
+    m_baudState = BaudState::Idle;
+    // Bare bytes until the descriptor of the new firmware shows it takes frames
+    m_framedCommands = false;
+    m_capabilities = IntegratorCapabilities();
+    clearPendingCommands();
+    if (m_port->isOpen())
+        m_port->close();
+
+    m_port->setPortName(name);
+    m_port->setBaudRate(baudRate);
+    m_port->setParity(QSerialPort::Parity::NoParity);
+    m_port->setDataBits(QSerialPort::DataBits::Data8);
+    m_port->setStopBits(QSerialPort::StopBits::OneStop);
+    m_port->setFlowControl(QSerialPort::FlowControl::NoFlowControl);
+    bool open = m_port->open(QIODevice::ReadWrite);
+    m_parser.reset();
+    resetMlx();
+    m_mlxEepromRequestUs = -1;
+    {
+        QMutexLocker locker(&m_monitorMutex);
+        m_monitor.reset();
+        m_monitor.setBaudRate(baudRate);
+    }
+    if (open)
+        m_capture.writeBaudRate(m_clock.nsecsElapsed() / 1000, baudRate);
+
+    emit portStateChanged(open, open ? QString() : m_port->errorString());
+    if (open)
+        requestCapabilities();
+}
+
+/**
+ * @brief Closes the serial port.
+ */
+
+void AcquisitionWorker::closePort()
+{
+    if (m_port && m_port->isOpen()) {
+        m_port->close();
+        emit portStateChanged(false, QString());
+    }
+}
+
+/**
+ * @brief Sends a command to the firmware.
+ * @param data Bytes to write.
+ */
+
+void AcquisitionWorker::writeData(const QByteArray &data)
+{
+    if (m_port && m_port->isOpen())
+        sendCommand(data.constData(), data.size());
+    else
+        qDebug() << "Port nie został otwarty\n";
+}
+
+/**
+ * @brief Drops any partially received frame, e.g. after a protocol switch.
+ */
+
+void AcquisitionWorker::resetParser()
+{
+    m_parser.reset();
+}
+
+/**
+ * @brief Raises the link to the fastest baud rate the firmware and the ST-LINK accept.
+ * @param maxRateIndex Index into INTEGRATOR_BAUD_RATES of the first rate to try.
+ *
+ * Rates are tried from maxRateIndex down. A rate is kept once the firmware
+ * confirms it at the new speed; otherwise both sides fall back to
+ * INTEGRATOR_BAUD_DEFAULT and the next slower rate is tried.
+ * baudRateChanged() reports the result.
+ */
+
+void AcquisitionWorker::negotiateBaudRate(int maxRateIndex)
+{
+    if (!m_port || !m_port->isOpen())
+        return;
+    requestBaudRate(qBound(0, maxRateIndex, INTEGRATOR_BAUD_RATE_COUNT - 1));
+}
+
+/**
+ * @brief Asks the firmware for its capability descriptor.
+ *
+ * The answer is reported with capabilitiesChanged(). Firmware without the
+ * descriptor ignores the request and the defaults stay in use.
+ */
+
+void AcquisitionWorker::requestCapabilities()
+{
+    if (!m_port || !m_port->isOpen())
+        return;
+    const char request = INTEGRATOR_CMD_CAPABILITIES;
+    sendCommand(&request, 1);
+}
+
+void AcquisitionWorker::requestBaudRate(int index)
+{
+    m_baudIndex = index;
+    m_baudState = BaudState::WaitSwitch;
+    const char request[] = { INTEGRATOR_CMD_BAUD, static_cast<char>('0' + index) };
+    sendCommand(request, sizeof(request));
+    m_baudTimer->start(BaudReplyTimeoutMs);
+}
+
+void AcquisitionWorker::setPortBaudRate(qint32 baudRate)
+{
+    m_port->flush();
+    m_port->setBaudRate(baudRate);
+    m_port->clear(QSerialPort::Input);
+    m_parser.reset();
+    // Acknowledgements still due went out at the old rate and are gone with the input
+    clearPendingCommands();
+
+    m_capture.writeBaudRate(m_clock.nsecsElapsed() / 1000, baudRate);
+
+    QMutexLocker locker(&m_monitorMutex);
+    m_monitor.setBaudRate(baudRate);
+}
+
+/**
+ * @brief Sends commands, as a command frame if the firmware takes them.
+ * @param data Command letters with their argument bytes.
+ * @param length Number of bytes.
+ *
+ * A frame holds at most INTEGRATOR_COMMAND_MAX_PAYLOAD bytes; longer data is
+ * split over several frames.
+ */
+
+void AcquisitionWorker::sendCommand(const char *data, int length)
+{
+    if (!m_framedCommands) {
+        m_port->write(data, length);
+        return;
+    }
+
+    uint8_t frame[INTEGRATOR_COMMAND_MAX_FRAME];
+    for (int offset = 0; offset < length; offset += INTEGRATOR_COMMAND_MAX_PAYLOAD) {
+        const uint16_t chunk = static_cast<uint16_t>(qMin(length - offset, INTEGRATOR_COMMAND_MAX_PAYLOAD));
+        const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+        const PendingCommand pending = { m_commandSequence++, nowUs, data[offset] };
+
+        integrator_put_header(frame, INTEGRATOR_ID_COMMAND, chunk, pending.sequence, static_cast<uint32_t>(nowUs));
+        memcpy(&frame[INTEGRATOR_HEADER_SIZE], data + offset, chunk);
+        m_port->write(reinterpret_cast<const char *>(frame), integrator_put_crc(frame, chunk));
+
+        m_pendingCommands.append(pending);
+        m_commandsSent.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!m_commandTimer->isActive())
+        m_commandTimer->start(CommandAckTimeoutMs);
+}
+
+void AcquisitionWorker::onCommandAck(const uint8_t *payload, int length)
+{
+    if (length < INTEGRATOR_ACK_SIZE)
+        return;
+    const quint16 sequence = integrator_get_u16(&payload[0]);
+    const uint8_t status = payload[2];
+
+    // Replayed captures bring acknowledgements of commands this session never sent
+    int index = 0;
+    while (index < m_pendingCommands.size() && m_pendingCommands[index].sequence != sequence)
+        ++index;
+    if (index == m_pendingCommands.size())
+        return;
+    const PendingCommand pending = m_pendingCommands.takeAt(index);
+
+    // The echoed timestamp is our own clock, truncated to 32 bits like the one sent
+    const quint32 nowUs = static_cast<quint32>(m_clock.nsecsElapsed() / 1000);
+    const quint32 rttUs = nowUs - integrator_get_u32(&payload[4]);
+    m_commandRttUs.store(rttUs, std::memory_order_relaxed);
+    if (rttUs > m_commandRttMaxUs.load(std::memory_order_relaxed))
+        m_commandRttMaxUs.store(rttUs, std::memory_order_relaxed);
+    m_commandsAcked.fetch_add(1, std::memory_order_relaxed);
+
+    if (status != INTEGRATOR_ACK_OK) {
+        m_commandsRejected.fetch_add(1, std::memory_order_relaxed);
+        emit commandFailed(status == INTEGRATOR_ACK_INCOMPLETE
+                           ? QString("Niepełne polecenie %1").arg(QLatin1Char(pending.command))
+                           : QString("Integrator nie rozpoznał polecenia %1").arg(QLatin1Char(pending.command)));
+    }
+
+    if (m_pendingCommands.isEmpty())
+        m_commandTimer->stop();
+}
+
+void AcquisitionWorker::commandTimeout()
+{
+    const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+    while (!m_pendingCommands.isEmpty()
+           && nowUs - m_pendingCommands.first().sentUs >= CommandAckTimeoutMs * 1000LL) {
+        const PendingCommand pending = m_pendingCommands.takeFirst();
+        m_commandsLost.fetch_add(1, std::memory_order_relaxed);
+        emit commandFailed(QString("Brak potwierdzenia polecenia %1").arg(QLatin1Char(pending.command)));
+    }
+    if (!m_pendingCommands.isEmpty()) {
+        const qint64 dueUs = m_pendingCommands.first().sentUs + CommandAckTimeoutMs * 1000LL;
+        m_commandTimer->start(static_cast<int>((dueUs - nowUs + 999) / 1000));
+    }
+}
+
+void AcquisitionWorker::clearPendingCommands()
+{
+    m_pendingCommands.clear();
+    if (m_commandTimer)
+        m_commandTimer->stop();
+}
+
+void AcquisitionWorker::onControlFrame(char id, const uint8_t *payload, int length)
+{
+    if (id == INTEGRATOR_ID_CAPABILITIES) {
+        IntegratorCapabilities capabilities;
+        if (capabilities.parse(payload, length)) {
+            m_framedCommands = firmwareAtLeast(capabilities, INTEGRATOR_COMMAND_VERSION_MAJOR,
+                                               INTEGRATOR_COMMAND_VERSION_MINOR);
+            // Only the distances are shown, the other blocks would just lengthen every I2C read.
+            // The firmware keeps the ranging running when the selection does not change.
+            if (!m_replaying && m_port && m_port->isOpen()
+                    && firmwareAtLeast(capabilities, INTEGRATOR_VL_OUTPUTS_VERSION_MAJOR,
+                                       INTEGRATOR_VL_OUTPUTS_VERSION_MINOR)) {
+                const char request[] = { INTEGRATOR_CMD_VL_OUTPUTS, 0 };
+                sendCommand(request, sizeof(request));
+            }
+            m_capabilities = capabilities;
+            sendTofFields();
+            emit capabilitiesChanged(capabilities);
+        }
+        return;
+    }
+
+    if (id == INTEGRATOR_ID_ACK) {
+        onCommandAck(payload, length);
+        return;
+    }
+
+    if (id == INTEGRATOR_ID_MLX90640_EEPROM) {
+        uint16_t eeprom[INTEGRATOR_MLX90640_EEPROM_WORDS];
+        if (length != static_cast<int>(sizeof(eeprom)))
+            return;
+        for (int i = 0; i < INTEGRATOR_MLX90640_EEPROM_WORDS; ++i)
+            eeprom[i] = integrator_get_u16(&payload[2 * i]);
+        if (!m_mlxSolver.setEeprom(eeprom))
+            qDebug() << "Błędne dane EEPROM czujnika MLX90640";
+        return;
+    }
+
+    if (id == INTEGRATOR_ID_SERIES) {
+        const uint8_t slot = length > 0 ? integrator_sensor_slot(payload[0]) : INTEGRATOR_SENSOR_COUNT;
+        if (slot < INTEGRATOR_SENSOR_COUNT && m_series[slot].addFrame(payload, length))
+            emit seriesFinished(m_series[slot]);
+        return;
+    }
+
+    if (id == INTEGRATOR_ID_PROFILE) {
+        CpuProfile profile;
+        if (profile.parse(payload, length))
+            emit profileReceived(profile);
+        return;
+    }
+
+    if (id != INTEGRATOR_ID_BAUD || length < 5 || m_baudState == BaudState::Idle)
+        return;
+
+    const qint32 rate = static_cast<qint32>(integrator_get_u32(payload));
+    const uint8_t state = payload[4];
+
+    if (m_baudState == BaudState::WaitSwitch && state == INTEGRATOR_BAUD_SWITCHING
+            && rate == baudRates[m_baudIndex]) {
+        setPortBaudRate(rate);
+        const char confirm = INTEGRATOR_CMD_BAUD_CONFIRM;
+        sendCommand(&confirm, 1);
+        m_baudState = BaudState::WaitConfirm;
+        m_baudTimer->start(BaudReplyTimeoutMs);
+    } else if (m_baudState == BaudState::WaitConfirm && state == INTEGRATOR_BAUD_CONFIRMED
+               && rate == baudRates[m_baudIndex]) {
+        m_baudTimer->stop();
+        m_baudState = BaudState::Idle;
+        emit baudRateChanged(rate);
+    } else if (m_baudState == BaudState::WaitSwitch && state == INTEGRATOR_BAUD_REJECTED) {
+        tryNextBaudRate();
+    }
+}
+
+void AcquisitionWorker::baudTimeout()
+{
+    if (m_baudState == BaudState::WaitConfirm) {
+        // The new rate does not work; the firmware returns to the default one by itself
+        setPortBaudRate(INTEGRATOR_BAUD_DEFAULT);
+        tryNextBaudRate();
+    } else {
+        // No reply at all, the firmware does not support the negotiation
+        m_baudState = BaudState::Idle;
+        emit baudRateChanged(m_port->baudRate());
+    }
+}
+
+void AcquisitionWorker::tryNextBaudRate()
+{
+    if (m_baudIndex > 0) {
+        requestBaudRate(m_baudIndex - 1);
+    } else {
+        m_baudTimer->stop();
+        m_baudState = BaudState::Idle;
+        emit baudRateChanged(m_port->baudRate());
+    }
+}
+
+/**
+ * @brief Starts recording the bytes received from the port.
+ * @param path Capture file, replaced if it exists.
+ */
+
+void AcquisitionWorker::startCapture(const QString &path)
+{
+    if (!m_capture.open(path)) {
+        emit captureStateChanged(false, m_capture.errorString());
+        return;
+    }
+    if (m_port && m_port->isOpen()) {
+        m_capture.writeBaudRate(m_clock.nsecsElapsed() / 1000, m_port->baudRate());
+        // Raw MLX90640 frames can only be solved again with the calibration in the file
+        if (m_mlxRaw)
+            requestMlxEeprom();
+    }
+    emit captureStateChanged(true, QString());
+}
+
+/**
+ * @brief Stops recording and closes the capture file.
+ */
+
+void AcquisitionWorker::stopCapture()
+{
+    m_capture.close();
+    emit captureStateChanged(false, QString());
+}
+
+/**
+ * @brief Feeds a capture file through the parser instead of the live port.
+ * @param path Capture file written by startCapture().
+ * @param speed Playback speed relative to the recording; 0 replays as fast as possible.
+ *
+ * The recorded arrival times are passed on as the frame receive times, so the
+ * link statistics of a replay match the ones of the recorded session.
+ */
+
+void AcquisitionWorker::startReplay(const QString &path, double speed)
+{
+    stopReplay();
+    if (!m_replay.open(path)) {
+        emit replayStateChanged(false, m_replay.errorString());
+        return;
+    }
+    if (!m_replayTimer) {
+        m_replayTimer = new QTimer(this);
+        m_replayTimer->setSingleShot(true);
+        m_replayTimer->setTimerType(Qt::PreciseTimer);
+        connect(m_replayTimer, &QTimer::timeout, this, &AcquisitionWorker::replayNext);
+    }
+
+    m_parser.reset();
+    resetMlx();
+    {
+        QMutexLocker locker(&m_monitorMutex);
+        m_monitor.reset();
+    }
+    m_replaying = true;
+    m_replayPending = false;
+    m_replaySpeed = speed;
+    m_replayFirstUs = -1;
+    m_replayClock.start();
+    emit replayStateChanged(true, QString());
+    m_replayTimer->start(0);
+}
+
+/**
+ * @brief Stops a running replay; the live port takes over again.
+ */
+
+void AcquisitionWorker::stopReplay()
+{
+    if (!m_replaying)
+        return;
+    m_replayTimer->stop();
+    m_replay.close();
+    m_replaying = false;
+    m_parser.reset();
+    resetMlx();
+    emit replayStateChanged(false, QString());
+}
+
+void AcquisitionWorker::replayNext()
+{
+    QElapsedTimer slice;
+    slice.start();
+
+    for (;;) {
+        if (!m_replayPending) {
+            if (!m_replay.readRecord(m_replayRecord)) {
+                stopReplay();
+                return;
+            }
+            m_replayPending = true;
+            if (m_replayFirstUs < 0)
+                m_replayFirstUs = m_replayRecord.timeUs;
+        }
+
+        if (m_replaySpeed > 0) {
+            const qint64 dueUs = static_cast<qint64>((m_replayRecord.timeUs - m_replayFirstUs) / m_replaySpeed);
+            const qint64 waitUs = dueUs - m_replayClock.nsecsElapsed() / 1000;
+            if (waitUs > 0) {
+                m_replayTimer->start(static_cast<int>(waitUs / 1000));
+                break;
+            }
+        } else if (slice.elapsed() >= ReplaySliceMs) {
+            m_replayTimer->start(0);
+            break;
+        }
+
+        replayRecord(m_replayRecord);
+        m_replayPending = false;
+    }
+    publishCounters();
+}
+
+void AcquisitionWorker::replayRecord(const CaptureRecord &record)
+{
+    if (record.type == CaptureRecord::BaudRate && record.data.size() == 4) {
+        QMutexLocker locker(&m_monitorMutex);
+        m_monitor.setBaudRate(static_cast<int>(integrator_get_u32(reinterpret_cast<const uint8_t *>(record.data.constData()))));
+    } else if (record.type == CaptureRecord::Data) {
+        m_bytesReceived.fetch_add(record.data.size(), std::memory_order_relaxed);
+        m_parser.setReceiveTime(record.timeUs);
+        m_parser.feed(record.data.constData(), record.data.size());
+    }
+}
+
+/**
+ * @brief Returns a snapshot of the link counters.
+ */
+
+LinkStats AcquisitionWorker::stats() const
+{
+    LinkStats stats;
+    stats.bytesReceived = m_bytesReceived.load(std::memory_order_relaxed);
+    stats.framesParsed = m_framesParsed.load(std::memory_order_relaxed);
+    stats.crcErrors = m_crcErrors.load(std::memory_order_relaxed);
+    stats.resyncs = m_resyncs.load(std::memory_order_relaxed);
+    stats.codecGaps = m_codecGaps.load(std::memory_order_relaxed);
+    stats.framesDropped = m_queue.dropped();
+    stats.commandsSent = m_commandsSent.load(std::memory_order_relaxed);
+    stats.commandsAcked = m_commandsAcked.load(std::memory_order_relaxed);
+    stats.commandsLost = m_commandsLost.load(std::memory_order_relaxed);
+    stats.commandsRejected = m_commandsRejected.load(std::memory_order_relaxed);
+    stats.commandRttUs = m_commandRttUs.load(std::memory_order_relaxed);
+    stats.commandRttMaxUs = m_commandRttMaxUs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ * @brief Returns a snapshot of the per-sensor loss, jitter and latency statistics.
+ */
+
+LinkStatsTable AcquisitionWorker::sensorStats() const
+{
+    QMutexLocker locker(&m_monitorMutex);
+    return m_monitor.stats();
+}
+
+void AcquisitionWorker::readPort()
+{
+    while (m_port->bytesAvailable())
+    {
+        int space;
+        char *dst = m_parser.writeBuffer(space);
+        qint64 received = m_port->read(dst, space);
+        if (received <= 0)
+            break;
+        if (m_replaying)
+            continue; // The replayed stream owns the parser
+        const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+        m_capture.writeData(nowUs, dst, static_cast<int>(received));
+        m_bytesReceived.fetch_add(received, std::memory_order_relaxed);
+        m_parser.setReceiveTime(nowUs);
+        m_parser.commit(static_cast<int>(received));
+    }
+    publishCounters();
+}
+
+/**
+ * @brief Sets the MLX90640 object emissivity and the reflected temperature used for raw frames.
+ * @param emissivity Emissivity of the observed surfaces, 0..1.
+ * @param reflectedShift The reflected temperature is the sensor temperature Ta minus this value.
+ */
+
+void AcquisitionWorker::setMlxCalibration(float emissivity, float reflectedShift)
+{
+    m_mlxSolver.setEmissivity(emissivity);
+    m_mlxSolver.setReflectedShift(reflectedShift);
+}
+
+/**
+ * @brief Notes whether the firmware was asked for raw MLX90640 frames.
+ * @param raw True after INTEGRATOR_CMD_MLX_RAW, false after INTEGRATOR_CMD_MLX_TEMP.
+ */
+
+void AcquisitionWorker::setMlxRawMode(bool raw)
+{
+    m_mlxRaw = raw;
+}
+
+/**
+ * @brief Starts a measurement series computed by the firmware.
+ * @param sensor Sensor id.
+ * @param frames Number of frames; 0 aborts a running series, which then reports what it has.
+ * @param sendFrames Keep sending the frames of the sensor during the series.
+ *
+ * The statistics arrive through seriesFinished() once the series is complete.
+ */
+
+void AcquisitionWorker::startSeries(char sensor, int frames, bool sendFrames)
+{
+    if (!m_port || !m_port->isOpen())
+        return;
+    const int count = qBound(0, frames, 0xFFFF);
+    const char command[] = {
+        INTEGRATOR_CMD_SERIES, sensor, static_cast<char>(count & 0xFF), static_cast<char>(count >> 8),
+        static_cast<char>(sendFrames ? INTEGRATOR_SERIES_FRAMES : 0)
+    };
+    sendCommand(command, sizeof(command));
+}
+
+/**
+ * @brief Subscribes every VL53L5CX to per-zone fields besides the distance.
+ * @param fields INTEGRATOR_TOF_FIELD_* flags; 0 returns to plain distance frames.
+ *
+ * Sent at once if the firmware is known to take them, otherwise with its
+ * next capability descriptor.
+ */
+
+void AcquisitionWorker::setTofFields(quint8 fields)
+{
+    m_tofFields = fields;
+    sendTofFields();
+}
+
+// One INTEGRATOR_CMD_TOF_FIELDS per VL53L5CX of the board, in one command frame
+void AcquisitionWorker::sendTofFields()
+{
+    if (m_replaying || !m_port || !m_port->isOpen()
+            || !firmwareAtLeast(m_capabilities, INTEGRATOR_TOF_FIELDS_VERSION_MAJOR, INTEGRATOR_TOF_FIELDS_VERSION_MINOR))
+        return;
+    char commands[INTEGRATOR_SENSOR_COUNT * (1 + INTEGRATOR_CMD_TOF_FIELDS_ARGS)];
+    int length = 0;
+    for (const SensorCapability &sensor : m_capabilities.sensors) {
+        if (!sensor.present || !integrator_is_vl53l5cx(static_cast<uint8_t>(sensor.id)))
+            continue;
+        commands[length++] = INTEGRATOR_CMD_TOF_FIELDS;
+        commands[length++] = sensor.id;
+        commands[length++] = static_cast<char>(m_tofFields);
+    }
+    if (length > 0)
+        sendCommand(commands, length);
+}
+
+// INTEGRATOR_CMD_MLX_RAW makes the firmware send the EEPROM frame again
+void AcquisitionWorker::requestMlxEeprom()
+{
+    if (!m_port || !m_port->isOpen())
+        return;
+    m_mlxEepromRequestUs = m_clock.nsecsElapsed() / 1000;
+    const char request = INTEGRATOR_CMD_MLX_RAW;
+    sendCommand(&request, 1);
+}
+
+void AcquisitionWorker::onRawFrame(const SensorFrame &header, const uint8_t *payload, int length)
+{
+    if (header.sensor == INTEGRATOR_ID_AMG8833_RAW) {
+        onAmgRawFrame(header, payload, length);
+        return;
+    }
+    if (header.sensor == INTEGRATOR_ID_MLX90640_SUBPAGE) {
+        onMlxSubpageFrame(header, payload, length);
+        return;
+    }
+    if (length != 2 * INTEGRATOR_MLX90640_RAW_WORDS)
+        return;
+
+    if (!m_mlxSolver.isReady()) {
+        // Started before the connection, or the EEPROM frame was lost
+        const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+        if (!m_replaying && (m_mlxEepromRequestUs < 0 || nowUs - m_mlxEepromRequestUs >= MlxEepromRetryUs))
+            requestMlxEeprom();
+        return;
+    }
+
+    uint16_t words[INTEGRATOR_MLX90640_RAW_WORDS];
+    for (int i = 0; i < INTEGRATOR_MLX90640_RAW_WORDS; ++i)
+        words[i] = integrator_get_u16(&payload[2 * i]);
+    m_mlxSolver.solve(words);
+    // Word 833 is the subpage of the frame, bit 12 of the control register the pattern
+    m_mlxAssembler.addSubpage(words[833] & 1, words[832] & 0x1000, m_mlxSolver.temperatures(), header.mcuTimeUs);
+    emitMlxFrame(header, length);
+}
+
+/*
+ * Subpage frames are already solved on the MCU and need no calibration.
+ */
+void AcquisitionWorker::onMlxSubpageFrame(const SensorFrame &header, const uint8_t *payload, int length)
+{
+    if (m_mlxAssembler.addSubpagePayload(payload, length, header.mcuTimeUs))
+        emitMlxFrame(header, length);
+}
+
+void AcquisitionWorker::emitMlxFrame(const SensorFrame &header, int length)
+{
+    m_mlxFrame.sensor = INTEGRATOR_ID_MLX90640;
+    m_mlxFrame.binary = true;
+    m_mlxFrame.sequence = header.sequence;
+    m_mlxFrame.mcuTimeUs = header.mcuTimeUs;
+    m_mlxFrame.hostTimeUs = header.hostTimeUs;
+    m_mlxAssembler.fill(m_mlxFrame);
+    onFrame(m_mlxFrame, INTEGRATOR_HEADER_SIZE + length + INTEGRATOR_CRC_SIZE);
+}
+
+void AcquisitionWorker::resetMlx()
+{
+    m_mlxSolver.reset();
+    m_mlxAssembler.reset();
+}
+
+/*
+ * The pixel registers are converted as the firmware converts them for the
+ * temperature frames, so both formats give the same values.
+ */
+void AcquisitionWorker::onAmgRawFrame(const SensorFrame &header, const uint8_t *payload, int length)
+{
+    if (length != 2 * INTEGRATOR_AMG8833_VALUES)
+        return;
+
+    m_amgFrame.sensor = INTEGRATOR_ID_AMG8833;
+    m_amgFrame.binary = true;
+    m_amgFrame.sequence = header.sequence;
+    m_amgFrame.mcuTimeUs = header.mcuTimeUs;
+    m_amgFrame.hostTimeUs = header.hostTimeUs;
+    m_amgFrame.count = INTEGRATOR_AMG8833_VALUES;
+    for (int i = 0; i < INTEGRATOR_AMG8833_VALUES; ++i)
+        m_amgFrame.values[i] = integrator_wire_to_temp(integrator_amg8833_raw_to_wire(integrator_get_u16(&payload[2 * i])));
+    onFrame(m_amgFrame, INTEGRATOR_HEADER_SIZE + length + INTEGRATOR_CRC_SIZE);
+}
+
+/*
+ * frameBytes is the size of the frame on the wire; 0 stands for an uncoded
+ * frame of frame.count values.
+ */
+void AcquisitionWorker::onFrame(const SensorFrame &frame, int frameBytes)
+{
+    if (frame.binary) {
+        // Tracked before the queue, so frames skipped by a slow GUI are not counted as lost
+        QMutexLocker locker(&m_monitorMutex);
+        m_monitor.addFrame(frame, frameBytes ? frameBytes : INTEGRATOR_HEADER_SIZE + 2 * frame.count + INTEGRATOR_CRC_SIZE);
+    }
+
+    m_queue.push(frame);
+    if (!m_notifyPending.exchange(true, std::memory_order_acq_rel))
+        emit framesAvailable();
+}
+
+void AcquisitionWorker::publishCounters()
+{
+    m_framesParsed.store(m_parser.framesParsed(), std::memory_order_relaxed);
+    m_crcErrors.store(m_parser.crcErrors(), std::memory_order_relaxed);
+    m_resyncs.store(m_parser.resyncs(), std::memory_order_relaxed);
+    m_codecGaps.store(m_parser.codecGaps(), std::memory_order_relaxed);
+}
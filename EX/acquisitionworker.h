@@ -0,0 +1,213 @@
+#ifndef ACQUISITIONWORKER_H
+#define ACQUISITIONWORKER_H
+
+#include <QObject>
+#include <QSerialPort>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVector>
+#include <atomic>
+
+#include "capturefile.h"
+#include "cpuprofile.h"
+#include "frameparser.h"
+#include "integrator_command.h"
+#include "linkmonitor.h"
+#include "mlxframeassembler.h"
+#include "mlxsolver.h"
+#include "sensorcapabilities.h"
+#include "seriessummary.h"
+#include "spscqueue.h"
+
+/**
+ * @brief Counters describing the serial link, safe to read from any thread.
+ */
+struct LinkStats
+{
+    quint64 bytesReceived = 0;
+    quint64 framesParsed = 0;
+    quint64 crcErrors = 0;
+    quint64 resyncs = 0;
+    quint64 codecGaps = 0;     ///< Coded frames skipped while waiting for a keyframe
+    quint64 framesDropped = 0; ///< Frames discarded because the GUI fell behind
+    quint64 commandsSent = 0;  ///< Command frames; bare command bytes are not counted
+    quint64 commandsAcked = 0;
+    quint64 commandsLost = 0;  ///< No acknowledgement within the timeout
+    quint64 commandsRejected = 0; ///< Acknowledged with an INTEGRATOR_ACK_* error
+    quint32 commandRttUs = 0;  ///< Round trip time of the last acknowledged command
+    quint32 commandRttMaxUs = 0;
+};
+
+/**
+ * @brief Serial port reader and frame decoder running on its own thread.
+ *
+ * The worker owns the QSerialPort and the FrameParser. Decoded frames are put
+ * into a bounded lock-free queue and the GUI is notified with framesAvailable().
+ * If the GUI does not keep up, the oldest queued frames are dropped, so slow
+ * painting never stalls the serial reads.
+ *
+ * The received bytes can be recorded to a capture file, and a capture can be
+ * replayed through the same parser and queue instead of the live port.
+ *
+ * Raw MLX90640 frames are solved here with the calibration from the EEPROM
+ * frame and queued as ordinary temperature frames. Emissivity and reflected
+ * temperature are set with setMlxCalibration(), also for replayed captures.
+ * Raw AMG8833 frames are converted from the pixel registers the same way.
+ * MLX90640 subpage frames and the subpages of raw frames are merged into
+ * whole images by an MlxFrameAssembler, which also gives the pixel ages.
+ *
+ * Measurement series computed by the firmware are started with startSeries();
+ * their statistics are reported with seriesFinished(). The cycle budget the
+ * firmware sends after INTEGRATOR_CMD_PROFILE is reported with
+ * profileReceived(); its frames are part of a capture like all others.
+ *
+ * Once the capability descriptor shows firmware that takes command frames
+ * (integrator_command.h), every command is sent framed and acknowledged; the
+ * round trip time and the lost or rejected commands end up in stats() and
+ * commandFailed(). Before that, and with older firmware, bare bytes are sent.
+ * Firmware that selects its VL53L5CX output blocks at runtime is asked to read
+ * the distances only, the one block the application uses, plus the blocks of
+ * the per-zone fields set with setTofFields(), which arrive in SensorFrame::tof.
+ */
+class AcquisitionWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int QueueCapacity = 16;
+
+    explicit AcquisitionWorker(QObject *parent = nullptr);
+
+    // Consumer side, called from the GUI thread
+    bool popFrame(SensorFrame &frame) { return m_queue.pop(frame); }
+    void rearmNotification() { m_notifyPending.store(false, std::memory_order_release); }
+    LinkStats stats() const;
+    LinkStatsTable sensorStats() const;
+
+public slots:
+    void openPort(const QString &name, qint32 baudRate);
+    void closePort();
+    void writeData(const QByteArray &data);
+    void resetParser();
+    void negotiateBaudRate(int maxRateIndex = INTEGRATOR_BAUD_RATE_COUNT - 1);
+    void requestCapabilities();
+    void startCapture(const QString &path);
+    void stopCapture();
+    void startReplay(const QString &path, double speed);
+    void stopReplay();
+    void setMlxCalibration(float emissivity, float reflectedShift);
+    void setMlxRawMode(bool raw);
+    void startSeries(char sensor, int frames, bool sendFrames);
+    void setTofFields(quint8 fields);
+
+signals:
+    void framesAvailable();
+    void portStateChanged(bool open, const QString &error);
+    void baudRateChanged(qint32 baudRate);
+    void capabilitiesChanged(const IntegratorCapabilities &capabilities);
+    void captureStateChanged(bool active, const QString &error);
+    void replayStateChanged(bool active, const QString &error);
+    void seriesFinished(const SeriesSummary &summary);
+    void profileReceived(const CpuProfile &profile);
+    void commandFailed(const QString &message);
+
+private slots:
+    void readPort();
+    void baudTimeout();
+    void commandTimeout();
+    void replayNext();
+
+private:
+    enum class BaudState {
+        Idle,
+        WaitSwitch,     // Request sent, waiting for the reply at the old rate
+        WaitConfirm     // Switched, confirmation sent at the new rate
+    };
+
+    struct PendingCommand {
+        quint16 sequence;
+        qint64 sentUs;
+        char command;           // First command letter of the frame, for the messages
+    };
+
+    void sendCommand(const char *data, int length);
+    void onCommandAck(const uint8_t *payload, int length);
+    void clearPendingCommands();
+    void onFrame(const SensorFrame &frame, int frameBytes = 0);
+    void onControlFrame(char id, const uint8_t *payload, int length);
+    void onRawFrame(const SensorFrame &header, const uint8_t *payload, int length);
+    void onAmgRawFrame(const SensorFrame &header, const uint8_t *payload, int length);
+    void onMlxSubpageFrame(const SensorFrame &header, const uint8_t *payload, int length);
+    void emitMlxFrame(const SensorFrame &header, int length);
+    void resetMlx();
+    void requestMlxEeprom();
+    void sendTofFields();
+    void requestBaudRate(int index);
+    void tryNextBaudRate();
+    void setPortBaudRate(qint32 baudRate);
+    void replayRecord(const CaptureRecord &record);
+    void publishCounters();
+
+    QSerialPort *m_port = nullptr;
+    QElapsedTimer m_clock;
+    QTimer *m_baudTimer = nullptr;
+    BaudState m_baudState = BaudState::Idle;
+    int m_baudIndex = 0;
+
+    // Command frames waiting for their acknowledgement, oldest first
+    bool m_framedCommands = false;
+    quint16 m_commandSequence = 0;
+    QVector<PendingCommand> m_pendingCommands;
+    QTimer *m_commandTimer = nullptr;
+
+    FrameParser m_parser;
+    SpscQueue<SensorFrame, QueueCapacity> m_queue;
+    std::atomic<bool> m_notifyPending{false};
+
+    mutable QMutex m_monitorMutex;
+    LinkMonitor m_monitor;
+
+    CaptureWriter m_capture;
+
+    // Raw MLX90640 frames; the EEPROM is requested again while it is missing
+    MlxSolver m_mlxSolver;
+    MlxFrameAssembler m_mlxAssembler;
+    SensorFrame m_mlxFrame;
+    qint64 m_mlxEepromRequestUs = -1;
+    bool m_mlxRaw = false;
+
+    // Raw AMG8833 frames, converted from the pixel registers
+    SensorFrame m_amgFrame;
+
+    // INTEGRATOR_TOF_FIELD_* of every VL53L5CX, sent once the firmware is known to take them
+    quint8 m_tofFields = 0;
+    IntegratorCapabilities m_capabilities;
+
+    // Series statistics being assembled, indexed by integrator_sensor_slot()
+    std::array<SeriesSummary, INTEGRATOR_SENSOR_COUNT> m_series;
+
+    // Replay; speed 0 feeds the records as fast as possible
+    CaptureReader m_replay;
+    QTimer *m_replayTimer = nullptr;
+    QElapsedTimer m_replayClock;
+    CaptureRecord m_replayRecord;
+    bool m_replaying = false;
+    bool m_replayPending = false;
+    double m_replaySpeed = 1.0;
+    qint64 m_replayFirstUs = -1;
+
+    std::atomic<quint64> m_bytesReceived{0};
+    std::atomic<quint64> m_framesParsed{0};
+    std::atomic<quint64> m_crcErrors{0};
+    std::atomic<quint64> m_resyncs{0};
+    std::atomic<quint64> m_codecGaps{0};
+    std::atomic<quint64> m_commandsSent{0};
+    std::atomic<quint64> m_commandsAcked{0};
+    std::atomic<quint64> m_commandsLost{0};
+    std::atomic<quint64> m_commandsRejected{0};
+    std::atomic<quint32> m_commandRttUs{0};
+    std::atomic<quint32> m_commandRttMaxUs{0};
+};
+
+#endif // ACQUISITIONWORKER_H
@@ -0,0 +1,141 @@
+/**
+ * @file capturefile.cpp
+ * @brief Implementation of the CaptureWriter and CaptureReader classes, raw serial recordings.
+ */
+
+#include "capturefile.h"
+
+#include <cstring>
+
+namespace {
+
+const char CaptureMagic[8] = { 'I', 'N', 'T', 'C', 'A', 'P', '0', '1' };
+
+} // namespace
+
+/**
+ * @brief Creates the capture file, replacing an existing one.
+ * @param path File path.
+ * @return True on success.
+ */
+
+bool CaptureWriter::open(const QString &path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    m_stream.setDevice(&m_file);
+    m_stream.setByteOrder(QDataStream::LittleEndian);
+    m_stream.writeRawData(CaptureMagic, sizeof(CaptureMagic));
+    return true;
+}
+
+/**
+ * @brief Flushes and closes the file.
+ */
+
+void CaptureWriter::close()
+{
+    if (m_file.isOpen()) {
+        m_stream.setDevice(nullptr);
+        m_file.close();
+    }
+}
+
+/**
+ * @brief Appends a chunk of received bytes.
+ * @param timeUs Host time at which the chunk was read.
+ * @param data Received bytes.
+ * @param length Number of bytes.
+ */
+
+void CaptureWriter::writeData(qint64 timeUs, const char *data, int length)
+{
+    writeRecord(CaptureRecord::Data, timeUs, data, length);
+}
+
+/**
+ * @brief Records a change of the port baud rate.
+ * @param timeUs Host time of the change.
+ * @param baudRate New baud rate.
+ */
+
+void CaptureWriter::writeBaudRate(qint64 timeUs, qint32 baudRate)
+{
+    char data[4];
+    for (int i = 0; i < 4; ++i)
+        data[i] = static_cast<char>((baudRate >> (8 * i)) & 0xFF);
+    writeRecord(CaptureRecord::BaudRate, timeUs, data, sizeof(data));
+}
+
+void CaptureWriter::writeRecord(CaptureRecord::Type type, qint64 timeUs, const char *data, int length)
+{
+    if (!m_file.isOpen())
+        return;
+    m_stream << static_cast<quint8>(type) << timeUs << static_cast<quint32>(length);
+    m_stream.writeRawData(data, length);
+}
+
+/**
+ * @brief Opens a capture file and checks its header.
+ * @param path File path.
+ * @return True if the file is a capture file.
+ */
+
+bool CaptureReader::open(const QString &path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream.setByteOrder(QDataStream::LittleEndian);
+    char magic[sizeof(CaptureMagic)];
+    if (m_stream.readRawData(magic, sizeof(magic)) != sizeof(magic)
+            || std::memcmp(magic, CaptureMagic, sizeof(magic)) != 0) {
+        m_error = "To nie jest plik nagrania";
+        close();
+        return false;
+    }
+    m_error.clear();
+    return true;
+}
+
+/**
+ * @brief Closes the file.
+ */
+
+void CaptureReader::close()
+{
+    if (m_file.isOpen()) {
+        m_stream.setDevice(nullptr);
+        m_file.close();
+    }
+}
+
+/**
+ * @brief Reads the next record.
+ * @param record Receives the record.
+ * @return False at the end of the file or if the last record is truncated.
+ */
+
+bool CaptureReader::readRecord(CaptureRecord &record)
+{
+    if (!m_file.isOpen() || m_stream.atEnd())
+        return false;
+
+    quint8 type;
+    quint32 length;
+    m_stream >> type >> record.timeUs >> length;
+    if (m_stream.status() != QDataStream::Ok || length > static_cast<quint32>(m_file.size()))
+        return false;
+
+    record.type = static_cast<CaptureRecord::Type>(type);
+    record.data.resize(static_cast<int>(length));
+    return m_stream.readRawData(record.data.data(), static_cast<int>(length)) == static_cast<int>(length);
+}
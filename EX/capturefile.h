@@ -0,0 +1,67 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+
+/**
+ * @brief One record of a raw serial capture.
+ */
+struct CaptureRecord
+{
+    enum Type : quint8 {
+        Data = 0,       ///< Bytes exactly as read from the port
+        BaudRate = 1    ///< Port switched to a new baud rate (data: u32)
+    };
+
+    Type type = Data;
+    qint64 timeUs = 0;  ///< Host time of arrival in microseconds
+    QByteArray data;
+};
+
+/**
+ * @brief Writes the raw byte stream read from the serial port to a file.
+ *
+ * File layout, little-endian:
+ *   "INTCAP01"
+ *   records: u8 type, i64 time [us], u32 length, length bytes
+ */
+class CaptureWriter
+{
+public:
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+    QString errorString() const { return m_file.errorString(); }
+
+    void writeData(qint64 timeUs, const char *data, int length);
+    void writeBaudRate(qint64 timeUs, qint32 baudRate);
+
+private:
+    void writeRecord(CaptureRecord::Type type, qint64 timeUs, const char *data, int length);
+
+    QFile m_file;
+    QDataStream m_stream;
+};
+
+/**
+ * @brief Reads a file written by CaptureWriter record by record.
+ */
+class CaptureReader
+{
+public:
+    bool open(const QString &path);
+    void close();
+    QString errorString() const { return m_error; }
+
+    bool readRecord(CaptureRecord &record);
+
+private:
+    QFile m_file;
+    QDataStream m_stream;
+    QString m_error;
+};
+
+#endif // CAPTUREFILE_H
@@ -0,0 +1,115 @@
+/**
+ * @file cpuprofile.cpp
+ * @brief Decoding of the cycle budget sent by the firmware.
+ */
+
+#include "cpuprofile.h"
+
+/**
+ * @brief Decodes an INTEGRATOR_ID_PROFILE payload.
+ * @param payload Payload of the frame.
+ * @param length Payload length in bytes.
+ * @return False if the payload is too short or empty.
+ *
+ * Stages this application does not know are dropped; they still count in
+ * windowCycles. The pipeline section is optional.
+ */
+
+bool CpuProfile::parse(const uint8_t *payload, int length)
+{
+    if (length < INTEGRATOR_PROFILE_HEADER_SIZE)
+        return false;
+    const int sent = payload[12];
+    if (length < INTEGRATOR_PROFILE_HEADER_SIZE + sent * INTEGRATOR_PROFILE_STAGE_SIZE
+            || integrator_get_u32(&payload[8]) == 0)
+        return false;
+
+    coreHz = integrator_get_u32(&payload[0]);
+    windowUs = integrator_get_u32(&payload[4]);
+    windowCycles = integrator_get_u32(&payload[8]);
+    stages = qMin(sent, INTEGRATOR_PROFILE_STAGES);
+    cycles.fill(0);
+    entries.fill(0);
+    for (int k = 0; k < stages; ++k) {
+        uint32_t stageCycles;
+        uint16_t stageEntries;
+        integrator_profile_get_stage(payload, static_cast<uint8_t>(k), &stageCycles, &stageEntries);
+        cycles[k] = stageCycles;
+        entries[k] = stageEntries;
+    }
+
+    pipeStages = qMin<int>(integrator_profile_pipe_stages(payload, static_cast<uint16_t>(length)), INTEGRATOR_PIPE_STAGES);
+    pipeCycles.fill(0);
+    pipeItems.fill(0);
+    pipeWaits.fill(0);
+    for (int m = 0; m < pipeStages; ++m) {
+        uint32_t stageCycles;
+        uint16_t items;
+        uint16_t waits;
+        integrator_profile_get_pipe(payload, static_cast<uint8_t>(m), &stageCycles, &items, &waits);
+        pipeCycles[m] = stageCycles;
+        pipeItems[m] = items;
+        pipeWaits[m] = waits;
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the part of the window spent in a stage, in percent.
+ */
+
+double CpuProfile::share(int stage) const
+{
+    if (windowCycles == 0 || stage < 0 || stage >= stages)
+        return 0.0;
+    return 100.0 * cycles[stage] / windowCycles;
+}
+
+/**
+ * @brief Returns the part of the window a pipeline stage was busy, in percent.
+ */
+
+double CpuProfile::occupancy(int stage) const
+{
+    if (windowCycles == 0 || stage < 0 || stage >= pipeStages)
+        return 0.0;
+    return 100.0 * pipeCycles[stage] / windowCycles;
+}
+
+/**
+ * @brief Returns the busiest pipeline stage, which sets the frame rate, or -1
+ * if the firmware sent no pipeline.
+ */
+
+int CpuProfile::bottleneck() const
+{
+    int busiest = -1;
+    for (int m = 0; m < pipeStages; ++m) {
+        if (busiest < 0 || pipeCycles[m] > pipeCycles[busiest])
+            busiest = m;
+    }
+    return busiest;
+}
+
+/**
+ * @brief Returns the name of a stage as shown in the application.
+ */
+
+QString CpuProfile::stageName(int stage)
+{
+    static const char *const names[INTEGRATOR_PROFILE_STAGES] = {
+        "Inne", "Bezczynność", "I2C", "VL53L5CX", "MLX90640", "AMG8833",
+        "Kodowanie", "CRC", "ASCII", "UART", "Opóźnienia"
+    };
+    return stage >= 0 && stage < INTEGRATOR_PROFILE_STAGES ? QString::fromUtf8(names[stage]) : QString("?");
+}
+
+/**
+ * @brief Returns the name of a pipeline stage as shown in the application.
+ */
+
+QString CpuProfile::pipeStageName(int stage)
+{
+    static const char *const names[INTEGRATOR_PIPE_STAGES] = { "I2C1", "I2C2", "Konwersja", "UART" };
+    return stage >= 0 && stage < INTEGRATOR_PIPE_STAGES ? QString::fromUtf8(names[stage]) : QString("?");
+}
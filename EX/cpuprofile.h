@@ -0,0 +1,43 @@
+#ifndef CPUPROFILE_H
+#define CPUPROFILE_H
+
+#include <array>
+#include <cstdint>
+
+#include <QMetaType>
+#include <QString>
+
+#include "integrator_profile.h"
+
+/**
+ * @brief Cycle budget of one profiling window of the firmware.
+ *
+ * Decoded from an INTEGRATOR_ID_PROFILE frame, see integrator_profile.h.
+ * Every cycle of the window belongs to exactly one stage, so the stages add
+ * up to windowCycles. The pipeline stages run at the same time and each one
+ * can be busy for the whole window.
+ */
+struct CpuProfile
+{
+    quint32 coreHz = 0;
+    quint32 windowUs = 0;       ///< Window length on the MCU clock
+    quint32 windowCycles = 0;
+    int stages = 0;             ///< Stages sent by the firmware
+    std::array<quint32, INTEGRATOR_PROFILE_STAGES> cycles{};
+    std::array<quint16, INTEGRATOR_PROFILE_STAGES> entries{};   ///< Times the stage was entered, saturating
+    int pipeStages = 0;         ///< Pipeline stages sent, 0 from older firmware
+    std::array<quint32, INTEGRATOR_PIPE_STAGES> pipeCycles{};   ///< Cycles the pipeline stage was busy
+    std::array<quint16, INTEGRATOR_PIPE_STAGES> pipeItems{};
+    std::array<quint16, INTEGRATOR_PIPE_STAGES> pipeWaits{};    ///< Items that found the stage busy or full
+
+    bool parse(const uint8_t *payload, int length);
+    double share(int stage) const;
+    double occupancy(int stage) const;
+    int bottleneck() const;
+    static QString stageName(int stage);
+    static QString pipeStageName(int stage);
+};
+
+Q_DECLARE_METATYPE(CpuProfile)
+
+#endif // CPUPROFILE_H
@@ -9,8 +9,10 @@
  */
 
 #include "datadisplay.h"
+#include "mlxframeassembler.h"
 #include <QToolTip>
 #include <QMouseEvent>
+#include <algorithm>
 #include <cassert>
 //#include "comapre.h"
 //int _MaxVal_Visualize = 2000;
@@ -98,6 +100,13 @@ void DataDisplay::mouseMoveEvent(QMouseEvent *event) {
 
         // Show the tooltip with the pixel value
         QString tooltipText = QString("Value: %1").arg(value);
+        if (sensor == 3) {
+            const uint32_t age = getMLXAge(index);
+            if (age == MlxFrameAssembler::NeverUs)
+                tooltipText = "No data yet";
+            else if (age > 0)
+                tooltipText += QString("\nAge: %1 ms").arg(age / 1000);
+        }
         QToolTip::showText(event->globalPos(), tooltipText, this);
     } else {
         // Hide the tooltip if the cursor is outside the valid range
@@ -193,6 +202,17 @@ void DataDisplay::paintEvent(QPaintEvent *event){
 
             // Set the cell color
             color.setRgb(CellVal, 0, 255 - CellVal);  // Example: red to blue gradient
+
+            // Pixels of the older subpage fade to gray with their age, 1/256 per 10 ms up to 60 %
+            const uint32_t age = getMLXAge(i);
+            if (age == MlxFrameAssembler::NeverUs) {
+                color.setRgb(128, 128, 128);
+            } else if (age > 0) {
+                const int fade = static_cast<int>(std::min<uint32_t>(age / 10000, 154));
+                color.setRgb(color.red() + (128 - color.red()) * fade / 256,
+                             color.green() + (128 - color.green()) * fade / 256,
+                             color.blue() + (128 - color.blue()) * fade / 256);
+            }
             brush.setColor(color);
             painter.setBrush(brush);
 
@@ -17,6 +17,7 @@ class DataDisplay: public QWidget
     int16_t tabVL2[64];
     float tabAMG[64];
     float tabMLX[768];
+    uint32_t tabMLXAge[768] = {};   // Microseconds since the pixel was measured, see MlxFrameAssembler
     int sensor = 0;
 public:
     DataDisplay(QWidget *pParent = nullptr);
@@ -37,6 +38,9 @@ public:
     void setMLX(int i, float meas) {tabMLX[i] = meas;}
     float getMLX(int i){return tabMLX[i];}
 
+    void setMLXAge(int i, uint32_t ageUs) {tabMLXAge[i] = ageUs;}
+    uint32_t getMLXAge(int i){return tabMLXAge[i];}
+
     void setSensor(int i){sensor = i;}
     int getSensor(){return sensor;}
 
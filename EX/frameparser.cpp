@@ -0,0 +1,452 @@
+/**
+ * @file frameparser.cpp
+ * @brief Implementation of the FrameParser class, a streaming decoder for the integrator frames.
+ *
+ * The parser accepts data in arbitrary chunks and recognizes two formats:
+ * - ASCII lines: "X <len> v0 v1 ... <crc> Y\r\n"
+ * - binary frames described in integrator_protocol.h
+ *
+ * Numbers are converted in place with std::from_chars, without building
+ * intermediate strings or lists.
+ *
+ * Both formats are checked with the CRC from integrator_crc16.h, computed over
+ * exactly the bytes the firmware sent. Frames failing the check are dropped
+ * and counted in crcErrors().
+ *
+ * Coded binary frames carry the sensor id with INTEGRATOR_ID_CODED set; they
+ * are decoded with integrator_codec.h and reported under the plain sensor id.
+ */
+
+#include "frameparser.h"
+
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+bool isSensorId(uint8_t c)
+{
+    return !(c & INTEGRATOR_ID_CODED) && integrator_sensor_slot(c) < INTEGRATOR_SENSOR_COUNT;
+}
+
+// Largest grid of the sensor, the values an uncoded frame may carry
+int maxSensorValues(uint8_t id)
+{
+    if (id == INTEGRATOR_ID_MLX90640)
+        return INTEGRATOR_MLX90640_VALUES;
+    if (id == INTEGRATOR_ID_AMG8833)
+        return INTEGRATOR_AMG8833_VALUES;
+    return INTEGRATOR_VL53L5CX_VALUES;
+}
+
+bool isTokenChar(uint8_t c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f')
+        || c == '-' || c == '+' || c == '.' || c == 'Y';
+}
+
+} // namespace
+
+/**
+ * @brief Constructs an empty parser.
+ */
+
+FrameParser::FrameParser()
+{
+    for (int i = 0; i < INTEGRATOR_SENSOR_COUNT; ++i)
+        integrator_codec_init(&m_codec[i], m_codecReference[i], INTEGRATOR_MAX_VALUES);
+    reset();
+}
+
+/**
+ * @brief Drops any partially received frame and empties the ring buffer.
+ */
+
+void FrameParser::reset()
+{
+    m_head = m_tail = 0;
+    m_state = State::Idle;
+    m_tokenLen = m_pendingLen = m_tokenIndex = 0;
+    m_payloadLen = m_payloadPos = 0;
+    for (integrator_codec_state &codec : m_codec)
+        integrator_codec_reset(&codec);
+}
+
+/**
+ * @brief Returns the free, contiguous part of the ring buffer.
+ * @param space Receives the number of bytes that may be written.
+ * @return Pointer to the first free byte.
+ */
+
+char *FrameParser::writeBuffer(int &space)
+{
+    uint32_t offset = m_head & (RingSize - 1);
+    uint32_t freeBytes = RingSize - (m_head - m_tail);
+    space = static_cast<int>(std::min(freeBytes, RingSize - offset));
+    return reinterpret_cast<char *>(m_ring + offset);
+}
+
+/**
+ * @brief Marks bytes written through writeBuffer() as received and parses them.
+ * @param length Number of bytes written.
+ */
+
+void FrameParser::commit(int length)
+{
+    m_head += length;
+    parse();
+}
+
+/**
+ * @brief Parses a chunk of received data.
+ * @param data Received bytes.
+ * @param length Number of bytes.
+ */
+
+void FrameParser::feed(const char *data, int length)
+{
+    while (length > 0) {
+        int space;
+        char *dst = writeBuffer(space);
+        int n = std::min(space, length);
+        std::memcpy(dst, data, n);
+        commit(n);
+        data += n;
+        length -= n;
+    }
+}
+
+void FrameParser::parse()
+{
+    while (m_tail != m_head) {
+        uint32_t offset = m_tail & (RingSize - 1);
+        int n = static_cast<int>(std::min(m_head - m_tail, RingSize - offset));
+        consume(m_ring + offset, n);
+        m_tail += n;
+    }
+}
+
+void FrameParser::startFrame(char sensor, bool binary)
+{
+    m_frame.sensor = sensor;
+    m_frame.binary = binary;
+    m_frame.sequence = 0;
+    m_frame.mcuTimeUs = 0;
+    m_frame.hostTimeUs = m_receiveTimeUs;
+    m_frame.count = 0;
+    m_frame.tof.fields = 0;
+    m_frame.tof.targets = 0;
+    m_frame.tof.zones = 0;
+}
+
+void FrameParser::resync(State next)
+{
+    ++m_resyncs;
+    m_state = next;
+}
+
+void FrameParser::consume(const uint8_t *data, int length)
+{
+    for (int i = 0; i < length; ++i) {
+        uint8_t c = data[i];
+
+        switch (m_state) {
+        case State::Idle:
+            if (c == INTEGRATOR_SYNC_1) {
+                m_state = State::BinSync2;
+            } else if (isSensorId(c)) {
+                startFrame(static_cast<char>(c), false);
+                m_asciiCrc = integrator_crc16_update(INTEGRATOR_CRC16_INIT, &c, 1);
+                m_state = State::AsciiId;
+            } else if (c != '\r' && c != '\n') {
+                m_state = State::SkipLine; // Boot messages and command echoes
+            }
+            break;
+
+        case State::SkipLine:
+            if (c == '\n')
+                m_state = State::Idle;
+            else if (c == INTEGRATOR_SYNC_1)
+                m_state = State::BinSync2;
+            break;
+
+        case State::AsciiId:
+            if (c == ' ') {
+                m_asciiCrc = integrator_crc16_update(m_asciiCrc, &c, 1);
+                m_tokenLen = m_pendingLen = m_tokenIndex = 0;
+                m_state = State::AsciiTokens;
+            } else if (c == INTEGRATOR_SYNC_1) {
+                m_state = State::BinSync2; // Echoed command letter that is also a sensor id
+            } else {
+                m_state = (c == '\n') ? State::Idle : State::SkipLine;
+            }
+            break;
+
+        case State::AsciiTokens:
+            if (c == ' ' || c == '\r' || c == '\n') {
+                if (c == ' ')
+                    m_asciiCrc = integrator_crc16_update(m_asciiCrc, &c, 1);
+                if (!endToken()) {
+                    resync(c == '\n' ? State::Idle : State::SkipLine);
+                } else if (c == '\n') {
+                    if (m_state == State::AsciiTokens)
+                        resync(State::Idle); // Line ended without the closing "Y"
+                    else
+                        m_state = State::Idle;
+                }
+            } else if (isTokenChar(c) && m_tokenLen < MaxToken) {
+                if (m_tokenLen == 0)
+                    m_tokenCrc = m_asciiCrc;
+                m_asciiCrc = integrator_crc16_update(m_asciiCrc, &c, 1);
+                m_token[m_tokenLen++] = static_cast<char>(c);
+            } else {
+                resync(c == INTEGRATOR_SYNC_1 ? State::BinSync2 : State::SkipLine);
+            }
+            break;
+
+        case State::BinSync2:
+            if (c == INTEGRATOR_SYNC_2) {
+                m_headerPos = INTEGRATOR_CRC_START;
+                m_state = State::BinHeader;
+            } else if (c != INTEGRATOR_SYNC_1) {
+                resync(c == '\n' ? State::Idle : State::SkipLine);
+            }
+            break;
+
+        case State::BinHeader:
+            m_header[m_headerPos++] = c;
+            if (m_headerPos == INTEGRATOR_HEADER_SIZE)
+                startBinaryPayload();
+            break;
+
+        case State::BinPayload: {
+            // Copy as much of the payload as this chunk holds in one go
+            int n = std::min(length - i, m_payloadLen - m_payloadPos);
+            std::memcpy(m_payload + m_payloadPos, data + i, n);
+            m_payloadPos += n;
+            i += n - 1;
+            if (m_payloadPos == m_payloadLen)
+                m_state = State::BinCrc1;
+            break;
+        }
+
+        case State::BinCrc1:
+            m_receivedCrc = c;
+            m_state = State::BinCrc2;
+            break;
+
+        case State::BinCrc2:
+            m_receivedCrc |= static_cast<uint16_t>(c) << 8;
+            finishBinaryFrame();
+            m_state = State::Idle;
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Closes the current ASCII token.
+ * @return False if the token is malformed and the line has to be dropped.
+ */
+
+bool FrameParser::endToken()
+{
+    if (m_tokenLen == 0)
+        return true;
+
+    if (m_tokenLen == 1 && m_token[0] == 'Y') {
+        m_tokenLen = 0;
+        if (m_pendingLen == 0)
+            return false;
+        finishAsciiFrame();
+        m_state = State::SkipLine; // Consume the rest of the line ("\r\n")
+        return true;
+    }
+
+    if (m_tokenIndex++ == 0) {
+        m_tokenLen = 0; // Length field, informative only
+        return true;
+    }
+
+    if (m_pendingLen > 0 && !pushPendingValue())
+        return false;
+
+    std::memcpy(m_pending, m_token, m_tokenLen);
+    m_pendingLen = m_tokenLen;
+    m_pendingCrc = m_tokenCrc;
+    m_tokenLen = 0;
+    return true;
+}
+
+bool FrameParser::pushPendingValue()
+{
+    if (m_frame.count >= INTEGRATOR_MAX_VALUES)
+        return false;
+
+    float value;
+    auto result = std::from_chars(m_pending, m_pending + m_pendingLen, value);
+    if (result.ec != std::errc() || result.ptr != m_pending + m_pendingLen)
+        return false;
+
+    m_frame.values[m_frame.count++] = value;
+    return true;
+}
+
+void FrameParser::finishAsciiFrame()
+{
+    unsigned int receivedCrc = 0;
+    auto result = std::from_chars(m_pending, m_pending + m_pendingLen, receivedCrc, 16);
+    m_pendingLen = 0;
+    if (result.ec != std::errc() || result.ptr == m_pending) {
+        ++m_resyncs;
+        return;
+    }
+
+    // The CRC covers the line up to the space in front of the CRC field
+    if (m_pendingCrc != receivedCrc) {
+        ++m_crcErrors;
+        return;
+    }
+
+    emitFrame();
+}
+
+void FrameParser::startBinaryPayload()
+{
+    m_payloadLen = integrator_get_u16(&m_header[3]);
+    m_payloadPos = 0;
+    if (m_payloadLen > INTEGRATOR_MAX_PAYLOAD) {
+        resync();
+        return;
+    }
+
+    startFrame(static_cast<char>(m_header[2]), true);
+    m_frame.sequence = integrator_get_u16(&m_header[5]);
+    m_frame.mcuTimeUs = integrator_get_u32(&m_header[7]);
+    m_state = m_payloadLen ? State::BinPayload : State::BinCrc1;
+}
+
+void FrameParser::finishBinaryFrame()
+{
+    uint16_t crc = integrator_crc16(&m_header[INTEGRATOR_CRC_START], INTEGRATOR_HEADER_SIZE - INTEGRATOR_CRC_START);
+    crc = integrator_crc16_update(crc, m_payload, m_payloadLen);
+    if (crc != m_receivedCrc) {
+        ++m_crcErrors;
+        return;
+    }
+
+    const uint8_t id = static_cast<uint8_t>(m_frame.sensor);
+    if ((id & INTEGRATOR_ID_CODED) && isSensorId(id & ~INTEGRATOR_ID_CODED)) {
+        if (decodeCodedFrame())
+            emitFrame();
+        return;
+    }
+
+    if (id == INTEGRATOR_ID_VL53L5CX_FIELDS) {
+        if (decodeTofFields())
+            emitFrame();
+        return;
+    }
+
+    if (id == INTEGRATOR_ID_MLX90640_RAW || id == INTEGRATOR_ID_AMG8833_RAW || id == INTEGRATOR_ID_MLX90640_SUBPAGE) {
+        ++m_framesParsed;
+        m_frame.count = 0;
+        if (m_rawHandler)
+            m_rawHandler(m_frame, m_payload, m_payloadLen);
+        return;
+    }
+
+    if (!isSensorId(id)) {
+        if (m_controlHandler)
+            m_controlHandler(m_frame.sensor, m_payload, m_payloadLen);
+        return;
+    }
+
+    // Raw frames are longer than any grid, so the payload limit alone does not bound values
+    if ((m_payloadLen & 1) || m_payloadLen > 2 * maxSensorValues(id)) {
+        ++m_resyncs;
+        return;
+    }
+
+    bool thermal = (m_frame.sensor == INTEGRATOR_ID_AMG8833 || m_frame.sensor == INTEGRATOR_ID_MLX90640);
+    m_frame.count = m_payloadLen / 2;
+    for (int i = 0; i < m_frame.count; ++i) {
+        int16_t value = integrator_get_i16(&m_payload[2 * i]);
+        m_frame.values[i] = thermal ? integrator_wire_to_temp(value) : value;
+    }
+
+    emitFrame();
+}
+
+/**
+ * @brief Decodes a delta or sparse coded payload against the previous frame.
+ * @return False if the frame could not be applied and has to be skipped.
+ */
+
+bool FrameParser::decodeCodedFrame()
+{
+    m_frame.sensor = static_cast<char>(static_cast<uint8_t>(m_frame.sensor) & ~INTEGRATOR_ID_CODED);
+    integrator_codec_state &codec = m_codec[integrator_sensor_slot(static_cast<uint8_t>(m_frame.sensor))];
+    int count = integrator_codec_decode(&codec, m_frame.sequence, m_payload, m_payloadLen, m_decoded);
+    if (count < 0) {
+        ++m_codecGaps;
+        return false;
+    }
+
+    bool thermal = (m_frame.sensor == INTEGRATOR_ID_AMG8833 || m_frame.sensor == INTEGRATOR_ID_MLX90640);
+    m_frame.count = count;
+    for (int i = 0; i < count; ++i)
+        m_frame.values[i] = thermal ? integrator_wire_to_temp(m_decoded[i]) : m_decoded[i];
+    return true;
+}
+
+/**
+ * @brief Unpacks a VL53L5CX frame with fields into m_frame.tof.
+ *
+ * The frame is reported under the sensor id from the payload, with the
+ * distances of the first target in values like a plain distance frame.
+ * @return False if the payload does not match its header.
+ */
+
+bool FrameParser::decodeTofFields()
+{
+    integrator_tof_layout layout;
+    if (!integrator_tof_get_header(m_payload, m_payloadLen, &layout) || !integrator_is_vl53l5cx(m_payload[0])) {
+        ++m_resyncs;
+        return false;
+    }
+
+    TofFields &tof = m_frame.tof;
+    m_frame.sensor = static_cast<char>(m_payload[0]);
+    tof.fields = m_payload[1];
+    tof.targets = m_payload[2];
+    tof.zones = m_payload[3];
+    for (int t = 0; t < tof.targets; ++t) {
+        const int first = t * tof.zones;
+        for (int z = 0; z < tof.zones; ++z) {
+            const int v = first + z;
+            tof.distanceMm[t][z] = integrator_get_i16(&m_payload[layout.distance + 2 * v]);
+            if (layout.status)
+                tof.status[t][z] = m_payload[layout.status + v];
+            if (layout.sigma)
+                tof.sigmaMm[t][z] = integrator_get_u16(&m_payload[layout.sigma + 2 * v]);
+            if (layout.signal)
+                tof.signalKcps[t][z] = integrator_get_u16(&m_payload[layout.signal + 2 * v]);
+        }
+    }
+    if (layout.detected)
+        std::memcpy(tof.detected, &m_payload[layout.detected], tof.zones);
+
+    m_frame.count = tof.zones;
+    for (int z = 0; z < tof.zones; ++z)
+        m_frame.values[z] = tof.distanceMm[0][z];
+    return true;
+}
+
+void FrameParser::emitFrame()
+{
+    ++m_framesParsed;
+    if (m_handler)
+        m_handler(m_frame);
+}
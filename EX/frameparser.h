@@ -0,0 +1,193 @@
+#ifndef FRAMEPARSER_H
+#define FRAMEPARSER_H
+
+#include <cstdint>
+#include <functional>
+
+#include "integrator_protocol.h"
+#include "integrator_crc16.h"
+#include "integrator_codec.h"
+#include "integrator_tof.h"
+
+/**
+ * @brief Per-zone fields of a VL53L5CX frame besides the distance (integrator_tof.h).
+ *
+ * Kept as a structure of arrays: one array per field and target, indexed by
+ * zone like SensorFrame::values, so filters and statistics over the zones of
+ * one field read contiguous memory. Only the arrays of the fields in fields
+ * hold data of the frame.
+ */
+struct TofFields
+{
+    static constexpr int MaxTargets = INTEGRATOR_TOF_MAX_TARGETS;
+    static constexpr int MaxZones = INTEGRATOR_VL53L5CX_VALUES;
+
+    uint8_t fields = 0;     ///< INTEGRATOR_TOF_FIELD_* carried, 0 for a plain distance frame
+    int targets = 0;        ///< Targets per zone in the arrays
+    int zones = 0;
+    int16_t distanceMm[MaxTargets][MaxZones];
+    uint8_t detected[MaxZones];             ///< Targets per zone (INTEGRATOR_TOF_FIELD_TARGETS)
+    uint8_t status[MaxTargets][MaxZones];   ///< INTEGRATOR_TOF_FIELD_STATUS
+    uint16_t sigmaMm[MaxTargets][MaxZones]; ///< INTEGRATOR_TOF_FIELD_SIGMA
+    uint16_t signalKcps[MaxTargets][MaxZones];  ///< Per SPAD, INTEGRATOR_TOF_FIELD_SIGNAL
+
+    bool has(uint8_t field) const { return (fields & field) != 0; }
+
+    // Target t of zone z is a valid range; without the status every target counts as one
+    bool valid(int t, int z) const
+    {
+        return !has(INTEGRATOR_TOF_FIELD_STATUS) || integrator_tof_status_valid(status[t][z]);
+    }
+};
+
+/**
+ * @brief One decoded sensor frame, independent of the wire format.
+ *
+ * Only frames that passed the CRC check are delivered.
+ */
+struct SensorFrame
+{
+    char sensor = 0;        ///< Sensor id ('X', 'Z', 'P', 'L')
+    bool binary = false;    ///< True if the frame arrived in the binary format
+    uint16_t sequence = 0;  ///< Per-sensor frame counter (binary frames only)
+    uint32_t mcuTimeUs = 0; ///< MCU timestamp of the reading (binary frames only)
+    int64_t hostTimeUs = 0; ///< Host time at which the frame was received
+    int count = 0;          ///< Number of valid entries in values
+    float values[INTEGRATOR_MAX_VALUES];
+    int subpage = -1;       ///< MLX90640 subpage that updated the frame, -1 if all values are new
+    bool chessPattern = false;  ///< MLX90640 subpages form a chess board, otherwise interleaved rows
+    uint32_t staleAgeUs = 0;    ///< Age of the values of the other subpage (MlxFrameAssembler::NeverUs if missing)
+    TofFields tof;          ///< VL53L5CX fields; values holds the distances of the first target
+};
+
+/**
+ * @brief Incremental parser for the ASCII and binary frames sent by the integrator.
+ *
+ * Bytes are read straight into a fixed ring buffer and run through a byte-level
+ * state machine. Every complete frame is passed to the frame handler as soon as
+ * its last byte arrives, so several frames in one chunk are all delivered.
+ * Boot messages, echoed commands and corrupted data are skipped until the next
+ * line start or sync word. Nothing is allocated while parsing.
+ *
+ * Delta and sparse coded frames (integrator_codec.h) are decoded against the
+ * previous frame of the same sensor and delivered like uncoded ones. After a
+ * lost frame they are skipped until the next keyframe and counted in
+ * codecGaps().
+ *
+ * Raw MLX90640 and AMG8833 frames (INTEGRATOR_ID_MLX90640_RAW,
+ * INTEGRATOR_ID_AMG8833_RAW) and MLX90640 subpages
+ * (INTEGRATOR_ID_MLX90640_SUBPAGE) are passed undecoded to the raw handler,
+ * which converts them to temperatures or merges them into whole images.
+ *
+ * VL53L5CX frames with fields (INTEGRATOR_ID_VL53L5CX_FIELDS) are delivered
+ * under the sensor id with the fields in SensorFrame::tof.
+ *
+ * Uncoded sensor frames with more values than the grid of the sensor, or an
+ * odd payload length, are dropped and counted in resyncs().
+ */
+class FrameParser
+{
+public:
+    using FrameHandler = std::function<void(const SensorFrame &frame)>;
+    using ControlHandler = std::function<void(char id, const uint8_t *payload, int length)>;
+    using RawHandler = std::function<void(const SensorFrame &header, const uint8_t *payload, int length)>;
+
+    static constexpr int RingSize = 8192; // Must be a power of two
+
+    FrameParser();
+
+    void setFrameHandler(FrameHandler handler) { m_handler = std::move(handler); }
+
+    // Binary frames with an id other than a sensor id (link control, replies)
+    void setControlHandler(ControlHandler handler) { m_controlHandler = std::move(handler); }
+
+    // Raw MLX90640 and AMG8833 frames; header carries the id, sequence and timestamps, no values
+    void setRawHandler(RawHandler handler) { m_rawHandler = std::move(handler); }
+
+    // Direct reads: fill at most space bytes at the returned pointer, then commit them
+    char *writeBuffer(int &space);
+    void commit(int length);
+
+    // Host time stamped on the frames completed by the following data
+    void setReceiveTime(int64_t timeUs) { m_receiveTimeUs = timeUs; }
+
+    // Copies and parses a chunk that is already in memory
+    void feed(const char *data, int length);
+
+    void reset();
+
+    uint64_t framesParsed() const { return m_framesParsed; }
+    uint64_t crcErrors() const { return m_crcErrors; }
+    uint64_t resyncs() const { return m_resyncs; }
+    uint64_t codecGaps() const { return m_codecGaps; }
+
+private:
+    enum class State {
+        Idle,          // Line start or right after a binary frame
+        SkipLine,      // Discarding text until '\n' or a sync byte
+        AsciiId,       // Sensor id read, expecting a space
+        AsciiTokens,   // Length, values, CRC and the closing "Y"
+        BinSync2,
+        BinHeader,     // Id, length, sequence and timestamp
+        BinPayload,
+        BinCrc1,
+        BinCrc2
+    };
+
+    void parse();
+    void consume(const uint8_t *data, int length);
+    void startFrame(char sensor, bool binary);
+    void resync(State next = State::SkipLine);
+    bool endToken();
+    bool pushPendingValue();
+    void startBinaryPayload();
+    void finishAsciiFrame();
+    void finishBinaryFrame();
+    bool decodeCodedFrame();
+    bool decodeTofFields();
+    void emitFrame();
+
+    FrameHandler m_handler;
+    ControlHandler m_controlHandler;
+    RawHandler m_rawHandler;
+
+    uint8_t m_ring[RingSize];
+    uint32_t m_head = 0;
+    uint32_t m_tail = 0;
+
+    State m_state = State::Idle;
+    SensorFrame m_frame;
+
+    // ASCII tokens; the last one is held back because it may turn out to be the CRC
+    static constexpr int MaxToken = 16;
+    char m_token[MaxToken];
+    int m_tokenLen = 0;
+    char m_pending[MaxToken];
+    int m_pendingLen = 0;
+    int m_tokenIndex = 0;
+    uint16_t m_asciiCrc = 0;     // Running CRC of the line so far
+    uint16_t m_tokenCrc = 0;     // CRC of the line up to the current token
+    uint16_t m_pendingCrc = 0;   // CRC of the line up to the held back token
+
+    // Binary frame
+    uint8_t m_header[INTEGRATOR_HEADER_SIZE];
+    int m_headerPos = 0;
+    uint8_t m_payload[INTEGRATOR_MAX_PAYLOAD];
+    uint16_t m_payloadLen = 0;
+    uint16_t m_payloadPos = 0;
+    uint16_t m_receivedCrc = 0;
+
+    // Coded frames, the references are indexed by integrator_sensor_slot()
+    integrator_codec_state m_codec[INTEGRATOR_SENSOR_COUNT];
+    int16_t m_codecReference[INTEGRATOR_SENSOR_COUNT][INTEGRATOR_MAX_VALUES];
+    int16_t m_decoded[INTEGRATOR_MAX_VALUES];
+
+    int64_t m_receiveTimeUs = 0;
+
+    uint64_t m_framesParsed = 0;
+    uint64_t m_crcErrors = 0;
+    uint64_t m_resyncs = 0;
+    uint64_t m_codecGaps = 0;
+};
+
+#endif // FRAMEPARSER_H
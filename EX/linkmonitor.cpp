@@ -0,0 +1,120 @@
+/**
+ * @file linkmonitor.cpp
+ * @brief Implementation of the LinkMonitor class, per-sensor loss, jitter and latency accounting.
+ */
+
+#include "linkmonitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Weight of a new sample in the smoothed values, as in the RFC 3550 jitter
+const double SmoothingGain = 1.0 / 16.0;
+
+} // namespace
+
+/**
+ * @brief Constructs a monitor with empty statistics.
+ */
+
+LinkMonitor::LinkMonitor()
+{
+    reset();
+}
+
+/**
+ * @brief Clears all statistics, e.g. after reconnecting.
+ */
+
+void LinkMonitor::reset()
+{
+    m_tracks = {};
+    m_stats = {};
+    m_mcuTimeValid = false;
+    m_offsetMin[0] = m_offsetMin[1] = std::numeric_limits<int64_t>::max();
+    m_windowStartUs = 0;
+}
+
+/**
+ * @brief Accounts one binary frame.
+ * @param frame Decoded frame with the sequence number and both timestamps.
+ * @param frameBytes Size of the frame on the wire.
+ */
+
+void LinkMonitor::addFrame(const SensorFrame &frame, int frameBytes)
+{
+    const uint8_t slot = integrator_sensor_slot(static_cast<uint8_t>(frame.sensor));
+    if (slot >= INTEGRATOR_SENSOR_COUNT)
+        return;
+
+    Track &track = m_tracks[slot];
+    SensorLinkStats &stats = m_stats[slot];
+    ++stats.frames;
+
+    const int64_t mcuUs = unwrapMcuTime(frame.mcuTimeUs);
+    const int64_t hostUs = frame.hostTimeUs;
+
+    // Latency against the estimated clock offset
+    const int64_t wireUs = static_cast<int64_t>(frameBytes) * 10 * 1000000 / m_baudRate;
+    const int64_t offset = clockOffset(hostUs - mcuUs - wireUs, hostUs);
+    const double latency = static_cast<double>(hostUs - mcuUs - offset);
+    stats.latencyUs = stats.frames == 1 ? latency : stats.latencyUs + (latency - stats.latencyUs) * SmoothingGain;
+    stats.maxLatencyUs = std::max(stats.maxLatencyUs, latency);
+
+    if (!track.started) {
+        track.started = true;
+    } else {
+        const uint16_t ahead = static_cast<uint16_t>(frame.sequence - track.nextSequence);
+        if (ahead >= 0x8000) {
+            ++stats.reordered;
+            return;
+        }
+        stats.lost += ahead;
+
+        const double mcuInterval = static_cast<double>(mcuUs - track.lastMcuUs);
+        const double hostInterval = static_cast<double>(hostUs - track.lastHostUs);
+        const double deviation = std::fabs(hostInterval - mcuInterval);
+        stats.jitterUs += (deviation - stats.jitterUs) * SmoothingGain;
+        stats.periodUs = stats.periodUs == 0 ? mcuInterval : stats.periodUs + (mcuInterval - stats.periodUs) * SmoothingGain;
+    }
+
+    track.nextSequence = static_cast<uint16_t>(frame.sequence + 1);
+    track.lastMcuUs = mcuUs;
+    track.lastHostUs = hostUs;
+}
+
+/**
+ * @brief Extends the 32-bit MCU timestamp, which wraps after about 71 minutes.
+ *
+ * Frames of different sensors are not sent in timestamp order, so the new
+ * value is placed nearest to the previous one rather than always after it.
+ */
+
+int64_t LinkMonitor::unwrapMcuTime(uint32_t mcuTimeUs)
+{
+    if (!m_mcuTimeValid) {
+        m_mcuTimeValid = true;
+        m_mcuTimeUs = mcuTimeUs;
+    } else {
+        m_mcuTimeUs += static_cast<int32_t>(mcuTimeUs - static_cast<uint32_t>(m_mcuTimeUs));
+    }
+    return m_mcuTimeUs;
+}
+
+/**
+ * @brief Updates the windowed minimum of the clock offset and returns it.
+ */
+
+int64_t LinkMonitor::clockOffset(int64_t offset, int64_t hostUs)
+{
+    if (hostUs - m_windowStartUs >= OffsetWindowUs) {
+        m_offsetMin[1] = m_offsetMin[0];
+        m_offsetMin[0] = std::numeric_limits<int64_t>::max();
+        m_windowStartUs = hostUs;
+    }
+    m_offsetMin[0] = std::min(m_offsetMin[0], offset);
+    return std::min(m_offsetMin[0], m_offsetMin[1]);
+}
@@ -0,0 +1,71 @@
+#ifndef LINKMONITOR_H
+#define LINKMONITOR_H
+
+#include <array>
+#include <cstdint>
+
+#include "frameparser.h"
+
+/**
+ * @brief Link quality of one sensor stream.
+ */
+struct SensorLinkStats
+{
+    uint64_t frames = 0;        ///< Frames received
+    uint64_t lost = 0;          ///< Sequence numbers skipped
+    uint64_t reordered = 0;     ///< Frames older than one already received (also duplicates)
+    double periodUs = 0;        ///< Smoothed interval between readings on the MCU clock
+    double jitterUs = 0;        ///< Inter-arrival jitter (RFC 3550 estimator)
+    double latencyUs = 0;       ///< Smoothed latency from the reading to the host
+    double maxLatencyUs = 0;
+};
+
+using LinkStatsTable = std::array<SensorLinkStats, INTEGRATOR_SENSOR_COUNT>;
+
+/**
+ * @brief Tracks sequence numbers and timestamps of the binary frames.
+ *
+ * The MCU and host clocks are not synchronized, so the latency is measured
+ * against an estimate of their offset: the smallest (host - MCU) difference
+ * seen in the last OffsetWindowUs to 2 * OffsetWindowUs, after subtracting
+ * the time the frame spent on the wire. The result is a lower bound that
+ * includes the processing on the MCU, the serial transfer and the host side
+ * up to the read. The moving window follows the drift between the crystals.
+ */
+class LinkMonitor
+{
+public:
+    static constexpr int64_t OffsetWindowUs = 5000000;
+
+    LinkMonitor();
+
+    void reset();
+    void setBaudRate(int baudRate) { m_baudRate = baudRate; }
+    void addFrame(const SensorFrame &frame, int frameBytes);
+
+    const LinkStatsTable &stats() const { return m_stats; }
+
+private:
+    struct Track
+    {
+        bool started = false;
+        uint16_t nextSequence = 0;
+        int64_t lastMcuUs = 0;
+        int64_t lastHostUs = 0;
+    };
+
+    int64_t unwrapMcuTime(uint32_t mcuTimeUs);
+    int64_t clockOffset(int64_t offset, int64_t hostUs);
+
+    std::array<Track, INTEGRATOR_SENSOR_COUNT> m_tracks;
+    LinkStatsTable m_stats;
+    int m_baudRate = INTEGRATOR_BAUD_DEFAULT;
+
+    bool m_mcuTimeValid = false;
+    int64_t m_mcuTimeUs = 0;
+
+    int64_t m_offsetMin[2];
+    int64_t m_windowStartUs = 0;
+};
+
+#endif // LINKMONITOR_H
@@ -0,0 +1,63 @@
+/**
+ * @file linkstatsdialog.cpp
+ * @brief Implementation of the LinkStatsDialog class.
+ */
+
+#include "linkstatsdialog.h"
+#include "sensorcapabilities.h"
+
+#include <QHeaderView>
+
+/**
+ * @brief Constructs the dialog with one row per sensor.
+ * @param parent Pointer to the parent widget.
+ */
+
+LinkStatsDialog::LinkStatsDialog(QWidget *parent) :
+    QDialog(parent) {
+    setWindowTitle("Statystyki łącza");
+    resize(760, 200);
+
+    table = new QTableWidget(INTEGRATOR_SENSOR_COUNT, 7, this);
+    table->setHorizontalHeaderLabels(QStringList() << "Ramki" << "Zgubione" << "Poza kolejnością"
+                                                   << "Okres [ms]" << "Jitter [ms]" << "Opóźnienie [ms]"
+                                                   << "Maks. opóźnienie [ms]");
+    QStringList sensors;
+    for (int slot = 0; slot < INTEGRATOR_SENSOR_COUNT; slot++)
+        sensors << IntegratorCapabilities::sensorName(static_cast<char>(integrator_slot_id(slot)));
+    table->setVerticalHeaderLabels(sensors);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(table);
+    setLayout(layout);
+}
+
+/**
+ * @brief Shows the current statistics.
+ * @param stats Statistics indexed by integrator_sensor_slot().
+ */
+
+void LinkStatsDialog::updateStats(const LinkStatsTable &stats) {
+    for (int row = 0; row < INTEGRATOR_SENSOR_COUNT; row++) {
+        const SensorLinkStats &s = stats[row];
+        const QStringList values = {
+            QString::number(s.frames),
+            QString::number(s.lost),
+            QString::number(s.reordered),
+            QString::number(s.periodUs / 1000.0, 'f', 1),
+            QString::number(s.jitterUs / 1000.0, 'f', 2),
+            QString::number(s.latencyUs / 1000.0, 'f', 1),
+            QString::number(s.maxLatencyUs / 1000.0, 'f', 1)
+        };
+        for (int col = 0; col < values.size(); col++) {
+            QTableWidgetItem *item = table->item(row, col);
+            if (!item) {
+                item = new QTableWidgetItem();
+                table->setItem(row, col, item);
+            }
+            item->setText(values[col]);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef LINKSTATSDIALOG_H
+#define LINKSTATSDIALOG_H
+
+#include <QDialog>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+#include "linkmonitor.h"
+
+/**
+ * @brief Window with the per-sensor link statistics (losses, jitter, latency).
+ */
+class LinkStatsDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit LinkStatsDialog(QWidget *parent = nullptr);
+
+    void updateStats(const LinkStatsTable &stats);
+
+private:
+    QTableWidget *table;
+};
+
+#endif // LINKSTATSDIALOG_H
@@ -1,11 +1,35 @@
 #include "mainwindow.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
-    MainWindow w;
+
+    // Replay of a raw capture, e.g. for profiling without the board:
+    //   EX --replay session.intcap --speed 0 --quit
+    // or of the firmware simulator (Mikrokontroler/Testy/Host/integrator_sim):
+    //   EX --port /tmp/ttyINT
+    // Raw MLX90640 frames in a capture are solved again with the given calibration:
+    //   EX --replay session.intcap --emissivity 0.98 --reflected-shift 5
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption replayOption("replay", "Odtwarza nagranie surowych danych.", "plik");
+    QCommandLineOption speedOption("speed", "Prędkość odtwarzania (0 - maksymalna).", "n", "1");
+    QCommandLineOption portOption("port", "Port szeregowy integratora.", "urządzenie", "/dev/ttyACM0");
+    QCommandLineOption quitOption("quit", "Kończy program po odtworzeniu nagrania i wypisuje statystyki.");
+    QCommandLineOption emissivityOption("emissivity", "Emisyjność dla surowych ramek MLX90640.", "e",
+                                        QString::number(MlxSolver::DefaultEmissivity));
+    QCommandLineOption reflectedOption("reflected-shift", "Temperatura odbita: temperatura czujnika MLX90640 minus n stopni.",
+                                       "n", QString::number(MlxSolver::DefaultReflectedShift));
+    parser.addOptions({ portOption, replayOption, speedOption, quitOption, emissivityOption, reflectedOption });
+    parser.process(a);
+
+    MainWindow w(nullptr, parser.value(portOption));
+    w.setMlxCalibration(parser.value(emissivityOption).toFloat(), parser.value(reflectedOption).toFloat());
     w.show();
+    if (parser.isSet(replayOption))
+        w.startReplay(parser.value(replayOption), parser.value(speedOption).toDouble(), parser.isSet(quitOption));
     return a.exec();
 }
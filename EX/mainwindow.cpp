@@ -18,16 +18,19 @@
 #include "ui_table_termo.h"
 #include <QMediaDevices>
 #include <QDebug>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QSignalBlocker>
 #include <camerawindow.h>
 // #include "comapre.h"
 // #include "datadisplay.h"
 
 #include <QtEndian>
 
+#include "integrator_protocol.h"
+#include "mlxframeassembler.h"
+
 #define BILLION  1000000000L;
-//#define CRC16 0x1021
-#define CRC16_INIT 0
-#define CRC16_POLYNOMIAL 0x8005
 
 float temp[768];
 QString path = " ";
@@ -39,6 +42,48 @@ int measurements = 0;
 
 struct timespec start, stop;
 
+// Grids drawn by the views; frames of another geometry are mapped onto them
+const int TofViewWidth = 8, TofViewHeight = 8;
+const int AmgViewWidth = 8, AmgViewHeight = 8;
+const int MlxViewWidth = 32, MlxViewHeight = 24;
+
+/**
+ * @brief Maps a sensor grid onto the grid of a view, taking the nearest zone.
+ *
+ * A 4x4 VL53L5CX frame, for example, fills the 8x8 views with 2x2 blocks.
+ */
+
+static void resampleGrid(const float *src, int srcWidth, int srcHeight, float *dst, int dstWidth, int dstHeight)
+{
+    for (int y = 0; y < dstHeight; y++) {
+        const float *row = src + (y * srcHeight / dstHeight) * srcWidth;
+        for (int x = 0; x < dstWidth; x++)
+            dst[y * dstWidth + x] = row[x * srcWidth / dstWidth];
+    }
+}
+
+/**
+ * @brief Tells whether the firmware reads a sensor in a mode, like mode_reads() in main.c.
+ *
+ * Until a mode is selected the firmware runs in mode B, the one it boots in.
+ */
+
+static bool modeReads(char mode, char id)
+{
+    switch (mode == ' ' ? 'B' : mode) {
+    case 'A': return true;
+    case 'B': return id == INTEGRATOR_ID_VL53L5CX_1;
+    case 'C': return id == INTEGRATOR_ID_VL53L5CX_2;
+    case 'D': return id == INTEGRATOR_ID_MLX90640;
+    case 'E': return id == INTEGRATOR_ID_AMG8833;
+    case 'F': return id != INTEGRATOR_ID_MLX90640;
+    case 'G': return id != INTEGRATOR_ID_AMG8833;
+    case 'H': return integrator_is_vl53l5cx(static_cast<uint8_t>(id));
+    case 'I': return id == INTEGRATOR_ID_MLX90640 || id == INTEGRATOR_ID_AMG8833;
+    default:  return false;
+    }
+}
+
 /**
  * @brief Constructs the MainWindow object.
  *
@@ -47,7 +92,7 @@ struct timespec start, stop;
  * @param parent Pointer to the parent widget.
  */
 
-MainWindow::MainWindow(QWidget *parent)
+MainWindow::MainWindow(QWidget *parent, const QString &portName)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 //    , m_dataDisplay(new DataDisplay())
@@ -56,14 +101,29 @@ MainWindow::MainWindow(QWidget *parent)
     //m_camera(new CameraWidget())
 {
     ui->setupUi(this);
-    Port = new QSerialPort();
-    Port->setPortName("/dev/ttyACM0");
-    Port->setBaudRate(QSerialPort::BaudRate::Baud115200);
-    Port->setParity(QSerialPort::Parity::NoParity);
-    Port->setDataBits(QSerialPort::DataBits::Data8);
-    Port->setStopBits(QSerialPort::StopBits::OneStop);
-    Port->setFlowControl(QSerialPort::FlowControl::NoFlowControl);
-    Port->open(QIODevice::ReadWrite);
+
+    // Serial I/O and frame decoding run on their own thread
+    acquisitionThread = new QThread(this);
+    acquisition = new AcquisitionWorker();
+    acquisition->moveToThread(acquisitionThread);
+    connect(acquisitionThread, &QThread::finished, acquisition, &QObject::deleteLater);
+    connect(acquisition, &AcquisitionWorker::portStateChanged, this, &MainWindow::portStateChanged);
+    connect(acquisition, &AcquisitionWorker::baudRateChanged, this, &MainWindow::baudRateChanged);
+    connect(acquisition, &AcquisitionWorker::capabilitiesChanged, this, &MainWindow::capabilitiesChanged);
+    connect(acquisition, &AcquisitionWorker::commandFailed, this, &MainWindow::commandFailed);
+    connect(acquisition, &AcquisitionWorker::captureStateChanged, this, &MainWindow::captureStateChanged);
+    connect(acquisition, &AcquisitionWorker::replayStateChanged, this, &MainWindow::replayStateChanged);
+    connect(this, &MainWindow::sendToPort, acquisition, &AcquisitionWorker::writeData);
+    // Series computed by the firmware; each table takes the summaries of its own sensors
+    connect(m_table, &table::seriesRequested, acquisition, &AcquisitionWorker::startSeries);
+    connect(m_table_termo, &table_termo::seriesRequested, acquisition, &AcquisitionWorker::startSeries);
+    connect(acquisition, &AcquisitionWorker::seriesFinished, m_table, &table::showSeriesSummary);
+    connect(acquisition, &AcquisitionWorker::seriesFinished, m_table_termo, &table_termo::showSeriesSummary);
+    updateSeriesSensors();
+    acquisitionThread->start();
+    QMetaObject::invokeMethod(acquisition, [worker = acquisition, portName] {
+        worker->openPort(portName, INTEGRATOR_BAUD_DEFAULT);
+    }, Qt::QueuedConnection);
 
     dialog = new Dialog(this);
     ui->dioda->setPixmap(QPixmap(":/img/diodaOff.png").scaled(widthD, heightD, Qt::KeepAspectRatio));
@@ -80,6 +140,13 @@ MainWindow::MainWindow(QWidget *parent)
     timer = new QTimer(this);
     timer->start(1100);
     QObject::connect(timer, SIGNAL(timeout()), this, SLOT(get_path()));
+    QObject::connect(timer, SIGNAL(timeout()), this, SLOT(updateLinkStats()));
+
+    linkStatsLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(linkStatsLabel);
+    linkStatsDialog = new LinkStatsDialog(this);
+    profileDialog = new ProfileDialog(this);
+    connect(acquisition, &AcquisitionWorker::profileReceived, profileDialog, &ProfileDialog::addProfile);
 
     connect(ui->languageComboBox, QOverload<int>::of(&QComboBox::activated), this, &MainWindow::on_languageComboBox_activated);
 
@@ -92,6 +159,8 @@ MainWindow::MainWindow(QWidget *parent)
  */
 
 MainWindow::~MainWindow() {
+    acquisitionThread->quit();
+    acquisitionThread->wait();
     delete ui;
     //delete cameraWindow; // Clean up camera window on destruction
 //    delete m_dataDisplay;
@@ -189,214 +258,313 @@ void MainWindow::showDataTableTermo() {
 }
 
 /**
- * @brief Reads data from the serial port.
+ * @brief Takes the frames decoded by the acquisition thread.
+ *
+ * Called through a queued framesAvailable() signal. Everything queued so far is
+ * handled here; frames that arrived while the GUI was busy may already have been
+ * replaced by newer ones.
  */
 
 void MainWindow::read_Data()
 {
-    if (Port->isOpen())
+    acquisition->rearmNotification();
+    while (acquisition->popFrame(receivedFrame))
     {
-        //qDebug() << "Port otwarty\n";
-        while (Port->bytesAvailable())
-        {
-            Data_From_Port += Port->readAll();
-            if (Data_From_Port.at(Data_From_Port.length() -1) == char(10))
-            {
-                Is_Data_Received = true;
-            }
-        }
-        if (Is_Data_Received == true){
-            list = Data_From_Port.split(" ");
-            //dataTableDialog->updateTable(row, col, value);
-            //int it = 0;
-
-            bool ok;
-            unsigned short int receivedCrc = list.at(list.size() - 2).toUInt(&ok, 16);
-
-            // QByteArray data;
-            // for (const QString &part : list) {
-            //     data.append(part.toUtf8());
-            // }
-
-            QByteArray data;
-            for (int i = 2; i < list.size() - 2; ++i) {
-                uint16_t value = list[i].toUInt(); // Assuming values are 16-bit integers
-                data.append(reinterpret_cast<const char*>(&value), sizeof(value));
-            }
+        handleFrame(receivedFrame);
+    }
+}
 
-            // QByteArray rawData = Port->readAll();
-            // rawData.chop(1); // Remove trailing newline character
-            // unsigned short int calculatedCrc = ComputeCRC16(rawData.data(), rawData.size(), CRC16_POLYNOMIAL, CRC16_INIT);
+/**
+ * @brief Stores the port state reported by the acquisition thread.
+ * @param open True if the port is open.
+ * @param error Error description when opening failed.
+ */
 
-            // Build QByteArray for numeric data
-            // QByteArray data;
-            // for (int i = 2; i < list.size() - 2; ++i) { // Skip the last two elements
-            //     uint16_t value = list[i].toUInt(&ok);
-            //     if (ok) {
-            //         value = qToLittleEndian(value); // Convert to little-endian
-            //         data.append(reinterpret_cast<const char*>(&value), sizeof(value));
-            //     }
-            // }
+void MainWindow::portStateChanged(bool open, const QString &error)
+{
+    portOpen = open;
+    portError = error;
+    // Another device, or the same one after a reset: every setting is sent again
+    forgetFrameFormat();
+    if (!open && !error.isEmpty())
+        qDebug() << "Port nie został otwarty:" << error;
+}
 
+/**
+ * @brief Shows the baud rate agreed with the firmware.
+ * @param baudRate Current baud rate of the serial port.
+ */
 
-            // Compute CRC
-            //unsigned short int calculatedCrc = ComputeCRC16(data.data(), data.size(), 0x1021, 0xFFFF);
+void MainWindow::baudRateChanged(qint32 baudRate)
+{
+    linkBaudRate = baudRate;
+    statusBar()->showMessage(QString("Prędkość łącza: %1 bit/s").arg(baudRate), 5000);
+}
 
+/**
+ * @brief Takes over the sensor set and grid sizes reported by the firmware.
+ * @param reported Decoded capability descriptor.
+ */
 
-            unsigned short int calculatedCrc = ComputeCRC16(data.data(), data.size(), CRC16_POLYNOMIAL, CRC16_INIT);
+void MainWindow::capabilitiesChanged(const IntegratorCapabilities &reported)
+{
+    capabilities = reported;
+    statusBar()->showMessage(capabilities.describe(), 10000);
+    updateSeriesSensors();
+}
 
-            // Validate CRC
-            if (calculatedCrc == receivedCrc) {
-                qDebug() << "CRC Match: Data is valid. Comp = " << calculatedCrc << ", Reci = " << receivedCrc;
-                // Process data here
-            } else {
-                qDebug() << "CRC Mismatch: Data is corrupted. Comp = " << calculatedCrc << ", Reci = " << receivedCrc;
-                qDebug() << "Received CRC String:" << receivedCrc;
-                //qDebug() << "crc: " << list.at(66);
-            }
+/**
+ * @brief Limits the series on the MCU to the sensors present and read in the current mode.
+ *
+ * A series of a sensor that is missing or not read would never report, and
+ * the table would wait for its summary.
+ */
 
-            if( list.at(0) == 'X'){
-                // uint16_t receivedCrc = list.last().toUInt(nullptr, 15); // Assuming CRC is the last element
-                // list.removeLast(); // Remove CRC from the list to process data
-
-                // // Compute CRC for received data
-                // uint16_t computedCrc = calculateCRC16(reinterpret_cast<uint16_t *>(list.data()), list.size());
-
-                // if (computedCrc == receivedCrc) {
-                //     qDebug() << "CRC match. Processing data...";
-                //     // Process the data
-                // } else {
-                //     qDebug() << "CRC mismatch. Data corrupted.";
-                // }
-
-                bool useMSE = (m_table->ui->errorMetricComboBox->currentText() == "Mean Squared Error");
-
-                for (int i = 0; i < 64; i++){
-                    ui->mainWidget->setVL1(63-i,list[i+2].toInt());
-                    //qDebug() << "ZAPISANA: " << ui->mainWidget->getVL1(63-i);
-
-                    m_table->ui->mainWidget->setVL1(63-i,list[i+2].toInt()); //data flow to datadisplay widget
-                    m_table->ui->mainWidget_4->setVL1(63-i,list[i+2].toInt()); //data flow to datadispalytext widget
-                    m_table->ui->mainWidget_3->setVL1(63-i,list[i+2].toInt()); //data flow to gauss widget
-                    int row = i / 8; // Determine the row (0-7)
-                    int col = i % 8; // Determine the column (0-7)
-                    int value = ui->mainWidget->getVL1(i); // Get the value for the current index
-                    m_table->updateTable_1(row, col, value); // Update the table with the row, column, and value
-                    //m_table->calculateMaxError(row, col, value);
-
-                    //if (m_table->isMeasurementSeriesActive) {
-                    m_table->calculateMaxError_1(row, col, value, useMSE);
-                    //}
-                    //qDebug() << "ODCZYTANA: " << list[i+2].toInt();
-                    //qDebug() << "test:" << dTab.tabVL1[63-i];
+void MainWindow::updateSeriesSensors()
+{
+    auto available = [this](char id) {
+        return capabilities.sensor(id).present && modeReads(symbol, id);
+    };
+    m_table->setSeriesSensors(available(INTEGRATOR_ID_VL53L5CX_1), available(INTEGRATOR_ID_VL53L5CX_2));
+    m_table_termo->setSeriesSensors(available(INTEGRATOR_ID_MLX90640), available(INTEGRATOR_ID_AMG8833));
+}
 
-                }
-                // // Increment the global measurement count
-                // if (m_table->isMeasurementSeriesActive) {
-                //     m_table->currentMeasurementCount++;
-
-                //     // If 5 measurements have been completed, end the series
-                //     if (m_table->currentMeasurementCount == 5) {
-                //         m_table->isMeasurementSeriesActive = false;
-                //         m_table->currentMeasurementCount = 0;
-                //         qDebug() << "Measurement series completed. Table_3 updated.";
-                //     }
-                // }
-
-                //Data_From_Port="";
-                /*if(list.at(18) == crc_result){
-                    qDebug() << "CRC zgadza się\n";
-                    qDebug() << "Ramka odebrana\n";
-                    Data_From_Port="";
-                }*/
-
-                Data_From_Port="";
-            }
-            else if( list.at(0) == 'Z'){
-                bool useMSE = (m_table->ui->errorMetricComboBox->currentText() == "Mean Squared Error");
-
-                for (int i = 0; i < 64; i++){
-                    ui->mainWidget->setVL2(63-i,list[i+2].toInt());
-                    //qDebug() << "ZAPISANA: " << ui->mainWidget->getVL2(63-i);
-
-                    m_table->ui->mainWidget_2->setVL2(63-i,list[i+2].toInt());
-                    m_table->ui->mainWidget_6->setVL2(63-i,list[i+2].toInt()); //data flow to datadispalytext widget
-                    m_table->ui->mainWidget_5->setVL2(63-i,list[i+2].toInt()); //data flow to gauss widget
-                    int row = i / 8; // Determine the row (0-7)
-                    int col = i % 8; // Determine the column (0-7)
-                    int value = ui->mainWidget->getVL2(i); // Get the value for the current index
-                    m_table->updateTable_2(row, col, value); // Update the table with the row, column, and value
-                    //qDebug() << "ODCZYTANA: " << list[i+2].toInt();
-                    m_table->calculateMaxError_2(row, col, value, useMSE);
-                }
-                //Data_From_Port="";
-                /*qDebug() << list[18];
-                if(list.at(18) == crc_result){
-                    Data_From_Port="";
-                }*/
-                Data_From_Port="";
-            }
-            else if( list.at(0) == 'P'){
-                bool useMSE = (m_table_termo->ui->errorMetricComboBox->currentText() == "Mean Squared Error");
-
-                for (int i = 0; i < 64; i++){
-                    float meas = list[i+2].toFloat();
-                    ui->mainWidget->setAMG(63-i,meas);
-
-                    m_table_termo->ui->mainWidget_2->setAMG(63-i,meas); //data flow to datadisplay widget
-                    m_table_termo->ui->mainWidget_6->setAMG(63-i,meas); //data flow to datadispalytext widget
-                    int row = i / 8; // Determine the row (0-7)
-                    int col = i % 8; // Determine the column (0-7)
-                    int value = ui->mainWidget->getAMG(i); // Get the value for the current index
-                    m_table_termo->updateTable_2(row, col, value); // Update the table with the row, column, and value
-                    //m_table->calculateMaxError(row, col, value);
-
-                    //if (m_table->isMeasurementSeriesActive) {
-                    m_table_termo->calculateMaxError_2(row, col, value, useMSE);
-                    // qDebug() << "ZAPISANA: " << ui->mainWidget->getAMG(63-i);
-                    // qDebug() << "ODCZYTANA: " << list[i+2].toFloat();
-                }
-                //Data_From_Port="";
-                /*if(list.at(66) == crc_result){
-                    Data_From_Port="";
-                }*/
-                Data_From_Port="";
-            }
-            else if( list.at(0) == 'L'){
-                bool useMSE = (m_table_termo->ui->errorMetricComboBox->currentText() == "Mean Squared Error");
-
-                for (int i = 0; i < 768; ++i){
-                    ui->mainWidget->setMLX(767-i,list[i+2].toFloat());
-
-                    m_table_termo->ui->mainWidget->setMLX(767-i,list[i+2].toFloat()); //data flow to datadisplay widget
-                    m_table_termo->ui->mainWidget_4->setMLX(767-i,list[i+2].toFloat()); //data flow to datadispalytext widget
-                    int row = i / 32; // Determine the row (0-7)
-                    int col = i % 32; // Determine the column (0-7)
-                    int value = ui->mainWidget->getMLX(i); // Get the value for the current index
-                    m_table_termo->updateTable_1(row, col, value); // Update the table with the row, column, and value
-                    //m_table->calculateMaxError(row, col, value);
-
-                    //if (m_table->isMeasurementSeriesActive) {
-                    m_table_termo->calculateMaxError_1(row, col, value, useMSE);
-                    // qDebug() << "ZAPISANA: " << ui->mainWidget->getMLX(767-i);
-                    // qDebug() << "ODCZYTANA: " << list[i+2].toFloat();
-                }
+/**
+ * @brief Reports a command the firmware lost or did not accept.
+ * @param message Description of the failure.
+ */
 
-                Data_From_Port="";
-                /*if(list.at(770) == crc_result){
-                    Data_From_Port="";
-                }*/
-                //Data_From_Port="";
-            }
-            else
-            {
-                //qDebug() << "Niepoprawna ramka danych!\n";
-                Data_From_Port="";
+void MainWindow::commandFailed(const QString &message)
+{
+    statusBar()->showMessage(message, 5000);
+}
+
+/**
+ * @brief Reports the state of the raw data recording.
+ * @param active True while recording.
+ * @param error Error description when the file could not be created.
+ */
+
+void MainWindow::captureStateChanged(bool active, const QString &error)
+{
+    QSignalBlocker blocker(ui->actionNagrywanie);
+    ui->actionNagrywanie->setChecked(active);
+    if (!error.isEmpty())
+        statusBar()->showMessage("Nie udało się rozpocząć nagrywania: " + error, 5000);
+    else
+        statusBar()->showMessage(active ? "Nagrywanie surowych danych" : "Nagrywanie zakończone", 5000);
+}
+
+/**
+ * @brief Reports the start and the end of a replay.
+ * @param active True while the replay is running.
+ * @param error Error description when the file could not be read.
+ */
+
+void MainWindow::replayStateChanged(bool active, const QString &error)
+{
+    const bool finished = replayActive && !active;
+    replayActive = active;
+    if (active)
+        profileDialog->clear();
+    if (!error.isEmpty())
+        statusBar()->showMessage("Nie udało się odtworzyć nagrania: " + error, 5000);
+    else
+        statusBar()->showMessage(active ? "Odtwarzanie nagrania" : "Odtwarzanie zakończone", 5000);
+
+    if (quitAfterReplay && !active) {
+        if (finished) {
+            read_Data();
+            LinkStats stats = acquisition->stats();
+            qInfo().noquote() << QString("Bajty: %1, ramki: %2, błędy CRC: %3, resynchronizacje: %4, pominięte: %5, "
+                                         "bez klatki kluczowej: %6")
+                                     .arg(stats.bytesReceived).arg(stats.framesParsed).arg(stats.crcErrors)
+                                     .arg(stats.resyncs).arg(stats.framesDropped).arg(stats.codecGaps);
+            LinkStatsTable sensorStats = acquisition->sensorStats();
+            for (int i = 0; i < INTEGRATOR_SENSOR_COUNT; i++) {
+                const SensorLinkStats &s = sensorStats[i];
+                if (s.frames == 0 && capabilities.sensors[i].id == 0)
+                    continue;
+                qInfo().noquote() << QString("%1: ramki %2, zgubione %3, poza kolejnością %4, jitter %5 ms, opóźnienie %6 ms")
+                                         .arg(static_cast<char>(integrator_slot_id(i))).arg(s.frames).arg(s.lost).arg(s.reordered)
+                                         .arg(s.jitterUs / 1000.0, 0, 'f', 2).arg(s.latencyUs / 1000.0, 0, 'f', 1);
             }
-            Is_Data_Received = false;
         }
-    } else {
-        qDebug() << "Port nie został otwarty\n";
+        qApp->exit(error.isEmpty() ? 0 : 1);
+    }
+}
+
+/**
+ * @brief Replays a raw capture through the parser and the views.
+ * @param path Capture file.
+ * @param speed Playback speed relative to the recording; 0 means as fast as possible.
+ * @param quitWhenDone Print the link statistics and quit once the file has been played.
+ */
+
+void MainWindow::startReplay(const QString &path, double speed, bool quitWhenDone)
+{
+    quitAfterReplay = quitWhenDone;
+    connect(acquisition, &AcquisitionWorker::framesAvailable, this, &MainWindow::read_Data, Qt::UniqueConnection);
+    read_Data();
+    QMetaObject::invokeMethod(acquisition, [worker = acquisition, path, speed] {
+        worker->startReplay(path, speed);
+    }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Sets the MLX90640 emissivity and reflected temperature used for the raw frames.
+ * @param emissivity Emissivity of the observed surfaces, 0..1.
+ * @param reflectedShift The reflected temperature is the sensor temperature minus this value.
+ */
+
+void MainWindow::setMlxCalibration(float emissivity, float reflectedShift)
+{
+    QMetaObject::invokeMethod(acquisition, [worker = acquisition, emissivity, reflectedShift] {
+        worker->setMlxCalibration(emissivity, reflectedShift);
+    }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Shows the link counters in the status bar.
+ */
+
+void MainWindow::updateLinkStats()
+{
+    LinkStats stats = acquisition->stats();
+    LinkStatsTable sensorStats = acquisition->sensorStats();
+    quint64 lost = 0;
+    for (const SensorLinkStats &s : sensorStats)
+        lost += s.lost;
+
+    QString text = QString("%1 bit/s | Ramki: %2 | Zgubione: %3 | Pominięte: %4 | Błędy CRC: %5")
+                       .arg(linkBaudRate)
+                       .arg(stats.framesParsed)
+                       .arg(lost)
+                       .arg(stats.framesDropped)
+                       .arg(stats.crcErrors);
+    // Only firmware that acknowledges command frames gives a round trip time
+    if (stats.commandsAcked > 0)
+        text += QString(" | RTT poleceń: %1 ms (maks. %2 ms)")
+                    .arg(stats.commandRttUs / 1000.0, 0, 'f', 1)
+                    .arg(stats.commandRttMaxUs / 1000.0, 0, 'f', 1);
+    if (stats.commandsLost + stats.commandsRejected > 0)
+        text += QString(" | Polecenia bez skutku: %1").arg(stats.commandsLost + stats.commandsRejected);
+    linkStatsLabel->setText(text);
+    if (linkStatsDialog->isVisible())
+        linkStatsDialog->updateStats(sensorStats);
+}
+
+/**
+ * @brief Passes one decoded frame to the main view and the comparison tables.
+ * @param frame Frame delivered by the parser, values in transmission order.
+ */
+
+void MainWindow::handleFrame(const SensorFrame &frame)
+{
+    const char sensor = frame.sensor;
+    const SensorCapability &geometry = capabilities.sensor(sensor);
+    if (geometry.values() == 0 || frame.count < geometry.values())
+        return;
+    // Only the first two VL53L5CX have views, the others show in the link statistics
+    if (sensor == INTEGRATOR_ID_VL53L5CX_3 || sensor == INTEGRATOR_ID_VL53L5CX_4)
+        return;
+
+    // Sensors reporting another grid than the views draw (e.g. 4x4 ToF) are resampled
+    float resampled[INTEGRATOR_MAX_VALUES];
+    const float *values = frame.values;
+    int viewWidth = TofViewWidth, viewHeight = TofViewHeight;
+    if (sensor == INTEGRATOR_ID_AMG8833) {
+        viewWidth = AmgViewWidth;
+        viewHeight = AmgViewHeight;
+    } else if (sensor == INTEGRATOR_ID_MLX90640) {
+        viewWidth = MlxViewWidth;
+        viewHeight = MlxViewHeight;
+    }
+    if (geometry.width != viewWidth || geometry.height != viewHeight) {
+        resampleGrid(frame.values, geometry.width, geometry.height, resampled, viewWidth, viewHeight);
+        values = resampled;
+    }
+
+    // Zones whose first target the sensor marked invalid keep their last value
+    const bool checkStatus = values == frame.values && frame.tof.has(INTEGRATOR_TOF_FIELD_STATUS);
+
+    if (sensor == INTEGRATOR_ID_VL53L5CX_1){
+        bool useMSE = (m_table->ui->errorMetricComboBox->currentText() == "Mean Squared Error");
+
+        for (int i = 0; i < 64; i++){
+            if (checkStatus && !frame.tof.valid(0, i))
+                continue;
+            int meas = static_cast<int>(values[i]);
+            ui->mainWidget->setVL1(63-i,meas);
+
+            m_table->ui->mainWidget->setVL1(63-i,meas); //data flow to datadisplay widget
+            m_table->ui->mainWidget_4->setVL1(63-i,meas); //data flow to datadispalytext widget
+            m_table->ui->mainWidget_3->setVL1(63-i,meas); //data flow to gauss widget
+            int row = i / 8; // Determine the row (0-7)
+            int col = i % 8; // Determine the column (0-7)
+            int value = ui->mainWidget->getVL1(i); // Get the value for the current index
+            m_table->updateTable_1(row, col, value); // Update the table with the row, column, and value
+            m_table->calculateMaxError_1(row, col, value, useMSE);
+        }
+    }
+    else if (sensor == INTEGRATOR_ID_VL53L5CX_2){
+        bool useMSE = (m_table->ui->errorMetricComboBox->currentText() == "Mean Squared Error");
+
+        for (int i = 0; i < 64; i++){
+            if (checkStatus && !frame.tof.valid(0, i))
+                continue;
+            int meas = static_cast<int>(values[i]);
+            ui->mainWidget->setVL2(63-i,meas);
+
+            m_table->ui->mainWidget_2->setVL2(63-i,meas);
+            m_table->ui->mainWidget_6->setVL2(63-i,meas); //data flow to datadispalytext widget
+            m_table->ui->mainWidget_5->setVL2(63-i,meas); //data flow to gauss widget
+            int row = i / 8; // Determine the row (0-7)
+            int col = i % 8; // Determine the column (0-7)
+            int value = ui->mainWidget->getVL2(i); // Get the value for the current index
+            m_table->updateTable_2(row, col, value); // Update the table with the row, column, and value
+            m_table->calculateMaxError_2(row, col, value, useMSE);
+        }
+    }
+    else if (sensor == INTEGRATOR_ID_AMG8833){
+        bool useMSE = (m_table_termo->ui->errorMetricComboBox->currentText() == "Mean Squared Error");
+
+        for (int i = 0; i < 64; i++){
+            float meas = values[i];
+            ui->mainWidget->setAMG(63-i,meas);
+
+            m_table_termo->ui->mainWidget_2->setAMG(63-i,meas); //data flow to datadisplay widget
+            m_table_termo->ui->mainWidget_6->setAMG(63-i,meas); //data flow to datadispalytext widget
+            int row = i / 8; // Determine the row (0-7)
+            int col = i % 8; // Determine the column (0-7)
+            int value = ui->mainWidget->getAMG(i); // Get the value for the current index
+            m_table_termo->updateTable_2(row, col, value); // Update the table with the row, column, and value
+            m_table_termo->calculateMaxError_2(row, col, value, useMSE);
+        }
+    }
+    else if (sensor == INTEGRATOR_ID_MLX90640){
+        bool useMSE = (m_table_termo->ui->errorMetricComboBox->currentText() == "Mean Squared Error");
+
+        // Merged subpages carry the age of the older half; resampled grids have none
+        const bool aged = values == frame.values;
+        for (int i = 0; i < 768; ++i){
+            const uint32_t age = aged ? MlxFrameAssembler::pixelAgeUs(frame, i) : 0;
+            ui->mainWidget->setMLX(767-i,values[i]);
+            ui->mainWidget->setMLXAge(767-i,age);
+
+            m_table_termo->ui->mainWidget->setMLX(767-i,values[i]); //data flow to datadisplay widget
+            m_table_termo->ui->mainWidget->setMLXAge(767-i,age);
+            m_table_termo->ui->mainWidget_4->setMLX(767-i,values[i]); //data flow to datadispalytext widget
+            int row = i / 32; // Determine the row (0-7)
+            int col = i % 32; // Determine the column (0-7)
+            int value = ui->mainWidget->getMLX(i); // Get the value for the current index
+            m_table_termo->updateTable_1(row, col, value); // Update the table with the row, column, and value
+            m_table_termo->calculateMaxError_1(row, col, value, useMSE);
+        }
+    }
+    else
+    {
+        //qDebug() << "Niepoprawna ramka danych!\n";
     }
 }
 
@@ -578,7 +746,7 @@ void MainWindow::on_trybWybor_activated(int index)
 
     if (index == 0){
         qDebug() << "Wybrano tryb 1";       //Tryb pracy wszystkich czujników
-        Port->write("A");
+        emit sendToPort("A");
         ui->mainWidget->setSensor(5);
         // Start the camera
         //camera->start();
@@ -586,7 +754,7 @@ void MainWindow::on_trybWybor_activated(int index)
         statusBar()->showMessage("Tryb pracy wszystkich czujników");
     } else if (index == 1) {
         qDebug() << "Wybrano tryb 2";       //Tryb pracy pierwszego czujnika VL53L5CX
-        Port->write("B");
+        emit sendToPort("B");
         ui->mainWidget->setSensor(1);
         //m_table->ui->mainWidget->setSensor(1);
         //ui->mainWidget_2->setSensor(1);
@@ -594,48 +762,49 @@ void MainWindow::on_trybWybor_activated(int index)
         statusBar()->showMessage("Tryb pracy pierwszego czujnika VL53L5CX");
     } else if (index == 2) {
         qDebug() << "Wybrano tryb 3";       //Tryb pracy drugiego czujnika VL53L5CX
-        Port->write("C");
+        emit sendToPort("C");
         ui->mainWidget->setSensor(2);
         symbol = 'C';
         statusBar()->showMessage("Tryb pracy drugiego czujnika VL53L5CX");
     } else if (index == 3) {
         qDebug() << "Wybrano tryb 4";       //Tryb pracy czujnika MLX
-        Port->write("D");
+        emit sendToPort("D");
         ui->mainWidget->setSensor(3);
         symbol = 'D';
         statusBar()->showMessage("Tryb pracy czujnika MLX90640");
     } else if (index == 4) {
         qDebug() << "Wybrano tryb 5";       //Tryb pracy czujnika AMG
-        Port->write("E");
+        emit sendToPort("E");
         ui->mainWidget->setSensor(4);
         symbol = 'E';
         statusBar()->showMessage("Tryb pracy czujnika AMG8833");
     } else if (index == 5) {
         qDebug() << "Wybrano tryb 6";       //Tryb pracy czujników odległości i czujnika AMG
-        Port->write("F");
+        emit sendToPort("F");
         ui->mainWidget->setSensor(4);
         symbol = 'F';
         statusBar()->showMessage("Tryb pracy czujników odległości i czujnika AMG8833");
     } else if (index == 6) {
         qDebug() << "Wybrano tryb 7";       //Tryb pracy czujników odległości i czujnika MLX
-        Port->write("G");
+        emit sendToPort("G");
         ui->mainWidget->setSensor(3);
         symbol = 'G';
         statusBar()->showMessage("Tryb pracy czujników odległości i czujnika MLX90640");
         /*ITS A NEW SECTION*/
     } else if (index == 7) {
         qDebug() << "Wybrano tryb 8";       //Tryb pracy czujników odległości i czujnika M
-        Port->write("H");
+        emit sendToPort("H");
         //ui->mainWidget->setSensor(3);
         symbol = 'H';
         statusBar()->showMessage("Tryb pracy czujnikow VL");
     } else if (index == 8) {
         qDebug() << "Wybrano tryb 9";       //Tryb pracy czujników odległości i czujnika MLX
-        Port->write("I");
+        emit sendToPort("I");
         //ui->mainWidget->setSensor(3);
         symbol = 'I';
         statusBar()->showMessage("Tryb pracy MLX90640 i AMG8833");
     }
+    updateSeriesSensors();
 }
 
 /**
@@ -644,15 +813,291 @@ void MainWindow::on_trybWybor_activated(int index)
 
 void MainWindow::on_actionPo_cz_triggered()
 {
-    if (Port->isOpen()){
+    if (portOpen){
         statusBar()->showMessage("Połączenie z integratorem zainicjowane", 5000);
         ui->dioda->setPixmap(QPixmap(":/img/diodaOn.png").scaled(widthD, heightD, Qt::KeepAspectRatio));
         ui->polaczenieDioda->setText("Połączono z integratorem");
     } else {
-        qDebug() << Port->error();
+        qDebug() << portError;
         statusBar()->showMessage("Połączenie z integratorem nie powiodło się", 5000);
     }
-    connect(Port, SIGNAL(readyRead()),this,SLOT(read_Data()));
+    connect(acquisition, &AcquisitionWorker::framesAvailable, this, &MainWindow::read_Data, Qt::UniqueConnection);
+    read_Data(); // Frames queued while disconnected, also re-arms the notification
+    forgetFrameFormat();
+    sendFrameFormat();
+    QMetaObject::invokeMethod(acquisition, [worker = acquisition] {
+        worker->negotiateBaudRate();
+    }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Switches between binary and ASCII frames.
+ * @param checked True selects the binary protocol.
+ */
+
+void MainWindow::on_actionRamkiBinarne_toggled(bool checked)
+{
+    binaryProtocol = checked;
+    QMetaObject::invokeMethod(acquisition, &AcquisitionWorker::resetParser, Qt::QueuedConnection);
+    sendFrameFormat();
+}
+
+/**
+ * @brief Enables the delta and sparse coding of the binary frames.
+ * @param checked True requests coded frames; only used with the binary protocol.
+ */
+
+void MainWindow::on_actionKompresjaRamek_toggled(bool checked)
+{
+    codedFrames = checked;
+    sendFrameFormat();
+}
+
+/**
+ * @brief Streams the MLX90640 as raw frames solved by the application.
+ * @param checked True requests raw frames; only used with the binary protocol.
+ */
+
+void MainWindow::on_actionSuroweMLX_toggled(bool checked)
+{
+    rawMlxFrames = checked;
+    if (checked && mlxSubpages) {
+        QSignalBlocker blocker(ui->actionPodstronyMLX);
+        ui->actionPodstronyMLX->setChecked(false);
+        mlxSubpages = false;
+    }
+    sendFrameFormat();
+}
+
+/**
+ * @brief Streams every MLX90640 subpage as soon as it is read; the application merges them.
+ * @param checked True requests subpage frames; only used with the binary protocol.
+ */
+
+void MainWindow::on_actionPodstronyMLX_toggled(bool checked)
+{
+    mlxSubpages = checked;
+    if (checked && rawMlxFrames) {
+        QSignalBlocker blocker(ui->actionSuroweMLX);
+        ui->actionSuroweMLX->setChecked(false);
+        rawMlxFrames = false;
+    }
+    sendFrameFormat();
+}
+
+/**
+ * @brief Asks for the MLX90640 refresh rate, given in subpages per second.
+ */
+
+void MainWindow::on_actionMlxCzestotliwosc_triggered()
+{
+    // The capability frame carries the rate the sensor runs at
+    const double reportedHz = capabilities.sensor(INTEGRATOR_ID_MLX90640).rateHz;
+    QStringList rates;
+    int current = 0;
+    for (int code = 0; code <= INTEGRATOR_MLX90640_RATE_MAX; ++code) {
+        const double hz = 0.5 * (1 << code);
+        rates.append(QString("%1 Hz").arg(hz));
+        if (hz <= reportedHz)
+            current = code;
+    }
+    bool ok = false;
+    QString rate = QInputDialog::getItem(this, "MLX90640", "Podstrony na sekundę:", rates, current, false, &ok);
+    if (!ok)
+        return;
+
+    mlxRate = rates.indexOf(rate);
+    sendFrameFormat();
+}
+
+/**
+ * @brief Streams the AMG8833 as raw pixel registers converted by the application.
+ * @param checked True requests raw frames; only used with the binary protocol.
+ */
+
+void MainWindow::on_actionSuroweAMG_toggled(bool checked)
+{
+    rawAmgFrames = checked;
+    sendFrameFormat();
+}
+
+/**
+ * @brief Switches the AMG8833 between 10 and 1 frames per second.
+ * @param checked True selects 1 frame per second.
+ */
+
+void MainWindow::on_actionAmgJednaKlatka_toggled(bool checked)
+{
+    amgConfig = checked ? (amgConfig | INTEGRATOR_AMG_FPS_1) : (amgConfig & ~INTEGRATOR_AMG_FPS_1);
+    sendFrameFormat();
+}
+
+/**
+ * @brief Enables the twice moving average output mode of the AMG8833.
+ * @param checked True enables the moving average.
+ */
+
+void MainWindow::on_actionAmgSredniaRuchoma_toggled(bool checked)
+{
+    amgConfig = checked ? (amgConfig | INTEGRATOR_AMG_MOVING_AVERAGE) : (amgConfig & ~INTEGRATOR_AMG_MOVING_AVERAGE);
+    sendFrameFormat();
+}
+
+/**
+ * @brief Skips the VL53L5CX zones the sensor reports without a valid range.
+ * @param checked True subscribes to the target status and the number of targets per zone.
+ */
+
+void MainWindow::on_actionStatusStrefVL_toggled(bool checked)
+{
+    const quint8 fields = checked ? (INTEGRATOR_TOF_FIELD_STATUS | INTEGRATOR_TOF_FIELD_TARGETS) : 0;
+    QMetaObject::invokeMethod(acquisition, [worker = acquisition, fields] {
+        worker->setTofFields(fields);
+    }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Shows the window with the per-sensor link statistics.
+ */
+
+void MainWindow::on_actionStatystykiLacza_triggered()
+{
+    linkStatsDialog->updateStats(acquisition->sensorStats());
+    linkStatsDialog->show();
+    linkStatsDialog->raise();
+}
+
+/**
+ * @brief Starts or stops the cycle budget of the firmware and shows it.
+ * @param checked True asks for a budget every second.
+ */
+
+void MainWindow::on_actionBudzetCPU_toggled(bool checked)
+{
+    const char command[] = { INTEGRATOR_CMD_PROFILE, checked ? '1' : '0' };
+    emit sendToPort(QByteArray(command, sizeof(command)));
+    if (checked) {
+        profileDialog->show();
+        profileDialog->raise();
+    }
+}
+
+/**
+ * @brief Starts or stops recording the raw serial data.
+ * @param checked True starts the recording.
+ */
+
+void MainWindow::on_actionNagrywanie_toggled(bool checked)
+{
+    if (!checked) {
+        QMetaObject::invokeMethod(acquisition, &AcquisitionWorker::stopCapture, Qt::QueuedConnection);
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Nagrywanie surowych danych", QString(), "Nagrania (*.intcap)");
+    if (fileName.isEmpty()) {
+        QSignalBlocker blocker(ui->actionNagrywanie);
+        ui->actionNagrywanie->setChecked(false);
+        return;
+    }
+    QMetaObject::invokeMethod(acquisition, [worker = acquisition, fileName] {
+        worker->startCapture(fileName);
+    }, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Asks for a capture file and the playback speed, then replays it.
+ */
+
+void MainWindow::on_actionOdtworz_triggered()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Odtwarzanie nagrania", QString(), "Nagrania (*.intcap)");
+    if (fileName.isEmpty())
+        return;
+
+    const QStringList speeds = { "1x", "2x", "5x", "10x", "Maksymalna" };
+    bool ok = false;
+    QString speed = QInputDialog::getItem(this, "Odtwarzanie nagrania", "Prędkość:", speeds, 0, false, &ok);
+    if (!ok)
+        return;
+
+    startReplay(fileName, speed == speeds.last() ? 0.0 : speed.chopped(1).toDouble());
+}
+
+/**
+ * @brief Stops the replay, the live port is used again.
+ */
+
+void MainWindow::on_actionZatrzymajOdtwarzanie_triggered()
+{
+    QMetaObject::invokeMethod(acquisition, &AcquisitionWorker::stopReplay, Qt::QueuedConnection);
+}
+
+/**
+ * @brief Tells the firmware which frame format and sensor settings the application expects.
+ *
+ * Only the commands of settings that changed since the last call are sent:
+ * INTEGRATOR_CMD_MLX_RAW makes the firmware send the EEPROM frame again, and
+ * INTEGRATOR_CMD_AMG_CONFIG a capability frame. forgetFrameFormat() has all
+ * of them sent with the next call.
+ */
+
+void MainWindow::sendFrameFormat()
+{
+    if (portOpen) {
+        char format = INTEGRATOR_CMD_FORMAT_ASCII;
+        if (binaryProtocol)
+            format = codedFrames ? INTEGRATOR_CMD_FORMAT_CODED : INTEGRATOR_CMD_FORMAT_BINARY;
+        const bool rawMlx = rawMlxFrames && binaryProtocol;
+        char mlxOutput = INTEGRATOR_CMD_MLX_TEMP;
+        if (rawMlx)
+            mlxOutput = INTEGRATOR_CMD_MLX_RAW;
+        else if (mlxSubpages && binaryProtocol)
+            mlxOutput = INTEGRATOR_CMD_MLX_SUBPAGE;
+        const char amgOutput = rawAmgFrames && binaryProtocol ? INTEGRATOR_CMD_AMG_RAW : INTEGRATOR_CMD_AMG_TEMP;
+
+        QByteArray commands;
+        if (format != sentFormat)
+            commands.append(format);
+        if (mlxOutput != sentMlxOutput)
+            commands.append(mlxOutput);
+        if (mlxRate >= 0 && mlxRate != sentMlxRate) {
+            commands.append(INTEGRATOR_CMD_MLX_RATE);
+            commands.append(static_cast<char>('0' + mlxRate));
+        }
+        if (amgOutput != sentAmgOutput)
+            commands.append(amgOutput);
+        if (amgConfig != sentAmgConfig) {
+            // The firmware answers with a capability frame carrying the AMG8833 rate
+            commands.append(INTEGRATOR_CMD_AMG_CONFIG);
+            commands.append(static_cast<char>(amgConfig));
+        }
+        if (commands.isEmpty())
+            return;
+
+        sentFormat = format;
+        sentMlxOutput = mlxOutput;
+        sentMlxRate = mlxRate;
+        sentAmgOutput = amgOutput;
+        sentAmgConfig = amgConfig;
+        emit sendToPort(commands);
+        QMetaObject::invokeMethod(acquisition, [worker = acquisition, rawMlx] {
+            worker->setMlxRawMode(rawMlx);
+        }, Qt::QueuedConnection);
+    }
+}
+
+/**
+ * @brief Has the next sendFrameFormat() send every setting, e.g. after a reconnection.
+ */
+
+void MainWindow::forgetFrameFormat()
+{
+    sentFormat = 0;
+    sentMlxOutput = 0;
+    sentMlxRate = -1;
+    sentAmgOutput = 0;
+    sentAmgConfig = -1;
 }
 
 /**
@@ -661,7 +1106,11 @@ void MainWindow::on_actionPo_cz_triggered()
 
 void MainWindow::on_actionRoz_cz_triggered()
 {
-    disconnect(Port, SIGNAL(readyRead()),this,SLOT(read_Data()));
+    disconnect(acquisition, &AcquisitionWorker::framesAvailable, this, &MainWindow::read_Data);
+    // Leave the firmware at the default rate for the next connection
+    QMetaObject::invokeMethod(acquisition, [worker = acquisition] {
+        worker->negotiateBaudRate(0);
+    }, Qt::QueuedConnection);
     ui->dioda->setPixmap(QPixmap(":/img/diodaOff.png").scaled(widthD, heightD, Qt::KeepAspectRatio));
     ui->polaczenieDioda->setText("Brak połączenia z integratorem");
     statusBar()->showMessage("Port zamknięty. Połączenie przerwane", 5000);
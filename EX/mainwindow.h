@@ -3,6 +3,8 @@
 
 #include <QMainWindow>
 #include <QSerialPort>
+#include <QThread>
+#include <QLabel>
 #include <QTimer>
 #include <QString>
 #include <QDebug>
@@ -18,6 +20,10 @@
 #include "datatabledialog.h"
 #include "table.h"
 #include "table_termo.h"
+#include "acquisitionworker.h"
+#include "linkstatsdialog.h"
+#include "profiledialog.h"
+#include "sensorcapabilities.h"
 #include <QTranslator>
 
 // class comapre;
@@ -33,25 +39,49 @@ class MainWindow : public QMainWindow
     int sensor = 0;
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    MainWindow(QWidget *parent = nullptr, const QString &portName = "/dev/ttyACM0");
     ~MainWindow();
     int flag = 1;
 
     void setSensor(int i){sensor = i;}
     int getSensor(){return sensor;}
+    void startReplay(const QString &path, double speed, bool quitWhenDone = false);
+    void setMlxCalibration(float emissivity, float reflectedShift);
     // void toggleCamera();
     // void adjustTransparency(int value);
     //uint16_t calculateCRC16(uint16_t *data, int length);
 
-
+signals:
+    void sendToPort(const QByteArray &data);
 
 private slots:
     void read_Data();
+    void portStateChanged(bool open, const QString &error);
+    void baudRateChanged(qint32 baudRate);
+    void capabilitiesChanged(const IntegratorCapabilities &reported);
+    void commandFailed(const QString &message);
+    void captureStateChanged(bool active, const QString &error);
+    void replayStateChanged(bool active, const QString &error);
+    void updateLinkStats();
     void save_file();
     void on_trybWybor_activated(int index);
     void get_path();
     void on_actionPo_cz_triggered();
     void on_actionRoz_cz_triggered();
+    void on_actionRamkiBinarne_toggled(bool checked);
+    void on_actionKompresjaRamek_toggled(bool checked);
+    void on_actionSuroweMLX_toggled(bool checked);
+    void on_actionPodstronyMLX_toggled(bool checked);
+    void on_actionMlxCzestotliwosc_triggered();
+    void on_actionSuroweAMG_toggled(bool checked);
+    void on_actionAmgJednaKlatka_toggled(bool checked);
+    void on_actionAmgSredniaRuchoma_toggled(bool checked);
+    void on_actionStatusStrefVL_toggled(bool checked);
+    void on_actionStatystykiLacza_triggered();
+    void on_actionBudzetCPU_toggled(bool checked);
+    void on_actionNagrywanie_toggled(bool checked);
+    void on_actionOdtworz_triggered();
+    void on_actionZatrzymajOdtwarzanie_triggered();
 
     void on_zamnkij_clicked();
 
@@ -70,10 +100,31 @@ private slots:
 
 private:
     Ui::MainWindow *ui;
-    QSerialPort* Port;
-    QString Data_From_Port;
-    QStringList list;
-    bool Is_Data_Received = false;
+    QThread *acquisitionThread;
+    AcquisitionWorker *acquisition;
+    SensorFrame receivedFrame;
+    bool portOpen = false;
+    QString portError;
+    QLabel *linkStatsLabel;
+    LinkStatsDialog *linkStatsDialog;
+    ProfileDialog *profileDialog;
+    qint32 linkBaudRate = INTEGRATOR_BAUD_DEFAULT;
+    IntegratorCapabilities capabilities = IntegratorCapabilities::defaults();
+    bool replayActive = false;
+    bool quitAfterReplay = false;
+    bool binaryProtocol = true;
+    bool codedFrames = false;
+    bool rawMlxFrames = false;
+    bool mlxSubpages = false;
+    int mlxRate = -1;       // INTEGRATOR_CMD_MLX_RATE code, -1 keeps the rate of the sensor
+    bool rawAmgFrames = false;
+    quint8 amgConfig = 0;   // INTEGRATOR_AMG_* flags
+    // Settings the firmware was last sent on this connection, 0 or -1 until sent
+    char sentFormat = 0;
+    char sentMlxOutput = 0;
+    int sentMlxRate = -1;
+    char sentAmgOutput = 0;
+    int sentAmgConfig = -1;
     QTimer *timer;
     Dialog *dialog;
     //QCamera *camera;
@@ -88,17 +139,9 @@ private:
     QTranslator translator;
     QString currentLanguage = "en";
 
-    unsigned short int ComputeCRC16(const char* pData, int Length, unsigned int Poly, unsigned short int InitVal)
-    {
-        short int i;
-        unsigned short int ResCRC = InitVal;
-
-        while (--Length >= 0) {
-            ResCRC ^= *pData++ << 8;
-            for (short int i=0; i < 8; ++i)
-                ResCRC = ResCRC & 0x8000 ? (ResCRC << 1) ^ Poly : ResCRC << 1;
-        }
-        return ResCRC & 0xFFFF;
-    }
+    void handleFrame(const SensorFrame &frame);
+    void sendFrameFormat();
+    void forgetFrameFormat();
+    void updateSeriesSensors();
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,81 @@
+/**
+ * @file mlxframeassembler.cpp
+ * @brief Implementation of the MlxFrameAssembler class, which merges MLX90640 subpages.
+ */
+
+#include "mlxframeassembler.h"
+
+#include <algorithm>
+
+/*
+ * A change of the reading pattern splits the pixels differently, so the other
+ * half counts as missing until its next subpage arrives.
+ */
+void MlxFrameAssembler::startSubpage(int subpage, bool chessPattern, uint32_t mcuTimeUs)
+{
+    if (chessPattern != m_chessPattern) {
+        m_chessPattern = chessPattern;
+        m_received[0] = m_received[1] = false;
+    }
+    m_subpage = subpage;
+    m_received[subpage] = true;
+    m_timeUs[subpage] = mcuTimeUs;
+}
+
+bool MlxFrameAssembler::addSubpagePayload(const uint8_t *payload, int length, uint32_t mcuTimeUs)
+{
+    if (length != INTEGRATOR_MLX90640_SUBPAGE_HEADER + 2 * INTEGRATOR_MLX90640_SUBPAGE_VALUES || payload[0] > 1)
+        return false;
+
+    const int subpage = payload[0];
+    const bool chess = payload[1] & INTEGRATOR_MLX90640_CHESS;
+    startSubpage(subpage, chess, mcuTimeUs);
+
+    const uint8_t *src = payload + INTEGRATOR_MLX90640_SUBPAGE_HEADER;
+    for (int pixel = 0; pixel < Pixels; ++pixel) {
+        if (integrator_mlx90640_pixel_subpage(pixel, chess) != subpage)
+            continue;
+        m_values[pixel] = integrator_wire_to_temp(integrator_get_i16(src));
+        src += 2;
+    }
+    return true;
+}
+
+void MlxFrameAssembler::addSubpage(int subpage, bool chessPattern, const float *temperatures, uint32_t mcuTimeUs)
+{
+    startSubpage(subpage & 1, chessPattern, mcuTimeUs);
+    for (int pixel = 0; pixel < Pixels; ++pixel) {
+        if (integrator_mlx90640_pixel_subpage(pixel, chessPattern) == m_subpage)
+            m_values[pixel] = temperatures[pixel];
+    }
+}
+
+void MlxFrameAssembler::fill(SensorFrame &frame) const
+{
+    frame.count = Pixels;
+    std::copy(m_values, m_values + Pixels, frame.values);
+    frame.subpage = m_subpage;
+    frame.chessPattern = m_chessPattern;
+    if (m_subpage < 0 || !m_received[m_subpage ^ 1])
+        frame.staleAgeUs = NeverUs;
+    else
+        frame.staleAgeUs = m_timeUs[m_subpage] - m_timeUs[m_subpage ^ 1];
+}
+
+void MlxFrameAssembler::reset()
+{
+    std::fill(m_values, m_values + Pixels, 0.0f);
+    m_subpage = -1;
+    m_received[0] = m_received[1] = false;
+}
+
+/**
+ * @brief Age of one pixel of a frame filled by an assembler.
+ * @return 0 for pixels of the last subpage, NeverUs for pixels not received yet.
+ */
+uint32_t MlxFrameAssembler::pixelAgeUs(const SensorFrame &frame, int pixel)
+{
+    if (frame.subpage < 0 || integrator_mlx90640_pixel_subpage(pixel, frame.chessPattern) == frame.subpage)
+        return 0;
+    return frame.staleAgeUs;
+}
@@ -0,0 +1,46 @@
+#ifndef MLXFRAMEASSEMBLER_H
+#define MLXFRAMEASSEMBLER_H
+
+#include <cstdint>
+
+#include "frameparser.h"
+
+/**
+ * @brief Merges MLX90640 subpages into whole images on the host.
+ *
+ * Each subpage measures half of the pixels (a chess board or interleaved rows,
+ * see integrator_mlx90640_pixel_subpage()), so an image always combines the
+ * latest two subpages. The frames written by fill() carry the subpage of the
+ * last update and the age of the other half, from which pixelAgeUs() gives
+ * the age of every pixel without storing one per pixel.
+ *
+ * Ages are taken on the MCU clock: the difference of the timestamps of the
+ * two subpages.
+ */
+class MlxFrameAssembler
+{
+public:
+    static constexpr int Pixels = INTEGRATOR_MLX90640_VALUES;
+    static constexpr uint32_t NeverUs = UINT32_MAX;    ///< Age of pixels not received yet
+
+    // Takes an INTEGRATOR_ID_MLX90640_SUBPAGE payload; false if it is malformed
+    bool addSubpagePayload(const uint8_t *payload, int length, uint32_t mcuTimeUs);
+    // Takes the pixels of one subpage from a whole image, e.g. a solved raw frame
+    void addSubpage(int subpage, bool chessPattern, const float *temperatures, uint32_t mcuTimeUs);
+    // Copies the merged image and its subpage and age fields into frame
+    void fill(SensorFrame &frame) const;
+    void reset();
+
+    static uint32_t pixelAgeUs(const SensorFrame &frame, int pixel);
+
+private:
+    void startSubpage(int subpage, bool chessPattern, uint32_t mcuTimeUs);
+
+    float m_values[Pixels] = {};
+    bool m_chessPattern = true;
+    int m_subpage = -1;                 // Subpage of the last update
+    bool m_received[2] = {false, false};
+    uint32_t m_timeUs[2] = {0, 0};      // MCU time of the last update of each subpage
+};
+
+#endif // MLXFRAMEASSEMBLER_H
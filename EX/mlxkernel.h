@@ -0,0 +1,116 @@
+#ifndef MLXKERNEL_H
+#define MLXKERNEL_H
+
+#include <cstdint>
+
+/**
+ * @brief Per-frame input of the MLX90640 To kernel.
+ *
+ * The per-pixel arrays are float copies of the calibration, prepared once by
+ * MlxSolver; the scalars are computed per frame as in MLX90640_SolveTo().
+ * Pixels whose mask entry is zero (the other subpage) keep their result.
+ * All arrays are 32-byte aligned, so the wide kernels use aligned loads.
+ */
+struct MlxKernelArgs
+{
+    static constexpr int Pixels = 768;
+
+    const float *raw;        // Frame words as signed values
+    const float *offset;
+    const float *kta;
+    const float *kv;
+    const float *ilChess;
+    const float *alpha;      // alpha - tgc * cpAlpha of the frame's subpage
+    const uint32_t *mask;    // ~0 for the pixels of the frame's subpage
+    float *result;
+
+    float gain;
+    float dTa;
+    float dVdd;
+    float ilChessOn;         // 1 if the IL/chess correction applies, else 0
+    float invEmissivity;
+    float tgcCP;
+    float ksTaScale;
+    float taTr;
+    float ksTo1;
+    float ksToScale;
+    float ct[4];
+    float ksTo[4];
+    float alphaCorrR[4];
+};
+
+namespace {
+
+template <typename Ops>
+inline typename Ops::V mlxRoot4(typename Ops::V x)
+{
+    return Ops::sqrt(Ops::sqrt(x));
+}
+
+/*
+ * The To equation of MLX90640_SolveTo() written once against a small set of
+ * vector operations. Ops supplies the vector type V, the mask type M, the
+ * lane count Width (a divisor of 768) and load, store, set1, add, sub, mul,
+ * div, sqrt, less, select(mask, a, b) and loadMask. Each instruction set
+ * instantiates it in its own translation unit, so the kernel is compiled with
+ * that unit's target options.
+ */
+template <typename Ops>
+void mlxKernel(const MlxKernelArgs &a)
+{
+    using V = typename Ops::V;
+    using M = typename Ops::M;
+
+    const V one = Ops::set1(1.0f);
+    const V kelvin = Ops::set1(273.15f);
+    const V gain = Ops::set1(a.gain);
+    const V dTa = Ops::set1(a.dTa);
+    const V dVdd = Ops::set1(a.dVdd);
+    const V ilChessOn = Ops::set1(a.ilChessOn);
+    const V invEmissivity = Ops::set1(a.invEmissivity);
+    const V tgcCP = Ops::set1(a.tgcCP);
+    const V ksTaScale = Ops::set1(a.ksTaScale);
+    const V taTr = Ops::set1(a.taTr);
+    const V ksTo1 = Ops::set1(a.ksTo1);
+    const V ksToScale = Ops::set1(a.ksToScale);
+    V ct[4], ksTo[4], alphaCorrR[4];
+    for (int r = 0; r < 4; ++r) {
+        ct[r] = Ops::set1(a.ct[r]);
+        ksTo[r] = Ops::set1(a.ksTo[r]);
+        alphaCorrR[r] = Ops::set1(a.alphaCorrR[r]);
+    }
+
+    for (int i = 0; i < MlxKernelArgs::Pixels; i += Ops::Width) {
+        const M selected = Ops::loadMask(a.mask + i);
+
+        V ir = Ops::mul(Ops::load(a.raw + i), gain);
+        const V offset = Ops::mul(Ops::mul(Ops::load(a.offset + i),
+                                           Ops::add(one, Ops::mul(Ops::load(a.kta + i), dTa))),
+                                  Ops::add(one, Ops::mul(Ops::load(a.kv + i), dVdd)));
+        ir = Ops::sub(ir, offset);
+        ir = Ops::add(ir, Ops::mul(Ops::load(a.ilChess + i), ilChessOn));
+        ir = Ops::sub(Ops::mul(ir, invEmissivity), tgcCP);
+
+        const V alpha = Ops::mul(Ops::load(a.alpha + i), ksTaScale);
+        const V alpha3 = Ops::mul(Ops::mul(alpha, alpha), alpha);
+        const V sx = Ops::mul(ksTo1, mlxRoot4<Ops>(Ops::mul(alpha3, Ops::add(ir, Ops::mul(alpha, taTr)))));
+        const V to = Ops::sub(mlxRoot4<Ops>(Ops::add(Ops::div(ir, Ops::add(Ops::mul(alpha, ksToScale), sx)), taTr)), kelvin);
+
+        // Temperature range, picked from the highest one down
+        V rangeCt = ct[3], rangeKsTo = ksTo[3], rangeCorr = alphaCorrR[3];
+        for (int r = 2; r >= 0; --r) {
+            const M below = Ops::less(to, ct[r + 1]);
+            rangeCt = Ops::select(below, ct[r], rangeCt);
+            rangeKsTo = Ops::select(below, ksTo[r], rangeKsTo);
+            rangeCorr = Ops::select(below, alphaCorrR[r], rangeCorr);
+        }
+
+        const V scale = Ops::mul(Ops::mul(alpha, rangeCorr), Ops::add(one, Ops::mul(rangeKsTo, Ops::sub(to, rangeCt))));
+        const V result = Ops::sub(mlxRoot4<Ops>(Ops::add(Ops::div(ir, scale), taTr)), kelvin);
+        Ops::store(a.result + i, Ops::select(selected, result, Ops::load(a.result + i)));
+    }
+}
+
+} // namespace
+
+#endif // MLXKERNEL_H
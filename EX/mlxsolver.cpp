@@ -0,0 +1,262 @@
+/**
+ * @file mlxsolver.cpp
+ * @brief Implementation of the MlxSolver class, the host-side MLX90640 temperature solver.
+ *
+ * The plain C++ and SSE2 kernels are instantiated here; the AVX one lives in
+ * mlxsolver_avx.cpp, which is the only unit compiled for AVX, so the
+ * application still starts on CPUs without it.
+ */
+
+#include "mlxsolver.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MLXSOLVER_SSE2
+#endif
+
+// Defined in mlxsolver_avx.cpp; mlxKernelAvx() may only run if mlxKernelAvxBuilt()
+void mlxKernelAvx(const MlxKernelArgs &args);
+bool mlxKernelAvxBuilt();
+
+namespace {
+
+struct ScalarOps
+{
+    using V = float;
+    using M = bool;
+    static constexpr int Width = 1;
+
+    static V load(const float *p) { return *p; }
+    static void store(float *p, V v) { *p = v; }
+    static V set1(float x) { return x; }
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V div(V a, V b) { return a / b; }
+    static V sqrt(V a) { return std::sqrt(a); }
+    static M less(V a, V b) { return a < b; }
+    static V select(M m, V a, V b) { return m ? a : b; }
+    static M loadMask(const uint32_t *p) { return *p != 0; }
+};
+
+#ifdef MLXSOLVER_SSE2
+struct Sse2Ops
+{
+    using V = __m128;
+    using M = __m128;
+    static constexpr int Width = 4;
+
+    static V load(const float *p) { return _mm_load_ps(p); }
+    static void store(float *p, V v) { _mm_store_ps(p, v); }
+    static V set1(float x) { return _mm_set1_ps(x); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+    static V sqrt(V a) { return _mm_sqrt_ps(a); }
+    static M less(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static V select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static M loadMask(const uint32_t *p) { return _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i *>(p))); }
+};
+#endif
+
+const float Kelvin = 273.15f;
+
+float pow4(float x)
+{
+    const float x2 = x * x;
+    return x2 * x2;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a solver without calibration; solve() must not be called before setEeprom().
+ */
+
+MlxSolver::MlxSolver()
+    : m_isa(bestIsa())
+{
+    std::memset(&m_params, 0, sizeof(m_params));
+    std::memset(&m_solver, 0, sizeof(m_solver));
+    reset();
+}
+
+/**
+ * @brief Extracts the calibration from an EEPROM image.
+ * @param words INTEGRATOR_MLX90640_EEPROM_WORDS words as read by MLX90640_DumpEE.
+ * @return False if the image is invalid; the solver is then not ready.
+ */
+
+bool MlxSolver::setEeprom(const uint16_t *words)
+{
+    // MLX90640_ExtractParameters takes a non-const pointer but only reads it
+    uint16_t eeprom[INTEGRATOR_MLX90640_EEPROM_WORDS];
+    std::memcpy(eeprom, words, sizeof(eeprom));
+
+    paramsMLX90640 params;
+    if (MLX90640_ExtractParameters(eeprom, &params) != 0) {
+        m_ready = false;
+        return false;
+    }
+    setParameters(params);
+    return true;
+}
+
+/**
+ * @brief Uses an already extracted calibration.
+ * @param params Parameters as filled by MLX90640_ExtractParameters.
+ */
+
+void MlxSolver::setParameters(const paramsMLX90640 &params)
+{
+    m_params = params;
+    MLX90640_PrepareSolver(&m_params, &m_solver);
+
+    for (int i = 0; i < Pixels; ++i) {
+        m_offset[i] = m_params.offset[i];
+        m_kta[i] = m_params.kta[i];
+        m_kv[i] = m_params.kv[i];
+        m_ilChess[i] = m_solver.ilChess[i];
+        m_alpha[0][i] = m_solver.alpha[0][i];
+        m_alpha[1][i] = m_solver.alpha[1][i];
+
+        const uint8_t pattern = m_solver.pattern[i];
+        for (int chess = 0; chess < 2; ++chess) {
+            const uint8_t patternMask = chess ? MLX90640_PATTERN_CHESS : MLX90640_PATTERN_IL;
+            for (int subPage = 0; subPage < 2; ++subPage) {
+                const uint8_t patternMatch = subPage ? patternMask : 0;
+                m_mask[2 * chess + subPage][i] = (pattern & patternMask) == patternMatch ? ~0u : 0u;
+            }
+        }
+    }
+    reset();
+    m_ready = true;
+}
+
+/**
+ * @brief Forgets the calibration and the last temperatures.
+ */
+
+void MlxSolver::reset()
+{
+    m_ready = false;
+    for (float &value : m_result)
+        value = 0.0f;
+}
+
+/**
+ * @brief Solves the subpage contained in a raw frame.
+ * @param frame INTEGRATOR_MLX90640_RAW_WORDS words as returned by MLX90640_GetFrameData.
+ * @return Ambient temperature Ta; the object temperatures are in temperatures().
+ */
+
+float MlxSolver::solve(const uint16_t *frame)
+{
+    const paramsMLX90640 &params = m_params;
+    const int subPage = frame[833] & 1;
+    const uint8_t mode = static_cast<uint8_t>((frame[832] & 0x1000) >> 5);
+    const int chess = mode ? 1 : 0;
+    const bool ilChess = (mode != params.calibrationModeEE);
+
+    const float vdd = MLX90640_SolverGetVdd(frame, &m_solver);
+    const float ta = MLX90640_SolverGetTa(frame, &m_solver);
+    const float tr = ta - m_reflectedShift;
+    const float dTa = ta - 25.0f;
+    const float dVdd = vdd - 3.3f;
+    const float tr4 = pow4(tr + Kelvin);
+
+    MlxKernelArgs args;
+    args.gain = params.gainEE / static_cast<float>(static_cast<int16_t>(frame[778]));
+    args.dTa = dTa;
+    args.dVdd = dVdd;
+    args.ilChessOn = ilChess ? 1.0f : 0.0f;
+    args.invEmissivity = 1.0f / m_emissivity;
+    args.ksTaScale = 1.0f + params.KsTa * dTa;
+    args.taTr = tr4 - (tr4 - pow4(ta + Kelvin)) / m_emissivity;
+    args.ksTo1 = params.ksTo[1];
+    args.ksToScale = m_solver.ksToScale;
+    for (int r = 0; r < 4; ++r) {
+        args.ct[r] = m_solver.ct[r];
+        args.ksTo[r] = params.ksTo[r];
+        args.alphaCorrR[r] = m_solver.alphaCorrR[r];
+    }
+
+    // Compensation pixel, as in MLX90640_SolveTo
+    const float cpScale = (1.0f + params.cpKta * dTa) * (1.0f + params.cpKv * dVdd);
+    float irDataCP;
+    if (subPage == 0)
+        irDataCP = static_cast<int16_t>(frame[776]) * args.gain - params.cpOffset[0] * cpScale;
+    else if (!ilChess)
+        irDataCP = static_cast<int16_t>(frame[808]) * args.gain - params.cpOffset[1] * cpScale;
+    else
+        irDataCP = static_cast<int16_t>(frame[808]) * args.gain - (params.cpOffset[1] + params.ilChessC[0]) * cpScale;
+    args.tgcCP = params.tgc * irDataCP;
+
+    for (int i = 0; i < Pixels; ++i)
+        m_raw[i] = static_cast<int16_t>(frame[i]);
+
+    args.raw = m_raw;
+    args.offset = m_offset;
+    args.kta = m_kta;
+    args.kv = m_kv;
+    args.ilChess = m_ilChess;
+    args.alpha = m_alpha[subPage];
+    args.mask = m_mask[2 * chess + subPage];
+    args.result = m_result;
+
+    switch (m_isa) {
+    case Isa::Avx:
+        mlxKernelAvx(args);
+        break;
+    case Isa::Sse2:
+#ifdef MLXSOLVER_SSE2
+        mlxKernel<Sse2Ops>(args);
+        break;
+#endif
+        // fall through
+    case Isa::Scalar:
+        mlxKernel<ScalarOps>(args);
+        break;
+    }
+    return ta;
+}
+
+/**
+ * @brief Selects the kernel; a set the CPU does not support is replaced by the best supported one.
+ */
+
+void MlxSolver::setIsa(Isa isa)
+{
+    m_isa = (static_cast<int>(isa) > static_cast<int>(bestIsa())) ? bestIsa() : isa;
+}
+
+/**
+ * @brief Returns the widest instruction set that is both built in and supported by the CPU.
+ */
+
+MlxSolver::Isa MlxSolver::bestIsa()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if (mlxKernelAvxBuilt() && __builtin_cpu_supports("avx"))
+        return Isa::Avx;
+#endif
+#ifdef MLXSOLVER_SSE2
+    return Isa::Sse2;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+const char *MlxSolver::isaName(Isa isa)
+{
+    switch (isa) {
+    case Isa::Avx: return "AVX";
+    case Isa::Sse2: return "SSE2";
+    case Isa::Scalar: break;
+    }
+    return "C++";
+}
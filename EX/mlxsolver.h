@@ -0,0 +1,81 @@
+#ifndef MLXSOLVER_H
+#define MLXSOLVER_H
+
+#include <cstdint>
+
+extern "C" {
+#include "MLX90640_API.h"
+#include "MLX90640_Solver.h"
+}
+
+#include "integrator_protocol.h"
+#include "mlxkernel.h"
+
+/**
+ * @brief Host-side MLX90640 temperature solver for the raw frames.
+ *
+ * The calibration is extracted from the EEPROM image with the Melexis code
+ * shared with the firmware (MLX90640_ExtractParameters, MLX90640_PrepareSolver).
+ * Ta and the per-frame constants come from the same single-precision solver;
+ * the per-pixel To equation runs in mlxKernel() with the widest instruction set
+ * the CPU supports (AVX, SSE2 or plain C++), picked at run time.
+ *
+ * Each raw frame holds one subpage, so temperatures() keeps the pixels of the
+ * other subpage from the previous frame, like the firmware's result buffer.
+ * Emissivity and the reflected temperature are host settings, so recordings
+ * of raw frames can be solved again with other values.
+ */
+class MlxSolver
+{
+public:
+    enum class Isa { Scalar, Sse2, Avx };
+
+    static constexpr int Pixels = MlxKernelArgs::Pixels;
+    static constexpr float DefaultEmissivity = 0.95f;
+    static constexpr float DefaultReflectedShift = 8.0f;   // TA_SHIFT of the firmware
+
+    MlxSolver();
+
+    // Extracts the calibration; false if the EEPROM image is invalid
+    bool setEeprom(const uint16_t *words);
+    void setParameters(const paramsMLX90640 &params);
+    // Drops the calibration and the last temperatures, e.g. for another sensor
+    void reset();
+    bool isReady() const { return m_ready; }
+
+    void setEmissivity(float emissivity) { m_emissivity = emissivity; }
+    float emissivity() const { return m_emissivity; }
+
+    // The reflected temperature is Ta - shift
+    void setReflectedShift(float shift) { m_reflectedShift = shift; }
+    float reflectedShift() const { return m_reflectedShift; }
+
+    // Solves one frame of INTEGRATOR_MLX90640_RAW_WORDS words and returns Ta
+    float solve(const uint16_t *frame);
+    const float *temperatures() const { return m_result; }
+
+    // The best supported set is selected by default; unsupported ones fall back
+    void setIsa(Isa isa);
+    Isa isa() const { return m_isa; }
+    static Isa bestIsa();
+    static const char *isaName(Isa isa);
+
+private:
+    paramsMLX90640 m_params;
+    mlx90640Solver m_solver;
+    bool m_ready = false;
+    float m_emissivity = DefaultEmissivity;
+    float m_reflectedShift = DefaultReflectedShift;
+    Isa m_isa;
+
+    alignas(32) float m_raw[Pixels];
+    alignas(32) float m_offset[Pixels];
+    alignas(32) float m_kta[Pixels];
+    alignas(32) float m_kv[Pixels];
+    alignas(32) float m_ilChess[Pixels];
+    alignas(32) float m_alpha[2][Pixels];
+    alignas(32) uint32_t m_mask[4][Pixels];    // Indexed by 2 * chess mode + subpage
+    alignas(32) float m_result[Pixels];
+};
+
+#endif // MLXSOLVER_H
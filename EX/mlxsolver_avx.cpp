@@ -0,0 +1,76 @@
+/**
+ * @file mlxsolver_avx.cpp
+ * @brief AVX instance of the MLX90640 To kernel.
+ *
+ * Only this unit is compiled for AVX, through target pragmas rather than a
+ * project-wide -mavx, so the rest of the application runs on any x86-64 CPU.
+ * MlxSolver calls it only after checking the CPU at run time.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || defined(__GNUC__))
+#define MLXSOLVER_AVX
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx")
+#endif
+#include <immintrin.h>
+#endif
+
+#include "mlxkernel.h"
+
+#ifdef MLXSOLVER_AVX
+
+namespace {
+
+struct AvxOps
+{
+    using V = __m256;
+    using M = __m256;
+    static constexpr int Width = 8;
+
+    static V load(const float *p) { return _mm256_load_ps(p); }
+    static void store(float *p, V v) { _mm256_store_ps(p, v); }
+    static V set1(float x) { return _mm256_set1_ps(x); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+    static M less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    // Bitwise rather than blendv, which GCC turns into per-lane branches without AVX2
+    static V select(M m, V a, V b) { return _mm256_or_ps(_mm256_and_ps(m, a), _mm256_andnot_ps(m, b)); }
+    static M loadMask(const uint32_t *p) { return _mm256_castsi256_ps(_mm256_load_si256(reinterpret_cast<const __m256i *>(p))); }
+};
+
+} // namespace
+
+void mlxKernelAvx(const MlxKernelArgs &args)
+{
+    mlxKernel<AvxOps>(args);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+bool mlxKernelAvxBuilt()
+{
+    return true;
+}
+
+#else
+
+void mlxKernelAvx(const MlxKernelArgs &)
+{
+}
+
+bool mlxKernelAvxBuilt()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * @file profiledialog.cpp
+ * @brief Implementation of the ProfileDialog class.
+ */
+
+#include "profiledialog.h"
+
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <QtCharts/QValueAxis>
+
+/**
+ * @brief Constructs the dialog with one bar set and one table row per stage.
+ * @param parent Pointer to the parent widget.
+ */
+
+ProfileDialog::ProfileDialog(QWidget *parent) :
+    QDialog(parent) {
+    setWindowTitle("Budżet CPU");
+    resize(760, 640);
+
+    summary = new QLabel("Brak ramek budżetu CPU", this);
+
+    series = new QStackedBarSeries(this);
+    QStringList stages;
+    for (int stage = 0; stage < INTEGRATOR_PROFILE_STAGES; stage++) {
+        sets[stage] = new QBarSet(CpuProfile::stageName(stage));
+        series->append(sets[stage]);
+        stages << CpuProfile::stageName(stage);
+    }
+    // Gaps between the bars would read as idle time
+    series->setBarWidth(1.0);
+
+    chart = new QChart();
+    chart->addSeries(series);
+    axisX = new QBarCategoryAxis(chart);
+    chart->addAxis(axisX, Qt::AlignBottom);
+    series->attachAxis(axisX);
+    QValueAxis *axisY = new QValueAxis(chart);
+    axisY->setRange(0, 100);
+    axisY->setLabelFormat("%d%%");
+    chart->addAxis(axisY, Qt::AlignLeft);
+    series->attachAxis(axisY);
+    chart->legend()->setAlignment(Qt::AlignRight);
+
+    QChartView *chartView = new QChartView(chart, this);
+    chartView->setRenderHint(QPainter::Antialiasing);
+
+    table = new QTableWidget(INTEGRATOR_PROFILE_STAGES, 4, this);
+    table->setHorizontalHeaderLabels(QStringList() << "Cykle" << "Udział [%]" << "Czas [ms]" << "Wejścia");
+    table->setVerticalHeaderLabels(stages);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    QStringList pipeStages;
+    for (int stage = 0; stage < INTEGRATOR_PIPE_STAGES; stage++)
+        pipeStages << CpuProfile::pipeStageName(stage);
+    pipeTable = new QTableWidget(INTEGRATOR_PIPE_STAGES, 4, this);
+    pipeTable->setHorizontalHeaderLabels(QStringList() << "Zajętość [%]" << "Czas [ms]" << "Zadania" << "Oczekiwania");
+    pipeTable->setVerticalHeaderLabels(pipeStages);
+    pipeTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    pipeTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(summary);
+    layout->addWidget(chartView, 3);
+    layout->addWidget(table, 2);
+    layout->addWidget(pipeTable, 1);
+    setLayout(layout);
+}
+
+/**
+ * @brief Adds the budget of a window; only the last HistoryWindows are charted.
+ * @param profile Budget decoded from an INTEGRATOR_ID_PROFILE frame.
+ */
+
+void ProfileDialog::addProfile(const CpuProfile &profile) {
+    const double busy = 100.0 - profile.share(INTEGRATOR_STAGE_IDLE);
+    QString text = QString("Rdzeń %1 MHz, okno %2 ms, zajętość %3%")
+                       .arg(profile.coreHz / 1e6, 0, 'f', 0)
+                       .arg(profile.windowUs / 1000.0, 0, 'f', 1)
+                       .arg(busy, 0, 'f', 1);
+    const int bottleneck = profile.bottleneck();
+    if (bottleneck >= 0)
+        text += QString(", najwolniejszy etap potoku: %1").arg(CpuProfile::pipeStageName(bottleneck));
+    summary->setText(text);
+
+    const bool full = sets[0]->count() >= HistoryWindows;
+    for (int stage = 0; stage < INTEGRATOR_PROFILE_STAGES; stage++) {
+        if (full)
+            sets[stage]->remove(0);
+        sets[stage]->append(profile.share(stage));
+    }
+    windows++;
+    // Windows are numbered from the oldest one received
+    QStringList categories;
+    const int first = windows - sets[0]->count() + 1;
+    for (int i = 0; i < sets[0]->count(); i++)
+        categories << QString::number(first + i);
+    axisX->setCategories(categories);
+
+    const double msPerCycle = profile.coreHz ? 1000.0 / profile.coreHz : 0.0;
+    for (int row = 0; row < INTEGRATOR_PROFILE_STAGES; row++) {
+        const QStringList values = {
+            QString::number(profile.cycles[row]),
+            QString::number(profile.share(row), 'f', 2),
+            QString::number(profile.cycles[row] * msPerCycle, 'f', 2),
+            QString::number(profile.entries[row])
+        };
+        for (int col = 0; col < values.size(); col++) {
+            QTableWidgetItem *item = table->item(row, col);
+            if (!item) {
+                item = new QTableWidgetItem();
+                table->setItem(row, col, item);
+            }
+            item->setText(values[col]);
+        }
+    }
+
+    // Older firmware sends no pipeline, its rows stay empty
+    for (int row = 0; row < INTEGRATOR_PIPE_STAGES; row++) {
+        QStringList values = { QString(), QString(), QString(), QString() };
+        if (row < profile.pipeStages) {
+            values = {
+                QString::number(profile.occupancy(row), 'f', 2),
+                QString::number(profile.pipeCycles[row] * msPerCycle, 'f', 2),
+                QString::number(profile.pipeItems[row]),
+                QString::number(profile.pipeWaits[row])
+            };
+        }
+        for (int col = 0; col < values.size(); col++) {
+            QTableWidgetItem *item = pipeTable->item(row, col);
+            if (!item) {
+                item = new QTableWidgetItem();
+                pipeTable->setItem(row, col, item);
+            }
+            item->setText(values[col]);
+        }
+    }
+}
+
+/**
+ * @brief Drops the charted windows, e.g. when a replay starts.
+ */
+
+void ProfileDialog::clear() {
+    for (int stage = 0; stage < INTEGRATOR_PROFILE_STAGES; stage++)
+        sets[stage]->remove(0, sets[stage]->count());
+    axisX->clear();
+    windows = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef PROFILEDIALOG_H
+#define PROFILEDIALOG_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QTableWidget>
+#include <QtCharts/QBarCategoryAxis>
+#include <QtCharts/QBarSet>
+#include <QtCharts/QChartView>
+#include <QtCharts/QStackedBarSeries>
+
+#include "cpuprofile.h"
+
+/**
+ * @brief Window with the cycle budget of the firmware: the last windows as
+ * stacked bars and the latest one as a table, with the occupancy of the
+ * acquisition pipeline below.
+ */
+class ProfileDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    static constexpr int HistoryWindows = 30;
+
+    explicit ProfileDialog(QWidget *parent = nullptr);
+
+public slots:
+    void addProfile(const CpuProfile &profile);
+    void clear();
+
+private:
+    QLabel *summary;
+    QTableWidget *table;
+    QTableWidget *pipeTable;
+    QChart *chart;
+    QStackedBarSeries *series;
+    QBarCategoryAxis *axisX;
+    QBarSet *sets[INTEGRATOR_PROFILE_STAGES];
+    int windows = 0;    ///< Windows received since clear()
+};
+
+#endif // PROFILEDIALOG_H
@@ -0,0 +1,133 @@
+/**
+ * @file sensorcapabilities.cpp
+ * @brief Decoding of the capability descriptor sent by the firmware.
+ */
+
+#include "sensorcapabilities.h"
+
+#include <QStringList>
+
+namespace {
+
+SensorCapability makeSensor(char id, uint8_t dataType, int width, int height, double rateHz)
+{
+    SensorCapability sensor;
+    sensor.id = id;
+    sensor.dataType = dataType;
+    sensor.width = width;
+    sensor.height = height;
+    sensor.rateHz = rateHz;
+    sensor.present = true;
+    return sensor;
+}
+
+} // namespace
+
+/**
+ * @brief Returns the sensor set of the original board, used until a descriptor arrives.
+ */
+
+IntegratorCapabilities IntegratorCapabilities::defaults()
+{
+    IntegratorCapabilities caps;
+    const SensorCapability sensors[] = {
+        makeSensor(INTEGRATOR_ID_VL53L5CX_1, INTEGRATOR_DATA_DISTANCE_MM, 8, 8, 1),
+        makeSensor(INTEGRATOR_ID_VL53L5CX_2, INTEGRATOR_DATA_DISTANCE_MM, 8, 8, 1),
+        makeSensor(INTEGRATOR_ID_AMG8833, INTEGRATOR_DATA_TEMP_CENTI, 8, 8, 1),
+        makeSensor(INTEGRATOR_ID_MLX90640, INTEGRATOR_DATA_TEMP_CENTI, 32, 24, 1),
+    };
+    for (const SensorCapability &sensor : sensors)
+        caps.sensors[integrator_sensor_slot(static_cast<uint8_t>(sensor.id))] = sensor;
+    return caps;
+}
+
+/**
+ * @brief Reads a descriptor payload.
+ * @param payload Payload of an INTEGRATOR_ID_CAPABILITIES frame.
+ * @param length Payload length in bytes.
+ * @return False if the descriptor is malformed or of an unknown version; the object is then unchanged.
+ *
+ * Entries of unknown sensor ids and grids larger than INTEGRATOR_MAX_VALUES are
+ * skipped. Sensors missing from the descriptor keep their default geometry but
+ * are marked as not present.
+ */
+
+bool IntegratorCapabilities::parse(const uint8_t *payload, int length)
+{
+    if (length < INTEGRATOR_CAPS_HEADER_SIZE || payload[0] != INTEGRATOR_CAPS_VERSION)
+        return false;
+    const int count = payload[3];
+    if (length < INTEGRATOR_CAPS_HEADER_SIZE + count * INTEGRATOR_CAPS_ENTRY_SIZE)
+        return false;
+
+    IntegratorCapabilities caps = defaults();
+    caps.reported = true;
+    caps.firmwareMajor = payload[1];
+    caps.firmwareMinor = payload[2];
+    for (SensorCapability &sensor : caps.sensors)
+        sensor.present = false;
+
+    for (int i = 0; i < count; ++i) {
+        const uint8_t *entry = payload + INTEGRATOR_CAPS_HEADER_SIZE + i * INTEGRATOR_CAPS_ENTRY_SIZE;
+        const uint8_t slot = integrator_sensor_slot(entry[0]);
+        if (slot >= INTEGRATOR_SENSOR_COUNT || entry[2] * entry[3] > INTEGRATOR_MAX_VALUES)
+            continue;
+
+        SensorCapability &sensor = caps.sensors[slot];
+        sensor.id = static_cast<char>(entry[0]);
+        sensor.dataType = entry[1];
+        sensor.width = entry[2];
+        sensor.height = entry[3];
+        sensor.rateHz = integrator_get_u16(&entry[4]) / 100.0;
+        sensor.present = (entry[6] & INTEGRATOR_CAPS_PRESENT) != 0;
+    }
+
+    *this = caps;
+    return true;
+}
+
+/**
+ * @brief Returns the entry of a sensor id; unknown ids get an empty entry.
+ */
+
+const SensorCapability &IntegratorCapabilities::sensor(char id) const
+{
+    static const SensorCapability none;
+    const uint8_t slot = integrator_sensor_slot(static_cast<uint8_t>(id));
+    return slot < INTEGRATOR_SENSOR_COUNT ? sensors[slot] : none;
+}
+
+/**
+ * @brief Short summary for the status bar, e.g. "Oprogramowanie 1.1: VL53L5CX 1 8x8 @ 15 Hz, ...".
+ */
+
+QString IntegratorCapabilities::describe() const
+{
+    QStringList parts;
+    for (const SensorCapability &sensor : sensors) {
+        if (sensor.id == 0)
+            continue;
+        if (sensor.present)
+            parts << QString("%1 %2x%3 @ %4 Hz").arg(sensorName(sensor.id)).arg(sensor.width).arg(sensor.height).arg(sensor.rateHz);
+        else
+            parts << QString("%1 brak").arg(sensorName(sensor.id));
+    }
+    return QString("Oprogramowanie %1.%2: %3").arg(firmwareMajor).arg(firmwareMinor).arg(parts.join(", "));
+}
+
+/**
+ * @brief Display name of a sensor id, "?" for unknown ids.
+ */
+
+const char *IntegratorCapabilities::sensorName(char id)
+{
+    switch (id) {
+    case INTEGRATOR_ID_VL53L5CX_1: return "VL53L5CX 1";
+    case INTEGRATOR_ID_VL53L5CX_2: return "VL53L5CX 2";
+    case INTEGRATOR_ID_VL53L5CX_3: return "VL53L5CX 3";
+    case INTEGRATOR_ID_VL53L5CX_4: return "VL53L5CX 4";
+    case INTEGRATOR_ID_AMG8833:    return "AMG8833";
+    case INTEGRATOR_ID_MLX90640:   return "MLX90640";
+    default:                       return "?";
+    }
+}
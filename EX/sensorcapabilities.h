@@ -0,0 +1,54 @@
+#ifndef SENSORCAPABILITIES_H
+#define SENSORCAPABILITIES_H
+
+#include <array>
+#include <cstdint>
+
+#include <QMetaType>
+#include <QString>
+
+#include "integrator_protocol.h"
+
+/**
+ * @brief Geometry and data type of one sensor, from the capability descriptor.
+ */
+struct SensorCapability
+{
+    char id = 0;
+    uint8_t dataType = INTEGRATOR_DATA_DISTANCE_MM;
+    int width = 0;
+    int height = 0;
+    double rateHz = 0;          ///< Refresh rate configured on the sensor
+    bool present = false;       ///< The sensor answered during initialisation
+
+    int values() const { return width * height; }
+    bool thermal() const { return dataType == INTEGRATOR_DATA_TEMP_CENTI; }
+};
+
+/**
+ * @brief Sensor set reported by the firmware in an INTEGRATOR_ID_CAPABILITIES frame.
+ *
+ * Entries are indexed by integrator_sensor_slot(). Until the firmware answers
+ * (or with firmware that predates the descriptor) defaults() describes the
+ * original board: two 8x8 VL53L5CX, an 8x8 AMG8833 and a 32x24 MLX90640.
+ * Slots of sensors the board does not have keep id 0.
+ */
+struct IntegratorCapabilities
+{
+    bool reported = false;      ///< False while the defaults are in use
+    int firmwareMajor = 0;
+    int firmwareMinor = 0;
+    std::array<SensorCapability, INTEGRATOR_SENSOR_COUNT> sensors;
+
+    static IntegratorCapabilities defaults();
+    bool parse(const uint8_t *payload, int length);
+
+    const SensorCapability &sensor(char id) const;
+    QString describe() const;
+
+    static const char *sensorName(char id);
+};
+
+Q_DECLARE_METATYPE(IntegratorCapabilities)
+
+#endif // SENSORCAPABILITIES_H
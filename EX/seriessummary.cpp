@@ -0,0 +1,99 @@
+/**
+ * @file seriessummary.cpp
+ * @brief Assembly of the series statistics sent by the firmware.
+ */
+
+#include "seriessummary.h"
+
+#include "integrator_series.h"
+
+/**
+ * @brief Adds one INTEGRATOR_ID_SERIES frame.
+ * @param payload Payload of the frame.
+ * @param length Payload length in bytes.
+ * @return True once the frame completes the summary.
+ *
+ * Frames must arrive in order, starting with the one of zone 0. A frame that
+ * does not continue the summary drops it until the next first frame.
+ */
+
+bool SeriesSummary::addFrame(const uint8_t *payload, int length)
+{
+    if (length < INTEGRATOR_SERIES_HEADER_SIZE)
+        return false;
+    const int total = integrator_get_u16(&payload[8]);
+    const int first = integrator_get_u16(&payload[10]);
+    const int count = integrator_get_u16(&payload[12]);
+    if (length < INTEGRATOR_SERIES_HEADER_SIZE + count * INTEGRATOR_SERIES_ZONE_SIZE
+            || total > INTEGRATOR_MAX_VALUES || first + count > total) {
+        m_received = -1;
+        return false;
+    }
+
+    if (first == 0) {
+        sensor = static_cast<char>(payload[0]);
+        aborted = payload[1] == INTEGRATOR_SERIES_ABORTED;
+        frames = integrator_get_u16(&payload[2]);
+        durationUs = integrator_get_u32(&payload[4]);
+        zones = total;
+        m_received = 0;
+    } else if (first != m_received || sensor != static_cast<char>(payload[0])) {
+        m_received = -1;
+        return false;
+    }
+
+    // Thermal sensors travel in hundredths of a degree
+    const float scale = integrator_is_vl53l5cx(payload[0]) ? 1.0f : 1.0f / INTEGRATOR_TEMP_SCALE;
+    for (int k = 0; k < count; ++k) {
+        int16_t zoneMin, zoneMax;
+        float zoneMean, zoneVariance;
+        integrator_series_get_zone(payload, k, &zoneMin, &zoneMax, &zoneMean, &zoneVariance);
+        min[first + k] = zoneMin * scale;
+        max[first + k] = zoneMax * scale;
+        mean[first + k] = zoneMean * scale;
+        variance[first + k] = zoneVariance * scale * scale;
+    }
+    m_received += count;
+    return m_received == zones;
+}
+
+/**
+ * @brief Writes the statistics as tab separated tables of the grid width.
+ * @param out Stream of the series file.
+ * @param width Grid width of the sensor.
+ * @param prefix Line prefix, e.g. "M1:S1".
+ *
+ * Zones are written last one first, in the order of the tables and of the
+ * frames saved by a series collected on the host.
+ */
+
+void SeriesSummary::write(QTextStream &out, int width, const QString &prefix) const
+{
+    const struct {
+        const char *tag;
+        const char *title;
+        const std::array<float, INTEGRATOR_MAX_VALUES> *values;
+        bool range;
+    } tables[] = {
+        { "MIN", "Minimum Table", &min, false },
+        { "MAX", "Maximum Table", &max, false },
+        { "MEAN", "Mean Table", &mean, false },
+        { "E", "Max Error Table", nullptr, true },
+        { "MSE", "MSE Table", &variance, false },
+    };
+
+    out << prefix << " Series on the MCU: " << frames << " measurements, " << durationUs << " us"
+        << (aborted ? ", aborted" : "") << "\n";
+    for (const auto &table : tables) {
+        out << prefix << ":" << table.tag << " " << table.title << ":\n";
+        for (int row = 0; row * width < zones; ++row) {
+            out << prefix << ":" << table.tag << ":R" << (row + 1) << " ";
+            for (int col = 0; col < width && row * width + col < zones; ++col) {
+                const int zone = zones - 1 - (row * width + col);
+                out << (table.range ? max[zone] - min[zone] : (*table.values)[zone]) << "\t";
+            }
+            out << "\n";
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef SERIESSUMMARY_H
+#define SERIESSUMMARY_H
+
+#include <array>
+#include <cstdint>
+
+#include <QMetaType>
+#include <QTextStream>
+
+#include "integrator_protocol.h"
+
+/**
+ * @brief Per-zone statistics of a measurement series computed by the firmware.
+ *
+ * Assembled from the INTEGRATOR_ID_SERIES frames of one sensor, see
+ * integrator_series.h. Values are in millimetres for the VL53L5CX and in
+ * degrees Celsius for the thermal sensors, zones in the order of the frames.
+ */
+struct SeriesSummary
+{
+    char sensor = 0;
+    bool aborted = false;       ///< Stopped by the host before all frames were in
+    int frames = 0;             ///< Frames accumulated by the firmware
+    quint32 durationUs = 0;     ///< MCU time from the first to the last frame
+    int zones = 0;
+    std::array<float, INTEGRATOR_MAX_VALUES> min{};
+    std::array<float, INTEGRATOR_MAX_VALUES> max{};
+    std::array<float, INTEGRATOR_MAX_VALUES> mean{};
+    std::array<float, INTEGRATOR_MAX_VALUES> variance{};   ///< Population variance, the MSE of the tables
+
+    bool addFrame(const uint8_t *payload, int length);
+    void write(QTextStream &out, int width, const QString &prefix) const;
+
+private:
+    int m_received = -1;        ///< Zones received so far, -1 until the first frame
+};
+
+Q_DECLARE_METATYPE(SeriesSummary)
+
+#endif // SERIESSUMMARY_H
@@ -0,0 +1,109 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Bounded lock-free queue for one producer thread and one consumer thread.
+ *
+ * When the queue is full, push() never blocks: the oldest queued element is
+ * discarded so the newest data always gets through ("latest wins"), and the
+ * dropped() counter is incremented.
+ *
+ * Elements are stored in a pool of Capacity + 2 buffers. The ready ring holds
+ * pool indices in arrival order. The consumer claims an index by advancing the
+ * tail with a compare-and-swap, copies the element and hands the buffer back
+ * through the free ring. The producer may advance the same tail to reclaim the
+ * oldest element, so a claimed buffer is never written while it is being read.
+ */
+template <typename T, int Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2, "SpscQueue needs room for at least two elements");
+
+public:
+    SpscQueue()
+    {
+        for (int i = 0; i < PoolSize; ++i)
+            m_free[i].store(i, std::memory_order_relaxed);
+        m_freeHead.store(PoolSize, std::memory_order_relaxed);
+    }
+
+    // Producer side. Always succeeds, possibly by dropping the oldest element.
+    void push(const T &item)
+    {
+        int index = takeFreeBuffer();
+        m_pool[index] = item;
+
+        const uint64_t head = m_head.load(std::memory_order_relaxed);
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        while (head - tail >= Capacity) {
+            if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel)) {
+                m_spare = m_ready[tail % Capacity].load(std::memory_order_relaxed);
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+        }
+
+        m_ready[head % Capacity].store(index, std::memory_order_relaxed);
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool pop(T &item)
+    {
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        int index;
+        do {
+            if (tail == m_head.load(std::memory_order_acquire))
+                return false;
+            index = m_ready[tail % Capacity].load(std::memory_order_relaxed);
+        } while (!m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel,
+                                               std::memory_order_acquire));
+
+        item = m_pool[index];
+
+        const uint64_t freeHead = m_freeHead.load(std::memory_order_relaxed);
+        m_free[freeHead % PoolSize].store(index, std::memory_order_relaxed);
+        m_freeHead.store(freeHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int PoolSize = Capacity + 2;
+
+    // At most Capacity buffers are queued and one is held by the consumer,
+    // so either the spare or the free ring always has a buffer.
+    int takeFreeBuffer()
+    {
+        if (m_spare >= 0) {
+            int index = m_spare;
+            m_spare = -1;
+            return index;
+        }
+        const uint64_t freeTail = m_freeTail;
+        while (freeTail == m_freeHead.load(std::memory_order_acquire)) {
+        }
+        m_freeTail = freeTail + 1;
+        return m_free[freeTail % PoolSize].load(std::memory_order_relaxed);
+    }
+
+    std::array<T, PoolSize> m_pool;
+
+    std::array<std::atomic<int>, Capacity> m_ready;
+    alignas(64) std::atomic<uint64_t> m_head{0};
+    alignas(64) std::atomic<uint64_t> m_tail{0};
+
+    std::array<std::atomic<int>, PoolSize> m_free;
+    alignas(64) std::atomic<uint64_t> m_freeHead{0};
+    alignas(64) uint64_t m_freeTail = 0;     // Producer only
+    int m_spare = -1;                        // Producer only
+
+    std::atomic<uint64_t> m_dropped{0};
+};
+
+#endif // SPSCQUEUE_H
@@ -368,14 +368,17 @@ void table_termo::updateBothTablesAfterMeasurement() {
         for (int row = 0; row < 24; ++row) {
             for (int col = 0; col < 32; ++col) {
                 // Sensor 1
-                int errorValue1 = ui->table_3->item(row, col)->text().toInt();
+                // Cells beyond a smaller grid of the series on the MCU stay empty
+                const QTableWidgetItem *item1 = ui->table_3->item(row, col);
+                int errorValue1 = item1 ? item1->text().toInt() : 0;
                 sumMaxError1 += errorValue1;
             }
         }
         for (int row = 0; row < 8; ++row) {
             for (int col = 0; col < 8; ++col) {
                 // Sensor 2
-                int errorValue2 = ui->table_4->item(row, col)->text().toInt();
+                const QTableWidgetItem *item2 = ui->table_4->item(row, col);
+                int errorValue2 = item2 ? item2->text().toInt() : 0;
                 sumMaxError2 += errorValue2;
             }
         }
@@ -432,8 +435,17 @@ void table_termo::updateBothTablesAfterMeasurement() {
  */
 
 void table_termo::startMeasurementSeries() {
+    if (mcuSeriesActive || (!isMeasurementSeriesActive && ui->mcuSeriesCheckBox->isChecked())) {
+        startMcuSeries();
+        return;
+    }
+
     if (!isMeasurementSeriesActive) {
+        // Every frame of a series on the host is kept for the saved file
+        if (customMeasurementCount > HostSeriesMax)
+            ui->spinBox->setValue(HostSeriesMax);
         isMeasurementSeriesActive = true;
+        lastSeriesOnMcu = false;
         currentMeasurementCount1 = 0;
         currentMeasurementCount2 = 0;
         table1Completed = false;
@@ -448,6 +460,106 @@ void table_termo::startMeasurementSeries() {
     }
 }
 
+/**
+ * @brief Starts or stops a series computed by the firmware.
+ *
+ * The firmware accumulates the statistics of the MLX90640 and the AMG8833 itself and
+ * reports them with INTEGRATOR_ID_SERIES frames, so the series is not limited
+ * by the frames the host keeps. Only the sensors set by setSeriesSensors()
+ * take part; the table of a sensor left out stays empty. Frames are sent
+ * during the series only when "Send frames" is checked.
+ */
+
+void table_termo::startMcuSeries() {
+    if (!mcuSeriesActive) {
+        if (!seriesSensor1 && !seriesSensor2) {
+            qDebug() << "Seria na MCU: zaden czujnik termiczny nie jest odczytywany w tym trybie";
+            return;
+        }
+        mcuSeriesActive = true;
+        lastSeriesOnMcu = true;
+        mcuSeries1 = seriesSensor1;
+        mcuSeries2 = seriesSensor2;
+        // A sensor left out is done from the start, no summary comes for it
+        table1Completed = mcuSummary1Received = !mcuSeries1;
+        table2Completed = mcuSummary2Received = !mcuSeries2;
+        if (!mcuSeries1)
+            ui->table_3->clearContents();
+        if (!mcuSeries2)
+            ui->table_4->clearContents();
+        const bool sendFrames = ui->sendFramesCheckBox->isChecked();
+        if (mcuSeries1)
+            emit seriesRequested(INTEGRATOR_ID_MLX90640, customMeasurementCount, sendFrames);
+        if (mcuSeries2)
+            emit seriesRequested(INTEGRATOR_ID_AMG8833, customMeasurementCount, sendFrames);
+        ui->pushButton_3->setText("Stop Series");
+        ui->saveMeasurementSeriesButton->setEnabled(false);
+        ui->progressBar->setRange(0, 0); // The firmware reports only at the end
+    } else {
+        if (mcuSeries1)
+            emit seriesRequested(INTEGRATOR_ID_MLX90640, 0, false);
+        if (mcuSeries2)
+            emit seriesRequested(INTEGRATOR_ID_AMG8833, 0, false);
+        mcuSeriesActive = false;
+        ui->pushButton_3->setText("Start Series");
+        ui->progressBar->setRange(0, customMeasurementCount * (768 + 64));
+    }
+}
+
+/**
+ * @brief Shows the statistics of a series computed by the firmware.
+ *
+ * Summaries of sensors not shown by this window or left out of the series are
+ * ignored. The series ends once the summaries of its sensors are in, even if
+ * one of them could not be shown.
+ *
+ * @param summary Statistics received from the firmware.
+ */
+
+void table_termo::showSeriesSummary(const SeriesSummary &summary) {
+    QTableWidget *errorTable;
+    bool *completed;
+    int width;
+    int zones;
+    if (summary.sensor == INTEGRATOR_ID_MLX90640 && mcuSeries1) {
+        mcuSummary1 = summary;
+        mcuSummary1Received = true;
+        errorTable = ui->table_3;
+        completed = &table1Completed;
+        width = 32;
+        zones = 768;
+    } else if (summary.sensor == INTEGRATOR_ID_AMG8833 && mcuSeries2) {
+        mcuSummary2 = summary;
+        mcuSummary2Received = true;
+        errorTable = ui->table_4;
+        completed = &table2Completed;
+        width = 8;
+        zones = 64;
+    } else {
+        return;
+    }
+
+    if (summary.zones != zones) {
+        qDebug() << "Seria na MCU: nieoczekiwana liczba stref" << summary.zones << "czujnika" << summary.sensor;
+    } else {
+        const bool useMSE = selectedErrorMetric == "Mean Squared Error";
+        for (int zone = 0; zone < zones; ++zone) {
+            const int cell = zones - 1 - zone;
+            const int errorValue = useMSE ? static_cast<int>(summary.variance[zone])
+                                          : static_cast<int>(summary.max[zone] - summary.min[zone]);
+            errorTable->setItem(cell / width, cell % width, new QTableWidgetItem(QString::number(errorValue)));
+        }
+        *completed = true;
+    }
+
+    if (mcuSummary1Received && mcuSummary2Received) {
+        mcuSeriesActive = false;
+        ui->pushButton_3->setText("Start Series");
+        ui->progressBar->setRange(0, customMeasurementCount * (768 + 64));
+        updateBothTablesAfterMeasurement();
+    }
+}
+
 /**
  * @brief Sets the custom measurement count for the series.
  *
@@ -708,6 +820,26 @@ void table_termo::saveMeasurementSeries() {
     QString dirName = "data-" + QDateTime::currentDateTime().toString("yyyy-MM-dd_hh_mm");
     QDir().mkdir(dirName);
 
+    if (lastSeriesOnMcu) {
+        const struct { bool inSeries; const SeriesSummary &summary; QString fileName; int width; const char *prefix; } files[] = {
+            { mcuSeries1, mcuSummary1, dirName + "/mlx90640.dat", 32, "M1:S1" },
+            { mcuSeries2, mcuSummary2, dirName + "/amg8833.dat", 8, "M1:S2" },
+        };
+        for (const auto &entry : files) {
+            if (!entry.inSeries)
+                continue;
+            QFile file(entry.fileName);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+                qDebug() << "Failed to open file for writing:" << entry.fileName;
+                continue;
+            }
+            QTextStream out(&file);
+            entry.summary.write(out, entry.width, entry.prefix);
+            qDebug() << "Series statistics saved to:" << entry.fileName;
+        }
+        return;
+    }
+
     // Lambda to calculate Maximum Error
     auto calculateMaxError = [&](int sensor, int row, int col) {
         int minVal = (sensor == 1) ? measurementsTable1[row][col][0] : measurementsTable2[row][col][0];
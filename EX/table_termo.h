@@ -2,6 +2,7 @@
 #define TABLE_TERMO_H
 
 #include "camerawidget.h"
+#include "seriessummary.h"
 #include <QMainWindow>
 
 namespace Ui {
@@ -31,6 +32,7 @@ public:
 
     void setSensor(int i){sensor = i;}
     int getSensor(){return sensor;}
+    void setSeriesSensors(bool mlx, bool amg){seriesSensor1 = mlx; seriesSensor2 = amg;}
 
     //private:
 
@@ -38,6 +40,17 @@ public:
     CameraWidget *cameraWidget;
 
     bool isMeasurementSeriesActive = false; // To track if a measurement series is active
+    bool mcuSeriesActive = false;            // Series computed by the firmware is running
+    bool lastSeriesOnMcu = false;            // The tables hold the statistics of a series computed by the firmware
+    SeriesSummary mcuSummary1;
+    SeriesSummary mcuSummary2;
+    bool mcuSummary1Received = false;        // Summaries of the running series received so far,
+    bool mcuSummary2Received = false;        // shown or not
+    bool seriesSensor1 = true;               // MLX90640 and AMG8833 present and read in the current
+    bool seriesSensor2 = true;               // mode, the sensors a series on the MCU may use
+    bool mcuSeries1 = false;                 // MLX90640 and AMG8833 in the running or last series
+    bool mcuSeries2 = false;                 // computed by the firmware
+    static constexpr int HostSeriesMax = 50; // Frames kept by a series collected on the host
     int currentMeasurementCount1 = 0;        // To track the current count of measurements
     int currentMeasurementCount2 = 0;        // To track the current count of measurements
     int customMeasurementCount = 5;
@@ -45,8 +58,8 @@ public:
 
     bool table1Completed = false;    // Flag for table_1 completion
     bool table2Completed = false;    // Flag for table_2 completion
-    int measurementsTable1[24][32][50] = {{{0}}};
-    int measurementsTable2[8][8][50] = {{{0}}};
+    int measurementsTable1[24][32][HostSeriesMax] = {{{0}}};
+    int measurementsTable2[8][8][HostSeriesMax] = {{{0}}};
 
     int minValueSensor1 = INT_MAX;
     int minValueSensor2 = INT_MAX;
@@ -61,6 +74,13 @@ public slots:
     void setErrorMetric(const QString &metric);
     void saveMeasurementSeries();
     void cameraClicked();
+    void showSeriesSummary(const SeriesSummary &summary);
+
+signals:
+    void seriesRequested(char sensor, int frames, bool sendFrames);
+
+private:
+    void startMcuSeries();
 };
 
 #endif // TABLE_TERMO_H
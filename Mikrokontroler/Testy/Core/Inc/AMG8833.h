@@ -2,6 +2,7 @@
 #define AMG8833_H
 
 #include <stdint.h>
+#include "i2c_bus.h"
 
 /*=========================================================================
     I2C ADDRESS/BITS
@@ -76,8 +77,11 @@ enum int_modes {
 int amg88xxInit(void);
 void readPixels(float *buf, uint8_t size/* = AMG88xx_PIXEL_ARRAY_SIZE */);
 void readPixelsRaw(int16_t* buf);
+HAL_StatusTypeDef startPixelsRawRead(int16_t* buf, i2c_transfer *transfer);
 float readThermistor(void);
 void setMovingAverageMode(int mode);
+void setFPS(uint8_t fps);
+uint8_t getFPSC(void);
 void enableInterrupt(void);
 void disableInterrupt(void);
 void setInterruptMode(uint8_t mode);
@@ -98,6 +102,7 @@ void read(uint8_t reg, uint8_t *buf, uint8_t num);
 void write(uint8_t reg, uint8_t *buf, uint8_t num);
 
 float signedMag12ToFloat(uint16_t val);
+float int12ToFloat(uint16_t val);
 
 		 // The power control register
 struct pctl {
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "stm32l4xx_hal.h"
+#include "i2c_bus.h"
 
 //mem adress
 #define MLX90640_STAT_REG 	0x8000
@@ -36,8 +37,24 @@
 #define MLX90640_TIMEOUT	1000
 #define MLX90640_ADDR		(0x33<<1)
 
+// MLX90640_FinishFrameRead(): a new subpage came in during the read, see MLX90640_RetryFrameRead()
+#define MLX90640_FRAME_RETRY	-2
+#define MLX90640_FRAME_ATTEMPTS	5		// Reads of one subpage before giving up, as MLX90640_GetFrameData()
+
+// Transfers of a non-blocking subpage read, see MLX90640_StartFrameRead()
+typedef struct
+{
+	i2c_transfer clear;
+	i2c_transfer ram;
+	i2c_transfer recheck;
+	uint8_t status[2];		// Status register as read, big-endian
+	uint8_t recheckStatus[2];	// Status register after the RAM read
+	uint8_t clearValue[2];
+	uint8_t attempts;
+} MLX90640_FrameRead;
+
 //-------------------------------------------------------------
-void Init_MLX90640_GPIO(I2C_HandleTypeDef i2c_handle);
+void Init_MLX90640_GPIO(I2C_HandleTypeDef *i2c_handle);
 //-------------------------------------------------------------
 void MLX90640_I2CRead(uint16_t startAddress, uint16_t nWordsRead, uint16_t *data);
 void MLX90640_I2CWrite(uint16_t writeAddress, uint16_t data);
@@ -56,8 +73,15 @@ uint8_t MLX90640_GetMode(void);
 //-----------------------------------------------------------
 uint16_t MLX90640_GetFrameData(uint16_t *frameData);
 uint16_t MLX90640_GetSubPageNumber(uint16_t *frameData);
+uint8_t MLX90640_IsFrameReady(void);
 void MLX90640_SynchFrame(void);
 //-----------------------------------------------------------
+HAL_StatusTypeDef MLX90640_StartStatusRead(MLX90640_FrameRead *read, i2c_transfer *transfer);
+uint8_t MLX90640_StatusFrameReady(const MLX90640_FrameRead *read);
+HAL_StatusTypeDef MLX90640_StartFrameRead(MLX90640_FrameRead *read, i2c_transfer *transfer, uint16_t *frameData);
+HAL_StatusTypeDef MLX90640_RetryFrameRead(MLX90640_FrameRead *read, i2c_transfer *transfer, uint16_t *frameData);
+int MLX90640_FinishFrameRead(MLX90640_FrameRead *read, uint16_t *frameData);
+//-----------------------------------------------------------
 void MLX90640_DumpEE(uint16_t *eeData);
 //-----------------------------------------------------------
 void MLX90640_ConfigI2C(uint16_t value);
@@ -0,0 +1,53 @@
+/**
+  ******************************************************************************
+  * @file    MLX90640_Solver.h
+  * @brief   Single-precision MLX90640 temperature solver with precomputed
+  *          per-pixel terms.
+  ******************************************************************************
+  * Gives the same result as MLX90640_GetTa/MLX90640_CalculateTo, but:
+  *
+  *   - everything that does not change between frames is computed once by
+  *     MLX90640_PrepareSolver() after MLX90640_ExtractParameters(): the
+  *     subpage and pattern of every pixel, the IL/chess correction, the
+  *     TGC-compensated sensitivity of both subpages and the constant
+  *     factors of the To equation;
+  *   - all math is float, so it runs on the Cortex-M4F FPU. pow() is
+  *     replaced by products and the 4th root by two sqrtf (VSQRT).
+  *
+  * Against the double-precision reference the result differs by less than
+  * MLX90640_SOLVER_TOLERANCE degrees; Host/mlx90640_check compares both on
+  * EEPROM and frame dumps.
+  ******************************************************************************
+  */
+#ifndef _MLX90640_SOLVER_H_
+#define _MLX90640_SOLVER_H_
+
+#include <stdint.h>
+#include "MLX90640_API.h"
+
+#define MLX90640_PIXEL_NUM          768
+#define MLX90640_SOLVER_TOLERANCE   0.01f
+
+/* Bits of mlx90640Solver.pattern */
+#define MLX90640_PATTERN_IL         0x01
+#define MLX90640_PATTERN_CHESS      0x02
+
+typedef struct
+{
+    const paramsMLX90640 *params;       /* offset, kta and kv are read from here */
+
+    float alpha[2][MLX90640_PIXEL_NUM]; /* alpha - tgc * cpAlpha[subpage] */
+    float ilChess[MLX90640_PIXEL_NUM];  /* Added in the mode without calibration */
+    uint8_t pattern[MLX90640_PIXEL_NUM];
+
+    float alphaCorrR[4];
+    float ksToScale;                    /* 1 - ksTo[1] * 273.15 */
+    float ct[4];
+} mlx90640Solver;
+
+void MLX90640_PrepareSolver(const paramsMLX90640 *params, mlx90640Solver *solver);
+float MLX90640_SolverGetVdd(const uint16_t *frameData, const mlx90640Solver *solver);
+float MLX90640_SolverGetTa(const uint16_t *frameData, const mlx90640Solver *solver);
+void MLX90640_SolveTo(const uint16_t *frameData, const mlx90640Solver *solver, float emissivity, float tr, float *result);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include "stm32l4xx_hal.h"
+
+/*
+ * Queued DMA transfers on the I2C buses.
+ *
+ * Every bus keeps a FIFO of register transfers. The first one runs as a
+ * HAL_I2C_Mem_Read_DMA/Mem_Write_DMA transfer and the next one is started
+ * from its completion interrupt, so both buses work at the same time and
+ * the CPU is free while they do.
+ *
+ * Once a bus is registered with i2c_bus_init(), every access to it has to go
+ * through here: the HAL rejects a blocking call while DMA owns the bus.
+ *
+ * i2c_bus_transfer() is the blocking form used by the sensor drivers; it
+ * queues the transfer and sleeps until it ends. i2c_bus_submit() returns at
+ * once, the transfer is finished when i2c_transfer_pending() turns 0 (or when
+ * its done callback runs, from the interrupt).
+ */
+
+#define I2C_BUS_COUNT			2
+/* Blocking transfers time out after this plus one ms per I2C_BUS_BYTES_PER_MS */
+#define I2C_BUS_TIMEOUT_MS		100
+#define I2C_BUS_BYTES_PER_MS	8		/* Below the 100 kHz rate, with margin */
+
+typedef enum
+{
+	I2C_TRANSFER_IDLE = 0,
+	I2C_TRANSFER_QUEUED,
+	I2C_TRANSFER_BUSY,
+	I2C_TRANSFER_DONE,
+	I2C_TRANSFER_ERROR
+} i2c_transfer_state;
+
+typedef struct i2c_transfer i2c_transfer;
+
+struct i2c_transfer
+{
+	uint16_t address;		/* 8-bit device address, as for HAL_I2C_* */
+	uint16_t reg;
+	uint16_t reg_size;		/* I2C_MEMADD_SIZE_8BIT or I2C_MEMADD_SIZE_16BIT */
+	uint8_t *data;
+	uint16_t size;
+	uint8_t write;
+	volatile i2c_transfer_state state;
+	void (*done)(i2c_transfer *transfer);	/* Called from the interrupt, may be 0 */
+
+	/* Owned by the queue */
+	I2C_HandleTypeDef *hi2c;
+	i2c_transfer *next;
+};
+
+static inline uint8_t i2c_transfer_pending(const i2c_transfer *transfer)
+{
+	return transfer->state == I2C_TRANSFER_QUEUED || transfer->state == I2C_TRANSFER_BUSY;
+}
+
+void i2c_bus_init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef i2c_bus_submit(I2C_HandleTypeDef *hi2c, i2c_transfer *transfer);
+HAL_StatusTypeDef i2c_bus_wait(i2c_transfer *transfer, uint32_t timeout_ms);
+HAL_StatusTypeDef i2c_bus_transfer(I2C_HandleTypeDef *hi2c, uint16_t address, uint16_t reg,
+		uint16_t reg_size, uint8_t *data, uint16_t size, uint8_t write);
+void i2c_bus_complete(I2C_HandleTypeDef *hi2c, uint8_t failed);
+
+#endif /* I2C_BUS_H */
@@ -0,0 +1,225 @@
+/**
+  ******************************************************************************
+  * @file    integrator_codec.h
+  * @brief   Delta and sparse coding of sensor frames, shared by the firmware
+  *          and the Qt application.
+  ******************************************************************************
+  * Coded frames use the binary frame layout of integrator_protocol.h with the
+  * sensor id ORed with INTEGRATOR_ID_CODED. The first payload byte selects the
+  * method, the rest depends on it:
+  *
+  *   INTEGRATOR_CODEC_KEY    the int16 values, as in an uncoded frame
+  *   INTEGRATOR_CODEC_DELTA  one zig-zag varint per value with the difference
+  *                           to the reference (MLX90640, AMG8833)
+  *   INTEGRATOR_CODEC_ZONES  a bitmap of the changed zones, one bit per value
+  *                           (LSB first), followed by the int16 value of every
+  *                           set bit (VL53L5CX)
+  *
+  * The reference is the previous frame of the same sensor as seen by the
+  * decoder. Delta and zone frames are only applied if their sequence number
+  * directly follows the reference; after a lost frame the decoder waits for
+  * the next keyframe, which the encoder sends every INTEGRATOR_KEYFRAME_INTERVAL
+  * frames, when the frame size changes, or when coding would not save space.
+  *
+  * With a deadband, zones that moved by less than it are not sent and the
+  * reference keeps the last transmitted value, so the error never grows beyond
+  * the deadband.
+  ******************************************************************************
+  */
+#ifndef INTEGRATOR_CODEC_H
+#define INTEGRATOR_CODEC_H
+
+#include <stdint.h>
+
+#include "integrator_protocol.h"
+
+#define INTEGRATOR_CODEC_KEY            0
+#define INTEGRATOR_CODEC_DELTA          1
+#define INTEGRATOR_CODEC_ZONES          2
+
+#define INTEGRATOR_KEYFRAME_INTERVAL    32
+
+typedef struct
+{
+	int16_t *reference;     /* Values of the last frame known to the decoder */
+	uint16_t capacity;      /* Number of entries in reference */
+	uint16_t count;         /* Values in the reference, 0 until a keyframe */
+	uint16_t sequence;      /* Sequence number of the reference (decoder) */
+	uint16_t since_key;     /* Frames since the last keyframe (encoder) */
+} integrator_codec_state;
+
+static inline void integrator_codec_init(integrator_codec_state *state, int16_t *reference, uint16_t capacity)
+{
+	state->reference = reference;
+	state->capacity = capacity;
+	state->count = 0;
+	state->sequence = 0;
+	state->since_key = 0;
+}
+
+/* Forces a keyframe (encoder) or waits for one (decoder) */
+static inline void integrator_codec_reset(integrator_codec_state *state)
+{
+	state->count = 0;
+}
+
+static inline uint8_t *integrator_put_varint(uint8_t *dst, int32_t value)
+{
+	uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	while (zigzag >= 0x80)
+	{
+		*dst++ = (uint8_t)(zigzag | 0x80);
+		zigzag >>= 7;
+	}
+	*dst++ = (uint8_t)zigzag;
+	return dst;
+}
+
+/* Returns the position after the varint, or 0 if it runs past end */
+static inline const uint8_t *integrator_get_varint(const uint8_t *src, const uint8_t *end, int32_t *value)
+{
+	uint32_t zigzag = 0;
+	for (int shift = 0; shift < 35 && src < end; shift += 7)
+	{
+		uint8_t byte = *src++;
+		zigzag |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			*value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+			return src;
+		}
+	}
+	return 0;
+}
+
+static inline uint16_t integrator_codec_keyframe(integrator_codec_state *state, const uint8_t *values,
+		uint16_t count, uint8_t *out)
+{
+	out[0] = INTEGRATOR_CODEC_KEY;
+	for (uint16_t i = 0; i < count; i++)
+	{
+		out[1 + 2*i] = values[2*i];
+		out[2 + 2*i] = values[2*i + 1];
+		state->reference[i] = integrator_get_i16(&values[2*i]);
+	}
+	state->count = count;
+	state->since_key = 0;
+	return 1 + 2*count;
+}
+
+/**
+ * Encodes count packed int16 values (an uncoded payload) into out, which must
+ * hold 1 + 2*count bytes. method is INTEGRATOR_CODEC_DELTA or
+ * INTEGRATOR_CODEC_ZONES; deadband applies to the zone method only.
+ * Returns the length of the coded payload.
+ */
+static inline uint16_t integrator_codec_encode(integrator_codec_state *state, uint8_t method,
+		const uint8_t *values, uint16_t count, uint16_t deadband, uint8_t *out)
+{
+	uint16_t limit = 1 + 2*count;
+
+	if (count > state->capacity) return 0;
+	if (state->count != count || state->since_key + 1 >= INTEGRATOR_KEYFRAME_INTERVAL)
+		return integrator_codec_keyframe(state, values, count, out);
+
+	uint8_t *dst = out + 1;
+	out[0] = method;
+	if (method == INTEGRATOR_CODEC_ZONES)
+	{
+		uint16_t bitmap_len = (count + 7) / 8;
+		for (uint16_t i = 0; i < bitmap_len; i++) dst[i] = 0;
+		uint8_t *value_dst = dst + bitmap_len;
+		for (uint16_t i = 0; i < count; i++)
+		{
+			int16_t value = integrator_get_i16(&values[2*i]);
+			int32_t diff = (int32_t)value - state->reference[i];
+			if (diff <= deadband && diff >= -(int32_t)deadband) continue;
+			if (value_dst + 2 > out + limit) return integrator_codec_keyframe(state, values, count, out);
+			dst[i / 8] |= (uint8_t)(1u << (i % 8));
+			integrator_put_i16(value_dst, value);
+			value_dst += 2;
+		}
+		dst = value_dst;
+		/* Only now commit the new reference, a fallback keyframe above rewrites it anyway */
+		for (uint16_t i = 0; i < count; i++)
+		{
+			if (out[1 + i / 8] & (1u << (i % 8))) state->reference[i] = integrator_get_i16(&values[2*i]);
+		}
+	}
+	else
+	{
+		for (uint16_t i = 0; i < count; i++)
+		{
+			/* A varint takes at most 3 bytes for an int16 difference */
+			if (dst + 3 > out + limit) return integrator_codec_keyframe(state, values, count, out);
+			dst = integrator_put_varint(dst, (int32_t)integrator_get_i16(&values[2*i]) - state->reference[i]);
+		}
+		for (uint16_t i = 0; i < count; i++) state->reference[i] = integrator_get_i16(&values[2*i]);
+	}
+
+	state->since_key++;
+	return (uint16_t)(dst - out);
+}
+
+/**
+ * Decodes a coded payload into values. Returns the number of values, or -1
+ * if the frame cannot be applied (no reference, lost frame, malformed data);
+ * the decoder then waits for the next keyframe.
+ */
+static inline int integrator_codec_decode(integrator_codec_state *state, uint16_t sequence,
+		const uint8_t *payload, uint16_t len, int16_t *values)
+{
+	const uint8_t *end = payload + len;
+	const uint8_t *src = payload + 1;
+	uint16_t count;
+
+	if (len == 0) return -1;
+
+	if (payload[0] == INTEGRATOR_CODEC_KEY)
+	{
+		count = (len - 1) / 2;
+		if (count > state->capacity || (len - 1) % 2) { state->count = 0; return -1; }
+		for (uint16_t i = 0; i < count; i++) state->reference[i] = integrator_get_i16(&src[2*i]);
+	}
+	else
+	{
+		count = state->count;
+		if (count == 0 || sequence != (uint16_t)(state->sequence + 1)) { state->count = 0; return -1; }
+
+		if (payload[0] == INTEGRATOR_CODEC_DELTA)
+		{
+			for (uint16_t i = 0; i < count; i++)
+			{
+				int32_t diff;
+				src = integrator_get_varint(src, end, &diff);
+				if (!src) { state->count = 0; return -1; }
+				state->reference[i] = (int16_t)(state->reference[i] + diff);
+			}
+		}
+		else if (payload[0] == INTEGRATOR_CODEC_ZONES)
+		{
+			const uint8_t *bitmap = src;
+			src += (count + 7) / 8;
+			if (src > end) { state->count = 0; return -1; }
+			for (uint16_t i = 0; i < count; i++)
+			{
+				if (!(bitmap[i / 8] & (1u << (i % 8)))) continue;
+				if (src + 2 > end) { state->count = 0; return -1; }
+				state->reference[i] = integrator_get_i16(src);
+				src += 2;
+			}
+		}
+		else
+		{
+			state->count = 0;
+			return -1;
+		}
+	}
+
+	for (uint16_t i = 0; i < count; i++) values[i] = state->reference[i];
+	state->count = count;
+	state->sequence = sequence;
+	return count;
+}
+
+#endif /* INTEGRATOR_CODEC_H */
@@ -0,0 +1,142 @@
+/**
+  ******************************************************************************
+  * @file    integrator_command.h
+  * @brief   Framed commands from the host with acknowledgements, shared by the
+  *          firmware, the simulator and the Qt application.
+  ******************************************************************************
+  * The host sends the command letters of integrator_protocol.h with their
+  * argument bytes as the payload of a frame in the binary layout, id
+  * INTEGRATOR_ID_COMMAND. Its sequence number is chosen by the host and its
+  * timestamp is host time in microseconds. A frame may hold several commands,
+  * at most INTEGRATOR_COMMAND_MAX_PAYLOAD bytes.
+  *
+  * The firmware parses the frames in its main loop and, once the commands and
+  * the requests they make (rates, settings, series) are carried out, answers
+  * with an INTEGRATOR_ID_ACK frame:
+  *
+  *   offset  size  field
+  *   0       2     sequence number of the command frame
+  *   2       1     INTEGRATOR_ACK_* status
+  *   3       1     commands carried out
+  *   4       4     timestamp of the command frame, echoed
+  *
+  * The echoed timestamp gives the host the round trip time. A command frame
+  * with a wrong CRC is dropped without an answer.
+  *
+  * Bare command bytes outside frames are still accepted, e.g. from a
+  * terminal; they are echoed and get no acknowledgement. No command letter is
+  * INTEGRATOR_SYNC_1, so both can be mixed. Firmware that takes command frames
+  * reports at least version INTEGRATOR_COMMAND_VERSION_MAJOR.
+  * INTEGRATOR_COMMAND_VERSION_MINOR in its capability descriptor; until the
+  * descriptor arrives the host sends bare bytes.
+  ******************************************************************************
+  */
+#ifndef INTEGRATOR_COMMAND_H
+#define INTEGRATOR_COMMAND_H
+
+#include <stdint.h>
+
+#include "integrator_protocol.h"
+
+#define INTEGRATOR_COMMAND_VERSION_MAJOR 1
+#define INTEGRATOR_COMMAND_VERSION_MINOR 2
+
+#define INTEGRATOR_COMMAND_MAX_PAYLOAD  32
+#define INTEGRATOR_COMMAND_MAX_FRAME    (INTEGRATOR_HEADER_SIZE + INTEGRATOR_COMMAND_MAX_PAYLOAD + INTEGRATOR_CRC_SIZE)
+/* A frame not completed within this time is dropped, so the next one is found */
+#define INTEGRATOR_COMMAND_TIMEOUT_MS   50
+
+#define INTEGRATOR_ACK_SIZE             8
+#define INTEGRATOR_ACK_OK               0
+#define INTEGRATOR_ACK_UNKNOWN          1   /* A byte is no command; the commands before it were carried out */
+#define INTEGRATOR_ACK_INCOMPLETE       2   /* The last command lacks argument bytes and was dropped */
+
+/* Results of integrator_command_feed() */
+#define INTEGRATOR_COMMAND_BYTE         0   /* Byte outside a frame, a bare command */
+#define INTEGRATOR_COMMAND_PENDING      1   /* Taken into the frame being received */
+#define INTEGRATOR_COMMAND_FRAME        2   /* Frame complete and valid */
+#define INTEGRATOR_COMMAND_BAD          3   /* Frame dropped: wrong id, length or CRC */
+
+typedef struct
+{
+	uint8_t frame[INTEGRATOR_COMMAND_MAX_FRAME];
+	uint16_t length;        /* Bytes of the frame received so far, 0 outside a frame */
+} integrator_command_parser;
+
+static inline void integrator_command_init(integrator_command_parser *parser)
+{
+	parser->length = 0;
+}
+
+/* Payload length of the frame in the parser, valid from the whole header on */
+static inline uint16_t integrator_command_length(const integrator_command_parser *parser)
+{
+	return integrator_get_u16(&parser->frame[3]);
+}
+
+static inline const uint8_t *integrator_command_payload(const integrator_command_parser *parser)
+{
+	return &parser->frame[INTEGRATOR_HEADER_SIZE];
+}
+
+static inline uint16_t integrator_command_sequence(const integrator_command_parser *parser)
+{
+	return integrator_get_u16(&parser->frame[5]);
+}
+
+static inline uint32_t integrator_command_timestamp(const integrator_command_parser *parser)
+{
+	return integrator_get_u32(&parser->frame[7]);
+}
+
+/*
+ * Takes one received byte. After INTEGRATOR_COMMAND_FRAME the frame stays in
+ * the parser until the next byte.
+ */
+static inline uint8_t integrator_command_feed(integrator_command_parser *parser, uint8_t byte)
+{
+	if (parser->length == 0)
+	{
+		if (byte != INTEGRATOR_SYNC_1) return INTEGRATOR_COMMAND_BYTE;
+		parser->frame[parser->length++] = byte;
+		return INTEGRATOR_COMMAND_PENDING;
+	}
+	if (parser->length == 1 && byte != INTEGRATOR_SYNC_2)
+	{
+		/* A lone INTEGRATOR_SYNC_1 is no command either and is dropped */
+		parser->length = 0;
+		return integrator_command_feed(parser, byte);
+	}
+
+	parser->frame[parser->length++] = byte;
+	if (parser->length < INTEGRATOR_HEADER_SIZE) return INTEGRATOR_COMMAND_PENDING;
+	if (parser->length == INTEGRATOR_HEADER_SIZE && (parser->frame[2] != INTEGRATOR_ID_COMMAND
+			|| integrator_command_length(parser) > INTEGRATOR_COMMAND_MAX_PAYLOAD))
+	{
+		parser->length = 0;
+		return INTEGRATOR_COMMAND_BAD;
+	}
+
+	const uint16_t payload_len = integrator_command_length(parser);
+	if (parser->length < INTEGRATOR_HEADER_SIZE + payload_len + INTEGRATOR_CRC_SIZE) return INTEGRATOR_COMMAND_PENDING;
+
+	parser->length = 0;
+	const uint16_t covered = INTEGRATOR_HEADER_SIZE - INTEGRATOR_CRC_START + payload_len;
+	if (integrator_crc16(&parser->frame[INTEGRATOR_CRC_START], covered)
+			!= integrator_get_u16(&parser->frame[INTEGRATOR_CRC_START + covered]))
+		return INTEGRATOR_COMMAND_BAD;
+	return INTEGRATOR_COMMAND_FRAME;
+}
+
+/* Writes an INTEGRATOR_ID_ACK payload and returns its length */
+static inline uint16_t integrator_put_ack(uint8_t *payload, uint16_t sequence, uint8_t status, uint8_t commands,
+		uint32_t timestamp)
+{
+	integrator_put_u16(&payload[0], sequence);
+	payload[2] = status;
+	payload[3] = commands;
+	integrator_put_u32(&payload[4], timestamp);
+	return INTEGRATOR_ACK_SIZE;
+}
+
+#endif /* INTEGRATOR_COMMAND_H */
@@ -0,0 +1,241 @@
+/**
+  ******************************************************************************
+  * @file    integrator_profile.h
+  * @brief   Cycle budget of the firmware, shared by the firmware and the Qt
+  *          application.
+  ******************************************************************************
+  * Every cycle of the core belongs to exactly one stage. The firmware switches
+  * the current stage around the code it profiles and the cycles counted since
+  * the last switch (DWT CYCCNT on the MCU) go to the stage being left. A stage
+  * entered inside another one pauses it, so the stages add up to the window
+  * and, e.g., the I2C waits inside vl53l5cx_get_ranging_data() do not count
+  * as parsing. Interrupts count to the stage they interrupt.
+  *
+  * With INTEGRATOR_CMD_PROFILE the firmware sends the budget of every window
+  * as an INTEGRATOR_ID_PROFILE frame and starts the next window:
+  *
+  *   offset  size  field
+  *   0       4     core clock in Hz
+  *   4       4     window length in microseconds (TIM2)
+  *   8       4     cycles in the window
+  *   12      1     stages, k
+  *   13+6k   4     cycles of stage k
+  *   17+6k   2     times stage k was entered, saturating
+  *
+  * The stages are followed by the occupancy of the acquisition pipeline: the
+  * I2C buses, the CPU work on the results and the UART run at the same time,
+  * and the busiest of them sets the frame rate. With o = 13 + 6k:
+  *
+  *   o       1     pipeline stages, m
+  *   o+1+8m  4     cycles pipeline stage m was busy
+  *   o+5+8m  2     items it finished (transfers, results, DMA blocks), saturating
+  *   o+7+8m  2     items that found it busy or full, saturating
+  *
+  * Firmware without the pipeline ends the payload after the stages.
+  ******************************************************************************
+  */
+#ifndef INTEGRATOR_PROFILE_H
+#define INTEGRATOR_PROFILE_H
+
+#include <stdint.h>
+
+#include "integrator_protocol.h"
+
+#define INTEGRATOR_STAGE_OTHER          0   /* Main loop, scheduler and everything not listed */
+#define INTEGRATOR_STAGE_IDLE           1   /* __WFI() with nothing due */
+#define INTEGRATOR_STAGE_I2C            2   /* Waiting for blocking I2C transfers */
+#define INTEGRATOR_STAGE_VL53L5CX       3   /* vl53l5cx_get_ranging_data() result parsing */
+#define INTEGRATOR_STAGE_MLX90640       4   /* MLX90640 Ta and To */
+#define INTEGRATOR_STAGE_AMG8833        5   /* AMG8833 pixel conversion */
+#define INTEGRATOR_STAGE_CODEC          6   /* Delta and sparse coding */
+#define INTEGRATOR_STAGE_CRC            7   /* CRC16 of the frames */
+#define INTEGRATOR_STAGE_ASCII          8   /* printf formatting of the ASCII frames and messages */
+#define INTEGRATOR_STAGE_UART           9   /* Waiting for a free UART buffer */
+#define INTEGRATOR_STAGE_DELAY          10  /* WaitMs() of the VL53L5CX driver */
+#define INTEGRATOR_PROFILE_STAGES       11
+
+#define INTEGRATOR_PIPE_I2C1            0   /* DMA transfers on I2C1 */
+#define INTEGRATOR_PIPE_I2C2            1   /* DMA transfers on I2C2 */
+#define INTEGRATOR_PIPE_CONVERT         2   /* Results decoded, solved and framed by the CPU */
+#define INTEGRATOR_PIPE_UART            3   /* UART DMA transmission */
+#define INTEGRATOR_PIPE_STAGES          4
+
+#define INTEGRATOR_PROFILE_HEADER_SIZE  13
+#define INTEGRATOR_PROFILE_STAGE_SIZE   6
+#define INTEGRATOR_PIPE_STAGE_SIZE      8
+#define INTEGRATOR_PROFILE_SIZE         (INTEGRATOR_PROFILE_HEADER_SIZE + INTEGRATOR_PROFILE_STAGES * INTEGRATOR_PROFILE_STAGE_SIZE \
+                                         + 1 + INTEGRATOR_PIPE_STAGES * INTEGRATOR_PIPE_STAGE_SIZE)
+
+typedef struct
+{
+	uint32_t cycles;        /* Busy cycles in the window up to since */
+	uint32_t since;         /* Counter when it turned busy */
+	uint16_t items;
+	uint16_t waits;
+	uint8_t busy;
+} integrator_pipe_stage;
+
+typedef struct
+{
+	uint32_t cycles[INTEGRATOR_PROFILE_STAGES];
+	uint16_t entries[INTEGRATOR_PROFILE_STAGES];
+	uint32_t last;          /* Counter at the last switch */
+	uint32_t window_start;  /* Counter at the start of the window */
+	uint8_t current;
+	integrator_pipe_stage pipe[INTEGRATOR_PIPE_STAGES];
+} integrator_profile;
+
+static inline const char *integrator_profile_stage_name(uint8_t stage)
+{
+	static const char *const names[INTEGRATOR_PROFILE_STAGES] = {
+		"inne", "bezczynnosc", "I2C", "VL53L5CX", "MLX90640", "AMG8833",
+		"kodowanie", "CRC", "ASCII", "UART", "opoznienia"
+	};
+	return stage < INTEGRATOR_PROFILE_STAGES ? names[stage] : "?";
+}
+
+static inline const char *integrator_pipe_stage_name(uint8_t stage)
+{
+	static const char *const names[INTEGRATOR_PIPE_STAGES] = { "I2C1", "I2C2", "konwersja", "UART" };
+	return stage < INTEGRATOR_PIPE_STAGES ? names[stage] : "?";
+}
+
+/* Starts the window of a pipeline stage at counter value now; a busy stage stays busy */
+static inline void integrator_pipe_restart(integrator_pipe_stage *pipe, uint32_t now)
+{
+	pipe->cycles = 0;
+	pipe->since = now;
+	pipe->items = 0;
+	pipe->waits = 0;
+}
+
+static inline void integrator_profile_init(integrator_profile *profile, uint32_t now)
+{
+	for(uint8_t s = 0; s < INTEGRATOR_PROFILE_STAGES; s++)
+	{
+		profile->cycles[s] = 0;
+		profile->entries[s] = 0;
+	}
+	for(uint8_t s = 0; s < INTEGRATOR_PIPE_STAGES; s++)
+	{
+		integrator_pipe_restart(&profile->pipe[s], now);
+	}
+	profile->last = now;
+	profile->window_start = now;
+	profile->current = INTEGRATOR_STAGE_OTHER;
+}
+
+/* Makes stage the current one at counter value now; returns the stage left */
+static inline uint8_t integrator_profile_switch(integrator_profile *profile, uint8_t stage, uint32_t now)
+{
+	uint8_t previous = profile->current;
+
+	profile->cycles[previous] += now - profile->last;
+	profile->last = now;
+	profile->current = stage;
+	return previous;
+}
+
+static inline void integrator_profile_count(integrator_profile *profile, uint8_t stage)
+{
+	if(profile->entries[stage] != UINT16_MAX) profile->entries[stage]++;
+}
+
+/* Pipeline stage turns busy at counter value now */
+static inline void integrator_pipe_busy(integrator_profile *profile, uint8_t stage, uint32_t now)
+{
+	integrator_pipe_stage *pipe = &profile->pipe[stage];
+
+	if(pipe->busy) return;
+	pipe->busy = 1;
+	pipe->since = now;
+}
+
+/* Pipeline stage finished its item at counter value now */
+static inline void integrator_pipe_idle(integrator_profile *profile, uint8_t stage, uint32_t now)
+{
+	integrator_pipe_stage *pipe = &profile->pipe[stage];
+
+	if(!pipe->busy) return;
+	pipe->busy = 0;
+	pipe->cycles += now - pipe->since;
+	if(pipe->items != UINT16_MAX) pipe->items++;
+}
+
+/* An item found the pipeline stage busy or full */
+static inline void integrator_pipe_wait(integrator_profile *profile, uint8_t stage)
+{
+	if(profile->pipe[stage].waits != UINT16_MAX) profile->pipe[stage].waits++;
+}
+
+/*
+ * Closes the window at counter value now, writes the INTEGRATOR_ID_PROFILE
+ * payload (INTEGRATOR_PROFILE_SIZE bytes) and starts the next window.
+ */
+static inline uint16_t integrator_profile_put(integrator_profile *profile, uint32_t now, uint32_t core_hz,
+		uint32_t window_us, uint8_t *payload)
+{
+	uint8_t *dst = payload + INTEGRATOR_PROFILE_HEADER_SIZE;
+
+	integrator_profile_switch(profile, profile->current, now);
+	integrator_put_u32(&payload[0], core_hz);
+	integrator_put_u32(&payload[4], window_us);
+	integrator_put_u32(&payload[8], now - profile->window_start);
+	payload[12] = INTEGRATOR_PROFILE_STAGES;
+	for(uint8_t s = 0; s < INTEGRATOR_PROFILE_STAGES; s++)
+	{
+		integrator_put_u32(&dst[0], profile->cycles[s]);
+		integrator_put_u16(&dst[4], profile->entries[s]);
+		dst += INTEGRATOR_PROFILE_STAGE_SIZE;
+		profile->cycles[s] = 0;
+		profile->entries[s] = 0;
+	}
+	*dst++ = INTEGRATOR_PIPE_STAGES;
+	for(uint8_t s = 0; s < INTEGRATOR_PIPE_STAGES; s++)
+	{
+		integrator_pipe_stage *pipe = &profile->pipe[s];
+		/* A stage busy across the end of the window counts its part in both */
+		const uint32_t busy = pipe->cycles + (pipe->busy ? now - pipe->since : 0);
+
+		integrator_put_u32(&dst[0], busy);
+		integrator_put_u16(&dst[4], pipe->items);
+		integrator_put_u16(&dst[6], pipe->waits);
+		dst += INTEGRATOR_PIPE_STAGE_SIZE;
+		integrator_pipe_restart(pipe, now);
+	}
+	profile->window_start = now;
+	return (uint16_t)(dst - payload);
+}
+
+/* Reads stage k of an INTEGRATOR_ID_PROFILE payload */
+static inline void integrator_profile_get_stage(const uint8_t *payload, uint8_t k, uint32_t *cycles, uint16_t *entries)
+{
+	const uint8_t *src = payload + INTEGRATOR_PROFILE_HEADER_SIZE + k * INTEGRATOR_PROFILE_STAGE_SIZE;
+	*cycles = integrator_get_u32(&src[0]);
+	*entries = integrator_get_u16(&src[4]);
+}
+
+/*
+ * Returns the number of pipeline stages in an INTEGRATOR_ID_PROFILE payload
+ * of length bytes, 0 if the firmware sent none.
+ */
+static inline uint8_t integrator_profile_pipe_stages(const uint8_t *payload, uint16_t length)
+{
+	const uint16_t offset = INTEGRATOR_PROFILE_HEADER_SIZE + payload[12] * INTEGRATOR_PROFILE_STAGE_SIZE;
+
+	if(length <= offset || length < offset + 1 + payload[offset] * INTEGRATOR_PIPE_STAGE_SIZE) return 0;
+	return payload[offset];
+}
+
+/* Reads pipeline stage m of an INTEGRATOR_ID_PROFILE payload */
+static inline void integrator_profile_get_pipe(const uint8_t *payload, uint8_t m, uint32_t *cycles, uint16_t *items,
+		uint16_t *waits)
+{
+	const uint8_t *src = payload + INTEGRATOR_PROFILE_HEADER_SIZE + payload[12] * INTEGRATOR_PROFILE_STAGE_SIZE
+			+ 1 + m * INTEGRATOR_PIPE_STAGE_SIZE;
+	*cycles = integrator_get_u32(&src[0]);
+	*items = integrator_get_u16(&src[4]);
+	*waits = integrator_get_u16(&src[6]);
+}
+
+#endif /* INTEGRATOR_PROFILE_H */
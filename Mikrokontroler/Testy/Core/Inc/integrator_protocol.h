@@ -0,0 +1,398 @@
+/**
+  ******************************************************************************
+  * @file    integrator_protocol.h
+  * @brief   Binary frame format shared by the firmware and the Qt application.
+  ******************************************************************************
+  * Every binary frame has the following layout (multi-byte fields are
+  * little-endian):
+  *
+  *   offset  size  field
+  *   0       1     INTEGRATOR_SYNC_1
+  *   1       1     INTEGRATOR_SYNC_2
+  *   2       1     sensor id (same letters as the ASCII frames: X, Z, P, L)
+  *   3       2     payload length in bytes
+  *   5       2     sequence number, counted separately for every id
+  *   7       4     MCU timestamp in microseconds (free-running TIM2), taken
+  *                 when the sensor data was read
+  *   11      n     payload
+  *   11+n    2     CRC16 of bytes 2 .. 10+n (header after the sync word and
+  *                 the payload)
+  *
+  * Payloads are packed int16 values: millimetres for the VL53L5CX and
+  * hundredths of a degree Celsius for the AMG8833 and the MLX90640.
+  *
+  * With INTEGRATOR_CMD_FORMAT_CODED the sensor frames are delta or sparse
+  * coded (see integrator_codec.h) and carry the sensor id ORed with
+  * INTEGRATOR_ID_CODED.
+  *
+  * With INTEGRATOR_CMD_MLX_RAW the MLX90640 is sent as raw frame data
+  * (INTEGRATOR_ID_MLX90640_RAW) instead of temperatures, and the host solves
+  * the temperatures with the calibration from the INTEGRATOR_ID_MLX90640_EEPROM
+  * frame. Raw frames are never coded and share the sequence counter of the
+  * INTEGRATOR_ID_MLX90640 frames.
+  *
+  * With INTEGRATOR_CMD_MLX_SUBPAGE every MLX90640 subpage is sent as soon as
+  * it is read, as an INTEGRATOR_ID_MLX90640_SUBPAGE frame with only the
+  * pixels of that subpage (see integrator_mlx90640_pixel_subpage()); the host
+  * merges the subpages into the image. Subpage frames are never coded and
+  * share the sequence counter of the INTEGRATOR_ID_MLX90640 frames.
+  *
+  * With INTEGRATOR_CMD_AMG_RAW the AMG8833 is sent as its pixel registers
+  * (INTEGRATOR_ID_AMG8833_RAW), converted by the host with
+  * integrator_amg8833_raw_to_wire(). They are never coded either and share
+  * the sequence counter of the INTEGRATOR_ID_AMG8833 frames.
+  *
+  * With INTEGRATOR_CMD_TOF_FIELDS a VL53L5CX is sent with every target of a
+  * zone and its status, sigma and signal (INTEGRATOR_ID_VL53L5CX_FIELDS, see
+  * integrator_tof.h). These frames are never coded and share the sequence
+  * counter of the sensor's distance frames.
+  *
+  * The ASCII format ("X <len> v0 v1 ... <crc> Y\r\n") is still available and
+  * selected with INTEGRATOR_CMD_FORMAT_ASCII, which keeps old tooling working.
+  *
+  * The host sends the INTEGRATOR_CMD_* letters below either as bare bytes or
+  * in command frames, which the firmware acknowledges (integrator_command.h).
+  ******************************************************************************
+  */
+#ifndef INTEGRATOR_PROTOCOL_H
+#define INTEGRATOR_PROTOCOL_H
+
+#include <stdint.h>
+
+#include "integrator_crc16.h"
+
+#define INTEGRATOR_SYNC_1               0xA5
+#define INTEGRATOR_SYNC_2               0x5A
+
+#define INTEGRATOR_HEADER_SIZE          11
+#define INTEGRATOR_CRC_SIZE             2
+#define INTEGRATOR_CRC_START            2       /* First byte covered by the CRC */
+
+/* Sensor ids, identical to the first character of the ASCII frames */
+#define INTEGRATOR_ID_VL53L5CX_1        'X'
+#define INTEGRATOR_ID_VL53L5CX_2        'Z'
+#define INTEGRATOR_ID_AMG8833           'P'
+#define INTEGRATOR_ID_MLX90640          'L'
+#define INTEGRATOR_ID_VL53L5CX_3        'S'
+#define INTEGRATOR_ID_VL53L5CX_4        'O'
+
+#define INTEGRATOR_SENSOR_COUNT         6
+#define INTEGRATOR_VL53L5CX_MAX         4       /* VL53L5CX ids, see integrator_vl53l5cx_id() */
+
+/* Set in the id of delta or sparse coded sensor frames */
+#define INTEGRATOR_ID_CODED             0x80
+
+#define INTEGRATOR_VL53L5CX_VALUES      64
+#define INTEGRATOR_AMG8833_VALUES       64
+#define INTEGRATOR_MLX90640_VALUES      768
+
+/* Raw MLX90640 data, see MLX90640_API.h */
+#define INTEGRATOR_MLX90640_EEPROM_WORDS 832
+#define INTEGRATOR_MLX90640_RAW_WORDS   834     /* RAM image plus control register and subpage */
+
+/*
+ * INTEGRATOR_ID_MLX90640_SUBPAGE payload: u8 subpage (0 or 1), u8 flags
+ * (INTEGRATOR_MLX90640_CHESS), then the int16 temperatures of the
+ * INTEGRATOR_MLX90640_SUBPAGE_VALUES pixels of the subpage in pixel order
+ */
+#define INTEGRATOR_MLX90640_SUBPAGE_HEADER 2
+#define INTEGRATOR_MLX90640_SUBPAGE_VALUES (INTEGRATOR_MLX90640_VALUES / 2)
+#define INTEGRATOR_MLX90640_CHESS       0x01    /* Chess pattern, otherwise interleaved rows */
+
+#define INTEGRATOR_MAX_VALUES           INTEGRATOR_MLX90640_VALUES
+#define INTEGRATOR_MAX_PAYLOAD          (INTEGRATOR_MLX90640_RAW_WORDS * 2)  /* Largest payload, a raw MLX90640 frame */
+#define INTEGRATOR_MAX_FRAME            (INTEGRATOR_HEADER_SIZE + INTEGRATOR_MAX_PAYLOAD + INTEGRATOR_CRC_SIZE)
+
+/* Temperatures travel as int16 hundredths of a degree */
+#define INTEGRATOR_TEMP_SCALE           100
+
+/* Output format commands, sent by the host next to the A..I mode letters */
+#define INTEGRATOR_CMD_FORMAT_ASCII     'T'
+#define INTEGRATOR_CMD_FORMAT_BINARY    'U'
+#define INTEGRATOR_CMD_FORMAT_CODED     'K'     /* Binary frames, delta or sparse coded */
+
+/* Asks for an INTEGRATOR_ID_CAPABILITIES frame, also sent once after boot */
+#define INTEGRATOR_CMD_CAPABILITIES     'Q'
+
+/*
+ * MLX90640 output: raw frames plus one EEPROM frame (sent again on every 'M'),
+ * temperatures of every subpage, or whole temperature frames
+ */
+#define INTEGRATOR_CMD_MLX_RAW          'M'
+#define INTEGRATOR_CMD_MLX_SUBPAGE      'L'
+#define INTEGRATOR_CMD_MLX_TEMP         'N'
+
+/*
+ * MLX90640 refresh rate: INTEGRATOR_CMD_MLX_RATE followed by '0' + rate code
+ * n, 0.5 * 2^n subpages per second (n <= 7). The firmware answers with an
+ * INTEGRATOR_ID_CAPABILITIES frame carrying the new rate.
+ */
+#define INTEGRATOR_CMD_MLX_RATE         'Z'
+#define INTEGRATOR_MLX90640_RATE_MAX    7
+
+/* AMG8833 output: raw pixel registers, or temperatures */
+#define INTEGRATOR_CMD_AMG_RAW          'R'
+#define INTEGRATOR_CMD_AMG_TEMP         'S'
+
+/*
+ * AMG8833 settings: INTEGRATOR_CMD_AMG_CONFIG followed by one byte of
+ * INTEGRATOR_AMG_* flags. The firmware answers with an
+ * INTEGRATOR_ID_CAPABILITIES frame carrying the new rate.
+ */
+#define INTEGRATOR_CMD_AMG_CONFIG       'O'
+#define INTEGRATOR_AMG_FPS_1            0x01    /* 1 frame per second instead of 10 */
+#define INTEGRATOR_AMG_MOVING_AVERAGE   0x02    /* Twice moving average output mode */
+
+/*
+ * VL53L5CX output blocks: INTEGRATOR_CMD_VL_OUTPUTS followed by one byte of
+ * INTEGRATOR_VL_OUTPUT_* flags selects what every sensor reads besides the
+ * distances, which are always read. Each block lengthens the I2C read of
+ * every frame; blocks the firmware is built without are ignored. Ranging is
+ * restarted with the new set. Firmware 1.3 and newer; older firmware would
+ * take the flags byte for a command.
+ */
+#define INTEGRATOR_CMD_VL_OUTPUTS       'Y'
+#define INTEGRATOR_VL_OUTPUTS_VERSION_MAJOR 1
+#define INTEGRATOR_VL_OUTPUTS_VERSION_MINOR 3
+#define INTEGRATOR_VL_OUTPUT_TARGET_STATUS  0x01
+#define INTEGRATOR_VL_OUTPUT_NB_TARGET      0x02
+#define INTEGRATOR_VL_OUTPUT_SIGMA          0x04
+#define INTEGRATOR_VL_OUTPUT_SIGNAL         0x08
+#define INTEGRATOR_VL_OUTPUT_AMBIENT        0x10
+#define INTEGRATOR_VL_OUTPUT_SPADS          0x20
+#define INTEGRATOR_VL_OUTPUT_REFLECTANCE    0x40
+#define INTEGRATOR_VL_OUTPUT_MOTION         0x80
+
+/*
+ * VL53L5CX fields: INTEGRATOR_CMD_TOF_FIELDS followed by the sensor id and
+ * one byte of INTEGRATOR_TOF_FIELD_* flags. A sensor with any field sends
+ * INTEGRATOR_ID_VL53L5CX_FIELDS frames (integrator_tof.h) instead of its
+ * distance frames and reads the output blocks the fields need; 0 returns to
+ * the distance frames. Firmware 1.4 and newer.
+ */
+#define INTEGRATOR_CMD_TOF_FIELDS       'X'
+#define INTEGRATOR_CMD_TOF_FIELDS_ARGS  2
+#define INTEGRATOR_TOF_FIELDS_VERSION_MAJOR 1
+#define INTEGRATOR_TOF_FIELDS_VERSION_MINOR 4
+
+/*
+ * Measurement series on the MCU: INTEGRATOR_CMD_SERIES followed by the
+ * sensor id, the number of frames (u16) and INTEGRATOR_SERIES_* flags. The
+ * next frames of the sensor are accumulated per zone (integrator_series.h)
+ * and only the statistics are sent, as INTEGRATOR_ID_SERIES frames; the
+ * sensor frames themselves are held back unless INTEGRATOR_SERIES_FRAMES is
+ * set. 0 frames aborts a running series, which then reports what it has.
+ * Every sensor has its own series. An MLX90640 frame is both subpages, so
+ * its series takes two subpage periods per frame.
+ */
+#define INTEGRATOR_CMD_SERIES           'J'
+#define INTEGRATOR_CMD_SERIES_ARGS      4
+#define INTEGRATOR_SERIES_FRAMES        0x01    /* Keep sending the frames of the sensor */
+
+/*
+ * Cycle budget telemetry: INTEGRATOR_CMD_PROFILE followed by '0' + n sends an
+ * INTEGRATOR_ID_PROFILE frame (integrator_profile.h) every n seconds, '0'
+ * stops it.
+ */
+#define INTEGRATOR_CMD_PROFILE          'P'
+
+/*
+ * Baud rate negotiation:
+ *  1. host sends INTEGRATOR_CMD_BAUD followed by '0' + index into
+ *     INTEGRATOR_BAUD_RATES,
+ *  2. the firmware answers with an INTEGRATOR_ID_BAUD frame
+ *     (INTEGRATOR_BAUD_SWITCHING) at the old rate and switches,
+ *  3. host switches and sends INTEGRATOR_CMD_BAUD_CONFIRM at the new rate,
+ *  4. the firmware answers with INTEGRATOR_BAUD_CONFIRMED. Without the
+ *     confirmation it returns to INTEGRATOR_BAUD_DEFAULT after
+ *     INTEGRATOR_BAUD_CONFIRM_MS.
+ */
+#define INTEGRATOR_CMD_BAUD             'V'
+#define INTEGRATOR_CMD_BAUD_CONFIRM     'W'
+
+#define INTEGRATOR_BAUD_DEFAULT         115200
+#define INTEGRATOR_BAUD_RATES           { 115200, 460800, 921600, 1000000, 2000000 }
+#define INTEGRATOR_BAUD_RATE_COUNT      5
+#define INTEGRATOR_BAUD_CONFIRM_MS      1000
+
+/* Control frame ids (firmware to host), next to the sensor ids */
+#define INTEGRATOR_ID_BAUD              'R'     /* payload: u32 baud rate, u8 state */
+#define INTEGRATOR_ID_CAPABILITIES      'C'     /* payload: capability descriptor, see below */
+#define INTEGRATOR_ID_MLX90640_EEPROM   'E'     /* payload: INTEGRATOR_MLX90640_EEPROM_WORDS u16 */
+#define INTEGRATOR_ID_MLX90640_RAW      'M'     /* payload: INTEGRATOR_MLX90640_RAW_WORDS u16 */
+#define INTEGRATOR_ID_SERIES            'G'     /* payload: series statistics, see integrator_series.h */
+#define INTEGRATOR_ID_AMG8833_RAW       'A'     /* payload: INTEGRATOR_AMG8833_VALUES u16 pixel registers */
+#define INTEGRATOR_ID_MLX90640_SUBPAGE  'H'     /* payload: see INTEGRATOR_MLX90640_SUBPAGE_HEADER */
+#define INTEGRATOR_ID_VL53L5CX_FIELDS   'F'     /* payload: distances and fields, see integrator_tof.h */
+#define INTEGRATOR_ID_PROFILE           'T'     /* payload: cycle budget, see integrator_profile.h */
+#define INTEGRATOR_ID_ACK               'K'     /* payload: acknowledgement, see integrator_command.h */
+
+/* Command frame id (host to firmware), see integrator_command.h */
+#define INTEGRATOR_ID_COMMAND           'K'
+
+#define INTEGRATOR_BAUD_SWITCHING       0
+#define INTEGRATOR_BAUD_CONFIRMED       1
+#define INTEGRATOR_BAUD_REJECTED        2
+
+/*
+ * Capability descriptor, lets the host size its buffers and views without
+ * assuming the sensor set or the grid sizes:
+ *
+ *   offset  size  field
+ *   0       1     INTEGRATOR_CAPS_VERSION
+ *   1       1     firmware version, major
+ *   2       1     firmware version, minor
+ *   3       1     number of sensor entries n
+ *   4+8k    1     sensor id
+ *   5+8k    1     data type (INTEGRATOR_DATA_*)
+ *   6+8k    1     grid width
+ *   7+8k    1     grid height
+ *   8+8k    2     sensor refresh rate in hundredths of a hertz
+ *   10+8k   1     flags (INTEGRATOR_CAPS_*)
+ *   11+8k   1     reserved, 0
+ */
+#define INTEGRATOR_CAPS_VERSION         1
+#define INTEGRATOR_CAPS_HEADER_SIZE     4
+#define INTEGRATOR_CAPS_ENTRY_SIZE      8
+
+#define INTEGRATOR_DATA_DISTANCE_MM     0       /* int16 millimetres */
+#define INTEGRATOR_DATA_TEMP_CENTI      1       /* int16 hundredths of a degree Celsius */
+
+#define INTEGRATOR_CAPS_PRESENT         0x01    /* Sensor answered during initialisation */
+
+static inline void integrator_put_u16(uint8_t *dst, uint16_t value)
+{
+	dst[0] = (uint8_t)(value & 0xFF);
+	dst[1] = (uint8_t)(value >> 8);
+}
+
+static inline uint16_t integrator_get_u16(const uint8_t *src)
+{
+	return (uint16_t)(src[0] | ((uint16_t)src[1] << 8));
+}
+
+static inline void integrator_put_u32(uint8_t *dst, uint32_t value)
+{
+	integrator_put_u16(dst, (uint16_t)(value & 0xFFFF));
+	integrator_put_u16(dst + 2, (uint16_t)(value >> 16));
+}
+
+static inline uint32_t integrator_get_u32(const uint8_t *src)
+{
+	return integrator_get_u16(src) | ((uint32_t)integrator_get_u16(src + 2) << 16);
+}
+
+static inline void integrator_put_i16(uint8_t *dst, int16_t value)
+{
+	integrator_put_u16(dst, (uint16_t)value);
+}
+
+static inline int16_t integrator_get_i16(const uint8_t *src)
+{
+	return (int16_t)integrator_get_u16(src);
+}
+
+/* Converts a temperature to the int16 wire representation, saturating */
+static inline int16_t integrator_temp_to_wire(float celsius)
+{
+	float scaled = celsius * INTEGRATOR_TEMP_SCALE;
+	if (scaled > 32767.0f) return 32767;
+	if (scaled < -32768.0f) return -32768;
+	return (int16_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
+static inline float integrator_wire_to_temp(int16_t value)
+{
+	return (float)value / INTEGRATOR_TEMP_SCALE;
+}
+
+/* AMG8833 pixel register (12-bit two's complement, quarters of a degree) to the wire representation */
+static inline int16_t integrator_amg8833_raw_to_wire(uint16_t raw)
+{
+	int16_t quarters = (int16_t)(raw & 0x07FF);
+	if (raw & 0x0800) quarters -= 0x0800;
+	return (int16_t)(quarters * (INTEGRATOR_TEMP_SCALE / 4));
+}
+
+/* Subpage (0 or 1) that measures an MLX90640 pixel in the chess or the interleaved pattern */
+static inline uint8_t integrator_mlx90640_pixel_subpage(uint16_t pixel, uint8_t chess)
+{
+	uint8_t row = (uint8_t)((pixel / 32) & 1);
+	return chess ? (uint8_t)(row ^ (pixel & 1)) : row;
+}
+
+/* Maps a sensor id, coded or not, to 0..INTEGRATOR_SENSOR_COUNT-1, other ids to INTEGRATOR_SENSOR_COUNT */
+static inline uint8_t integrator_sensor_slot(uint8_t id)
+{
+	switch (id & ~INTEGRATOR_ID_CODED)
+	{
+	case INTEGRATOR_ID_VL53L5CX_1: return 0;
+	case INTEGRATOR_ID_VL53L5CX_2: return 1;
+	case INTEGRATOR_ID_AMG8833:    return 2;
+	case INTEGRATOR_ID_MLX90640:   return 3;
+	case INTEGRATOR_ID_VL53L5CX_3: return 4;
+	case INTEGRATOR_ID_VL53L5CX_4: return 5;
+	default:                       return INTEGRATOR_SENSOR_COUNT;
+	}
+}
+
+/* Inverse of integrator_sensor_slot(), 0 for slots out of range */
+static inline uint8_t integrator_slot_id(uint8_t slot)
+{
+	static const uint8_t ids[INTEGRATOR_SENSOR_COUNT] = {
+		INTEGRATOR_ID_VL53L5CX_1, INTEGRATOR_ID_VL53L5CX_2, INTEGRATOR_ID_AMG8833,
+		INTEGRATOR_ID_MLX90640, INTEGRATOR_ID_VL53L5CX_3, INTEGRATOR_ID_VL53L5CX_4
+	};
+	return slot < INTEGRATOR_SENSOR_COUNT ? ids[slot] : 0;
+}
+
+/* Id of the n-th VL53L5CX, n < INTEGRATOR_VL53L5CX_MAX */
+static inline uint8_t integrator_vl53l5cx_id(uint8_t n)
+{
+	static const uint8_t ids[INTEGRATOR_VL53L5CX_MAX] = {
+		INTEGRATOR_ID_VL53L5CX_1, INTEGRATOR_ID_VL53L5CX_2, INTEGRATOR_ID_VL53L5CX_3, INTEGRATOR_ID_VL53L5CX_4
+	};
+	return n < INTEGRATOR_VL53L5CX_MAX ? ids[n] : 0;
+}
+
+static inline uint8_t integrator_is_vl53l5cx(uint8_t id)
+{
+	id &= (uint8_t)~INTEGRATOR_ID_CODED;
+	return id == INTEGRATOR_ID_VL53L5CX_1 || id == INTEGRATOR_ID_VL53L5CX_2
+		|| id == INTEGRATOR_ID_VL53L5CX_3 || id == INTEGRATOR_ID_VL53L5CX_4;
+}
+
+/* Writes one capability descriptor entry, see INTEGRATOR_CAPS_ENTRY_SIZE */
+static inline void integrator_put_caps_entry(uint8_t *dst, uint8_t id, uint8_t data_type, uint8_t width,
+		uint8_t height, uint16_t rate_centihz, uint8_t flags)
+{
+	dst[0] = id;
+	dst[1] = data_type;
+	dst[2] = width;
+	dst[3] = height;
+	integrator_put_u16(&dst[4], rate_centihz);
+	dst[6] = flags;
+	dst[7] = 0;
+}
+
+/* Writes the frame header in front of a payload of payload_len bytes */
+static inline void integrator_put_header(uint8_t *frame, uint8_t id, uint16_t payload_len,
+		uint16_t sequence, uint32_t timestamp_us)
+{
+	frame[0] = INTEGRATOR_SYNC_1;
+	frame[1] = INTEGRATOR_SYNC_2;
+	frame[2] = id;
+	integrator_put_u16(&frame[3], payload_len);
+	integrator_put_u16(&frame[5], sequence);
+	integrator_put_u32(&frame[7], timestamp_us);
+}
+
+/* Appends the CRC behind the payload and returns the length of the whole frame */
+static inline uint16_t integrator_put_crc(uint8_t *frame, uint16_t payload_len)
+{
+	uint16_t covered = INTEGRATOR_HEADER_SIZE - INTEGRATOR_CRC_START + payload_len;
+	integrator_put_u16(&frame[INTEGRATOR_CRC_START + covered], integrator_crc16(&frame[INTEGRATOR_CRC_START], covered));
+	return INTEGRATOR_HEADER_SIZE + payload_len + INTEGRATOR_CRC_SIZE;
+}
+
+#endif /* INTEGRATOR_PROTOCOL_H */
@@ -0,0 +1,203 @@
+/**
+  ******************************************************************************
+  * @file    integrator_series.h
+  * @brief   Per-zone statistics of a measurement series, shared by the
+  *          firmware and the Qt application.
+  ******************************************************************************
+  * A series started with INTEGRATOR_CMD_SERIES is accumulated on the MCU with
+  * Welford's method: mean and sum of squared differences are updated with
+  * every frame, so no frame has to be kept and long series stay accurate.
+  * The result is sent in INTEGRATOR_ID_SERIES frames of at most
+  * INTEGRATOR_SERIES_ZONES_PER_FRAME zones each:
+  *
+  *   offset  size  field
+  *   0       1     sensor id
+  *   1       1     INTEGRATOR_SERIES_DONE or INTEGRATOR_SERIES_ABORTED
+  *   2       2     frames accumulated
+  *   4       4     MCU time from the first to the last frame in microseconds
+  *   8       2     zones of the sensor
+  *   10      2     first zone in this frame
+  *   12      2     zones in this frame, k
+  *   14+12k  2     minimum, int16
+  *   16+12k  2     maximum, int16
+  *   18+12k  4     mean, int32 in 1/INTEGRATOR_SERIES_FRACTION
+  *   22+12k  4     population variance, uint32 in 1/INTEGRATOR_SERIES_FRACTION
+  *                 of the squared unit, saturating
+  *
+  * Values are in the unit of the sensor frames: millimetres or hundredths of
+  * a degree Celsius.
+  ******************************************************************************
+  */
+#ifndef INTEGRATOR_SERIES_H
+#define INTEGRATOR_SERIES_H
+
+#include <stdint.h>
+
+#include "integrator_protocol.h"
+
+#define INTEGRATOR_SERIES_DONE          0
+#define INTEGRATOR_SERIES_ABORTED       1
+
+#define INTEGRATOR_SERIES_HEADER_SIZE   14
+#define INTEGRATOR_SERIES_ZONE_SIZE     12
+#define INTEGRATOR_SERIES_ZONES_PER_FRAME 128
+#define INTEGRATOR_SERIES_FRACTION      256
+
+typedef struct
+{
+	float mean;
+	float m2;               /* Sum of squared differences from the mean */
+	int16_t min;
+	int16_t max;
+} integrator_series_zone;
+
+typedef struct
+{
+	integrator_series_zone *zones;
+	uint16_t capacity;      /* Number of entries in zones */
+	uint16_t count;         /* Zones per frame, taken from the first frame */
+	uint16_t target;        /* Frames requested, 0 while no series runs */
+	uint16_t frames;        /* Frames accumulated */
+	uint8_t flags;          /* INTEGRATOR_SERIES_FRAMES */
+	uint32_t first_us;
+	uint32_t last_us;
+} integrator_series;
+
+static inline void integrator_series_init(integrator_series *series, integrator_series_zone *zones, uint16_t capacity)
+{
+	series->zones = zones;
+	series->capacity = capacity;
+	series->count = 0;
+	series->target = 0;
+	series->frames = 0;
+	series->flags = 0;
+}
+
+static inline void integrator_series_start(integrator_series *series, uint16_t target, uint8_t flags)
+{
+	series->count = 0;
+	series->target = target;
+	series->frames = 0;
+	series->flags = flags;
+}
+
+/* Frames are still being accumulated */
+static inline uint8_t integrator_series_running(const integrator_series *series)
+{
+	return series->target != 0 && series->frames < series->target;
+}
+
+/* All requested frames are in, the summary is due */
+static inline uint8_t integrator_series_complete(const integrator_series *series)
+{
+	return series->target != 0 && series->frames >= series->target;
+}
+
+/**
+ * Adds a frame of count packed int16 values (an uncoded payload). The first
+ * frame fixes the number of zones; later frames of another size only update
+ * the zones both have. Returns 1 when the frame completes the series.
+ */
+static inline uint8_t integrator_series_add(integrator_series *series, const uint8_t *values, uint16_t count,
+		uint32_t timestamp_us)
+{
+	if (!integrator_series_running(series)) return 0;
+
+	if (series->frames == 0)
+	{
+		series->count = count < series->capacity ? count : series->capacity;
+		series->first_us = timestamp_us;
+		for (uint16_t i = 0; i < series->count; i++)
+		{
+			series->zones[i].mean = 0.0f;
+			series->zones[i].m2 = 0.0f;
+			series->zones[i].min = INT16_MAX;
+			series->zones[i].max = INT16_MIN;
+		}
+	}
+	if (count > series->count) count = series->count;
+
+	/* One division per frame instead of one per zone */
+	const float weight = 1.0f / (float)(series->frames + 1);
+	for (uint16_t i = 0; i < count; i++)
+	{
+		integrator_series_zone *zone = &series->zones[i];
+		int16_t value = integrator_get_i16(&values[2*i]);
+		float delta = (float)value - zone->mean;
+		zone->mean += delta * weight;
+		zone->m2 += delta * ((float)value - zone->mean);
+		if (value < zone->min) zone->min = value;
+		if (value > zone->max) zone->max = value;
+	}
+	series->frames++;
+	series->last_us = timestamp_us;
+	return series->frames >= series->target;
+}
+
+/* Mean in 1/INTEGRATOR_SERIES_FRACTION, saturating */
+static inline int32_t integrator_series_fixed_mean(float mean)
+{
+	float scaled = mean * INTEGRATOR_SERIES_FRACTION;
+	if (scaled >= 2147483520.0f) return INT32_MAX;
+	if (scaled <= -2147483520.0f) return INT32_MIN;
+	return (int32_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
+/* Variance in 1/INTEGRATOR_SERIES_FRACTION, saturating */
+static inline uint32_t integrator_series_fixed_variance(float variance)
+{
+	float scaled = variance * INTEGRATOR_SERIES_FRACTION;
+	if (scaled >= 4294967040.0f) return UINT32_MAX;
+	if (scaled <= 0.0f) return 0;
+	return (uint32_t)(scaled + 0.5f);
+}
+
+/**
+ * Writes the INTEGRATOR_ID_SERIES payload with the zones from first_zone on
+ * into payload, which must hold INTEGRATOR_SERIES_HEADER_SIZE +
+ * INTEGRATOR_SERIES_ZONES_PER_FRAME * INTEGRATOR_SERIES_ZONE_SIZE bytes.
+ * Returns the length of the payload.
+ */
+static inline uint16_t integrator_series_put_summary(const integrator_series *series, uint8_t id, uint8_t state,
+		uint16_t first_zone, uint8_t *payload)
+{
+	uint16_t zones = 0;
+	uint8_t *dst = payload + INTEGRATOR_SERIES_HEADER_SIZE;
+
+	if (series->frames > 0 && first_zone < series->count)
+	{
+		zones = series->count - first_zone;
+		if (zones > INTEGRATOR_SERIES_ZONES_PER_FRAME) zones = INTEGRATOR_SERIES_ZONES_PER_FRAME;
+	}
+
+	payload[0] = id;
+	payload[1] = state;
+	integrator_put_u16(&payload[2], series->frames);
+	integrator_put_u32(&payload[4], series->frames > 0 ? series->last_us - series->first_us : 0);
+	integrator_put_u16(&payload[8], series->frames > 0 ? series->count : 0);
+	integrator_put_u16(&payload[10], first_zone);
+	integrator_put_u16(&payload[12], zones);
+	for (uint16_t i = 0; i < zones; i++)
+	{
+		const integrator_series_zone *zone = &series->zones[first_zone + i];
+		integrator_put_i16(&dst[0], zone->min);
+		integrator_put_i16(&dst[2], zone->max);
+		integrator_put_u32(&dst[4], (uint32_t)integrator_series_fixed_mean(zone->mean));
+		integrator_put_u32(&dst[8], integrator_series_fixed_variance(zone->m2 / series->frames));
+		dst += INTEGRATOR_SERIES_ZONE_SIZE;
+	}
+	return (uint16_t)(dst - payload);
+}
+
+/* Reads zone k of an INTEGRATOR_ID_SERIES payload, counted from its first zone */
+static inline void integrator_series_get_zone(const uint8_t *payload, uint16_t k, int16_t *min, int16_t *max,
+		float *mean, float *variance)
+{
+	const uint8_t *src = payload + INTEGRATOR_SERIES_HEADER_SIZE + k * INTEGRATOR_SERIES_ZONE_SIZE;
+	*min = integrator_get_i16(&src[0]);
+	*max = integrator_get_i16(&src[2]);
+	*mean = (float)(int32_t)integrator_get_u32(&src[4]) / INTEGRATOR_SERIES_FRACTION;
+	*variance = (float)integrator_get_u32(&src[8]) / INTEGRATOR_SERIES_FRACTION;
+}
+
+#endif /* INTEGRATOR_SERIES_H */
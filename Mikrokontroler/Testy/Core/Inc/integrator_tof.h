@@ -0,0 +1,123 @@
+/**
+  ******************************************************************************
+  * @file    integrator_tof.h
+  * @brief   VL53L5CX frames with per-zone fields besides the distance, shared
+  *          by the firmware and the Qt application.
+  ******************************************************************************
+  * A sensor subscribed with INTEGRATOR_CMD_TOF_FIELDS sends
+  * INTEGRATOR_ID_VL53L5CX_FIELDS frames instead of its plain distance frames,
+  * with the same sequence counter. The payload is a structure of arrays: one
+  * array per field and target, each indexed by zone, in this order:
+  *
+  *   offset  size    field
+  *   0       1       sensor id
+  *   1       1       INTEGRATOR_TOF_FIELD_* carried
+  *   2       1       targets per zone, t (1 without INTEGRATOR_TOF_FIELD_TARGETS)
+  *   3       1       zones, n
+  *   4       2tn     distance in millimetres, int16, target 0 of all zones first
+  *           n       targets detected per zone, u8 (INTEGRATOR_TOF_FIELD_TARGETS)
+  *           tn      target status, u8 (INTEGRATOR_TOF_FIELD_STATUS)
+  *           2tn     range sigma in millimetres, u16 (INTEGRATOR_TOF_FIELD_SIGMA)
+  *           2tn     signal per SPAD in kcps, u16 saturating (INTEGRATOR_TOF_FIELD_SIGNAL)
+  *
+  * Targets are ordered as the sensor reports them (closest first on this
+  * board). A target beyond the number detected in its zone has status
+  * INTEGRATOR_TOF_STATUS_NONE. The frames are never coded and are sent in
+  * the binary formats only.
+  ******************************************************************************
+  */
+#ifndef INTEGRATOR_TOF_H
+#define INTEGRATOR_TOF_H
+
+#include <stdint.h>
+
+#include "integrator_protocol.h"
+
+#define INTEGRATOR_TOF_FIELD_STATUS     0x01    /* Target status */
+#define INTEGRATOR_TOF_FIELD_SIGMA      0x02    /* Range sigma */
+#define INTEGRATOR_TOF_FIELD_SIGNAL     0x04    /* Signal per SPAD */
+#define INTEGRATOR_TOF_FIELD_TARGETS    0x08    /* Every target of a zone and their number */
+#define INTEGRATOR_TOF_FIELDS_ALL       0x0F
+
+#define INTEGRATOR_TOF_MAX_TARGETS      2
+#define INTEGRATOR_TOF_HEADER_SIZE      4
+
+/* Target status of the VL53L5CX: 5 and 9 are valid ranges, 255 no target */
+#define INTEGRATOR_TOF_STATUS_VALID     5
+#define INTEGRATOR_TOF_STATUS_VALID_WIDE 9
+#define INTEGRATOR_TOF_STATUS_NONE      255
+
+/* Offsets of the arrays in the payload, 0 for fields not carried */
+typedef struct
+{
+	uint16_t distance;
+	uint16_t detected;
+	uint16_t status;
+	uint16_t sigma;
+	uint16_t signal;
+	uint16_t size;          /* Length of the payload */
+} integrator_tof_layout;
+
+static inline uint8_t integrator_tof_status_valid(uint8_t status)
+{
+	return status == INTEGRATOR_TOF_STATUS_VALID || status == INTEGRATOR_TOF_STATUS_VALID_WIDE;
+}
+
+static inline integrator_tof_layout integrator_tof_get_layout(uint8_t fields, uint8_t targets, uint8_t zones)
+{
+	integrator_tof_layout layout = { 0, 0, 0, 0, 0, 0 };
+	const uint16_t values = (uint16_t)targets * zones;
+	uint16_t offset = INTEGRATOR_TOF_HEADER_SIZE;
+
+	layout.distance = offset;
+	offset += 2 * values;
+	if (fields & INTEGRATOR_TOF_FIELD_TARGETS)
+	{
+		layout.detected = offset;
+		offset += zones;
+	}
+	if (fields & INTEGRATOR_TOF_FIELD_STATUS)
+	{
+		layout.status = offset;
+		offset += values;
+	}
+	if (fields & INTEGRATOR_TOF_FIELD_SIGMA)
+	{
+		layout.sigma = offset;
+		offset += 2 * values;
+	}
+	if (fields & INTEGRATOR_TOF_FIELD_SIGNAL)
+	{
+		layout.signal = offset;
+		offset += 2 * values;
+	}
+	layout.size = offset;
+	return layout;
+}
+
+/* Writes the header and returns the layout the arrays have to be written in */
+static inline integrator_tof_layout integrator_tof_put_header(uint8_t *payload, uint8_t id, uint8_t fields,
+		uint8_t targets, uint8_t zones)
+{
+	payload[0] = id;
+	payload[1] = fields;
+	payload[2] = targets;
+	payload[3] = zones;
+	return integrator_tof_get_layout(fields, targets, zones);
+}
+
+/*
+ * Reads the header of an INTEGRATOR_ID_VL53L5CX_FIELDS payload. Returns 0 if
+ * the payload is too short for it or holds more than the protocol allows.
+ */
+static inline uint8_t integrator_tof_get_header(const uint8_t *payload, uint16_t length, integrator_tof_layout *layout)
+{
+	if (length < INTEGRATOR_TOF_HEADER_SIZE) return 0;
+	const uint8_t targets = payload[2];
+	const uint8_t zones = payload[3];
+	if (targets == 0 || targets > INTEGRATOR_TOF_MAX_TARGETS || zones > INTEGRATOR_VL53L5CX_VALUES) return 0;
+	*layout = integrator_tof_get_layout(payload[1], targets, zones);
+	return layout->size <= length;
+}
+
+#endif /* INTEGRATOR_TOF_H */
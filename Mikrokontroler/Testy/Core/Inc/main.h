@@ -65,12 +65,21 @@ void Error_Handler(void);
 #define USART_RX_GPIO_Port GPIOA
 #define LD2_Pin GPIO_PIN_5
 #define LD2_GPIO_Port GPIOA
+#define VL1_INT_Pin GPIO_PIN_10
+#define VL1_INT_GPIO_Port GPIOA
+#define VL1_INT_EXTI_IRQn EXTI15_10_IRQn
 #define TMS_Pin GPIO_PIN_13
 #define TMS_GPIO_Port GPIOA
 #define TCK_Pin GPIO_PIN_14
 #define TCK_GPIO_Port GPIOA
 #define SWO_Pin GPIO_PIN_3
 #define SWO_GPIO_Port GPIOB
+#define VL2_INT_Pin GPIO_PIN_4
+#define VL2_INT_GPIO_Port GPIOB
+#define VL2_INT_EXTI_IRQn EXTI4_IRQn
+#define AMG_INT_Pin GPIO_PIN_5
+#define AMG_INT_GPIO_Port GPIOB
+#define AMG_INT_EXTI_IRQn EXTI9_5_IRQn
 
 /* USER CODE BEGIN Private defines */
 
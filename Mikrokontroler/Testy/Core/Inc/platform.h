@@ -67,6 +67,7 @@
 #include <stdint.h>
 #include <string.h>
 #include "stm32l4xx.h"
+#include "i2c_bus.h"
 
 /**
  * @brief Structure VL53L5CX_Platform needs to be filled by the customer,
@@ -82,6 +83,9 @@ typedef struct
 	 * needs to be added */
 	/* Example for most standard platform : I2C address of sensor */
     uint16_t  			address;
+	/* Bus the sensor is connected to, so one driver serves any number of
+	 * sensors on any bus */
+	I2C_HandleTypeDef	*hi2c;
 
 } VL53L5CX_Platform;
 
@@ -92,7 +96,7 @@ typedef struct
  * zone means a lower RAM). The value must be between 1 and 4.
  */
 
-#define 	VL53L5CX_NB_TARGET_PER_ZONE		1U
+#define 	VL53L5CX_NB_TARGET_PER_ZONE		2U
 
 /*
  * @brief The macro below can be used to avoid data conversion into the driver.
@@ -112,7 +116,7 @@ typedef struct
 #define VL53L5CX_DISABLE_AMBIENT_PER_SPAD
 #define VL53L5CX_DISABLE_NB_SPADS_ENABLED
 // #define VL53L5CX_DISABLE_NB_TARGET_DETECTED
-#define VL53L5CX_DISABLE_SIGNAL_PER_SPAD
+// #define VL53L5CX_DISABLE_SIGNAL_PER_SPAD
 // #define VL53L5CX_DISABLE_RANGE_SIGMA_MM
 // #define VL53L5CX_DISABLE_DISTANCE_MM
 #define VL53L5CX_DISABLE_REFLECTANCE_PERCENT
@@ -132,11 +136,6 @@ uint8_t RdByte(
 		uint16_t RegisterAdress,
 		uint8_t *p_value);
 
-uint8_t RdByte2(
-		VL53L5CX_Platform *p_platform,
-		uint16_t RegisterAdress,
-		uint8_t *p_value);
-
 /**
  * @brief Mandatory function used to write one single byte.
  * @param (VL53L5CX_Platform*) p_platform : Pointer of VL53L5CX platform
@@ -151,11 +150,6 @@ uint8_t WrByte(
 		uint16_t RegisterAdress,
 		uint8_t value);
 
-uint8_t WrByte2(
-		VL53L5CX_Platform *p_platform,
-		uint16_t RegisterAdress,
-		uint8_t value);
-
 /**
  * @brief Mandatory function used to read multiples bytes.
  * @param (VL53L5CX_Platform*) p_platform : Pointer of VL53L5CX platform
@@ -172,12 +166,6 @@ uint8_t RdMulti(
 		uint8_t *p_values,
 		uint32_t size);
 
-uint8_t RdMulti2(
-		VL53L5CX_Platform *p_platform,
-		uint16_t RegisterAdress,
-		uint8_t *p_values,
-		uint32_t size);
-
 /**
  * @brief Mandatory function used to write multiples bytes.
  * @param (VL53L5CX_Platform*) p_platform : Pointer of VL53L5CX platform
@@ -194,11 +182,47 @@ uint8_t WrMulti(
 		uint8_t *p_values,
 		uint32_t size);
 
-uint8_t WrMulti2(
+/**
+ * @brief Starts reading multiples bytes without waiting for them. The read
+ * is queued on the sensor bus and runs by DMA; the data is in *p_values once
+ * i2c_transfer_pending(p_transfer) returns 0.
+ * @param (VL53L5CX_Platform*) p_platform : Pointer of VL53L5CX platform
+ * structure.
+ * @param (uint16_t) Address : I2C location of values to read.
+ * @param (uint8_t) *p_values : Buffer of bytes to read.
+ * @param (uint16_t) size : Size of *p_values buffer.
+ * @param (i2c_transfer*) p_transfer : Transfer descriptor, valid until done.
+ * @return (uint8_t) status : 0 if the read was queued
+ */
+
+uint8_t RdMultiAsync(
 		VL53L5CX_Platform *p_platform,
 		uint16_t RegisterAdress,
 		uint8_t *p_values,
-		uint32_t size);
+		uint16_t size,
+		i2c_transfer *p_transfer);
+
+/**
+ * @brief Starts writing multiples bytes without waiting for them, like
+ * RdMultiAsync(). done is called from the completion interrupt and may queue
+ * the next transfer with p_transfer.
+ * @param (VL53L5CX_Platform*) p_platform : Pointer of VL53L5CX platform
+ * structure.
+ * @param (uint16_t) Address : I2C location of values to write.
+ * @param (uint8_t) *p_values : Buffer of bytes to write, valid until done.
+ * @param (uint16_t) size : Size of *p_values buffer.
+ * @param (i2c_transfer*) p_transfer : Transfer descriptor, valid until done.
+ * @param done : Completion callback, may be 0.
+ * @return (uint8_t) status : 0 if the write was queued
+ */
+
+uint8_t WrMultiAsync(
+		VL53L5CX_Platform *p_platform,
+		uint16_t RegisterAdress,
+		uint8_t *p_values,
+		uint16_t size,
+		i2c_transfer *p_transfer,
+		void (*done)(i2c_transfer *p_transfer));
 
 /**
  * @brief Optional function, only used to perform an hardware reset of the
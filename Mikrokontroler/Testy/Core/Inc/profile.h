@@ -0,0 +1,62 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include "stm32l4xx_hal.h"
+#include "integrator_profile.h"
+
+/*
+ * Cycle budget of the firmware, counted with the DWT cycle counter.
+ *
+ * profile_enter() and profile_leave() bracket the profiled code in thread
+ * mode. In interrupts they do nothing, so a handler counts to the stage it
+ * interrupts and the budget never has to be locked.
+ *
+ * profile_init() keeps the core clock running in Sleep mode (DBG_SLEEP):
+ * without it CYCCNT stops in __WFI() and the idle time and the I2C waits
+ * would be missing from the budget.
+ *
+ * profile_pipe_busy(), profile_pipe_idle() and profile_pipe_wait() count the
+ * occupancy of the pipeline stages (INTEGRATOR_PIPE_*). They work in
+ * interrupts too; a stage switched from both thread mode and an interrupt
+ * has to be switched with interrupts disabled.
+ */
+
+extern integrator_profile cpu_profile;
+
+void profile_init(void);
+
+static inline uint32_t profile_cycles(void)
+{
+	return DWT->CYCCNT;
+}
+
+/* Makes stage the current one; returns the stage to hand to profile_leave() */
+static inline uint8_t profile_enter(uint8_t stage)
+{
+	if(__get_IPSR() != 0) return INTEGRATOR_PROFILE_STAGES;
+	integrator_profile_count(&cpu_profile, stage);
+	return integrator_profile_switch(&cpu_profile, stage, DWT->CYCCNT);
+}
+
+static inline void profile_leave(uint8_t previous)
+{
+	if(previous < INTEGRATOR_PROFILE_STAGES) integrator_profile_switch(&cpu_profile, previous, DWT->CYCCNT);
+}
+
+static inline void profile_pipe_busy(uint8_t stage)
+{
+	integrator_pipe_busy(&cpu_profile, stage, DWT->CYCCNT);
+}
+
+static inline void profile_pipe_idle(uint8_t stage)
+{
+	integrator_pipe_idle(&cpu_profile, stage, DWT->CYCCNT);
+}
+
+static inline void profile_pipe_wait(uint8_t stage)
+{
+	integrator_pipe_wait(&cpu_profile, stage);
+}
+
+#endif /* PROFILE_H */
@@ -0,0 +1,30 @@
+#ifndef UART_RX_H
+#define UART_RX_H
+
+#include <stdint.h>
+#include "stm32l4xx_hal.h"
+
+/*
+ * Circular DMA receiver for the host link.
+ *
+ * DMA writes the received bytes into a ring without an interrupt per byte and
+ * the main loop takes them out with uart_rx_read(), so commands are never
+ * parsed in an interrupt. The idle line interrupt only ends the __WFI() of the
+ * main loop once the host stops sending.
+ *
+ * The ring must be read before the host sends UART_RX_BUFFER_SIZE more bytes;
+ * commands are a few bytes each, so only a stalled main loop loses any.
+ * After a reception error (overrun, noise, framing) the HAL stops the DMA;
+ * uart_rx_read() restarts it once the ring is drained.
+ */
+
+#define UART_RX_BUFFER_SIZE		256
+
+extern volatile uint32_t uart_rx_errors;
+
+void uart_rx_init(UART_HandleTypeDef *huart);
+uint16_t uart_rx_read(uint8_t *data, uint16_t size);
+void uart_rx_irq(UART_HandleTypeDef *huart);
+void uart_rx_error(UART_HandleTypeDef *huart);
+
+#endif /* UART_RX_H */
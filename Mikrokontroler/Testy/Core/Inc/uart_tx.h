@@ -0,0 +1,28 @@
+#ifndef UART_TX_H
+#define UART_TX_H
+
+#include <stdint.h>
+#include "stm32l4xx_hal.h"
+
+/*
+ * Double-buffered DMA transmitter for the host link.
+ *
+ * Data is copied into the buffer being filled while DMA sends the other one,
+ * so the caller continues (e.g. with the next sensor read) as soon as the copy
+ * is done. When the transfer ends, the filled buffer is started right away
+ * from HAL_UART_TxCpltCallback.
+ *
+ * uart_tx_write() may be called from interrupts; there it never waits and
+ * drops a write that does not fit (counted in uart_tx_dropped).
+ */
+
+#define UART_TX_BUFFER_SIZE		2048
+
+extern volatile uint32_t uart_tx_dropped;
+
+void uart_tx_init(UART_HandleTypeDef *huart);
+uint16_t uart_tx_write(const void *data, uint16_t len);
+void uart_tx_wait_idle(void);
+void uart_tx_complete(UART_HandleTypeDef *huart);
+
+#endif /* UART_TX_H */
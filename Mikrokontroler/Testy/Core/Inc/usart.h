@@ -41,7 +41,7 @@ extern UART_HandleTypeDef huart2;
 void MX_USART2_UART_Init(void);
 
 /* USER CODE BEGIN Prototypes */
-
+HAL_StatusTypeDef USART2_SetBaudRate(uint32_t baudRate);
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
@@ -72,6 +72,22 @@
 #define VL53L5CX_POWER_MODE_SLEEP		((uint8_t) 0U)
 #define VL53L5CX_POWER_MODE_WAKEUP		((uint8_t) 1U)
 
+/**
+ * @brief Optional output blocks, selected at runtime with
+ * vl53l5cx_set_outputs(). Blocks disabled in the 'platform.h' file can not be
+ * selected. Each block enlarges the I2C read of every frame.
+ */
+
+#define VL53L5CX_OUTPUT_AMBIENT_PER_SPAD	((uint32_t) 8U)
+#define VL53L5CX_OUTPUT_NB_SPADS_ENABLED	((uint32_t) 16U)
+#define VL53L5CX_OUTPUT_NB_TARGET_DETECTED	((uint32_t) 32U)
+#define VL53L5CX_OUTPUT_SIGNAL_PER_SPAD		((uint32_t) 64U)
+#define VL53L5CX_OUTPUT_RANGE_SIGMA_MM		((uint32_t) 128U)
+#define VL53L5CX_OUTPUT_DISTANCE_MM		((uint32_t) 256U)
+#define VL53L5CX_OUTPUT_REFLECTANCE_PERCENT	((uint32_t) 512U)
+#define VL53L5CX_OUTPUT_TARGET_STATUS		((uint32_t) 1024U)
+#define VL53L5CX_OUTPUT_MOTION_INDICATOR	((uint32_t) 2048U)
+
 /**
  * @brief Macro VL53L5CX_STATUS_OK indicates that VL53L5 sensor has no error.
  * Macro VL53L5CX_STATUS_ERROR indicates that something is wrong (value,
@@ -258,6 +274,31 @@
 #endif
 
 
+/**
+ * @brief Structure VL53L5CX_Upload holds the firmware download started by
+ * vl53l5cx_init_start(). The firmware is queued in chunks of
+ * VL53L5CX_UPLOAD_CHUNK_SIZE bytes, each one from the completion of the
+ * previous one, so the other devices of the bus are served in between.
+ */
+
+#define VL53L5CX_FIRMWARE_SIZE			((uint32_t) 0x15000U)
+#define VL53L5CX_FIRMWARE_PAGE_SIZE		((uint32_t) 0x8000U)
+#define VL53L5CX_UPLOAD_CHUNK_SIZE		((uint32_t) 0x1000U)
+#define VL53L5CX_UPLOAD_TIMEOUT_MS		((uint32_t) 500U)
+
+typedef struct
+{
+	/* First member, the completion callback casts it back */
+	i2c_transfer		transfer;
+	VL53L5CX_Platform	*p_platform;
+	/* Next firmware byte to send */
+	uint32_t		offset;
+	/* Page selected by the last page write, also its DMA source */
+	uint8_t			page;
+	volatile uint8_t	busy;
+	volatile uint8_t	status;
+} VL53L5CX_Upload;
+
 /**
  * @brief Structure VL53L5CX_Configuration contains the sensor configuration.
  * User MUST not manually change these field, except for the sensor address.
@@ -283,6 +324,10 @@ typedef struct
 	 uint8_t	        temp_buffer[VL53L5CX_TEMPORARY_BUFFER_SIZE];
 	/* Auto-stop flag for stopping the sensor */
 	uint8_t				is_auto_stop_enabled;
+	/* VL53L5CX_OUTPUT_* blocks of the next ranging session */
+	uint32_t			outputs;
+	/* Firmware download of vl53l5cx_init_start() */
+	VL53L5CX_Upload			upload;
 } VL53L5CX_Configuration;
 
 
@@ -377,10 +422,6 @@ uint8_t vl53l5cx_is_alive(
 		VL53L5CX_Configuration		*p_dev,
 		uint8_t				*p_is_alive);
 
-uint8_t vl53l5cx_is_alive2(
-		VL53L5CX_Configuration		*p_dev,
-		uint8_t				*p_is_alive);
-
 /**
  * @brief Mandatory function used to initialize the sensor. This function must
  * be called after a power on, to load the firmware into the VL53L5CX. It takes
@@ -392,7 +433,26 @@ uint8_t vl53l5cx_is_alive2(
 uint8_t vl53l5cx_init(
 		VL53L5CX_Configuration		*p_dev);
 
-uint8_t vl53l5cx_init2(
+/**
+ * @brief First half of vl53l5cx_init(): boots the sensor and starts the
+ * firmware download by DMA, then returns. Sensors on other buses can be
+ * started meanwhile, so their downloads run at the same time.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @return (uint8_t) status : 0 if the download was started.
+ */
+
+uint8_t vl53l5cx_init_start(
+		VL53L5CX_Configuration		*p_dev);
+
+/**
+ * @brief Second half of vl53l5cx_init(): waits for the firmware download
+ * started by vl53l5cx_init_start(), then loads the calibration and the
+ * default configuration.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @return (uint8_t) status : 0 if initialization is OK.
+ */
+
+uint8_t vl53l5cx_init_finish(
 		VL53L5CX_Configuration		*p_dev);
 
 
@@ -440,6 +500,34 @@ uint8_t vl53l5cx_set_power_mode(
 		VL53L5CX_Configuration		*p_dev,
 		uint8_t				power_mode);
 
+/**
+ * @brief This function selects the optional output blocks (VL53L5CX_OUTPUT_*)
+ * read with every frame; fields of the results structure whose block is not
+ * selected are left unchanged. After vl53l5cx_init() all blocks enabled in the
+ * 'platform.h' file are selected. The selection is used by the next
+ * vl53l5cx_start_ranging(), so a streaming sensor must be stopped and started
+ * again.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (uint32_t) outputs : VL53L5CX_OUTPUT_* flags.
+ * @return (uint8_t) status : 0 if all blocks are available, or 127 if a block
+ * is disabled in the 'platform.h' file; the available ones are still selected.
+ */
+
+uint8_t vl53l5cx_set_outputs(
+		VL53L5CX_Configuration		*p_dev,
+		uint32_t			outputs);
+
+/**
+ * @brief This function gets the selected output blocks.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (uint32_t) *p_outputs : VL53L5CX_OUTPUT_* flags.
+ * @return (uint8_t) status : 0 if OK.
+ */
+
+uint8_t vl53l5cx_get_outputs(
+		VL53L5CX_Configuration		*p_dev,
+		uint32_t			*p_outputs);
+
 /**
  * @brief This function starts a ranging session. When the sensor streams, host
  * cannot change settings 'on-the-fly'.
@@ -450,9 +538,6 @@ uint8_t vl53l5cx_set_power_mode(
 uint8_t vl53l5cx_start_ranging(
 		VL53L5CX_Configuration		*p_dev);
 
-uint8_t vl53l5cx_start_ranging2(
-		VL53L5CX_Configuration		*p_dev);
-
 /**
  * @brief This function stops the ranging session. It must be used when the
  * sensor streams, after calling vl53l5cx_start_ranging().
@@ -463,9 +548,6 @@ uint8_t vl53l5cx_start_ranging2(
 uint8_t vl53l5cx_stop_ranging(
 		VL53L5CX_Configuration		*p_dev);
 
-uint8_t vl53l5cx_stop_ranging2(
-		VL53L5CX_Configuration		*p_dev);
-
 /**
  * @brief This function checks if a new data is ready by polling I2C. If a new
  * data is ready, a flag will be raised.
@@ -479,10 +561,6 @@ uint8_t vl53l5cx_check_data_ready(
 		VL53L5CX_Configuration		*p_dev,
 		uint8_t				*p_isReady);
 
-uint8_t vl53l5cx_check_data_ready2(
-		VL53L5CX_Configuration		*p_dev,
-		uint8_t				*p_isReady);
-
 /**
  * @brief This function gets the ranging data, using the selected output and the
  * resolution.
@@ -495,7 +573,29 @@ uint8_t vl53l5cx_get_ranging_data(
 		VL53L5CX_Configuration		*p_dev,
 		VL53L5CX_ResultsData		*p_results);
 
-uint8_t vl53l5cx_get_ranging_data2(
+/**
+ * @brief This function starts reading the ranging data into p_dev->temp_buffer
+ * and returns without waiting. The read runs by DMA; once
+ * i2c_transfer_pending(p_transfer) returns 0, the data is converted with
+ * vl53l5cx_decode_ranging_data(). p_dev must not be used meanwhile.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (i2c_transfer) *p_transfer : Transfer descriptor, valid until done.
+ * @return (uint8_t) status : 0 if the read was started.
+ */
+
+uint8_t vl53l5cx_start_ranging_data_read(
+		VL53L5CX_Configuration		*p_dev,
+		i2c_transfer			*p_transfer);
+
+/**
+ * @brief This function converts the ranging data read into p_dev->temp_buffer,
+ * using the selected output and the resolution.
+ * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
+ * @param (VL53L5CX_ResultsData) *p_results : VL53L5 results structure.
+ * @return (uint8_t) status : 0 data are successfully converted.
+ */
+
+uint8_t vl53l5cx_decode_ranging_data(
 		VL53L5CX_Configuration		*p_dev,
 		VL53L5CX_ResultsData		*p_results);
 
@@ -511,10 +611,6 @@ uint8_t vl53l5cx_get_resolution(
 		VL53L5CX_Configuration		*p_dev,
 		uint8_t				*p_resolution);
 
-uint8_t vl53l5cx_get_resolution2(
-		VL53L5CX_Configuration		*p_dev,
-		uint8_t				*p_resolution);
-
 
 /**
  * @brief This function sets a new resolution (4x4 or 8x8).
@@ -556,10 +652,6 @@ uint8_t vl53l5cx_set_ranging_frequency_hz(
 		VL53L5CX_Configuration		*p_dev,
 		uint8_t				frequency_hz);
 
-uint8_t vl53l5cx_set_ranging_frequency_hz2(
-		VL53L5CX_Configuration		*p_dev,
-		uint8_t				frequency_hz);
-
 /**
  * @brief This function gets the current integration time in ms.
  * @param (VL53L5CX_Configuration) *p_dev : VL53L5CX configuration structure.
@@ -664,10 +756,6 @@ uint8_t vl53l5cx_set_ranging_mode(
 		VL53L5CX_Configuration		*p_dev,
 		uint8_t				ranging_mode);
 
-
-uint8_t vl53l5cx_set_ranging_mode2(
-		VL53L5CX_Configuration		*p_dev,
-		uint8_t				ranging_mode);
 /**
  * @brief This function is used to disable the VCSEL charge pump
  * This optimizes the power consumption of the device
@@ -706,12 +794,6 @@ uint8_t vl53l5cx_dci_read_data(
 		uint32_t			index,
 		uint16_t			data_size);
 
-uint8_t vl53l5cx_dci_read_data2(
-		VL53L5CX_Configuration		*p_dev,
-		uint8_t				*data,
-		uint32_t			index,
-		uint16_t			data_size);
-
 /**
  * @brief This function can be used to write 'extra data' to DCI. The data can
  * be simple data, or casted structure.
@@ -731,12 +813,6 @@ uint8_t vl53l5cx_dci_write_data(
 		uint32_t			index,
 		uint16_t			data_size);
 
-
-uint8_t vl53l5cx_dci_write_data2(
-		VL53L5CX_Configuration		*p_dev,
-		uint8_t				*data,
-		uint32_t			index,
-		uint16_t			data_size);
 /**
  * @brief This function can be used to replace 'extra data' in DCI. The data can
  * be simple data, or casted structure.
@@ -762,13 +838,4 @@ uint8_t vl53l5cx_dci_replace_data(
 		uint16_t			new_data_size,
 		uint16_t			new_data_pos);
 
-uint8_t vl53l5cx_dci_replace_data2(
-		VL53L5CX_Configuration		*p_dev,
-		uint8_t				*data,
-		uint32_t			index,
-		uint16_t			data_size,
-		uint8_t				*new_data,
-		uint16_t			new_data_size,
-		uint16_t			new_data_pos);
-
 #endif //VL53L5CX_API_H_
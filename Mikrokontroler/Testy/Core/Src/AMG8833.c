@@ -1,5 +1,6 @@
 #include "AMG8833.h"
 #include "stm32l4xx_hal.h"
+#include "i2c_bus.h"
 
 struct pctl _pctl;
 struct rst _rst;
@@ -58,7 +59,7 @@ int amg88xxInit(void)
 	disableInterrupt();
 
 	//set to 10 FPS
-	_fpsc.FPS = AMG88xx_FPS_1;
+	_fpsc.FPS = AMG88xx_FPS_10;
 	write8(AMG88xx_FPSC, getFPSC());
 
 	HAL_Delay(100);
@@ -78,6 +79,18 @@ void setMovingAverageMode(int mode)
 	write8(AMG88xx_AVE, getAVE());
 }
 
+/**************************************************************************/
+/*!
+    @brief  Set the frame rate.
+    @param  fps AMG88xx_FPS_10 or AMG88xx_FPS_1
+*/
+/**************************************************************************/
+void setFPS(uint8_t fps)
+{
+	_fpsc.FPS = fps;
+	write8(AMG88xx_FPSC, getFPSC());
+}
+
 /**************************************************************************/
 /*!
     @brief  Set the interrupt levels. The hysteresis value defaults to .95 * high
@@ -217,7 +230,7 @@ void readPixels(float *buf, uint8_t size)
 		uint8_t pos = i << 1;
 		recast = ((uint16_t)rawArray[pos + 1] << 8) | ((uint16_t)rawArray[pos]);
 
-		converted = signedMag12ToFloat(recast) * AMG88xx_PIXEL_TEMP_CONVERSION;
+		converted = int12ToFloat(recast) * AMG88xx_PIXEL_TEMP_CONVERSION;
 		buf[i] = converted;
 	}
 }
@@ -228,6 +241,26 @@ void readPixelsRaw(int16_t* buf)
 	read(AMG88xx_PIXEL_OFFSET, (uint8_t*)buf, 128);
 }
 
+/**************************************************************************/
+/*!
+    @brief  Queue the read of readPixelsRaw() and return at once
+    @param  buf the array to place the pixel registers in, valid until the read ends
+    @param  transfer the transfer to run it on, finished when i2c_transfer_pending() turns 0
+    @returns HAL_OK if the read was queued
+*/
+/**************************************************************************/
+HAL_StatusTypeDef startPixelsRawRead(int16_t* buf, i2c_transfer *transfer)
+{
+	transfer->address = AMG88xx_ADDRESS<<1;
+	transfer->reg = AMG88xx_PIXEL_OFFSET;
+	transfer->reg_size = I2C_MEMADD_SIZE_8BIT;
+	transfer->data = (uint8_t*)buf;
+	transfer->size = 128;
+	transfer->write = 0;
+	transfer->done = 0;
+	return i2c_bus_submit(&hi2c1, transfer);
+}
+
 /**************************************************************************/
 /*!
     @brief  write one byte of data to the specified register
@@ -260,7 +293,7 @@ void read(uint8_t reg, uint8_t *buf, uint8_t num)
 {
 	HAL_StatusTypeDef err;
 
-	err = HAL_I2C_Mem_Read(&hi2c1, (AMG88xx_ADDRESS<<1), reg, 1, buf, num, 0xffff);
+	err = i2c_bus_transfer(&hi2c1, (AMG88xx_ADDRESS<<1), reg, I2C_MEMADD_SIZE_8BIT, buf, num, 0);
 	if(err != HAL_OK)
 		while(1);
 }
@@ -269,7 +302,7 @@ void write(uint8_t reg, uint8_t *buf, uint8_t num)
 {
 	HAL_StatusTypeDef err;
 
-	err = HAL_I2C_Mem_Write(&hi2c1, (AMG88xx_ADDRESS<<1), reg, 1, buf, num, 0xffff);
+	err = i2c_bus_transfer(&hi2c1, (AMG88xx_ADDRESS<<1), reg, I2C_MEMADD_SIZE_8BIT, buf, num, 1);
 	if(err != HAL_OK)
 		while(1);
 }
@@ -288,3 +321,18 @@ float signedMag12ToFloat(uint16_t val)
 
 	return (val & 0x8000) ? 0 - (float)absVal : (float)absVal ;
 }
+
+/**************************************************************************/
+/*!
+    @brief  convert a 12-bit two's complement value (the pixel registers) to a floating point number
+    @param  val the 12-bit two's complement value to be converted
+    @returns the converted floating point value
+*/
+/**************************************************************************/
+float int12ToFloat(uint16_t val)
+{
+	//move the sign bit of the 12-bit value to the sign bit of an int16_t and back
+	int16_t sVal = (int16_t)(val << 4);
+
+	return (float)(sVal >> 4);
+}
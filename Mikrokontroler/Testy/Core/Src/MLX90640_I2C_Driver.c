@@ -1,10 +1,11 @@
 #include "MLX90640_I2C_Driver.h"
+#include "i2c_bus.h"
 
-I2C_HandleTypeDef hi2c_mlx;
+I2C_HandleTypeDef *hi2c_mlx;
 
 //------------------------------------------------------------------------------
 
-void Init_MLX90640_GPIO(I2C_HandleTypeDef i2c_handle)
+void Init_MLX90640_GPIO(I2C_HandleTypeDef *i2c_handle)
 {
 	hi2c_mlx=i2c_handle;
 }
@@ -15,7 +16,7 @@ void MLX90640_I2CRead(uint16_t startAddress, uint16_t nWordsRead, uint16_t *data
 	uint16_t j,i;
 	uint8_t* buf = (uint8_t*) data;
 
-	HAL_I2C_Mem_Read(&hi2c_mlx, MLX90640_ADDR, startAddress, I2C_MEMADD_SIZE_16BIT, buf, nWordsRead<<1, MLX90640_TIMEOUT);
+	i2c_bus_transfer(hi2c_mlx, MLX90640_ADDR, startAddress, I2C_MEMADD_SIZE_16BIT, buf, nWordsRead<<1, 0);
 
 	for(j=0; j<nWordsRead; j++)
 	{
@@ -30,7 +31,7 @@ void MLX90640_I2CWrite(uint16_t writeAddress, uint16_t data)
 {
 	uint8_t tx_buff[2] = {data>>8, data & 0x00FF};
 
-    HAL_I2C_Mem_Write(&hi2c_mlx, MLX90640_ADDR, writeAddress, I2C_MEMADD_SIZE_16BIT, tx_buff, 2, MLX90640_TIMEOUT);
+    i2c_bus_transfer(hi2c_mlx, MLX90640_ADDR, writeAddress, I2C_MEMADD_SIZE_16BIT, tx_buff, 2, 1);
 }
 //------------------------------------------------------------------------------
 
@@ -165,6 +166,106 @@ uint16_t MLX90640_GetSubPageNumber(uint16_t *frameData)
 }
 //------------------------------------------------------------------------------
 
+// Single status read; MLX90640_GetFrameData() does not block once this returns 1
+uint8_t MLX90640_IsFrameReady(void)
+{
+    uint16_t statusRegister;
+
+    MLX90640_I2CRead(MLX90640_STAT_REG, 1, &statusRegister);
+    return (statusRegister & 0x0008) != 0;
+}
+//------------------------------------------------------------------------------
+// Non-blocking MLX90640_GetFrameData() for the scheduler, in three steps on
+// the i2c_bus queue. MLX90640_StartStatusRead() queues the status read; once
+// MLX90640_StatusFrameReady() sees a new subpage, MLX90640_StartFrameRead()
+// queues the status clear, the RAM read into frameData, a second status read
+// and the control register read into frameData[832], the last one on
+// transfer, which the bus finishes after the others.
+// MLX90640_FinishFrameRead() then turns the bytes into the words of
+// MLX90640_GetFrameData() and returns the subpage, or -1 if a transfer
+// failed. Like the Melexis driver it checks the second status read: if a new
+// subpage came in during the RAM read, frameData may mix both, and it returns
+// MLX90640_FRAME_RETRY for MLX90640_RetryFrameRead() to read the new one, at
+// most MLX90640_FRAME_ATTEMPTS times (then -8). read and frameData must stay
+// valid until then.
+
+static void MLX90640_SetTransfer(i2c_transfer *transfer, uint16_t reg, uint8_t *data, uint16_t size, uint8_t write)
+{
+    transfer->address = MLX90640_ADDR;
+    transfer->reg = reg;
+    transfer->reg_size = I2C_MEMADD_SIZE_16BIT;
+    transfer->data = data;
+    transfer->size = size;
+    transfer->write = write;
+    transfer->done = 0;
+}
+
+HAL_StatusTypeDef MLX90640_StartStatusRead(MLX90640_FrameRead *read, i2c_transfer *transfer)
+{
+    MLX90640_SetTransfer(transfer, MLX90640_STAT_REG, read->status, 2, 0);
+    return i2c_bus_submit(hi2c_mlx, transfer);
+}
+
+uint8_t MLX90640_StatusFrameReady(const MLX90640_FrameRead *read)
+{
+    return (read->status[1] & 0x08) != 0;
+}
+
+static HAL_StatusTypeDef MLX90640_QueueFrameRead(MLX90640_FrameRead *read, i2c_transfer *transfer, uint16_t *frameData)
+{
+    read->clearValue[0] = 0x00;
+    read->clearValue[1] = 0x30;
+    MLX90640_SetTransfer(&read->clear, MLX90640_STAT_REG, read->clearValue, 2, 1);
+    MLX90640_SetTransfer(&read->ram, MLX90640_RAM, (uint8_t*)frameData, 832<<1, 0);
+    MLX90640_SetTransfer(&read->recheck, MLX90640_STAT_REG, read->recheckStatus, 2, 0);
+    MLX90640_SetTransfer(transfer, MLX90640_CTRL_REG1, (uint8_t*)&frameData[832], 2, 0);
+
+    if(i2c_bus_submit(hi2c_mlx, &read->clear) != HAL_OK) return HAL_ERROR;
+    if(i2c_bus_submit(hi2c_mlx, &read->ram) != HAL_OK) return HAL_ERROR;
+    if(i2c_bus_submit(hi2c_mlx, &read->recheck) != HAL_OK) return HAL_ERROR;
+    return i2c_bus_submit(hi2c_mlx, transfer);
+}
+
+HAL_StatusTypeDef MLX90640_StartFrameRead(MLX90640_FrameRead *read, i2c_transfer *transfer, uint16_t *frameData)
+{
+    read->attempts = 1;
+    return MLX90640_QueueFrameRead(read, transfer, frameData);
+}
+
+HAL_StatusTypeDef MLX90640_RetryFrameRead(MLX90640_FrameRead *read, i2c_transfer *transfer, uint16_t *frameData)
+{
+    read->attempts++;
+    return MLX90640_QueueFrameRead(read, transfer, frameData);
+}
+
+int MLX90640_FinishFrameRead(MLX90640_FrameRead *read, uint16_t *frameData)
+{
+    uint8_t* buf = (uint8_t*) frameData;
+    uint16_t j,i;
+
+    if(read->clear.state != I2C_TRANSFER_DONE || read->ram.state != I2C_TRANSFER_DONE
+            || read->recheck.state != I2C_TRANSFER_DONE) return -1;
+
+    // A new subpage during the RAM read: read again, the status now names the new one
+    if((read->recheckStatus[1] & 0x08) || (read->recheckStatus[1] & 0x01) != (read->status[1] & 0x01))
+    {
+        read->status[0] = read->recheckStatus[0];
+        read->status[1] = read->recheckStatus[1];
+        return read->attempts < MLX90640_FRAME_ATTEMPTS ? MLX90640_FRAME_RETRY : -8;
+    }
+
+    // Word j is built from its own two bytes, so the swap works in place
+    for(j=0; j<833; j++)
+    {
+        i = j << 1;
+        frameData[j] = ((uint16_t)buf[i]<<8)|((uint16_t)buf[i+1]);
+    }
+    frameData[833] = read->status[1] & 0x01;
+
+    return frameData[833];
+}
+//------------------------------------------------------------------------------
+
 void MLX90640_SynchFrame(void)
 {
     uint16_t dataReady = 0;
@@ -0,0 +1,162 @@
+#include <math.h>
+
+#include "MLX90640_Solver.h"
+
+#define KELVIN  273.15f
+
+static inline float Root4(float x)
+{
+    return sqrtf(sqrtf(x));
+}
+
+static inline float Pow4(float x)
+{
+    float x2 = x * x;
+    return x2 * x2;
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_PrepareSolver(const paramsMLX90640 *params, mlx90640Solver *solver)
+{
+    solver->params = params;
+
+    for(int pixelNumber = 0; pixelNumber < MLX90640_PIXEL_NUM; pixelNumber++)
+    {
+        int8_t ilPattern = pixelNumber / 32 - (pixelNumber / 64) * 2;
+        int8_t chessPattern = ilPattern ^ (pixelNumber - (pixelNumber/2)*2);
+        int8_t conversionPattern = ((pixelNumber + 2) / 4 - (pixelNumber + 3) / 4 + (pixelNumber + 1) / 4 - pixelNumber / 4) * (1 - 2 * ilPattern);
+
+        solver->pattern[pixelNumber] = (ilPattern ? MLX90640_PATTERN_IL : 0) | (chessPattern ? MLX90640_PATTERN_CHESS : 0);
+        solver->ilChess[pixelNumber] = params->ilChessC[2] * (2 * ilPattern - 1) - params->ilChessC[1] * conversionPattern;
+        for(int subPage = 0; subPage < 2; subPage++)
+        {
+            solver->alpha[subPage][pixelNumber] = params->alpha[pixelNumber] - params->tgc * params->cpAlpha[subPage];
+        }
+    }
+
+    solver->alphaCorrR[0] = 1.0f / (1.0f + params->ksTo[0] * 40);
+    solver->alphaCorrR[1] = 1.0f;
+    solver->alphaCorrR[2] = (1.0f + params->ksTo[2] * params->ct[2]);
+    solver->alphaCorrR[3] = solver->alphaCorrR[2] * (1.0f + params->ksTo[3] * (params->ct[3] - params->ct[2]));
+    solver->ksToScale = 1.0f - params->ksTo[1] * KELVIN;
+    for(int range = 0; range < 4; range++)
+    {
+        solver->ct[range] = params->ct[range];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+float MLX90640_SolverGetVdd(const uint16_t *frameData, const mlx90640Solver *solver)
+{
+    const paramsMLX90640 *params = solver->params;
+    int resolutionRAM = (frameData[832] & 0x0C00) >> 10;
+    float resolutionCorrection = (float)(1 << params->resolutionEE) / (float)(1 << resolutionRAM);
+
+    return (resolutionCorrection * (int16_t)frameData[810] - params->vdd25) / params->kVdd + 3.3f;
+}
+
+//------------------------------------------------------------------------------
+
+static float SolverGetTa(const uint16_t *frameData, const mlx90640Solver *solver, float vdd)
+{
+    const paramsMLX90640 *params = solver->params;
+    float ptat = (int16_t)frameData[800];
+    float ptatArt = (int16_t)frameData[768];
+
+    ptatArt = (ptat / (ptat * params->alphaPTAT + ptatArt)) * 262144.0f;
+
+    return (ptatArt / (1.0f + params->KvPTAT * (vdd - 3.3f)) - params->vPTAT25) / params->KtPTAT + 25.0f;
+}
+
+float MLX90640_SolverGetTa(const uint16_t *frameData, const mlx90640Solver *solver)
+{
+    return SolverGetTa(frameData, solver, MLX90640_SolverGetVdd(frameData, solver));
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_SolveTo(const uint16_t *frameData, const mlx90640Solver *solver, float emissivity, float tr, float *result)
+{
+    const paramsMLX90640 *params = solver->params;
+    const uint16_t subPage = frameData[833];
+    const uint8_t mode = (frameData[832] & 0x1000) >> 5;
+    const uint8_t patternMask = (mode == 0) ? MLX90640_PATTERN_IL : MLX90640_PATTERN_CHESS;
+    const uint8_t patternMatch = subPage ? patternMask : 0;
+    const uint8_t ilChess = (mode != params->calibrationModeEE);
+    const float *alpha = solver->alpha[subPage & 1];
+
+    const float vdd = MLX90640_SolverGetVdd(frameData, solver);
+    const float ta = SolverGetTa(frameData, solver, vdd);
+    const float dTa = ta - 25.0f;
+    const float dVdd = vdd - 3.3f;
+    const float tr4 = Pow4(tr + KELVIN);
+    const float taTr = tr4 - (tr4 - Pow4(ta + KELVIN)) / emissivity;
+    const float invEmissivity = 1.0f / emissivity;
+    const float ksTaScale = 1.0f + params->KsTa * dTa;
+    const float ksTo1 = params->ksTo[1];
+
+//------------------------- Gain calculation -----------------------------------
+    const float gain = params->gainEE / (float)(int16_t)frameData[778];
+
+//------------------------- Compensation pixel ---------------------------------
+    const float cpScale = (1.0f + params->cpKta * dTa) * (1.0f + params->cpKv * dVdd);
+    float irDataCP;
+    if(subPage == 0)
+    {
+        irDataCP = (int16_t)frameData[776] * gain - params->cpOffset[0] * cpScale;
+    }
+    else if(!ilChess)
+    {
+        irDataCP = (int16_t)frameData[808] * gain - params->cpOffset[1] * cpScale;
+    }
+    else
+    {
+        irDataCP = (int16_t)frameData[808] * gain - (params->cpOffset[1] + params->ilChessC[0]) * cpScale;
+    }
+    const float tgcCP = params->tgc * irDataCP;
+
+//------------------------- To calculation -------------------------------------
+    for(int pixelNumber = 0; pixelNumber < MLX90640_PIXEL_NUM; pixelNumber++)
+    {
+        if((solver->pattern[pixelNumber] & patternMask) != patternMatch)
+        {
+            continue;
+        }
+
+        float irData = (int16_t)frameData[pixelNumber] * gain;
+        irData -= params->offset[pixelNumber] * (1.0f + params->kta[pixelNumber] * dTa) * (1.0f + params->kv[pixelNumber] * dVdd);
+        if(ilChess)
+        {
+            irData += solver->ilChess[pixelNumber];
+        }
+        irData = irData * invEmissivity - tgcCP;
+
+        const float alphaCompensated = alpha[pixelNumber] * ksTaScale;
+        const float alpha3 = alphaCompensated * alphaCompensated * alphaCompensated;
+
+        float Sx = ksTo1 * Root4(alpha3 * (irData + alphaCompensated * taTr));
+        float To = Root4(irData / (alphaCompensated * solver->ksToScale + Sx) + taTr) - KELVIN;
+
+        int range;
+        if(To < solver->ct[1])
+        {
+            range = 0;
+        }
+        else if(To < solver->ct[2])
+        {
+            range = 1;
+        }
+        else if(To < solver->ct[3])
+        {
+            range = 2;
+        }
+        else
+        {
+            range = 3;
+        }
+
+        result[pixelNumber] = Root4(irData / (alphaCompensated * solver->alphaCorrR[range] * (1.0f + params->ksTo[range] * (To - solver->ct[range]))) + taTr) - KELVIN;
+    }
+}
@@ -0,0 +1,187 @@
+#include "i2c_bus.h"
+#include "profile.h"
+
+typedef struct
+{
+	I2C_HandleTypeDef *hi2c;
+	i2c_transfer *head;		/* Running transfer */
+	i2c_transfer *tail;
+} i2c_bus;
+
+static i2c_bus buses[I2C_BUS_COUNT];
+
+/* Pipeline stage of a bus in the cycle budget, buses in the order of i2c_bus_init() */
+static uint8_t i2c_bus_pipe(const i2c_bus *bus)
+{
+	return (uint8_t)(INTEGRATOR_PIPE_I2C1 + (bus - buses));
+}
+
+static i2c_bus *i2c_bus_find(I2C_HandleTypeDef *hi2c)
+{
+	for(int b = 0; b < I2C_BUS_COUNT; b++)
+	{
+		if(buses[b].hi2c == hi2c) return &buses[b];
+	}
+	return 0;
+}
+
+/* Takes the head transfer off the queue. Interrupts must be disabled. */
+static void i2c_bus_finish(i2c_bus *bus, i2c_transfer_state state)
+{
+	i2c_transfer *transfer = bus->head;
+	void (*done)(i2c_transfer *) = transfer->done;
+
+	if(transfer->state == I2C_TRANSFER_BUSY) profile_pipe_idle(i2c_bus_pipe(bus));
+	bus->head = transfer->next;
+	if(!bus->head) bus->tail = 0;
+	transfer->next = 0;
+	transfer->state = state;
+	if(done) done(transfer);
+}
+
+/* Starts the head transfer if the bus is free. Interrupts must be disabled. */
+static void i2c_bus_start(i2c_bus *bus)
+{
+	while(bus->head && bus->head->state == I2C_TRANSFER_QUEUED)
+	{
+		i2c_transfer *transfer = bus->head;
+		HAL_StatusTypeDef result;
+
+		transfer->state = I2C_TRANSFER_BUSY;
+		if(transfer->write)
+		{
+			result = HAL_I2C_Mem_Write_DMA(bus->hi2c, transfer->address, transfer->reg,
+					transfer->reg_size, transfer->data, transfer->size);
+		}
+		else
+		{
+			result = HAL_I2C_Mem_Read_DMA(bus->hi2c, transfer->address, transfer->reg,
+					transfer->reg_size, transfer->data, transfer->size);
+		}
+		if(result == HAL_OK)
+		{
+			profile_pipe_busy(i2c_bus_pipe(bus));
+			return;
+		}
+
+		/* Not started (NACK on the address, bus error): fail it and try the next one */
+		i2c_bus_finish(bus, I2C_TRANSFER_ERROR);
+	}
+}
+
+void i2c_bus_init(I2C_HandleTypeDef *hi2c)
+{
+	for(int b = 0; b < I2C_BUS_COUNT; b++)
+	{
+		if(buses[b].hi2c == 0 || buses[b].hi2c == hi2c)
+		{
+			buses[b].hi2c = hi2c;
+			buses[b].head = 0;
+			buses[b].tail = 0;
+			return;
+		}
+	}
+}
+
+/*
+ * Queues a transfer; address, reg, reg_size, data, size, write and done must
+ * be set. The transfer and its data must stay valid until it is finished.
+ */
+HAL_StatusTypeDef i2c_bus_submit(I2C_HandleTypeDef *hi2c, i2c_transfer *transfer)
+{
+	i2c_bus *bus = i2c_bus_find(hi2c);
+
+	if(!bus || i2c_transfer_pending(transfer)) return HAL_ERROR;
+
+	transfer->hi2c = hi2c;
+	transfer->next = 0;
+	transfer->state = I2C_TRANSFER_QUEUED;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if(bus->tail)
+	{
+		bus->tail->next = transfer;
+		profile_pipe_wait(i2c_bus_pipe(bus));
+	}
+	else bus->head = transfer;
+	bus->tail = transfer;
+	i2c_bus_start(bus);
+	__set_PRIMASK(primask);
+
+	return HAL_OK;
+}
+
+/*
+ * Sleeps until the transfer is finished. After timeout_ms a transfer still in
+ * the queue is dropped; a running one is stopped by resetting the peripheral.
+ */
+HAL_StatusTypeDef i2c_bus_wait(i2c_transfer *transfer, uint32_t timeout_ms)
+{
+	uint32_t start = HAL_GetTick();
+	uint8_t stage = profile_enter(INTEGRATOR_STAGE_I2C);
+
+	while(i2c_transfer_pending(transfer))
+	{
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		if(HAL_GetTick() - start > timeout_ms && i2c_transfer_pending(transfer))
+		{
+			i2c_bus *bus = i2c_bus_find(transfer->hi2c);
+			if(bus->head == transfer)
+			{
+				HAL_I2C_DeInit(bus->hi2c);
+				HAL_I2C_Init(bus->hi2c);
+				i2c_bus_finish(bus, I2C_TRANSFER_ERROR);
+				i2c_bus_start(bus);
+			}
+			else
+			{
+				i2c_transfer *prev = bus->head;
+				while(prev->next != transfer) prev = prev->next;
+				prev->next = transfer->next;
+				if(bus->tail == transfer) bus->tail = prev;
+				transfer->next = 0;
+				transfer->state = I2C_TRANSFER_ERROR;
+			}
+		}
+		/* With interrupts masked, an interrupt that is already pending still ends __WFI */
+		else if(i2c_transfer_pending(transfer))
+		{
+			__WFI();
+		}
+		__set_PRIMASK(primask);
+	}
+	profile_leave(stage);
+	return (transfer->state == I2C_TRANSFER_DONE) ? HAL_OK : HAL_ERROR;
+}
+
+/* Blocking register access through the queue */
+HAL_StatusTypeDef i2c_bus_transfer(I2C_HandleTypeDef *hi2c, uint16_t address, uint16_t reg,
+		uint16_t reg_size, uint8_t *data, uint16_t size, uint8_t write)
+{
+	i2c_transfer transfer = {
+		.address = address,
+		.reg = reg,
+		.reg_size = reg_size,
+		.data = data,
+		.size = size,
+		.write = write,
+		.state = I2C_TRANSFER_IDLE,
+		.done = 0,
+	};
+
+	if(i2c_bus_submit(hi2c, &transfer) != HAL_OK) return HAL_ERROR;
+	return i2c_bus_wait(&transfer, I2C_BUS_TIMEOUT_MS + size / I2C_BUS_BYTES_PER_MS);
+}
+
+/* Called from the HAL I2C completion and error callbacks */
+void i2c_bus_complete(I2C_HandleTypeDef *hi2c, uint8_t failed)
+{
+	i2c_bus *bus = i2c_bus_find(hi2c);
+
+	if(!bus || !bus->head || bus->head->state != I2C_TRANSFER_BUSY) return;
+
+	i2c_bus_finish(bus, failed ? I2C_TRANSFER_ERROR : I2C_TRANSFER_DONE);
+	i2c_bus_start(bus);
+}
@@ -21,21 +21,78 @@
 #include "dma.h"
 #include "i2c.h"
 #include "usart.h"
+#include "tim.h"
 #include "gpio.h"
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "stdio.h"
+#include "stdarg.h"
 #include "MLX90640_API.h"
 #include "MLX90640_I2C_Driver.h"
+#include "MLX90640_Solver.h"
 #include "vl53l5cx_api.h"
 #include "AMG8833.h"
+#include "integrator_protocol.h"
+#include "integrator_crc16.h"
+#include "integrator_codec.h"
+#include "integrator_series.h"
+#include "integrator_tof.h"
+#include "integrator_profile.h"
+#include "integrator_command.h"
+#include "uart_tx.h"
+#include "uart_rx.h"
+#include "i2c_bus.h"
+#include "profile.h"
 #include "stm32l4xx_hal.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
-
+/*
+ * One sensor in the scheduler. A task runs when its data-ready interrupt
+ * fired, or when poll_us passed since its last run (polled sensors, and a
+ * fallback for interrupt lines that are not wired).
+ * A task that starts a DMA read in run() leaves it in transfer; finish()
+ * is called once the read is done. Both get context, e.g. the tof_sensor.
+ */
+typedef struct
+{
+	char id;
+	volatile uint8_t ready;		/* Set from HAL_GPIO_EXTI_Callback */
+	uint32_t poll_us;
+	uint32_t last_us;
+	void *context;
+	void (*run)(void *context);
+	void (*finish)(void *context);
+	i2c_transfer transfer;
+} sensor_task;
+
+/*
+ * One VL53L5CX. All of them use the same driver, dev.platform carries the bus
+ * and the address. Sensors sharing a bus need their own LPn line so they can
+ * be moved to their own address one by one, see tof_init(); lpn_port is NULL
+ * for a sensor alone on its bus, which keeps the default address.
+ */
+typedef struct
+{
+	char id;						/* INTEGRATOR_ID_VL53L5CX_n */
+	I2C_HandleTypeDef *hi2c;
+	uint16_t address;				/* 8-bit I2C address */
+	GPIO_TypeDef *lpn_port;
+	uint16_t lpn_pin;
+	uint16_t int_pin;				/* EXTI line of the INT output, 0 if not wired */
+	VL53L5CX_Configuration dev;
+	VL53L5CX_ResultsData results;
+	int16_t codec_reference[INTEGRATOR_VL53L5CX_VALUES];
+	int status;
+	uint8_t alive;
+	uint8_t resolution;				/* Number of zones, 16 or 64 */
+	uint8_t ranging;
+	uint32_t outputs;				/* VL53L5CX_OUTPUT_* blocks wanted, set by apply_mode() */
+	uint8_t output_flags;			/* INTEGRATOR_VL_OUTPUT_* of INTEGRATOR_CMD_VL_OUTPUTS */
+	uint8_t fields;					/* INTEGRATOR_TOF_FIELD_* sent, 0 for distance frames */
+} tof_sensor;
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
@@ -45,8 +102,27 @@
 #define TA_SHIFT 8
 
 #define CRC16 0x1021
-#define CRC16_INIT 0
-#define CRC16_POLYNOMIAL 0x8005
+
+/* Distance change below which a VL53L5CX zone is not resent in coded frames */
+#define TOF_DEADBAND_MM 5
+
+/* Reported to the host in the capability descriptor */
+#define FIRMWARE_VERSION_MAJOR 1
+#define FIRMWARE_VERSION_MINOR 4
+
+#define TOF_FREQUENCY_HZ 1
+
+/* Blocks read until the host selects others with INTEGRATOR_CMD_VL_OUTPUTS */
+#define TOF_OUTPUTS_DEFAULT (INTEGRATOR_VL_OUTPUT_TARGET_STATUS | INTEGRATOR_VL_OUTPUT_NB_TARGET | INTEGRATOR_VL_OUTPUT_SIGMA)
+
+#if VL53L5CX_NB_TARGET_PER_ZONE > INTEGRATOR_TOF_MAX_TARGETS
+#error "VL53L5CX_NB_TARGET_PER_ZONE exceeds the targets of INTEGRATOR_ID_VL53L5CX_FIELDS"
+#endif
+
+/* The MLX90640 status register is polled this many times per subpage */
+#define MLX_POLLS_PER_SUBPAGE 4
+/* Subpages read ahead of the conversion, see process_mlx_frames() */
+#define MLX_FRAME_BUFFERS 2
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -60,16 +136,33 @@
 float mlx90640To[768];
 uint16_t eeMLX90640[832];
 paramsMLX90640 mlx90640;
-uint16_t mlx90640Frame[834];
+mlx90640Solver mlxSolver;
 int status3=0;
 
-int status, status2;
-int startVL1 = 0;
-int startVL2 = 0;
-uint8_t i, isReady, isReady2;
-VL53L5CX_Configuration 	Dev, Dev2;
-VL53L5CX_ResultsData 	Results, Results2;
-uint8_t resolution, resolution2, isAlive, isAlive2;
+/*
+ * MLX90640 subpages read by DMA, oldest first from mlxFramesHead. The next
+ * subpage is read into a free buffer while the CPU solves the one before;
+ * with every buffer waiting the status polls pause until one is free.
+ */
+uint16_t mlx90640Frames[MLX_FRAME_BUFFERS][834];
+uint32_t mlxFrameTimes[MLX_FRAME_BUFFERS];
+uint8_t mlxFramesHead = 0;
+uint8_t mlxFramesQueued = 0;
+uint16_t *mlx90640Frame = mlx90640Frames[0];	/* Subpage being solved and sent */
+MLX90640_FrameRead mlxRead;
+uint8_t mlxReadingFrame = 0;	/* The task transfer carries the subpage, not the status */
+
+/* VL53L5CX of this board; ids in the order of integrator_vl53l5cx_id() */
+tof_sensor tofSensors[] = {
+	{ .id = INTEGRATOR_ID_VL53L5CX_1, .hi2c = &hi2c1, .address = VL53L5CX_DEFAULT_I2C_ADDRESS, .int_pin = VL1_INT_Pin,
+	  .output_flags = TOF_OUTPUTS_DEFAULT },
+	{ .id = INTEGRATOR_ID_VL53L5CX_2, .hi2c = &hi2c2, .address = VL53L5CX_DEFAULT_I2C_ADDRESS, .int_pin = VL2_INT_Pin,
+	  .output_flags = TOF_OUTPUTS_DEFAULT },
+};
+#define TOF_COUNT ((int)(sizeof(tofSensors) / sizeof(tofSensors[0])))
+
+uint8_t amgPresent;
+uint16_t mlxRefreshRate;
 
 float pixels[64];
 int16_t pixelsRaw[64];
@@ -77,23 +170,149 @@ int16_t pixelsRawResize[RESIZE_X*RESIZE_Y];
 uint16_t buf[64];
 
 char flag = 'B';
-uint8_t Rx_data;
 
 uint16_t crc_result;
 
 uint16_t test = 12345;
+
+/* 0 - ASCII frames (printf), 1 - binary frames from integrator_protocol.h */
+uint8_t binaryFormat = 0;
+uint8_t txFrame[INTEGRATOR_MAX_FRAME];
+/* Per-id frame counters, the last one is shared by the control frames */
+uint16_t txSequence[INTEGRATOR_SENSOR_COUNT + 1];
+
+/* Delta and sparse coding of the binary frames, see integrator_codec.h */
+uint8_t codedFormat = 0;
+volatile uint8_t codecRestart = 0;	/* Start every stream with a keyframe */
+uint8_t codedFrame[INTEGRATOR_MAX_FRAME];
+int16_t codecReferenceAMG[INTEGRATOR_AMG8833_VALUES];
+int16_t codecReferenceMLX[INTEGRATOR_MLX90640_VALUES];
+integrator_codec_state txCodec[INTEGRATOR_SENSOR_COUNT];
+
+/* Scheduler, indexed by integrator_sensor_slot() */
+sensor_task sensorTasks[INTEGRATOR_SENSOR_COUNT];
+
+/* Baud rate negotiation, see integrator_protocol.h */
+const uint32_t baudRates[INTEGRATOR_BAUD_RATE_COUNT] = INTEGRATOR_BAUD_RATES;
+uint8_t rxBaudArgument = 0;			/* Next received byte is the rate index */
+volatile int8_t baudRequest = -1;	/* Rate index waiting for the main loop */
+volatile uint8_t baudSwitching = 0;	/* New rate set, waiting for the confirmation */
+uint32_t baudSwitchTick;
+
+/* Boot time per stage, see boot_stage() */
+#define BOOT_STAGES_MAX 8
+const char *bootStageName[BOOT_STAGES_MAX];
+uint32_t bootStageUs[BOOT_STAGES_MAX];
+uint8_t bootStageCount = 0;
+uint32_t bootStageStart = 0;
+
+/* MLX90640 sent as raw frames, solved on the host (INTEGRATOR_CMD_MLX_RAW) */
+uint8_t mlxRaw = 0;
+volatile uint8_t mlxEepromRequest = 0;	/* EEPROM frame waiting for the main loop */
+/* MLX90640 sent one subpage at a time, merged on the host (INTEGRATOR_CMD_MLX_SUBPAGE) */
+uint8_t mlxSubpage = 0;
+uint8_t rxMlxRateArgument = 0;		/* Next received byte is the rate code */
+volatile int8_t mlxRateRequest = -1;	/* Rate code waiting for the main loop */
+
+/* AMG8833 sent as raw pixel registers, converted on the host (INTEGRATOR_CMD_AMG_RAW) */
+uint8_t amgRaw = 0;
+uint8_t rxAmgConfigArgument = 0;	/* Next received byte holds the INTEGRATOR_AMG_* flags */
+volatile int16_t amgConfigRequest = -1;	/* Flags waiting for the main loop */
+
+/* VL53L5CX output blocks (INTEGRATOR_CMD_VL_OUTPUTS) */
+uint8_t rxVlOutputsArgument = 0;	/* Next received byte holds the INTEGRATOR_VL_OUTPUT_* flags */
+/* VL53L5CX fields (INTEGRATOR_CMD_TOF_FIELDS) */
+uint8_t rxTofFieldsArgument = 0;	/* Argument bytes of INTEGRATOR_CMD_TOF_FIELDS still expected */
+uint8_t rxTofFieldsCommand[INTEGRATOR_CMD_TOF_FIELDS_ARGS];
+
+/* Measurement series on the MCU (INTEGRATOR_CMD_SERIES), indexed by integrator_sensor_slot() */
+integrator_series series[INTEGRATOR_SENSOR_COUNT];
+/* 64 zones for every sensor but the MLX90640, which has its own */
+integrator_series_zone seriesZones[(INTEGRATOR_SENSOR_COUNT - 1) * INTEGRATOR_VL53L5CX_VALUES];
+integrator_series_zone seriesZonesMLX[INTEGRATOR_MLX90640_VALUES];
+uint8_t mlxSeriesHalf = 0;			/* Subpage 0 of the next frame for the MLX90640 series is solved */
+uint8_t rxSeriesArgument = 0;		/* Argument bytes of INTEGRATOR_CMD_SERIES still expected */
+uint8_t rxSeriesCommand[INTEGRATOR_CMD_SERIES_ARGS];
+/* Requests waiting for the main loop, one per sensor */
+volatile uint8_t seriesRequested = 0;
+uint16_t seriesRequestFrames[INTEGRATOR_SENSOR_COUNT];
+uint8_t seriesRequestFlags[INTEGRATOR_SENSOR_COUNT];
+
+/* Cycle budget telemetry (INTEGRATOR_CMD_PROFILE), counted in cpu_profile */
+uint8_t rxProfileArgument = 0;		/* Next received byte is the period */
+volatile int8_t profileRequest = -1;	/* Period waiting for the main loop */
+uint8_t profilePeriodS = 0;			/* 0 while no frames are sent */
+uint32_t profileWindowStart = 0;	/* micros() at the start of the window */
+
+/* Commands from the host, parsed in the main loop (integrator_command.h) */
+integrator_command_parser rxCommand;
+uint32_t rxCommandTick;				/* HAL_GetTick() of the last received byte */
+uint32_t rxCommandErrors = 0;		/* Command frames dropped */
+/* Acknowledgement of the last command frame, waiting for send_command_ack() */
+uint8_t ackPending = 0;
+uint16_t ackSequence;
+uint8_t ackStatus;
+uint8_t ackCommands;
+uint32_t ackTimestamp;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 /* USER CODE BEGIN PFP */
-uint16_t calculateCRC16(uint16_t *data, int length);
 void get_data_by_polling(VL53L5CX_Configuration *p_dev);
 void get_data_by_interrupt(VL53L5CX_Configuration *p_dev);
-void get_result_VL53L5CX1();
-void get_result_VL53L5CX2();
-void get_result_MLX90640();
-void get_result_AMG8833();
+void tof_init_start();
+void tof_init_finish();
+uint32_t tof_outputs(uint8_t flags);
+uint8_t tof_fields_available();
+void tof_update_outputs(tof_sensor *tof);
+void tof_select_outputs(uint8_t flags);
+void tof_select_fields(uint8_t id, uint8_t fields);
+void boot_stage(const char *name);
+void print_boot_report();
+void start_VL53L5CX(void *context);
+void get_result_VL53L5CX(void *context);
+void send_tof_fields_frame(tof_sensor *tof, uint32_t timestamp);
+void get_result_MLX90640(uint32_t timestamp);
+void finish_MLX90640(void *context);
+uint8_t process_mlx_frames();
+void start_AMG8833(void *context);
+void get_result_AMG8833(void *context);
+void send_binary_frame(uint8_t id, uint16_t payload_len, uint32_t timestamp);
+void codec_init();
+void scheduler_init();
+uint8_t mode_reads(char mode, char id);
+void apply_mode();
+uint8_t run_scheduler();
+void poll_MLX90640(void *context);
+void send_baud_frame(uint32_t rate, uint8_t state);
+void send_capabilities_frame();
+void send_mlx_eeprom_frame();
+void send_mlx_raw_frame(uint32_t timestamp);
+void send_mlx_subpage_frame(uint32_t timestamp);
+uint32_t mlx_period_us();
+void process_mlx_rate();
+void send_amg_raw_frame(uint32_t timestamp);
+uint32_t amg_period_us();
+void process_amg_config();
+void series_init();
+void series_request(const uint8_t *command);
+uint8_t series_add_frame(uint8_t id, uint16_t count, uint32_t timestamp);
+uint8_t series_holds_frames(uint8_t id);
+void send_series_summary(uint8_t slot, uint8_t state);
+void process_series();
+void set_baud_rate(uint32_t rate);
+void process_baud_request();
+void ascii_print(const char *format, ...) __attribute__((format(printf, 1, 2)));
+uint16_t put_frame_crc(uint8_t *frame, uint16_t payload_len);
+void send_profile_frame(uint32_t now);
+void process_profile();
+uint8_t command_argument_pending();
+void command_reset_arguments();
+uint8_t run_command(uint8_t byte);
+void run_command_frame();
+void process_commands();
+void send_command_ack();
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -160,23 +379,421 @@ void get_result_AMG8833();
 //    return crc;
 //}
 
-unsigned short int ComputeCRC16(const char* pData, int Length, unsigned int Poly, unsigned short int InitVal) {
-    unsigned short int ResCRC = InitVal;
+int _write(int file, char *ptr, int len){
+	//HAL_UART_Transmit(&huart2, ptr, len, 100);
+	uart_tx_write(ptr, len);
+	return len;
+}
 
-    while (--Length >= 0) {
-        ResCRC ^= *pData++ << 8;
-        for (short int i = 0; i < 8; ++i) {
-            ResCRC = ResCRC & 0x8000 ? (ResCRC << 1) ^ Poly : ResCRC << 1;
-        }
-    }
-    return ResCRC & 0xFFFF;
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	uart_tx_complete(huart);
 }
 
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	uart_rx_error(huart);
+}
 
-int _write(int file, char *ptr, int len){
-	HAL_UART_Transmit(&huart2, ptr, len, 100);
-	//HAL_UART_Transmit_IT(&huart2, ptr, len);
-	return len;
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	i2c_bus_complete(hi2c, 0);
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	i2c_bus_complete(hi2c, 0);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	i2c_bus_complete(hi2c, 1);
+}
+
+/* integrator_put_crc() counted in the CRC stage of the cycle budget */
+uint16_t put_frame_crc(uint8_t *frame, uint16_t payload_len){
+	uint8_t stage = profile_enter(INTEGRATOR_STAGE_CRC);
+	uint16_t frame_len = integrator_put_crc(frame, payload_len);
+	profile_leave(stage);
+	return frame_len;
+}
+
+/*
+ * Sends the frame prepared in txFrame. The payload must already be placed
+ * after the header; the header and the CRC are filled in here. The frame is
+ * copied to the DMA buffer, so txFrame may be reused as soon as this returns.
+ * timestamp is the micros() value at which the sensor data was read.
+ * In the coded format the payload is delta or sparse coded into codedFrame.
+ */
+void send_binary_frame(uint8_t id, uint16_t payload_len, uint32_t timestamp){
+	uint8_t slot = integrator_sensor_slot(id);
+	uint16_t sequence = txSequence[slot]++;
+	uint8_t *frame = txFrame;
+
+	if(codedFormat && slot < INTEGRATOR_SENSOR_COUNT){
+		if(codecRestart){
+			codecRestart = 0;
+			for(int s = 0; s < INTEGRATOR_SENSOR_COUNT; s++) integrator_codec_reset(&txCodec[s]);
+		}
+		uint8_t tof = integrator_is_vl53l5cx(id);
+		uint8_t stage = profile_enter(INTEGRATOR_STAGE_CODEC);
+		payload_len = integrator_codec_encode(&txCodec[slot], tof ? INTEGRATOR_CODEC_ZONES : INTEGRATOR_CODEC_DELTA,
+				&txFrame[INTEGRATOR_HEADER_SIZE], payload_len / 2, tof ? TOF_DEADBAND_MM : 0,
+				&codedFrame[INTEGRATOR_HEADER_SIZE]);
+		profile_leave(stage);
+		frame = codedFrame;
+		id |= INTEGRATOR_ID_CODED;
+	}
+
+	integrator_put_header(frame, id, payload_len, sequence, timestamp);
+	uint16_t frame_len = put_frame_crc(frame, payload_len);
+
+	fflush(stdout);
+	uart_tx_write(frame, frame_len);
+}
+
+void codec_init(){
+	for(int t = 0; t < TOF_COUNT; t++){
+		integrator_codec_init(&txCodec[integrator_sensor_slot(tofSensors[t].id)], tofSensors[t].codec_reference,
+				INTEGRATOR_VL53L5CX_VALUES);
+	}
+	integrator_codec_init(&txCodec[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)], codecReferenceAMG, INTEGRATOR_AMG8833_VALUES);
+	integrator_codec_init(&txCodec[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)], codecReferenceMLX, INTEGRATOR_MLX90640_VALUES);
+}
+
+/* Reports the link rate to the host */
+void send_baud_frame(uint32_t rate, uint8_t state){
+	uint8_t frame[INTEGRATOR_HEADER_SIZE + 5 + INTEGRATOR_CRC_SIZE];
+	uint8_t *payload = &frame[INTEGRATOR_HEADER_SIZE];
+
+	integrator_put_header(frame, INTEGRATOR_ID_BAUD, 5, txSequence[INTEGRATOR_SENSOR_COUNT]++, micros());
+	integrator_put_u32(payload, rate);
+	payload[4] = state;
+	uart_tx_write(frame, put_frame_crc(frame, 5));
+}
+
+/*
+ * Describes the attached sensors to the host, see integrator_protocol.h.
+ * Uses only values cached during initialisation and by the reads.
+ */
+void send_capabilities_frame(){
+	const uint8_t count = TOF_COUNT + 2;
+	const uint16_t len = INTEGRATOR_CAPS_HEADER_SIZE + count * INTEGRATOR_CAPS_ENTRY_SIZE;
+	uint8_t frame[INTEGRATOR_HEADER_SIZE + INTEGRATOR_CAPS_HEADER_SIZE
+			+ INTEGRATOR_SENSOR_COUNT * INTEGRATOR_CAPS_ENTRY_SIZE + INTEGRATOR_CRC_SIZE];
+	uint8_t *payload = &frame[INTEGRATOR_HEADER_SIZE];
+	uint8_t *entry = &payload[INTEGRATOR_CAPS_HEADER_SIZE];
+
+	payload[0] = INTEGRATOR_CAPS_VERSION;
+	payload[1] = FIRMWARE_VERSION_MAJOR;
+	payload[2] = FIRMWARE_VERSION_MINOR;
+	payload[3] = count;
+	for(int t = 0; t < TOF_COUNT; t++){
+		uint8_t side = (tofSensors[t].resolution == VL53L5CX_RESOLUTION_4X4) ? 4 : 8;
+		integrator_put_caps_entry(entry, tofSensors[t].id, INTEGRATOR_DATA_DISTANCE_MM, side, side,
+				TOF_FREQUENCY_HZ * 100, tofSensors[t].alive ? INTEGRATOR_CAPS_PRESENT : 0);
+		entry += INTEGRATOR_CAPS_ENTRY_SIZE;
+	}
+	integrator_put_caps_entry(entry, INTEGRATOR_ID_AMG8833, INTEGRATOR_DATA_TEMP_CENTI, 8, 8,
+			getFPSC() == AMG88xx_FPS_1 ? 100 : 1000, amgPresent ? INTEGRATOR_CAPS_PRESENT : 0);
+	entry += INTEGRATOR_CAPS_ENTRY_SIZE;
+	/* MLX90640 refresh rate code n stands for 0.5 * 2^n Hz */
+	integrator_put_caps_entry(entry, INTEGRATOR_ID_MLX90640, INTEGRATOR_DATA_TEMP_CENTI, 32, 24,
+			50 << mlxRefreshRate, status3 >= 0 ? INTEGRATOR_CAPS_PRESENT : 0);
+
+	integrator_put_header(frame, INTEGRATOR_ID_CAPABILITIES, len, txSequence[INTEGRATOR_SENSOR_COUNT]++, micros());
+	uart_tx_write(frame, put_frame_crc(frame, len));
+}
+
+/*
+ * Sends the MLX90640 calibration EEPROM, which the host needs to solve the
+ * raw frames. Uses txFrame, so it runs in the main loop.
+ */
+void send_mlx_eeprom_frame(){
+	const uint16_t len = 2*INTEGRATOR_MLX90640_EEPROM_WORDS;
+
+	for(int i = 0; i < INTEGRATOR_MLX90640_EEPROM_WORDS; i++){
+		integrator_put_u16(&txFrame[INTEGRATOR_HEADER_SIZE + 2*i], eeMLX90640[i]);
+	}
+	integrator_put_header(txFrame, INTEGRATOR_ID_MLX90640_EEPROM, len, txSequence[INTEGRATOR_SENSOR_COUNT]++, micros());
+	uart_tx_write(txFrame, put_frame_crc(txFrame, len));
+}
+
+/* Raw words of mlx90640Frame, the host solves the temperatures; never coded */
+void send_mlx_raw_frame(uint32_t timestamp){
+	const uint16_t len = 2*INTEGRATOR_MLX90640_RAW_WORDS;
+
+	for(int i = 0; i < INTEGRATOR_MLX90640_RAW_WORDS; i++){
+		integrator_put_u16(&txFrame[INTEGRATOR_HEADER_SIZE + 2*i], mlx90640Frame[i]);
+	}
+	integrator_put_header(txFrame, INTEGRATOR_ID_MLX90640_RAW, len,
+			txSequence[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)]++, timestamp);
+	uart_tx_write(txFrame, put_frame_crc(txFrame, len));
+}
+
+/*
+ * Temperatures of the pixels measured in the subpage of mlx90640Frame, the
+ * only ones MLX90640_SolveTo() updated; the host keeps the other half. Never
+ * coded.
+ */
+void send_mlx_subpage_frame(uint32_t timestamp){
+	const uint16_t len = INTEGRATOR_MLX90640_SUBPAGE_HEADER + 2*INTEGRATOR_MLX90640_SUBPAGE_VALUES;
+	const uint8_t subpage = mlx90640Frame[833] & 1;
+	const uint8_t chess = (mlx90640Frame[832] & 0x1000) != 0;
+	uint8_t *payload = &txFrame[INTEGRATOR_HEADER_SIZE];
+	uint8_t *dst = &payload[INTEGRATOR_MLX90640_SUBPAGE_HEADER];
+
+	payload[0] = subpage;
+	payload[1] = chess ? INTEGRATOR_MLX90640_CHESS : 0;
+	for(int i = 0; i < INTEGRATOR_MLX90640_VALUES; i++){
+		if(integrator_mlx90640_pixel_subpage(i, chess) != subpage) continue;
+		integrator_put_i16(dst, integrator_temp_to_wire(mlx90640To[i]));
+		dst += 2;
+	}
+	integrator_put_header(txFrame, INTEGRATOR_ID_MLX90640_SUBPAGE, len,
+			txSequence[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)]++, timestamp);
+	uart_tx_write(txFrame, put_frame_crc(txFrame, len));
+}
+
+/* Subpage period of the MLX90640, refresh rate code n stands for 0.5 * 2^n subpages per second */
+uint32_t mlx_period_us(){
+	return 2000000 >> mlxRefreshRate;
+}
+
+/*
+ * Sets the refresh rate requested with INTEGRATOR_CMD_MLX_RATE. Runs in the
+ * main loop, because the control register is written over I2C; the new rate
+ * goes to the host in a capability frame.
+ */
+void process_mlx_rate(){
+	int8_t code = mlxRateRequest;
+
+	if(code < 0) return;
+	mlxRateRequest = -1;
+	/* status3 holds the last subpage read, negative after an error */
+	if(code <= INTEGRATOR_MLX90640_RATE_MAX && status3 >= 0){
+		MLX90640_SetRefreshRate(code);
+		mlxRefreshRate = MLX90640_GetRefreshRate();
+		sensorTasks[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)].poll_us = mlx_period_us() / MLX_POLLS_PER_SUBPAGE;
+	}
+	send_capabilities_frame();
+}
+
+/* Closes the cycle budget window at micros() value now and sends it */
+void send_profile_frame(uint32_t now){
+	/* The I2C and UART interrupts switch the pipeline stages */
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint16_t len = integrator_profile_put(&cpu_profile, profile_cycles(), HAL_RCC_GetHCLKFreq(),
+			now - profileWindowStart, &txFrame[INTEGRATOR_HEADER_SIZE]);
+	__set_PRIMASK(primask);
+
+	profileWindowStart = now;
+	integrator_put_header(txFrame, INTEGRATOR_ID_PROFILE, len, txSequence[INTEGRATOR_SENSOR_COUNT]++, now);
+	uart_tx_write(txFrame, put_frame_crc(txFrame, len));
+}
+
+/*
+ * Applies the period requested with INTEGRATOR_CMD_PROFILE, which starts a
+ * new window, and sends the budget when the window is over. Runs in the main
+ * loop outside every profiled stage.
+ */
+void process_profile(){
+	int8_t period = profileRequest;
+	uint32_t now = micros();
+
+	if(period >= 0){
+		profileRequest = -1;
+		profilePeriodS = period;
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		integrator_profile_init(&cpu_profile, profile_cycles());
+		__set_PRIMASK(primask);
+		profileWindowStart = now;
+		return;
+	}
+	if(profilePeriodS && now - profileWindowStart >= profilePeriodS * 1000000u){
+		send_profile_frame(now);
+	}
+}
+
+/* Pixel registers in pixelsRaw as read, the host converts them; never coded */
+void send_amg_raw_frame(uint32_t timestamp){
+	const uint16_t len = 2*INTEGRATOR_AMG8833_VALUES;
+
+	for(int i = 0; i < INTEGRATOR_AMG8833_VALUES; i++){
+		integrator_put_u16(&txFrame[INTEGRATOR_HEADER_SIZE + 2*i], (uint16_t)pixelsRaw[i]);
+	}
+	integrator_put_header(txFrame, INTEGRATOR_ID_AMG8833_RAW, len,
+			txSequence[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)]++, timestamp);
+	uart_tx_write(txFrame, put_frame_crc(txFrame, len));
+}
+
+/* Frame period of the AMG8833 at its current frame rate */
+uint32_t amg_period_us(){
+	return (getFPSC() == AMG88xx_FPS_1) ? 1000000 : 100000;
+}
+
+/*
+ * Applies the INTEGRATOR_AMG_* flags of INTEGRATOR_CMD_AMG_CONFIG: frame rate
+ * and moving average. Runs in the main loop, because the registers are
+ * written over I2C; the new rate goes to the host in a capability frame.
+ */
+void process_amg_config(){
+	int16_t request = amgConfigRequest;
+
+	if(request < 0) return;
+	amgConfigRequest = -1;
+	if(amgPresent){
+		setFPS((request & INTEGRATOR_AMG_FPS_1) ? AMG88xx_FPS_1 : AMG88xx_FPS_10);
+		setMovingAverageMode((request & INTEGRATOR_AMG_MOVING_AVERAGE) != 0);
+		sensorTasks[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)].poll_us = amg_period_us();
+	}
+	send_capabilities_frame();
+}
+
+void series_init(){
+	integrator_series_zone *zones = seriesZones;
+
+	for(int s = 0; s < INTEGRATOR_SENSOR_COUNT; s++){
+		if(integrator_slot_id(s) == INTEGRATOR_ID_MLX90640){
+			integrator_series_init(&series[s], seriesZonesMLX, INTEGRATOR_MLX90640_VALUES);
+			continue;
+		}
+		integrator_series_init(&series[s], zones, INTEGRATOR_VL53L5CX_VALUES);
+		zones += INTEGRATOR_VL53L5CX_VALUES;
+	}
+}
+
+/*
+ * Takes the arguments of INTEGRATOR_CMD_SERIES (sensor id, u16 frames, flags)
+ * from run_command(); the series starts in process_series().
+ */
+void series_request(const uint8_t *command){
+	uint8_t slot = integrator_sensor_slot(command[0]);
+
+	if(slot >= INTEGRATOR_SENSOR_COUNT) return;
+	seriesRequestFrames[slot] = integrator_get_u16(&command[1]);
+	seriesRequestFlags[slot] = command[3];
+	seriesRequested |= (uint8_t)(1u << slot);
+}
+
+/*
+ * Adds the frame in the txFrame payload to the series of the sensor, if one
+ * is running. Returns 1 if the frame is not to be sent, i.e. the series runs
+ * without INTEGRATOR_SERIES_FRAMES. The summary goes out from process_series().
+ */
+uint8_t series_add_frame(uint8_t id, uint16_t count, uint32_t timestamp){
+	integrator_series *s = &series[integrator_sensor_slot(id)];
+
+	if(!integrator_series_running(s)) return 0;
+	integrator_series_add(s, &txFrame[INTEGRATOR_HEADER_SIZE], count, timestamp);
+	return !(s->flags & INTEGRATOR_SERIES_FRAMES);
+}
+
+/* Like series_add_frame() for a frame the series does not take */
+uint8_t series_holds_frames(uint8_t id){
+	const integrator_series *s = &series[integrator_sensor_slot(id)];
+
+	return integrator_series_running(s) && !(s->flags & INTEGRATOR_SERIES_FRAMES);
+}
+
+/*
+ * Sends the statistics of a series in as many INTEGRATOR_ID_SERIES frames as
+ * its zones need and ends the series. Uses txFrame, so it runs in the main loop.
+ */
+void send_series_summary(uint8_t slot, uint8_t state){
+	integrator_series *s = &series[slot];
+	uint16_t first = 0;
+
+	do{
+		uint16_t len = integrator_series_put_summary(s, integrator_slot_id(slot), state, first,
+				&txFrame[INTEGRATOR_HEADER_SIZE]);
+		integrator_put_header(txFrame, INTEGRATOR_ID_SERIES, len, txSequence[INTEGRATOR_SENSOR_COUNT]++, micros());
+		uart_tx_write(txFrame, put_frame_crc(txFrame, len));
+		first += INTEGRATOR_SERIES_ZONES_PER_FRAME;
+	}while(first < s->count && s->frames > 0);
+	s->target = 0;
+}
+
+/* Starts or aborts the requested series and reports the completed ones */
+void process_series(){
+	for(int s = 0; s < INTEGRATOR_SENSOR_COUNT; s++){
+		if(integrator_series_complete(&series[s])){
+			send_series_summary(s, INTEGRATOR_SERIES_DONE);
+		}
+	}
+	if(!seriesRequested) return;
+
+	for(int s = 0; s < INTEGRATOR_SENSOR_COUNT; s++){
+		__disable_irq();
+		uint8_t requested = seriesRequested & (1u << s);
+		seriesRequested &= (uint8_t)~(1u << s);
+		uint16_t frames = seriesRequestFrames[s];
+		uint8_t flags = seriesRequestFlags[s];
+		__enable_irq();
+
+		if(!requested) continue;
+		if(frames == 0){
+			if(series[s].target) send_series_summary(s, INTEGRATOR_SERIES_ABORTED);
+			continue;
+		}
+		integrator_series_start(&series[s], frames, flags);
+	}
+}
+
+void set_baud_rate(uint32_t rate){
+	uart_tx_wait_idle();
+	USART2_SetBaudRate(rate);
+	uart_rx_init(&huart2);
+}
+
+/*
+ * Carries out a baud rate change requested with INTEGRATOR_CMD_BAUD, or falls
+ * back to the default rate when the host did not confirm the new one. Runs in
+ * the main loop, because the switch has to wait until the transmitter drains.
+ */
+void process_baud_request(){
+	if(baudRequest >= 0){
+		uint8_t index = baudRequest;
+		baudRequest = -1;
+		if(index >= INTEGRATOR_BAUD_RATE_COUNT){
+			send_baud_frame(huart2.Init.BaudRate, INTEGRATOR_BAUD_REJECTED);
+			return;
+		}
+		send_baud_frame(baudRates[index], INTEGRATOR_BAUD_SWITCHING);
+		set_baud_rate(baudRates[index]);
+		baudSwitchTick = HAL_GetTick();
+		baudSwitching = 1;
+		return;
+	}
+
+	__disable_irq();
+	uint8_t expired = baudSwitching && HAL_GetTick() - baudSwitchTick > INTEGRATOR_BAUD_CONFIRM_MS;
+	if(expired) baudSwitching = 0;
+	__enable_irq();
+	if(expired){
+		set_baud_rate(INTEGRATOR_BAUD_DEFAULT);
+	}
+}
+
+/*
+ * Prints a part of an ASCII frame and adds the printed text to crc_result,
+ * so the CRC field covers exactly the bytes that were sent. Reset crc_result
+ * to INTEGRATOR_CRC16_INIT before the sensor id.
+ */
+void ascii_print(const char *format, ...){
+	char token[24];
+	va_list args;
+
+	va_start(args, format);
+	int len = vsnprintf(token, sizeof(token), format, args);
+	va_end(args);
+	if(len < 0) return;
+	if(len >= (int)sizeof(token)) len = sizeof(token) - 1;
+
+	crc_result = integrator_crc16_update(crc_result, token, len);
+	fputs(token, stdout);
 }
 
 /*int _read(int file, char *ptr, int len){
@@ -184,9 +801,70 @@ int _write(int file, char *ptr, int len){
 	return len;
 }*/
 
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
-{
-	switch (Rx_data) {
+/* An argument byte of the previous command is still expected */
+uint8_t command_argument_pending(){
+	return rxBaudArgument || rxProfileArgument || rxMlxRateArgument || rxAmgConfigArgument || rxSeriesArgument
+			|| rxVlOutputsArgument || rxTofFieldsArgument;
+}
+
+void command_reset_arguments(){
+	rxBaudArgument = 0;
+	rxProfileArgument = 0;
+	rxMlxRateArgument = 0;
+	rxAmgConfigArgument = 0;
+	rxSeriesArgument = 0;
+	rxVlOutputsArgument = 0;
+	rxTofFieldsArgument = 0;
+}
+
+/*
+ * Carries out one command byte, or takes it as an argument of the previous
+ * command. Runs in the main loop; what needs I2C or a drained transmitter is
+ * left as a request to the process_*() functions. Returns 0 for a byte that
+ * is no command.
+ */
+uint8_t run_command(uint8_t byte){
+	if(rxBaudArgument){
+		rxBaudArgument = 0;
+		baudRequest = (byte >= '0') ? byte - '0' : INTEGRATOR_BAUD_RATE_COUNT;
+		return 1;
+	}
+	if(rxProfileArgument){
+		rxProfileArgument = 0;
+		profileRequest = (byte >= '0' && byte <= '9') ? byte - '0' : 0;
+		return 1;
+	}
+	if(rxMlxRateArgument){
+		rxMlxRateArgument = 0;
+		mlxRateRequest = (byte >= '0') ? byte - '0' : INTEGRATOR_MLX90640_RATE_MAX + 1;
+		return 1;
+	}
+	if(rxAmgConfigArgument){
+		rxAmgConfigArgument = 0;
+		amgConfigRequest = byte;
+		return 1;
+	}
+	if(rxVlOutputsArgument){
+		rxVlOutputsArgument = 0;
+		tof_select_outputs(byte);
+		return 1;
+	}
+	if(rxTofFieldsArgument){
+		rxTofFieldsCommand[INTEGRATOR_CMD_TOF_FIELDS_ARGS - rxTofFieldsArgument] = byte;
+		if(--rxTofFieldsArgument == 0){
+			tof_select_fields(rxTofFieldsCommand[0], rxTofFieldsCommand[1]);
+		}
+		return 1;
+	}
+	if(rxSeriesArgument){
+		rxSeriesCommand[INTEGRATOR_CMD_SERIES_ARGS - rxSeriesArgument] = byte;
+		if(--rxSeriesArgument == 0){
+			series_request(rxSeriesCommand);
+		}
+		return 1;
+	}
+
+	switch (byte) {
 
 	case 'A':
 		flag = 'A';
@@ -216,101 +894,774 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 	case 'I':
 			flag = 'I';
 			break;
-	default:
-		printf("Nieobslugiwany przypadek \n");
+	case INTEGRATOR_CMD_FORMAT_ASCII:
+		binaryFormat = 0;
+		codedFormat = 0;
+		break;
+	case INTEGRATOR_CMD_FORMAT_BINARY:
+		binaryFormat = 1;
+		codedFormat = 0;
+		break;
+	case INTEGRATOR_CMD_FORMAT_CODED:
+		binaryFormat = 1;
+		codedFormat = 1;
+		codecRestart = 1;
+		break;
+	case INTEGRATOR_CMD_BAUD:
+		rxBaudArgument = 1;
+		break;
+	case INTEGRATOR_CMD_CAPABILITIES:
+		send_capabilities_frame();
+		break;
+	/* Uncoded frames take sequence numbers of the slot, so the coder restarts
+	 * and the first coded frame after a switch is a key frame */
+	case INTEGRATOR_CMD_MLX_RAW:
+		mlxRaw = 1;
+		mlxSubpage = 0;
+		mlxEepromRequest = 1;
+		integrator_codec_reset(&txCodec[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)]);
+		break;
+	case INTEGRATOR_CMD_MLX_SUBPAGE:
+		mlxRaw = 0;
+		mlxSubpage = 1;
+		integrator_codec_reset(&txCodec[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)]);
+		break;
+	case INTEGRATOR_CMD_MLX_TEMP:
+		mlxRaw = 0;
+		mlxSubpage = 0;
+		integrator_codec_reset(&txCodec[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)]);
 		break;
+	case INTEGRATOR_CMD_MLX_RATE:
+		rxMlxRateArgument = 1;
+		break;
+	case INTEGRATOR_CMD_PROFILE:
+		rxProfileArgument = 1;
+		break;
+	case INTEGRATOR_CMD_AMG_RAW:
+		amgRaw = 1;
+		integrator_codec_reset(&txCodec[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)]);
+		break;
+	case INTEGRATOR_CMD_AMG_TEMP:
+		amgRaw = 0;
+		integrator_codec_reset(&txCodec[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)]);
+		break;
+	case INTEGRATOR_CMD_AMG_CONFIG:
+		rxAmgConfigArgument = 1;
+		break;
+	case INTEGRATOR_CMD_SERIES:
+		rxSeriesArgument = INTEGRATOR_CMD_SERIES_ARGS;
+		break;
+	case INTEGRATOR_CMD_VL_OUTPUTS:
+		rxVlOutputsArgument = 1;
+		break;
+	case INTEGRATOR_CMD_TOF_FIELDS:
+		rxTofFieldsArgument = INTEGRATOR_CMD_TOF_FIELDS_ARGS;
+		break;
+	case INTEGRATOR_CMD_BAUD_CONFIRM:
+		if(baudSwitching){
+			baudSwitching = 0;
+			send_baud_frame(huart2.Init.BaudRate, INTEGRATOR_BAUD_CONFIRMED);
+		}
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Carries out the commands of a frame as a whole. A command whose arguments
+ * are cut off by the end of the frame is dropped. The acknowledgement goes
+ * out from send_command_ack().
+ */
+void run_command_frame(){
+	const uint8_t *payload = integrator_command_payload(&rxCommand);
+	const uint16_t len = integrator_command_length(&rxCommand);
+
+	ackStatus = INTEGRATOR_ACK_OK;
+	ackCommands = 0;
+	command_reset_arguments();
+	for(uint16_t i = 0; i < len; i++){
+		uint8_t argument = command_argument_pending();
+		if(!run_command(payload[i])){
+			ackStatus = INTEGRATOR_ACK_UNKNOWN;
+			break;
+		}
+		if(!argument) ackCommands++;
+	}
+	if(ackStatus == INTEGRATOR_ACK_OK && command_argument_pending()){
+		command_reset_arguments();
+		ackStatus = INTEGRATOR_ACK_INCOMPLETE;
+		ackCommands--;
 	}
-	printf("Flaga: %c\n", flag);
-	HAL_UART_Transmit_IT(&huart2, &Rx_data, 1);
-	HAL_UART_Receive_IT(&huart2, &Rx_data, 1);
+	ackSequence = integrator_command_sequence(&rxCommand);
+	ackTimestamp = integrator_command_timestamp(&rxCommand);
+	ackPending = 1;
 }
 
+/*
+ * Parses the bytes received from the host (uart_rx.h). Bare bytes are carried
+ * out and echoed as they come; a command frame stops the parsing until
+ * send_command_ack() has answered it, so its requests are processed by the
+ * main loop before the acknowledgement.
+ */
+void process_commands(){
+	uint8_t byte;
+
+	if(rxCommand.length && HAL_GetTick() - rxCommandTick > INTEGRATOR_COMMAND_TIMEOUT_MS){
+		integrator_command_init(&rxCommand);
+		rxCommandErrors++;
+	}
+	while(!ackPending && uart_rx_read(&byte, 1)){
+		rxCommandTick = HAL_GetTick();
+		if(!rxCommand.length && command_argument_pending()){
+			run_command(byte);
+			continue;
+		}
+		switch(integrator_command_feed(&rxCommand, byte)){
+		case INTEGRATOR_COMMAND_BYTE:
+			if(!run_command(byte)) printf("Nieobslugiwany przypadek \n");
+			printf("Flaga: %c\n", flag);
+			uart_tx_write(&byte, 1);
+			break;
+		case INTEGRATOR_COMMAND_FRAME:
+			run_command_frame();
+			break;
+		case INTEGRATOR_COMMAND_BAD:
+			rxCommandErrors++;
+			break;
+		}
+	}
+}
+
+/* Answers the last command frame, see integrator_command.h */
+void send_command_ack(){
+	uint8_t frame[INTEGRATOR_HEADER_SIZE + INTEGRATOR_ACK_SIZE + INTEGRATOR_CRC_SIZE];
+
+	if(!ackPending) return;
+	ackPending = 0;
+	integrator_put_header(frame, INTEGRATOR_ID_ACK, INTEGRATOR_ACK_SIZE, txSequence[INTEGRATOR_SENSOR_COUNT]++, micros());
+	integrator_put_ack(&frame[INTEGRATOR_HEADER_SIZE], ackSequence, ackStatus, ackCommands, ackTimestamp);
+	uart_tx_write(frame, put_frame_crc(frame, INTEGRATOR_ACK_SIZE));
+}
+
+
+/* Ends a boot stage: records the time since the previous call */
+void boot_stage(const char *name){
+	uint32_t now = micros();
+
+	if(bootStageCount < BOOT_STAGES_MAX){
+		bootStageName[bootStageCount] = name;
+		bootStageUs[bootStageCount] = now - bootStageStart;
+		bootStageCount++;
+	}
+	bootStageStart = now;
+}
+
+void print_boot_report(){
+	uint32_t total = 0;
+
+	printf("Czas uruchamiania [us]:");
+	for(int s = 0; s < bootStageCount; s++){
+		printf(" %s %lu,", bootStageName[s], (unsigned long)bootStageUs[s]);
+		total += bootStageUs[s];
+	}
+	printf(" razem %lu\n", (unsigned long)total);
+}
+
+/*
+ * Brings up the VL53L5CX of tofSensors[], first half. The sensors with an LPn
+ * line are all put in low power mode first, then enabled one at a time, found
+ * at the default address and moved to their own one, so any number of them
+ * can share a bus. Every sensor is left with its firmware download running by
+ * DMA: the downloads of different buses overlap, and other devices on the
+ * same bus are served between the chunks. tof_init_finish() completes them.
+ */
+void tof_init_start(){
+	for(int t = 0; t < TOF_COUNT; t++){
+		if(tofSensors[t].lpn_port != NULL){
+			HAL_GPIO_WritePin(tofSensors[t].lpn_port, tofSensors[t].lpn_pin, GPIO_PIN_RESET);
+		}
+	}
+	HAL_Delay(10);
+
+	for(int t = 0; t < TOF_COUNT; t++){
+		tof_sensor *tof = &tofSensors[t];
+
+		printf("Inicjalizacja czujnika VL53L5CX %c...\n", tof->id);
+		if(tof->lpn_port != NULL){
+			HAL_GPIO_WritePin(tof->lpn_port, tof->lpn_pin, GPIO_PIN_SET);
+			HAL_Delay(10);
+		}
+		tof->dev.platform.hi2c = tof->hi2c;
+		tof->dev.platform.address = VL53L5CX_DEFAULT_I2C_ADDRESS;
+		tof->status = vl53l5cx_is_alive(&tof->dev, &tof->alive);
+		if(!tof->alive){
+			printf("Brak czujnika\n");
+			continue;
+		}
+		if(tof->address != VL53L5CX_DEFAULT_I2C_ADDRESS){
+			tof->status = vl53l5cx_set_i2c_address(&tof->dev, tof->address);
+		}
+		tof->status = vl53l5cx_init_start(&tof->dev);
+		if(tof->status != VL53L5CX_STATUS_OK){
+			printf("Blad inicjalizacji czujnika VL53L5CX %c\n", tof->id);
+			tof->alive = 0;
+		}
+	}
+}
+
+/* Waits for the firmware downloads started by tof_init_start() and configures the sensors */
+void tof_init_finish(){
+	for(int t = 0; t < TOF_COUNT; t++){
+		tof_sensor *tof = &tofSensors[t];
+
+		if(!tof->alive){
+			continue;
+		}
+		tof->status = vl53l5cx_init_finish(&tof->dev);
+		if(tof->status != VL53L5CX_STATUS_OK){
+			printf("Blad inicjalizacji czujnika VL53L5CX %c\n", tof->id);
+			tof->alive = 0;
+			continue;
+		}
+		tof->status = vl53l5cx_set_resolution(&tof->dev, VL53L5CX_RESOLUTION_8X8);
+		tof->status = vl53l5cx_set_ranging_frequency_hz(&tof->dev, TOF_FREQUENCY_HZ);
+		tof->status = vl53l5cx_set_target_order(&tof->dev, VL53L5CX_TARGET_ORDER_CLOSEST);
+		tof->status = vl53l5cx_set_ranging_mode(&tof->dev, VL53L5CX_RANGING_MODE_CONTINUOUS);
+		vl53l5cx_get_resolution(&tof->dev, &tof->resolution);
+		tof_update_outputs(tof);
+		printf("Koniec inicjalizacji\n");
+	}
+}
+
+/* VL53L5CX_OUTPUT_* blocks of INTEGRATOR_VL_OUTPUT_* flags, the distance always */
+uint32_t tof_outputs(uint8_t flags){
+	uint32_t outputs = VL53L5CX_OUTPUT_DISTANCE_MM;
+
+	if(flags & INTEGRATOR_VL_OUTPUT_TARGET_STATUS) outputs |= VL53L5CX_OUTPUT_TARGET_STATUS;
+	if(flags & INTEGRATOR_VL_OUTPUT_NB_TARGET) outputs |= VL53L5CX_OUTPUT_NB_TARGET_DETECTED;
+	if(flags & INTEGRATOR_VL_OUTPUT_SIGMA) outputs |= VL53L5CX_OUTPUT_RANGE_SIGMA_MM;
+	if(flags & INTEGRATOR_VL_OUTPUT_SIGNAL) outputs |= VL53L5CX_OUTPUT_SIGNAL_PER_SPAD;
+	if(flags & INTEGRATOR_VL_OUTPUT_AMBIENT) outputs |= VL53L5CX_OUTPUT_AMBIENT_PER_SPAD;
+	if(flags & INTEGRATOR_VL_OUTPUT_SPADS) outputs |= VL53L5CX_OUTPUT_NB_SPADS_ENABLED;
+	if(flags & INTEGRATOR_VL_OUTPUT_REFLECTANCE) outputs |= VL53L5CX_OUTPUT_REFLECTANCE_PERCENT;
+	if(flags & INTEGRATOR_VL_OUTPUT_MOTION) outputs |= VL53L5CX_OUTPUT_MOTION_INDICATOR;
+	return outputs;
+}
+
+/* INTEGRATOR_TOF_FIELD_* whose blocks are compiled in, see platform.h */
+uint8_t tof_fields_available(){
+	uint8_t fields = 0;
+#if !defined(VL53L5CX_DISABLE_TARGET_STATUS) && !defined(VL53L5CX_DISABLE_NB_TARGET_DETECTED)
+	fields |= INTEGRATOR_TOF_FIELD_STATUS;
+#endif
+#ifndef VL53L5CX_DISABLE_RANGE_SIGMA_MM
+	fields |= INTEGRATOR_TOF_FIELD_SIGMA;
+#endif
+#ifndef VL53L5CX_DISABLE_SIGNAL_PER_SPAD
+	fields |= INTEGRATOR_TOF_FIELD_SIGNAL;
+#endif
+#ifndef VL53L5CX_DISABLE_NB_TARGET_DETECTED
+	fields |= INTEGRATOR_TOF_FIELD_TARGETS;
+#endif
+	return fields;
+}
+
+/* The blocks selected by the host plus those the subscribed fields are read from */
+void tof_update_outputs(tof_sensor *tof){
+	uint8_t flags = tof->output_flags;
+
+	if(tof->fields & INTEGRATOR_TOF_FIELD_STATUS) flags |= INTEGRATOR_VL_OUTPUT_TARGET_STATUS | INTEGRATOR_VL_OUTPUT_NB_TARGET;
+	if(tof->fields & INTEGRATOR_TOF_FIELD_SIGMA) flags |= INTEGRATOR_VL_OUTPUT_SIGMA;
+	if(tof->fields & INTEGRATOR_TOF_FIELD_SIGNAL) flags |= INTEGRATOR_VL_OUTPUT_SIGNAL;
+	if(tof->fields & INTEGRATOR_TOF_FIELD_TARGETS) flags |= INTEGRATOR_VL_OUTPUT_NB_TARGET;
+	tof->outputs = tof_outputs(flags);
+}
+
+/*
+ * Takes the INTEGRATOR_VL_OUTPUT_* flags of INTEGRATOR_CMD_VL_OUTPUTS. Blocks
+ * no field is subscribed to are not sent to the host, they just lengthen the
+ * read of each frame. apply_mode() restarts the ranging with the new blocks.
+ */
+void tof_select_outputs(uint8_t flags){
+	for(int t = 0; t < TOF_COUNT; t++){
+		tofSensors[t].output_flags = flags;
+		tof_update_outputs(&tofSensors[t]);
+	}
+}
+
+/*
+ * Takes the arguments of INTEGRATOR_CMD_TOF_FIELDS. Fields whose block is
+ * compiled out are dropped. The coder of the sensor restarts, so the first
+ * distance frame after the fields is a key frame.
+ */
+void tof_select_fields(uint8_t id, uint8_t fields){
+	for(int t = 0; t < TOF_COUNT; t++){
+		tof_sensor *tof = &tofSensors[t];
+		if(tof->id != id) continue;
+		tof->fields = fields & tof_fields_available();
+		tof_update_outputs(tof);
+		integrator_codec_reset(&txCodec[integrator_sensor_slot(id)]);
+	}
+}
+
+/*
+ * Sends the frame of tof as INTEGRATOR_ID_VL53L5CX_FIELDS, see integrator_tof.h.
+ * The driver keeps the targets of a zone next to each other; the payload
+ * has one array per target, so filters on the host read contiguous zones.
+ */
+void send_tof_fields_frame(tof_sensor *tof, uint32_t timestamp){
+	const VL53L5CX_ResultsData *results = &tof->results;
+	const uint8_t zones = tof->resolution;
+	const uint8_t targets = (tof->fields & INTEGRATOR_TOF_FIELD_TARGETS) ? VL53L5CX_NB_TARGET_PER_ZONE : 1;
+	uint8_t *payload = &txFrame[INTEGRATOR_HEADER_SIZE];
+	integrator_tof_layout layout = integrator_tof_put_header(payload, tof->id, tof->fields, targets, zones);
+
+	for(uint8_t t = 0; t < targets; t++){
+		for(uint8_t i = 0; i < zones; i++){
+			const uint16_t k = VL53L5CX_NB_TARGET_PER_ZONE*i + t;
+			const uint16_t v = t*zones + i;
+			integrator_put_i16(&payload[layout.distance + 2*v], results->distance_mm[k]);
+#if !defined(VL53L5CX_DISABLE_TARGET_STATUS) && !defined(VL53L5CX_DISABLE_NB_TARGET_DETECTED)
+			if(layout.status){
+				payload[layout.status + v] = (t < results->nb_target_detected[i])
+						? results->target_status[k] : INTEGRATOR_TOF_STATUS_NONE;
+			}
+#endif
+#ifndef VL53L5CX_DISABLE_RANGE_SIGMA_MM
+			if(layout.sigma){
+				integrator_put_u16(&payload[layout.sigma + 2*v], results->range_sigma_mm[k]);
+			}
+#endif
+#ifndef VL53L5CX_DISABLE_SIGNAL_PER_SPAD
+			if(layout.signal){
+				uint32_t signal = results->signal_per_spad[k];
+				integrator_put_u16(&payload[layout.signal + 2*v], signal > UINT16_MAX ? UINT16_MAX : (uint16_t)signal);
+			}
+#endif
+		}
+	}
+#ifndef VL53L5CX_DISABLE_NB_TARGET_DETECTED
+	if(layout.detected){
+		for(uint8_t i = 0; i < zones; i++){
+			payload[layout.detected + i] = results->nb_target_detected[i];
+		}
+	}
+#endif
+
+	integrator_put_header(txFrame, INTEGRATOR_ID_VL53L5CX_FIELDS, layout.size,
+			txSequence[integrator_sensor_slot(tof->id)]++, timestamp);
+	uart_tx_write(txFrame, put_frame_crc(txFrame, layout.size));
+}
 
-void get_result_VL53L5CX1(){
-	status = vl53l5cx_check_data_ready(&Dev, &isReady);
+/*
+ * Starts the DMA read of a new VL53L5CX frame and returns; the bus transfers
+ * it while the other sensors are served, get_result_VL53L5CX() sends it.
+ */
+void start_VL53L5CX(void *context){
+	tof_sensor *tof = context;
+	uint8_t isReady = 0;
+
+	tof->status = vl53l5cx_check_data_ready(&tof->dev, &isReady);
 	if(isReady)
 	{
-		vl53l5cx_get_resolution(&Dev, &resolution);
-		vl53l5cx_get_ranging_data(&Dev, &Results);
+		vl53l5cx_get_resolution(&tof->dev, &tof->resolution);
+		tof->status = vl53l5cx_start_ranging_data_read(&tof->dev,
+				&sensorTasks[integrator_sensor_slot(tof->id)].transfer);
+	}
+}
+
+void get_result_VL53L5CX(void *context){
+	tof_sensor *tof = context;
+
+	/* Ended by run_scheduler() */
+	profile_pipe_busy(INTEGRATOR_PIPE_CONVERT);
+	uint8_t stage = profile_enter(INTEGRATOR_STAGE_VL53L5CX);
+	tof->status = vl53l5cx_decode_ranging_data(&tof->dev, &tof->results);
+	profile_leave(stage);
+	if(tof->status == VL53L5CX_STATUS_OK)
+	{
+		uint32_t timestamp = micros();
+
+		for(int i = 0; i < tof->resolution; i++)
+		{
+			integrator_put_i16(&txFrame[INTEGRATOR_HEADER_SIZE + 2*i], tof->results.distance_mm[VL53L5CX_NB_TARGET_PER_ZONE*i]);
+		}
+		if(series_add_frame(tof->id, tof->resolution, timestamp))
+		{
+			return;
+		}
+		if(binaryFormat && tof->fields)
+		{
+			send_tof_fields_frame(tof, timestamp);
+			return;
+		}
+		if(binaryFormat)
+		{
+			send_binary_frame(tof->id, 2*tof->resolution, timestamp);
+			return;
+		}
 
-		//crc_result = calculateCRC16((uint16_t*)&Results.distance_mm, sizeof(Results.distance_mm));
-		crc_result = ComputeCRC16((char*)&Results.distance_mm, sizeof(Results.distance_mm), CRC16_POLYNOMIAL, CRC16_INIT);
+		stage = profile_enter(INTEGRATOR_STAGE_ASCII);
+		crc_result = INTEGRATOR_CRC16_INIT;
 
-		//printf("\r\n==========================DANE Z PIERWSZEGO CZUJNIKA VL53LC5X==========================\r\n");
-		//printf("\r\n============================================================================\r\n");
-		printf("X %d ",sizeof(Results.distance_mm)+6);
-		for(i = 0; i < resolution; i++)
+		ascii_print("%c %d ", tof->id, (int)sizeof(tof->results.distance_mm)+6);
+		for(int i = 0; i < tof->resolution; i++)
 		{
-			/*if(i%4 == 0 && i != 0){
-				printf("\r\n");
-			}*/
-		  	printf("%d ", Results.distance_mm[VL53L5CX_NB_TARGET_PER_ZONE*i]);
+		  	ascii_print("%d ", tof->results.distance_mm[VL53L5CX_NB_TARGET_PER_ZONE*i]);
 		}
 		printf("%04X Y\r\n", crc_result);
+		profile_leave(stage);
 	}
-	WaitMs(&(Dev.platform), 5);
+}
 
+/*
+ * Starts the DMA read of the MLX90640 status register; finish_MLX90640()
+ * reads the subpage once the status shows a new one, so the read never waits.
+ * Nothing is read while every frame buffer waits for its conversion.
+ */
+void poll_MLX90640(void *context){
+	(void)context;
+	if(mlxFramesQueued == MLX_FRAME_BUFFERS){
+		profile_pipe_wait(INTEGRATOR_PIPE_CONVERT);
+		return;
+	}
+	mlxReadingFrame = 0;
+	MLX90640_StartStatusRead(&mlxRead, &sensorTasks[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)].transfer);
 }
 
-void get_result_VL53L5CX2(){
-	status2 = vl53l5cx_check_data_ready2(&Dev2, &isReady2);
-	if(isReady2)
-	{
-		vl53l5cx_get_resolution2(&Dev2, &resolution2);
-		vl53l5cx_get_ranging_data2(&Dev2, &Results2);
- //	crc_result = calculateCRC16((uint16_t*)&Results2.distance_mm, sizeof(Results2.distance_mm));
-		crc_result = ComputeCRC16((char*)&Results2.distance_mm, sizeof(Results2.distance_mm), CRC16_POLYNOMIAL, CRC16_INIT);
-
-		//printf("\r\n==========================DANE Z DRUGIEGO CZUJNIKA VL53LC5X==========================\r\n");
-		//printf("\r\n============================================================================\r\n");
-		printf("Z %d ",sizeof(Results2.distance_mm)+6);
-		for(i = 0; i < resolution2; i++)
-		{
-			/*if(i%4 == 0 && i != 0){
-				printf("\r\n");
-			}*/
-		  	printf("%d ", Results2.distance_mm[VL53L5CX_NB_TARGET_PER_ZONE*i]);
+/*
+ * Chains the subpage read to the status read, then queues the subpage for
+ * process_mlx_frames(). A subpage that came in during the read is read again.
+ */
+void finish_MLX90640(void *context){
+	(void)context;
+	const uint8_t buffer = (mlxFramesHead + mlxFramesQueued) % MLX_FRAME_BUFFERS;
+	int result;
+
+	if(!mlxReadingFrame){
+		if(MLX90640_StatusFrameReady(&mlxRead)){
+			mlxReadingFrame = 1;
+			MLX90640_StartFrameRead(&mlxRead, &sensorTasks[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)].transfer,
+					mlx90640Frames[buffer]);
 		}
-		printf("%04X Y\r\n", crc_result);
+		return;
 	}
-	WaitMs(&(Dev2.platform), 5);
+	result = MLX90640_FinishFrameRead(&mlxRead, mlx90640Frames[buffer]);
+	if(result == MLX90640_FRAME_RETRY){
+		MLX90640_RetryFrameRead(&mlxRead, &sensorTasks[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)].transfer,
+				mlx90640Frames[buffer]);
+		return;
+	}
+	mlxReadingFrame = 0;
+	status3 = result;
+	if(status3 >= 0){
+		mlxFrameTimes[buffer] = micros();
+		mlxFramesQueued++;
+	}
+}
 
+/*
+ * Conversion stage of the MLX90640: solves and sends the oldest subpage read.
+ * Runs in the main loop once the scheduler has started the reads, one subpage
+ * per pass, so the buses and the UART DMA keep working while the CPU solves.
+ * Returns 0 if no subpage was waiting.
+ */
+uint8_t process_mlx_frames(){
+	if(mlxFramesQueued == 0){
+		return 0;
+	}
+	mlx90640Frame = mlx90640Frames[mlxFramesHead];
+	profile_pipe_busy(INTEGRATOR_PIPE_CONVERT);
+	get_result_MLX90640(mlxFrameTimes[mlxFramesHead]);
+	profile_pipe_idle(INTEGRATOR_PIPE_CONVERT);
+	mlxFramesHead = (mlxFramesHead + 1) % MLX_FRAME_BUFFERS;
+	mlxFramesQueued--;
+	return 1;
 }
 
-void get_result_MLX90640(){
-	status3 = MLX90640_GetFrameData(mlx90640Frame);
+/* Solves and sends the subpage in mlx90640Frame, read at timestamp */
+void get_result_MLX90640(uint32_t timestamp){
+	/* A series needs the temperatures even when the host solves the frames */
+	uint8_t inSeries = integrator_series_running(&series[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)]);
 
-	float Ta = MLX90640_GetTa(mlx90640Frame, &mlx90640);
+	if(binaryFormat && mlxRaw && !inSeries){
+		send_mlx_raw_frame(timestamp);
+		return;
+	}
+
+	uint8_t stage = profile_enter(INTEGRATOR_STAGE_MLX90640);
+	float Ta = MLX90640_SolverGetTa(mlx90640Frame, &mlxSolver);
 	float tr = Ta - TA_SHIFT;
-	float emissivity = 0.95;
-	MLX90640_CalculateTo(mlx90640Frame, &mlx90640, emissivity, tr, mlx90640To);
-	//crc_result = calculateCRC16((uint16_t*)&mlx90640To, sizeof(mlx90640To));
-	crc_result = ComputeCRC16((char*)&mlx90640To, sizeof(mlx90640To), CRC16_POLYNOMIAL, CRC16_INIT);
+	float emissivity = 0.95f;
+	MLX90640_SolveTo(mlx90640Frame, &mlxSolver, emissivity, tr, mlx90640To);
+	profile_leave(stage);
+
+	/* Half of the pixels, and no stale half for the host to take as new */
+	if(binaryFormat && mlxSubpage && !inSeries){
+		send_mlx_subpage_frame(timestamp);
+		return;
+	}
+
+	for(int i = 0; i < 768; i++){
+		integrator_put_i16(&txFrame[INTEGRATOR_HEADER_SIZE + 2*i], integrator_temp_to_wire(mlx90640To[i]));
+	}
+	/*
+	 * Every subpage refreshes half of the pixels, so the series takes whole
+	 * frames: one sample per pixel once subpage 1 follows subpage 0
+	 */
+	uint8_t subpage = mlx90640Frame[833] & 1;
+	uint8_t wholeFrame = mlxSeriesHalf && subpage == 1;
+	mlxSeriesHalf = inSeries && subpage == 0;
+	if(wholeFrame ? series_add_frame(INTEGRATOR_ID_MLX90640, 768, timestamp)
+			: series_holds_frames(INTEGRATOR_ID_MLX90640)){
+		return;
+	}
+	if(binaryFormat && mlxRaw){
+		send_mlx_raw_frame(timestamp);
+		return;
+	}
+	if(binaryFormat && mlxSubpage){
+		send_mlx_subpage_frame(timestamp);
+		return;
+	}
+	if(binaryFormat){
+		send_binary_frame(INTEGRATOR_ID_MLX90640, 2*768, timestamp);
+		return;
+	}
+	stage = profile_enter(INTEGRATOR_STAGE_ASCII);
+	crc_result = INTEGRATOR_CRC16_INIT;
 	//printf("\r\n==========================DANE Z CZUJNIKA MLX90640==========================\r\n");
-	printf("L %d ",sizeof(mlx90640To)+6);
+	ascii_print("L %d ",(int)sizeof(mlx90640To)+6);
 	for(int i = 0; i < 768; i++){
 		/*if(i%32 == 0 && i != 0){
 			printf("\r\n");
 		}*/
-		printf("%2.2f ",mlx90640To[i]);
+		ascii_print("%2.2f ",mlx90640To[i]);
 	}
 	printf("%04X Y\r\n", crc_result);
+	profile_leave(stage);
+}
+
+/* Starts the DMA read of the AMG8833 pixels, get_result_AMG8833() sends them */
+void start_AMG8833(void *context){
+	(void)context;
+	startPixelsRawRead(pixelsRaw, &sensorTasks[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)].transfer);
 }
 
-void get_result_AMG8833(){
+void get_result_AMG8833(void *context){
+	(void)context;
 	//printf("\r\n============================================================================\r\n");
 	//printf("\r\n==========================DANE Z CZUJNIKA AMG8833===========================\r\n");
-	readPixels(pixels, 64);
-	//crc_result = calculateCRC16((uint16_t*)&pixels, sizeof(pixels));
-	crc_result = ComputeCRC16((char*)&pixels, sizeof(pixels), CRC16_POLYNOMIAL, CRC16_INIT);
-	printf("P %d ",sizeof(pixels)+6);
+	uint32_t timestamp = micros();
+	/* Ended by run_scheduler() */
+	profile_pipe_busy(INTEGRATOR_PIPE_CONVERT);
+	/* A series needs the temperatures even when the host converts the frames */
+	uint8_t inSeries = integrator_series_running(&series[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)]);
+
+	if(binaryFormat && amgRaw && !inSeries){
+		send_amg_raw_frame(timestamp);
+		return;
+	}
+
+	/* Integer conversion, 0.25 degree steps are exact in hundredths */
+	uint8_t stage = profile_enter(INTEGRATOR_STAGE_AMG8833);
+	for(int i = 0; i < 64; i++){
+		integrator_put_i16(&txFrame[INTEGRATOR_HEADER_SIZE + 2*i], integrator_amg8833_raw_to_wire(pixelsRaw[i]));
+	}
+	profile_leave(stage);
+	if(series_add_frame(INTEGRATOR_ID_AMG8833, 64, timestamp)){
+		return;
+	}
+	if(binaryFormat && amgRaw){
+		send_amg_raw_frame(timestamp);
+		return;
+	}
+	if(binaryFormat){
+		send_binary_frame(INTEGRATOR_ID_AMG8833, 2*64, timestamp);
+		return;
+	}
+	stage = profile_enter(INTEGRATOR_STAGE_ASCII);
+	crc_result = INTEGRATOR_CRC16_INIT;
+	ascii_print("P %d ",(int)sizeof(pixels)+6);
 	for(int i = 0; i < 64; i++){
 		/*if(i%8 == 0 && i != 0){
 			printf("\r\n");
 		}*/
-		printf("%2.2f ",pixels[i]);
+		pixels[i] = integrator_wire_to_temp(integrator_get_i16(&txFrame[INTEGRATOR_HEADER_SIZE + 2*i]));
+		ascii_print("%2.2f ",pixels[i]);
 	}
 	printf("%04X Y\r\n", crc_result);
+	profile_leave(stage);
+}
+
+/*
+ * Gives every sensor its own period: the VL53L5CX run on their INT lines,
+ * the AMG8833 on its frame period (and its INT line when the threshold
+ * interrupt is enabled), the MLX90640 status register is polled for a new
+ * subpage. Periods come from the configured sensor rates.
+ */
+void scheduler_init(){
+	const uint32_t tof_period = 1000000 / TOF_FREQUENCY_HZ;
+	const uint32_t amg_period = amg_period_us();
+	const uint32_t mlx_period = mlx_period_us();
+	sensor_task *task;
+
+	for(int s = 0; s < INTEGRATOR_SENSOR_COUNT; s++){
+		/* Slots without a sensor on this board are never read */
+		sensorTasks[s].id = 0;
+		sensorTasks[s].context = NULL;
+		sensorTasks[s].run = NULL;
+		sensorTasks[s].finish = NULL;
+	}
+
+	for(int t = 0; t < TOF_COUNT; t++){
+		if(!tofSensors[t].alive){
+			continue;
+		}
+		task = &sensorTasks[integrator_sensor_slot(tofSensors[t].id)];
+		task->id = tofSensors[t].id;
+		task->poll_us = tof_period;
+		task->context = &tofSensors[t];
+		task->run = start_VL53L5CX;
+		task->finish = get_result_VL53L5CX;
+	}
+
+	task = &sensorTasks[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)];
+	task->id = INTEGRATOR_ID_AMG8833;
+	task->poll_us = amg_period;
+	task->run = start_AMG8833;
+	task->finish = get_result_AMG8833;
+
+	task = &sensorTasks[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)];
+	task->id = INTEGRATOR_ID_MLX90640;
+	task->poll_us = mlx_period / MLX_POLLS_PER_SUBPAGE;
+	task->run = poll_MLX90640;
+	task->finish = finish_MLX90640;
+
+	for(int s = 0; s < INTEGRATOR_SENSOR_COUNT; s++){
+		sensorTasks[s].ready = 0;
+		sensorTasks[s].last_us = micros();
+		sensorTasks[s].transfer.state = I2C_TRANSFER_IDLE;
+	}
+}
+
+/* Sensors read in the given mode, see show_menu() */
+uint8_t mode_reads(char mode, char id){
+	switch(mode){
+	case 'A': return 1;
+	case 'B': return id == INTEGRATOR_ID_VL53L5CX_1;
+	case 'C': return id == INTEGRATOR_ID_VL53L5CX_2;
+	case 'D': return id == INTEGRATOR_ID_MLX90640;
+	case 'E': return id == INTEGRATOR_ID_AMG8833;
+	case 'F': return id != INTEGRATOR_ID_MLX90640;
+	case 'G': return id != INTEGRATOR_ID_AMG8833;
+	case 'H': return integrator_is_vl53l5cx(id);
+	case 'I': return id == INTEGRATOR_ID_MLX90640 || id == INTEGRATOR_ID_AMG8833;
+	default:  return 0;
+	}
+}
+
+/*
+ * Starts and stops the VL53L5CX ranging to match the selected mode, and
+ * restarts it when other output blocks were selected. A sensor with a frame
+ * read in flight is left alone until the frame is sent, the commands would
+ * reuse its buffer.
+ */
+void apply_mode(){
+	for(int t = 0; t < TOF_COUNT; t++){
+		tof_sensor *tof = &tofSensors[t];
+
+		if(!tof->alive || sensorTasks[integrator_sensor_slot(tof->id)].transfer.state != I2C_TRANSFER_IDLE)
+			continue;
+
+		uint8_t reads = mode_reads(flag, tof->id);
+		if(tof->outputs != tof->dev.outputs){
+			if(tof->ranging){
+				tof->status = vl53l5cx_stop_ranging(&tof->dev);
+				tof->ranging = 0;
+			}
+			/* Blocks the driver is built without are dropped, so the set is taken once */
+			vl53l5cx_set_outputs(&tof->dev, tof->outputs);
+			tof->outputs = tof->dev.outputs;
+		}
+		if(reads && !tof->ranging){
+			tof->status = vl53l5cx_start_ranging(&tof->dev);
+			tof->ranging = 1;
+		}
+		else if(!reads && tof->ranging){
+			tof->status = vl53l5cx_stop_ranging(&tof->dev);
+			tof->ranging = 0;
+		}
+	}
+}
+
+/*
+ * Runs every due sensor of the current mode once, then finishes the reads
+ * that completed. The reads of both buses are started before any result is
+ * encoded, so the buses stay busy while the CPU works. A finish() that
+ * converts a result marks INTEGRATOR_PIPE_CONVERT busy, it ends here.
+ * Returns 0 if there was nothing to do.
+ */
+uint8_t run_scheduler(){
+	uint8_t ran = 0;
+
+	for(int s = 0; s < INTEGRATOR_SENSOR_COUNT; s++){
+		sensor_task *task = &sensorTasks[s];
+		uint32_t now = micros();
+
+		if(task->run == NULL || task->transfer.state != I2C_TRANSFER_IDLE){
+			continue;
+		}
+		if(!mode_reads(flag, task->id)){
+			task->ready = 0;
+			task->last_us = now;
+			continue;
+		}
+		if(!task->ready && (now - task->last_us) < task->poll_us){
+			continue;
+		}
+		/* Clear first, an interrupt during the read schedules the next one */
+		task->ready = 0;
+		task->last_us = now;
+		task->run(task->context);
+		ran = 1;
+	}
+
+	for(int s = 0; s < INTEGRATOR_SENSOR_COUNT; s++){
+		sensor_task *task = &sensorTasks[s];
+
+		if(task->transfer.state == I2C_TRANSFER_IDLE || i2c_transfer_pending(&task->transfer)){
+			continue;
+		}
+		uint8_t done = (task->transfer.state == I2C_TRANSFER_DONE);
+		task->transfer.state = I2C_TRANSFER_IDLE;
+		if(done){
+			task->finish(task->context);
+			profile_pipe_idle(INTEGRATOR_PIPE_CONVERT);
+		}
+		ran = 1;
+	}
+	return ran;
+}
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	for(int t = 0; t < TOF_COUNT; t++){
+		if(tofSensors[t].int_pin == GPIO_Pin){
+			sensorTasks[integrator_sensor_slot(tofSensors[t].id)].ready = 1;
+			return;
+		}
+	}
+
+	switch(GPIO_Pin){
+	case AMG_INT_Pin:
+		sensorTasks[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)].ready = 1;
+		break;
+	default:
+		break;
+	}
 }
 
 void show_menu(){
@@ -321,6 +1672,18 @@ void show_menu(){
 	printf("E - Zbieranie danych z czujnika AMG8833\n");
 	printf("F - Zbieranie danych z czujnika AMG8833 oraz czujnikow odleglosci\n");
 	printf("G - Zbieranie danych z czujnika MLX90640 oraz czujnikow odleglosci\n");
+	printf("T - Ramki tekstowe (ASCII)\n");
+	printf("U - Ramki binarne\n");
+	printf("K - Ramki binarne kodowane roznicowo\n");
+	printf("Q - Opis czujnikow (ramka C)\n");
+	printf("M - Surowe ramki MLX90640 (ramki M i E), N - temperatury MLX90640\n");
+	printf("L - Temperatury MLX90640 po kazdej podstronie (ramki H)\n");
+	printf("Z<n> - Czestotliwosc odswiezania MLX90640, 0.5 * 2^n podstron/s\n");
+	printf("P<n> - Budzet cykli CPU co n s (ramki T), P0 wylacza\n");
+	printf("R - Surowe ramki AMG8833 (ramki A), S - temperatury AMG8833\n");
+	printf("O<flagi> - Czestotliwosc (bit 0: 1 kl./s) i srednia ruchoma (bit 1) AMG8833\n");
+	printf("V<n> - Zmiana predkosci transmisji (potwierdzenie: W)\n");
+	printf("J<czujnik><liczba ramek u16><flagi> - Seria pomiarowa liczona na MCU (ramki G)\n");
 }
 /* USER CODE END 0 */
 
@@ -356,44 +1719,54 @@ int main(void)
   MX_USART2_UART_Init();
   MX_I2C1_Init();
   MX_I2C2_Init();
+  MX_TIM2_Init();
   /* USER CODE BEGIN 2 */
-  printf("%04X \r\n", calculateCRC16(test, sizeof(test)));
-  HAL_UART_Receive_IT(&huart2, &Rx_data, 1);
+  profile_init();
+  uart_tx_init(&huart2);
+  i2c_bus_init(&hi2c1);
+  i2c_bus_init(&hi2c2);
+  codec_init();
+  series_init();
+  printf("%04X \r\n", integrator_crc16(&test, sizeof(test)));
+  integrator_command_init(&rxCommand);
+  uart_rx_init(&huart2);
+  /* Time since reset, TIM2 counts from here on */
+  bootStageStart = micros();
+  bootStageName[0] = "HAL";
+  bootStageUs[0] = HAL_GetTick() * 1000;
+  bootStageCount = 1;
+
+  /* The VL53L5CX firmware downloads run by DMA while the thermal sensors start */
+  tof_init_start();
+  boot_stage("VL53L5CX-start");
+
   printf("Inicjalizacja czujnika AMG8833...\n");
   amg88xxInit();
+  /* Through the queue, the VL53L5CX download owns the bus by DMA meanwhile */
+  uint8_t amgPctl;
+  amgPresent = (i2c_bus_transfer(&hi2c1, AMG88xx_ADDRESS << 1, AMG88xx_PCTL, I2C_MEMADD_SIZE_8BIT, &amgPctl, 1, 0) == HAL_OK);
   printf("Koniec inicjalizacji\n");
+  boot_stage("AMG8833");
 
   printf("Inicjalizacja czujnika MLX90640...\n");
-  Init_MLX90640_GPIO(hi2c1);
+  Init_MLX90640_GPIO(&hi2c1);
   MLX90640_SetRefreshRate(MLX90640_RATE_1HZ);
   MLX90640_SetResolution(MLX90640_RES16);
   MLX90640_SetPattern(MLX90640_CHESS);
   MLX90640_SetMode(MLX90640_DEFAULT);
   MLX90640_DumpEE(eeMLX90640);
   status3 = MLX90640_ExtractParameters(eeMLX90640, &mlx90640);
+  MLX90640_PrepareSolver(&mlx90640, &mlxSolver);
+  mlxRefreshRate = MLX90640_GetRefreshRate();
   printf("Koniec inicjalizacji\n");
+  boot_stage("MLX90640");
 
-  HAL_Delay(10);
+  tof_init_finish();
+  boot_stage("VL53L5CX");
 
-  Dev.platform.address = VL53L5CX_DEFAULT_I2C_ADDRESS;
-  status = vl53l5cx_is_alive(&Dev, &isAlive);
-  printf("Inicjalizacja pierwszego czujnika VL53L5CX...\n");
-  status = vl53l5cx_init(&Dev);
-  status = vl53l5cx_set_resolution(&Dev, VL53L5CX_RESOLUTION_8X8);
-  status = vl53l5cx_set_ranging_frequency_hz(&Dev, 1);
-  status = vl53l5cx_set_target_order(&Dev, VL53L5CX_TARGET_ORDER_CLOSEST);
-  status = vl53l5cx_set_ranging_mode(&Dev, VL53L5CX_RANGING_MODE_CONTINUOUS);
-  printf("Koniec inicjalizacji\n");
-
-  Dev2.platform.address = VL53L5CX_DEFAULT_I2C_ADDRESS;
-  status2 = vl53l5cx_is_alive2(&Dev2, &isAlive2);
-  printf("Inicjalizacja drugiego czujnika VL53L5CX...\n");
-  status2 = vl53l5cx_init2(&Dev2);
-  status2 = vl53l5cx_set_resolution2(&Dev2, VL53L5CX_RESOLUTION_8X8);
-  status2 = vl53l5cx_set_ranging_frequency_hz2(&Dev2, 1);
-  status2 = vl53l5cx_set_target_order2(&Dev2, VL53L5CX_TARGET_ORDER_CLOSEST);
-  status2 = vl53l5cx_set_ranging_mode2(&Dev2, VL53L5CX_RANGING_MODE_CONTINUOUS);
-  printf("Koniec inicjalizacji\n");
+  send_capabilities_frame();
+  scheduler_init();
+  print_boot_report();
 
   show_menu();
   printf("Wybierz opcje: \n");
@@ -406,111 +1779,27 @@ int main(void)
   /* USER CODE BEGIN WHILE */
   while (1)
   {
-	  switch(flag){
-	  case 'A':
-		  if (startVL1 == 0 || startVL2 == 0){
-			  status = vl53l5cx_start_ranging(&Dev);
-			  startVL1 = 1;
-			  status2 = vl53l5cx_start_ranging2(&Dev2);
-			  startVL2 = 1;
-		  }
-		  get_result_VL53L5CX1();
-		  get_result_VL53L5CX2();
-		  get_result_MLX90640();
-		  get_result_AMG8833();
-		  HAL_Delay(1000);
-		  break;
-	  case 'B':
-		  if (startVL1 == 0){
-			  status = vl53l5cx_start_ranging(&Dev);
-			  startVL1 = 1;
-			  status2 = vl53l5cx_stop_ranging2(&Dev2);
-			  startVL2 = 0;
-		  }
-		  get_result_VL53L5CX1();
-		  HAL_Delay(1000);
-		  break;
-	  case 'C':
-		  if (startVL2 == 0){
-			  status2 = vl53l5cx_start_ranging2(&Dev2);
-			  startVL2 = 1;
-			  status = vl53l5cx_stop_ranging(&Dev);
-			  startVL1 = 0;
-		  }
-		  get_result_VL53L5CX2();
-		  HAL_Delay(1000);
-		  break;
-	  case 'D':
-		  if (startVL1 == 1 || startVL2 == 1){
-			  status = vl53l5cx_stop_ranging(&Dev);
-			  startVL1 = 0;
-			  status2 = vl53l5cx_stop_ranging2(&Dev2);
-			  startVL2 = 0;
-		  }
-		  get_result_MLX90640();
-		  HAL_Delay(1000);
-		  break;
-	  case 'E':
-		  if (startVL1 == 1 || startVL2 == 1){
-			  status = vl53l5cx_stop_ranging(&Dev);
-			  startVL1 = 0;
-			  status2 = vl53l5cx_stop_ranging2(&Dev2);
-			  startVL2 = 0;
-		  }
-		  get_result_AMG8833();
-		  HAL_Delay(1000);
-		  break;
-	  case 'F':
-		  if (startVL1 == 0 || startVL2 == 0){
-			  status = vl53l5cx_start_ranging(&Dev);
-			  startVL1 = 1;
-			  status2 = vl53l5cx_start_ranging2(&Dev2);
-			  startVL2 = 1;
-		  }
-		  get_result_VL53L5CX1();
-		  get_result_VL53L5CX2();
-		  get_result_AMG8833();
-		  HAL_Delay(1000);
-		  break;
-	  case 'G':
-		  if (startVL1 == 0 || startVL2 == 0){
-			  status = vl53l5cx_start_ranging(&Dev);
-			  startVL1 = 1;
-			  status2 = vl53l5cx_start_ranging2(&Dev2);
-			  startVL2 = 1;
-		  }
-		  get_result_VL53L5CX1();
-		  get_result_VL53L5CX2();
-		  get_result_MLX90640();
-		  HAL_Delay(1000);
-		  break;
-		  /*ITS A NEW SECTON*/
-	  case 'H':
-		  if (startVL1 == 0 || startVL2 == 0){
-			  status = vl53l5cx_start_ranging(&Dev);
-			  startVL1 = 1;
-			  status2 = vl53l5cx_start_ranging2(&Dev2);
-			  startVL2 = 1;
-		  }
-		  get_result_VL53L5CX1();
-		  get_result_VL53L5CX2();
-		  HAL_Delay(1000);
-		  break;
-	  case 'I':
-		  if (startVL1 == 1 || startVL2 == 1){
-			  status = vl53l5cx_stop_ranging(&Dev);
-			  startVL1 = 0;
-			  status2 = vl53l5cx_stop_ranging2(&Dev2);
-			  startVL2 = 0;
-		  }
-		  get_result_MLX90640();
-		  get_result_AMG8833();
-		  HAL_Delay(1000);
-
-		  break;
-
-	  default:
-		  break;
+	  process_commands();
+	  if(mlxEepromRequest){
+		  mlxEepromRequest = 0;
+		  send_mlx_eeprom_frame();
+	  }
+	  process_amg_config();
+	  process_mlx_rate();
+	  process_series();
+	  process_profile();
+	  apply_mode();
+	  /* Before a baud rate switch, so the host gets it at the rate it sent the command at */
+	  send_command_ack();
+	  process_baud_request();
+	  uint8_t busy = run_scheduler();
+	  /* After the reads were started, so the buses work while the MLX90640 subpage is solved */
+	  busy |= process_mlx_frames();
+	  if(!busy){
+		  /* Nothing due; the next EXTI, I2C, UART or SysTick interrupt wakes the core */
+		  uint8_t stage = profile_enter(INTEGRATOR_STAGE_IDLE);
+		  __WFI();
+		  profile_leave(stage);
 	  }
     /* USER CODE END WHILE */
 
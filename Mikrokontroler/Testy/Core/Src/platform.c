@@ -61,44 +61,42 @@
 *******************************************************************************/
 
 #include "platform.h"
-
-extern I2C_HandleTypeDef 	hi2c1;
-extern I2C_HandleTypeDef 	hi2c2;
-
-uint8_t RdByte(
+#include "profile.h"
+
+/*
+ * All accesses go through the DMA queue of i2c_bus.c on the bus of the
+ * platform, so a frame read started with RdMultiAsync() on one bus runs while
+ * another bus is used.
+ */
+static uint8_t Transfer(
 		VL53L5CX_Platform *p_platform,
 		uint16_t RegisterAdress,
-		uint8_t *p_value)
+		uint8_t *p_values,
+		uint32_t size,
+		uint8_t write)
 {
 	uint8_t status = 0;
-	uint8_t data_write[2];
-	uint8_t data_read[1];
 
-	data_write[0] = (RegisterAdress >> 8) & 0xFF;
-	data_write[1] = RegisterAdress & 0xFF;
-	status = HAL_I2C_Master_Transmit(&hi2c1, p_platform->address, data_write, 2, 100);
-	status = HAL_I2C_Master_Receive(&hi2c1, p_platform->address, data_read, 1, 100);
-	*p_value = data_read[0];
+	/* A DMA transfer is limited to 65535 bytes */
+	while(size > 0)
+	{
+		uint16_t chunk = (size > 0x8000) ? 0x8000 : (uint16_t)size;
+		status |= i2c_bus_transfer(p_platform->hi2c, p_platform->address, RegisterAdress,
+				I2C_MEMADD_SIZE_16BIT, p_values, chunk, write);
+		RegisterAdress += chunk;
+		p_values += chunk;
+		size -= chunk;
+	}
 
 	return status;
 }
 
-uint8_t RdByte2(
+uint8_t RdByte(
 		VL53L5CX_Platform *p_platform,
 		uint16_t RegisterAdress,
 		uint8_t *p_value)
 {
-	uint8_t status = 0;
-	uint8_t data_write[2];
-	uint8_t data_read[1];
-
-	data_write[0] = (RegisterAdress >> 8) & 0xFF;
-	data_write[1] = RegisterAdress & 0xFF;
-	status = HAL_I2C_Master_Transmit(&hi2c2, p_platform->address, data_write, 2, 100);
-	status = HAL_I2C_Master_Receive(&hi2c2, p_platform->address, data_read, 1, 100);
-	*p_value = data_read[0];
-
-	return status;
+	return Transfer(p_platform, RegisterAdress, p_value, 1, 0);
 }
 
 uint8_t WrByte(
@@ -106,31 +104,7 @@ uint8_t WrByte(
 		uint16_t RegisterAdress,
 		uint8_t value)
 {
-	uint8_t data_write[3];
-	uint8_t status = 0;
-
-	data_write[0] = (RegisterAdress >> 8) & 0xFF;
-	data_write[1] = RegisterAdress & 0xFF;
-	data_write[2] = value & 0xFF;
-	status = HAL_I2C_Master_Transmit(&hi2c1,p_platform->address, data_write, 3, 100);
-
-	return status;
-}
-
-uint8_t WrByte2(
-		VL53L5CX_Platform *p_platform,
-		uint16_t RegisterAdress,
-		uint8_t value)
-{
-	uint8_t data_write[3];
-	uint8_t status = 0;
-
-	data_write[0] = (RegisterAdress >> 8) & 0xFF;
-	data_write[1] = RegisterAdress & 0xFF;
-	data_write[2] = value & 0xFF;
-	status = HAL_I2C_Master_Transmit(&hi2c2,p_platform->address, data_write, 3, 100);
-
-	return status;
+	return Transfer(p_platform, RegisterAdress, &value, 1, 1);
 }
 
 uint8_t WrMulti(
@@ -139,52 +113,53 @@ uint8_t WrMulti(
 		uint8_t *p_values,
 		uint32_t size)
 {
-	uint8_t status = HAL_I2C_Mem_Write(&hi2c1, p_platform->address, RegisterAdress,
-									I2C_MEMADD_SIZE_16BIT, p_values, size, 65535);
-	return status;
+	return Transfer(p_platform, RegisterAdress, p_values, size, 1);
 }
 
-uint8_t WrMulti2(
+uint8_t RdMulti(
 		VL53L5CX_Platform *p_platform,
 		uint16_t RegisterAdress,
 		uint8_t *p_values,
 		uint32_t size)
 {
-	uint8_t status = HAL_I2C_Mem_Write(&hi2c2, p_platform->address, RegisterAdress,
-									I2C_MEMADD_SIZE_16BIT, p_values, size, 65535);
-	return status;
+	return Transfer(p_platform, RegisterAdress, p_values, size, 0);
 }
 
-uint8_t RdMulti(
+uint8_t RdMultiAsync(
 		VL53L5CX_Platform *p_platform,
 		uint16_t RegisterAdress,
 		uint8_t *p_values,
-		uint32_t size)
+		uint16_t size,
+		i2c_transfer *p_transfer)
 {
-	uint8_t status;
-	uint8_t data_write[2];
-	data_write[0] = (RegisterAdress>>8) & 0xFF;
-	data_write[1] = RegisterAdress & 0xFF;
-	status = HAL_I2C_Master_Transmit(&hi2c1, p_platform->address, data_write, 2, 100);
-	status += HAL_I2C_Master_Receive(&hi2c1, p_platform->address, p_values, size, 100);
-
-	return status;
+	p_transfer->address = p_platform->address;
+	p_transfer->reg = RegisterAdress;
+	p_transfer->reg_size = I2C_MEMADD_SIZE_16BIT;
+	p_transfer->data = p_values;
+	p_transfer->size = size;
+	p_transfer->write = 0;
+	p_transfer->done = 0;
+
+	return i2c_bus_submit(p_platform->hi2c, p_transfer);
 }
 
-uint8_t RdMulti2(
+uint8_t WrMultiAsync(
 		VL53L5CX_Platform *p_platform,
 		uint16_t RegisterAdress,
 		uint8_t *p_values,
-		uint32_t size)
+		uint16_t size,
+		i2c_transfer *p_transfer,
+		void (*done)(i2c_transfer *p_transfer))
 {
-	uint8_t status;
-	uint8_t data_write[2];
-	data_write[0] = (RegisterAdress>>8) & 0xFF;
-	data_write[1] = RegisterAdress & 0xFF;
-	status = HAL_I2C_Master_Transmit(&hi2c2, p_platform->address, data_write, 2, 100);
-	status += HAL_I2C_Master_Receive(&hi2c2, p_platform->address, p_values, size, 100);
-
-	return status;
+	p_transfer->address = p_platform->address;
+	p_transfer->reg = RegisterAdress;
+	p_transfer->reg_size = I2C_MEMADD_SIZE_16BIT;
+	p_transfer->data = p_values;
+	p_transfer->size = size;
+	p_transfer->write = 1;
+	p_transfer->done = done;
+
+	return i2c_bus_submit(p_platform->hi2c, p_transfer);
 }
 
 uint8_t Reset_Sensor(VL53L5CX_Platform *p_platform)
@@ -227,6 +202,8 @@ uint8_t WaitMs(
 		VL53L5CX_Platform *p_platform,
                uint32_t TimeMs)
 {
+	uint8_t stage = profile_enter(INTEGRATOR_STAGE_DELAY);
 	HAL_Delay(TimeMs);
+	profile_leave(stage);
 	return 0;
 }
@@ -0,0 +1,12 @@
+#include "profile.h"
+
+integrator_profile cpu_profile;
+
+void profile_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DBGMCU->CR |= DBGMCU_CR_DBG_SLEEP;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	integrator_profile_init(&cpu_profile, DWT->CYCCNT);
+}
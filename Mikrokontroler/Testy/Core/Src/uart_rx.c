@@ -0,0 +1,63 @@
+#include "uart_rx.h"
+
+volatile uint32_t uart_rx_errors = 0;
+
+static UART_HandleTypeDef *rx_uart;
+static uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+static uint16_t rx_tail = 0;				/* Next byte to read */
+static volatile uint8_t rx_stopped = 0;		/* DMA stopped by a reception error */
+
+/* Next byte DMA writes; the counter reloads to the buffer size on the wrap */
+static uint16_t uart_rx_head(void)
+{
+	return (uint16_t)((UART_RX_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(rx_uart->hdmarx)) % UART_RX_BUFFER_SIZE);
+}
+
+/* Starts the reception, also after a baud rate change, which aborts it */
+void uart_rx_init(UART_HandleTypeDef *huart)
+{
+	rx_uart = huart;
+	rx_tail = 0;
+	rx_stopped = 0;
+	HAL_UART_Receive_DMA(huart, rx_buffer, UART_RX_BUFFER_SIZE);
+	__HAL_UART_CLEAR_IDLEFLAG(huart);
+	__HAL_UART_ENABLE_IT(huart, UART_IT_IDLE);
+}
+
+/* Copies up to size received bytes to data; returns the number copied */
+uint16_t uart_rx_read(uint8_t *data, uint16_t size)
+{
+	uint16_t head = uart_rx_head();
+	uint16_t n = 0;
+
+	while(n < size && rx_tail != head)
+	{
+		data[n++] = rx_buffer[rx_tail];
+		rx_tail = (rx_tail + 1) % UART_RX_BUFFER_SIZE;
+	}
+	if(n < size && rx_stopped)
+	{
+		uart_rx_errors++;
+		uart_rx_init(rx_uart);
+	}
+	return n;
+}
+
+/* Called from USART2_IRQHandler before the HAL, which does not clear the idle flag */
+void uart_rx_irq(UART_HandleTypeDef *huart)
+{
+	if(huart == rx_uart && __HAL_UART_GET_FLAG(huart, UART_FLAG_IDLE))
+	{
+		__HAL_UART_CLEAR_IDLEFLAG(huart);
+	}
+}
+
+/* Called from HAL_UART_ErrorCallback; in DMA mode the HAL aborts the reception on these */
+void uart_rx_error(UART_HandleTypeDef *huart)
+{
+	if(huart != rx_uart) return;
+	if(huart->ErrorCode & (HAL_UART_ERROR_ORE | HAL_UART_ERROR_NE | HAL_UART_ERROR_FE | HAL_UART_ERROR_PE))
+	{
+		rx_stopped = 1;
+	}
+}
@@ -0,0 +1,99 @@
+#include "uart_tx.h"
+#include "profile.h"
+#include <string.h>
+
+volatile uint32_t uart_tx_dropped = 0;
+
+static UART_HandleTypeDef *tx_uart;
+static uint8_t tx_buffer[2][UART_TX_BUFFER_SIZE];
+static volatile uint8_t tx_fill = 0;		/* Buffer being filled */
+static volatile uint16_t tx_fill_len = 0;	/* Bytes waiting in tx_buffer[tx_fill] */
+static volatile uint8_t tx_busy = 0;		/* DMA transfer in progress */
+
+/* Starts sending the filled buffer if DMA is free. Interrupts must be disabled. */
+static void uart_tx_start(void)
+{
+	if(tx_busy || tx_fill_len == 0) return;
+
+	uint8_t sending = tx_fill;
+	uint16_t len = tx_fill_len;
+	tx_fill ^= 1;
+	tx_fill_len = 0;
+	tx_busy = 1;
+
+	if(HAL_UART_Transmit_DMA(tx_uart, tx_buffer[sending], len) != HAL_OK)
+	{
+		tx_busy = 0;
+		uart_tx_dropped += len;
+		return;
+	}
+	profile_pipe_busy(INTEGRATOR_PIPE_UART);
+}
+
+void uart_tx_init(UART_HandleTypeDef *huart)
+{
+	tx_uart = huart;
+	tx_fill = 0;
+	tx_fill_len = 0;
+	tx_busy = 0;
+}
+
+/*
+ * Queues len bytes for transmission. In thread mode waits for a free buffer
+ * when both are taken; returns the number of bytes queued.
+ */
+uint16_t uart_tx_write(const void *data, uint16_t len)
+{
+	const uint8_t *src = (const uint8_t *)data;
+	uint8_t in_interrupt = __get_IPSR() != 0;
+	uint16_t written = 0;
+
+	while(written < len)
+	{
+		uint16_t n = len - written;
+		if(n > UART_TX_BUFFER_SIZE) n = UART_TX_BUFFER_SIZE;
+
+		/* Copy whole chunks only, so bytes written from interrupts never land inside them */
+		if(!in_interrupt && UART_TX_BUFFER_SIZE - tx_fill_len < n)
+		{
+			uint8_t stage = profile_enter(INTEGRATOR_STAGE_UART);
+			profile_pipe_wait(INTEGRATOR_PIPE_UART);
+			while(UART_TX_BUFFER_SIZE - tx_fill_len < n);
+			profile_leave(stage);
+		}
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		if(UART_TX_BUFFER_SIZE - tx_fill_len < n)
+		{
+			/* Only in an interrupt: the DMA interrupt cannot run to free a buffer */
+			profile_pipe_wait(INTEGRATOR_PIPE_UART);
+			__set_PRIMASK(primask);
+			uart_tx_dropped += len - written;
+			break;
+		}
+		memcpy(&tx_buffer[tx_fill][tx_fill_len], &src[written], n);
+		tx_fill_len += n;
+		written += n;
+		uart_tx_start();
+		__set_PRIMASK(primask);
+	}
+	return written;
+}
+
+/* Waits until all queued bytes have left the UART, e.g. before changing the baud rate */
+void uart_tx_wait_idle(void)
+{
+	uint8_t stage = profile_enter(INTEGRATOR_STAGE_UART);
+	while(tx_busy || tx_fill_len);
+	profile_leave(stage);
+}
+
+/* Called from HAL_UART_TxCpltCallback */
+void uart_tx_complete(UART_HandleTypeDef *huart)
+{
+	if(huart != tx_uart) return;
+	profile_pipe_idle(INTEGRATOR_PIPE_UART);
+	tx_busy = 0;
+	uart_tx_start();
+}
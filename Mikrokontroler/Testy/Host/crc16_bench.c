@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * @file    crc16_bench.c
+  * @brief   Throughput of the table-driven CRC16 against the bit-by-bit loop.
+  ******************************************************************************
+  * Both implementations run over a buffer the size of the largest frame
+  * payload (INTEGRATOR_MAX_PAYLOAD). The bit-by-bit loop is the ComputeCRC16
+  * function the firmware used before integrator_crc16.h.
+  *
+  *   make crc16_bench && ./crc16_bench [iterations]
+  ******************************************************************************
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "integrator_protocol.h"
+#include "integrator_crc16.h"
+
+static unsigned short int ComputeCRC16(const char* pData, int Length, unsigned int Poly, unsigned short int InitVal) {
+    unsigned short int ResCRC = InitVal;
+
+    while (--Length >= 0) {
+        ResCRC ^= *pData++ << 8;
+        for (short int i = 0; i < 8; ++i) {
+            ResCRC = ResCRC & 0x8000 ? (ResCRC << 1) ^ Poly : ResCRC << 1;
+        }
+    }
+    return ResCRC & 0xFFFF;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t payload[INTEGRATOR_MAX_PAYLOAD];
+	long iterations = argc > 1 ? atol(argv[1]) : 20000;
+	volatile uint16_t sink = 0;
+	double t0, bitwise_s, table_s, mbytes;
+
+	srand(1);
+	for (int i = 0; i < INTEGRATOR_MAX_PAYLOAD; i++)
+		payload[i] = (uint8_t)rand();
+
+	if (ComputeCRC16((const char *)payload, sizeof(payload), INTEGRATOR_CRC16_POLYNOMIAL, INTEGRATOR_CRC16_INIT)
+			!= integrator_crc16(payload, sizeof(payload)))
+	{
+		printf("Blad: wyniki CRC sie roznia\n");
+		return 1;
+	}
+
+	t0 = now_s();
+	for (long n = 0; n < iterations; n++)
+	{
+		payload[0] = (uint8_t)n;
+		sink ^= ComputeCRC16((const char *)payload, sizeof(payload), INTEGRATOR_CRC16_POLYNOMIAL, INTEGRATOR_CRC16_INIT);
+	}
+	bitwise_s = now_s() - t0;
+
+	t0 = now_s();
+	for (long n = 0; n < iterations; n++)
+	{
+		payload[0] = (uint8_t)n;
+		sink ^= integrator_crc16(payload, sizeof(payload));
+	}
+	table_s = now_s() - t0;
+
+	mbytes = (double)iterations * sizeof(payload) / 1e6;
+	printf("payload %d B, %ld iterations\n", INTEGRATOR_MAX_PAYLOAD, iterations);
+	printf("bit-by-bit : %8.1f MB/s\n", mbytes / bitwise_s);
+	printf("table      : %8.1f MB/s (x%.1f)\n", mbytes / table_s, bitwise_s / table_s);
+	return 0;
+}
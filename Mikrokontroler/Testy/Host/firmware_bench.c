@@ -0,0 +1,954 @@
+/**
+  ******************************************************************************
+  * @file    firmware_bench.c
+  * @brief   Runs the firmware on the PC against a stub HAL and sensor models.
+  ******************************************************************************
+  * main.c (with main() renamed to firmware_main()), i2c_bus.c, uart_tx.c,
+  * platform.c and the sensor drivers are compiled unchanged and linked with
+  * hal/hal_stub.c and hal/sensor_models.c. Time is virtual and only passes
+  * while the firmware sleeps, so a run is deterministic and its timings are
+  * those of the buses and the sensors, not of the PC.
+  *
+  * After the boot every output format runs for --seconds of virtual time in
+  * mode A (all sensors):
+  *   T   ASCII frames
+  *   U   binary frames
+  *   K   coded binary frames
+  *   MR  still coded, MLX90640 and AMG8833 as raw frames; the next subpage
+  *       comes in halfway through two of the MLX90640 RAM reads, which have
+  *       to be read again
+  *   NS  the thermal sensors back to coded temperatures without another K:
+  *       the raw frames used up sequence numbers of their slots, so the
+  *       coders have to restart instead of sending deltas the host drops
+  *   UMR binary frames, MLX90640 as raw frames with the EEPROM frame, AMG8833
+  *       as raw pixel registers, again with two subpages during a read
+  *   UNS binary frames and a series on the MCU (INTEGRATOR_CMD_SERIES) of the
+  *       first VL53L5CX, whose frames are still sent, and of the thermal
+  *       sensors, whose frames are held back
+  *   ULZ3 binary frames, MLX90640 as one frame per subpage at 4 subpages per
+  *       second (INTEGRATOR_CMD_MLX_RATE)
+  *   UNP1 binary frames and the cycle budget every second
+  *       (INTEGRATOR_CMD_PROFILE), whose stages have to add up to the window;
+  *       the budget and the occupancy of the pipeline stages (both buses,
+  *       the conversion and the UART), none busier than the window, are
+  *       printed with the phase
+  *   UY  binary frames, VL53L5CX reading the distances only
+  *       (INTEGRATOR_CMD_VL_OUTPUTS with no flags); the I2C read of every
+  *       frame has to be shorter than in the other phases
+  *   UX  binary frames, the first VL53L5CX with all its fields
+  *       (INTEGRATOR_CMD_TOF_FIELDS): both targets, status, sigma and signal
+  *       have to be those of the model, the second one stays on distances
+  * The ASCII phase sends its commands as bare bytes, the others in command
+  * frames (integrator_command.h), each of which has to be acknowledged.
+  * Before the boot the parser is fed a binary frame right after each echoed
+  * command letter that is also a sensor id, which must not cost the frame,
+  * and uncoded frames longer than the grid of their sensor, which it has to
+  * drop.
+  * The UART output is decoded by the FrameParser of the application. A phase
+  * fails on CRC errors, lost coded frames, fewer frames than the sensor rates
+  * give, or values that are not the ones the models had in their registers.
+  *
+  * The PC CPU time of the firmware (without the models) is reported per phase:
+  * not the MCU time, but it shows what a firmware change costs. Then the hot
+  * paths are timed in a loop: VL53L5CX frame decoding, the MLX90640 solver and
+  * building a binary and a coded frame.
+  *
+  *   make firmware_bench && ./firmware_bench [--seconds N] [--capture FILE]
+  *
+  * A capture is in the format of EX --replay.
+  ******************************************************************************
+  */
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hal_stub.h"
+#include "sensor_models.h"
+#include "firmware_check.h"
+#include "integrator_protocol.h"
+#include "integrator_series.h"
+#include "integrator_profile.h"
+#include "integrator_command.h"
+#include "integrator_tof.h"
+#include "MLX90640_I2C_Driver.h"
+#include "MLX90640_Solver.h"
+#include "vl53l5cx_api.h"
+#include "uart_tx.h"
+#include "i2c_bus.h"
+#include "main.h"
+#include "i2c.h"
+#include "usart.h"
+
+#define PHASE_COUNT			11
+#define TOF_DEADBAND_MM		5
+/* Frames whose values are looked up among the last ones of the model */
+#define MODEL_HISTORY		3
+#define VL_COUNT			2
+/* VL53L5CX frames kept to check the statistics of its series */
+#define TOF_HISTORY			16
+
+/* From main.c */
+int firmware_main(void);
+int _write(int file, char *ptr, int len);
+void send_binary_frame(uint8_t id, uint16_t payload_len, uint32_t timestamp);
+extern uint8_t codedFormat;
+extern uint8_t txFrame[];
+extern mlx90640Solver mlxSolver;
+
+typedef struct
+{
+	const char *commands;	/* Sent before mode A */
+	const char *name;
+	uint8_t series;			/* Starts the series of series_sensors[] */
+	uint32_t frames[INTEGRATOR_SENSOR_COUNT];
+	uint32_t bad_values[INTEGRATOR_SENSOR_COUNT];
+	uint32_t eeprom_frames;
+	uint64_t uart_bytes;
+	uint64_t i2c_bytes[2];
+	uint32_t vl_read_size;	/* Bytes of a VL53L5CX frame read, set by the firmware */
+	uint64_t cpu_ns;
+	uint64_t model_ns;
+	firmware_check_stats stats;
+	uint32_t profile_frames;
+	uint32_t profile_bad;
+	uint64_t profile_cycles[INTEGRATOR_PROFILE_STAGES];
+	uint64_t profile_total;
+	uint64_t pipe_cycles[INTEGRATOR_PIPE_STAGES];
+	uint32_t pipe_waits[INTEGRATOR_PIPE_STAGES];
+	uint32_t commands_sent;	/* Command frames */
+	uint32_t acks;
+	uint32_t acks_bad;
+	uint32_t ack_rtt_max_us;
+	uint32_t tof_field_frames;	/* INTEGRATOR_ID_VL53L5CX_FIELDS */
+} phase;
+
+static phase phases[PHASE_COUNT] = {
+	{ "T",  "ASCII" },
+	{ "U",  "binarne" },
+	{ "K",  "kodowane" },
+	{ "MR", "kodowane, surowe MLX90640 i AMG8833" },
+	{ "NS", "kodowane po surowych" },
+	{ "UMR", "surowe MLX90640 i AMG8833" },
+	{ "UNS", "seria na MCU", 1 },
+	{ "ULZ3", "podstrony MLX90640" },
+	{ "UNP1", "budzet cykli CPU" },
+	{ "UY", "tylko odleglosci VL53L5CX" },
+	{ "UX", "pola VL53L5CX" },
+};
+
+/* Series of the last phase: the VL53L5CX with its frames, the others without */
+typedef struct
+{
+	char id;
+	uint8_t flags;
+	uint16_t frames;		/* Requested */
+	uint16_t zones;			/* Zones of the summary received so far */
+	uint16_t total;			/* Zones of the sensor as reported by the summary */
+	uint16_t reported;		/* Frames as reported by the summary */
+	uint32_t bad;
+} series_check;
+
+static series_check seriesChecks[] = {
+	{ INTEGRATOR_ID_VL53L5CX_1, INTEGRATOR_SERIES_FRAMES },
+	{ INTEGRATOR_ID_AMG8833, 0 },
+	{ INTEGRATOR_ID_MLX90640, 0 },
+};
+#define SERIES_COUNT ((int)(sizeof(seriesChecks) / sizeof(seriesChecks[0])))
+
+static int16_t tofHistory[TOF_HISTORY][64];
+static uint32_t tofHistoryCount;
+
+static vl53l5cx_model vlModels[VL_COUNT];
+static amg8833_model amgModel;
+static mlx90640_model mlxModel;
+
+static uint32_t seconds = 5;
+static FILE *report;
+static FILE *capture;
+static jmp_buf stop;
+static int current = -1;			/* Phase, -1 during the boot */
+static uint64_t boot_us;
+static uint64_t phase_start_cpu_ns, phase_start_model_ns;
+static uint64_t phase_start_i2c[2];
+static firmware_check_stats phase_start_stats;
+static uint16_t commandSequence;
+static int codedOutput;			/* The current phase runs in coded frames */
+static uint16_t ackSequence;		/* Sequence number the next acknowledgement has to carry */
+
+/* Firmware output --------------------------------------------------------------*/
+static ssize_t firmware_stdout_write(void *cookie, const char *buf, size_t size)
+{
+	(void)cookie;
+	return _write(1, (char *)buf, (int)size);
+}
+
+static void put_le(uint8_t *dst, uint64_t value, int size)
+{
+	for(int i = 0; i < size; i++) dst[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void uart_sink(const uint8_t *data, uint16_t size, uint64_t time_us)
+{
+	if(capture)
+	{
+		uint8_t record[13];
+		record[0] = 0;
+		put_le(&record[1], time_us, 8);
+		put_le(&record[9], size, 4);
+		fwrite(record, 1, sizeof(record), capture);
+		fwrite(data, 1, size, capture);
+	}
+	if(current >= 0) phases[current].uart_bytes += size;
+	firmware_check_feed(data, size, time_us);
+}
+
+/* Phases ------------------------------------------------------------------------*/
+static void close_phase(void)
+{
+	phase *p;
+
+	if(current < 0) return;
+	p = &phases[current];
+	p->cpu_ns = hal_stub_cpu_ns() - phase_start_cpu_ns;
+	p->model_ns = hal_stub_model_ns() - phase_start_model_ns;
+	for(int b = 0; b < 2; b++) p->i2c_bytes[b] = hal_stub_i2c_bytes[b] - phase_start_i2c[b];
+	p->vl_read_size = vlModels[0].frame_size;
+
+	firmware_check_stats stats = firmware_check_get_stats();
+	p->stats.frames = stats.frames - phase_start_stats.frames;
+	p->stats.crc_errors = stats.crc_errors - phase_start_stats.crc_errors;
+	p->stats.resyncs = stats.resyncs - phase_start_stats.resyncs;
+	p->stats.codec_gaps = stats.codec_gaps - phase_start_stats.codec_gaps;
+}
+
+/* Sends commands in a command frame stamped with the virtual time */
+static void send_command_frame(const uint8_t *commands, uint16_t len)
+{
+	uint8_t frame[INTEGRATOR_COMMAND_MAX_FRAME];
+
+	integrator_put_header(frame, INTEGRATOR_ID_COMMAND, len, commandSequence++, (uint32_t)hal_stub_now_us());
+	memcpy(&frame[INTEGRATOR_HEADER_SIZE], commands, len);
+	uint16_t size = integrator_put_crc(frame, len);
+	for(uint16_t i = 0; i < size; i++) hal_stub_uart_receive(frame[i]);
+	phases[current].commands_sent++;
+}
+
+static void open_phase(void *arg)
+{
+	close_phase();
+	current = (int)(intptr_t)arg;
+	phase_start_cpu_ns = hal_stub_cpu_ns();
+	phase_start_model_ns = hal_stub_model_ns();
+	for(int b = 0; b < 2; b++) phase_start_i2c[b] = hal_stub_i2c_bytes[b];
+	phase_start_stats = firmware_check_get_stats();
+
+	const char *commands = phases[current].commands;
+	uint8_t command[INTEGRATOR_COMMAND_MAX_PAYLOAD];
+	uint16_t len = 0;
+	/* A phase without a format letter keeps the one of the phase before */
+	if(strchr(commands, INTEGRATOR_CMD_FORMAT_CODED)) codedOutput = 1;
+	else if(strchr(commands, INTEGRATOR_CMD_FORMAT_ASCII) || strchr(commands, INTEGRATOR_CMD_FORMAT_BINARY)) codedOutput = 0;
+	/* Raw frames are compared word for word: a subpage mixed with the next one fails */
+	if(strchr(commands, INTEGRATOR_CMD_MLX_RAW)) mlxModel.collisions = 2;
+	if(commands[0] == INTEGRATOR_CMD_FORMAT_ASCII)
+	{
+		for(const char *c = commands; *c; c++) hal_stub_uart_receive((uint8_t)*c);
+		hal_stub_uart_receive('A');
+	}
+	else
+	{
+		for(const char *c = commands; *c; c++)
+		{
+			command[len++] = (uint8_t)*c;
+			/* No INTEGRATOR_VL_OUTPUT_* flags: the distances only */
+			if(*c == INTEGRATOR_CMD_VL_OUTPUTS) command[len++] = 0;
+			/* Every field of the first VL53L5CX */
+			if(*c == INTEGRATOR_CMD_TOF_FIELDS)
+			{
+				command[len++] = INTEGRATOR_ID_VL53L5CX_1;
+				command[len++] = INTEGRATOR_TOF_FIELDS_ALL;
+			}
+		}
+		command[len++] = 'A';
+		send_command_frame(command, len);
+	}
+
+	if(!phases[current].series) return;
+	/* Leaves a second at the end for the summaries */
+	seriesChecks[0].frames = seconds - 2;
+	seriesChecks[1].frames = 10 * (seconds - 2);
+	/* An MLX90640 frame is two subpages */
+	seriesChecks[2].frames = (seconds - 2) / 2 ? (seconds - 2) / 2 : 1;
+	for(int s = 0; s < SERIES_COUNT; s++)
+	{
+		command[0] = INTEGRATOR_CMD_SERIES;
+		command[1] = (uint8_t)seriesChecks[s].id;
+		integrator_put_u16(&command[2], seriesChecks[s].frames);
+		command[4] = seriesChecks[s].flags;
+		send_command_frame(command, 1 + INTEGRATOR_CMD_SERIES_ARGS);
+	}
+}
+
+/* Checks of the received frames -------------------------------------------------*/
+static int check_vl(const vl53l5cx_model *model, const firmware_check_frame *frame)
+{
+	int tolerance = codedOutput ? TOF_DEADBAND_MM : 0;
+
+	if(frame->count != 64) return 0;
+	for(uint32_t back = 1; back <= MODEL_HISTORY && back <= model->frames; back++)
+	{
+		uint32_t k = model->frames - back;
+		int z = 0;
+		while(z < 64 && fabsf(frame->values[z] - vl53l5cx_model_distance(model, k, z)) <= tolerance) z++;
+		if(z == 64) return 1;
+	}
+	return 0;
+}
+
+/* Both targets of every zone and their fields, as the model had them in one of its last frames */
+static int check_vl_fields(const vl53l5cx_model *model, const firmware_check_frame *frame)
+{
+	if(frame->tof_fields != INTEGRATOR_TOF_FIELDS_ALL || frame->tof_targets != VL53L5CX_NB_TARGET_PER_ZONE
+			|| frame->count != 64) return 0;
+	for(int z = 0; z < 64; z++)
+	{
+		if(frame->tof_detected[z] != vl53l5cx_model_targets(z)) return 0;
+		for(int t = 0; t < frame->tof_targets; t++)
+		{
+			const int v = t * frame->tof_stride + z;
+			const uint8_t status = t < vl53l5cx_model_targets(z) ? vl53l5cx_model_status(z, t) : INTEGRATOR_TOF_STATUS_NONE;
+			if(frame->tof_status[v] != status || frame->tof_sigma[v] != vl53l5cx_model_sigma(z, t)
+					|| frame->tof_signal[v] != vl53l5cx_model_signal(z, t)) return 0;
+		}
+	}
+	for(uint32_t back = 1; back <= MODEL_HISTORY && back <= model->frames; back++)
+	{
+		uint32_t k = model->frames - back;
+		int v = 0;
+		while(v < frame->tof_targets * 64
+				&& frame->tof_distance[(v / 64) * frame->tof_stride + v % 64]
+				== vl53l5cx_model_target_distance(model, k, v % 64, v / 64)) v++;
+		if(v == frame->tof_targets * 64) return 1;
+	}
+	return 0;
+}
+
+static int check_amg(const firmware_check_frame *frame)
+{
+	if(frame->count != 64) return 0;
+	for(uint32_t back = 1; back <= MODEL_HISTORY && back <= amgModel.frames; back++)
+	{
+		uint32_t k = amgModel.frames - back;
+		int p = 0;
+		while(p < 64 && fabsf(frame->values[p] - amg8833_model_pixel(k, p) * 0.25f) < 0.006f) p++;
+		if(p == 64) return 1;
+	}
+	return 0;
+}
+
+static int check_mlx(const firmware_check_frame *frame)
+{
+	if(frame->count != 768) return 0;
+	for(int i = 0; i < 768; i++)
+	{
+		if(!(frame->values[i] > -60.0f && frame->values[i] < 400.0f)) return 0;
+	}
+	return 1;
+}
+
+static void on_frame(const firmware_check_frame *frame)
+{
+	uint8_t slot = integrator_sensor_slot((uint8_t)frame->sensor);
+	int good;
+
+	if(current < 0 || slot >= INTEGRATOR_SENSOR_COUNT) return;
+	switch(frame->sensor)
+	{
+	case INTEGRATOR_ID_VL53L5CX_1: good = check_vl(&vlModels[0], frame); break;
+	case INTEGRATOR_ID_VL53L5CX_2: good = check_vl(&vlModels[1], frame); break;
+	case INTEGRATOR_ID_AMG8833:    good = check_amg(frame); break;
+	case INTEGRATOR_ID_MLX90640:   good = check_mlx(frame); break;
+	default:                       good = 0; break;
+	}
+	if(frame->tof_fields)
+	{
+		phases[current].tof_field_frames++;
+		good = good && frame->sensor == INTEGRATOR_ID_VL53L5CX_1 && check_vl_fields(&vlModels[0], frame);
+	}
+	phases[current].frames[slot]++;
+	if(!good) phases[current].bad_values[slot]++;
+
+	if(frame->sensor == INTEGRATOR_ID_VL53L5CX_1 && frame->count == 64)
+	{
+		for(int z = 0; z < 64; z++) tofHistory[tofHistoryCount % TOF_HISTORY][z] = (int16_t)frame->values[z];
+		tofHistoryCount++;
+	}
+}
+
+/* Pixel registers of one of the last AMG8833 frames, converted as on the host */
+static int check_amg_raw(const uint8_t *payload, int length)
+{
+	if(length != 2 * INTEGRATOR_AMG8833_VALUES) return 0;
+	for(uint32_t back = 1; back <= MODEL_HISTORY && back <= amgModel.frames; back++)
+	{
+		uint32_t k = amgModel.frames - back;
+		int p = 0;
+		while(p < 64 && integrator_amg8833_raw_to_wire(integrator_get_u16(&payload[2*p]))
+				== amg8833_model_pixel(k, p) * (INTEGRATOR_TEMP_SCALE / 4)) p++;
+		if(p == 64) return 1;
+	}
+	return 0;
+}
+
+/* Half of the pixels, of the subpage the model had in RAM and in its pattern */
+static int check_mlx_subpage(const uint8_t *payload, int length)
+{
+	const uint16_t ctrl = mlxModel.words[MLX90640_CTRL_REG1];
+	const uint8_t chess = (ctrl & 0x1000) ? INTEGRATOR_MLX90640_CHESS : 0;
+
+	if(length != INTEGRATOR_MLX90640_SUBPAGE_HEADER + 2 * INTEGRATOR_MLX90640_SUBPAGE_VALUES) return 0;
+	if(payload[0] != mlxModel.subpage || payload[1] != chess) return 0;
+	for(int i = 0; i < INTEGRATOR_MLX90640_SUBPAGE_VALUES; i++)
+	{
+		float value = integrator_wire_to_temp(integrator_get_i16(&payload[INTEGRATOR_MLX90640_SUBPAGE_HEADER + 2*i]));
+		if(!(value > -60.0f && value < 400.0f)) return 0;
+	}
+	return 1;
+}
+
+static void on_raw(char id, uint16_t sequence, const uint8_t *payload, int length)
+{
+	uint8_t slot = integrator_sensor_slot(INTEGRATOR_ID_MLX90640);
+	int good = 0;
+
+	(void)sequence;
+	if(current < 0) return;
+	if(id == INTEGRATOR_ID_AMG8833_RAW)
+	{
+		slot = integrator_sensor_slot(INTEGRATOR_ID_AMG8833);
+		good = check_amg_raw(payload, length);
+	}
+	else if(id == INTEGRATOR_ID_MLX90640_SUBPAGE)
+	{
+		good = check_mlx_subpage(payload, length);
+	}
+	else if(length == 2 * INTEGRATOR_MLX90640_RAW_WORDS)
+	{
+		for(uint32_t back = 1; back <= MODEL_HISTORY && back <= mlxModel.frames && !good; back++)
+		{
+			const uint16_t *image = mlx90640_model_image(&mlxModel, mlxModel.frames - back);
+			int w = 0;
+			while(w < 832 && integrator_get_u16(&payload[2*w]) == image[w]) w++;
+			good = w == 832
+					&& integrator_get_u16(&payload[2*832]) == mlxModel.words[MLX90640_CTRL_REG1]
+					&& integrator_get_u16(&payload[2*833]) == (image[833] & 1);
+		}
+	}
+	phases[current].frames[slot]++;
+	if(!good) phases[current].bad_values[slot]++;
+}
+
+/*
+ * The VL53L5CX frames of its series were all sent, the last ones before the
+ * summary, so its statistics are recomputed from them. The thermal frames are
+ * held back; their statistics have to stay within the model values.
+ */
+static int check_series_zone(const series_check *check, uint16_t frames, uint16_t zone, int16_t min, int16_t max,
+		float mean, float variance)
+{
+	if(min > max || mean < min - 0.01f || mean > max + 0.01f) return 0;
+	/* Popoviciu: the variance is at most a quarter of the squared range */
+	if(variance > (max - min) * (max - min) / 4.0f + 0.01f) return 0;
+
+	if(check->id == INTEGRATOR_ID_VL53L5CX_1)
+	{
+		double sum = 0, squares = 0;
+		int lo = INT16_MAX, hi = INT16_MIN;
+
+		if(frames > tofHistoryCount || frames > TOF_HISTORY) return 0;
+		for(uint32_t f = tofHistoryCount - frames; f < tofHistoryCount; f++)
+		{
+			int value = tofHistory[f % TOF_HISTORY][zone];
+			sum += value;
+			if(value < lo) lo = value;
+			if(value > hi) hi = value;
+		}
+		double m = sum / frames;
+		for(uint32_t f = tofHistoryCount - frames; f < tofHistoryCount; f++)
+		{
+			double d = tofHistory[f % TOF_HISTORY][zone] - m;
+			squares += d * d;
+		}
+		return min == lo && max == hi && fabs(mean - m) < 0.01 && fabs(variance - squares / frames) < 0.01 + 1e-4 * squares / frames;
+	}
+	if(check->id == INTEGRATOR_ID_AMG8833)
+	{
+		/* Quarter degrees to hundredths */
+		return min >= amg8833_model_pixel(0, zone) * 25 && max <= amg8833_model_pixel(3, zone) * 25;
+	}
+	return min > -5000 && max < 40000;
+}
+
+static void on_series(const uint8_t *payload, int length)
+{
+	series_check *check = NULL;
+
+	if(length < INTEGRATOR_SERIES_HEADER_SIZE) return;
+	for(int s = 0; s < SERIES_COUNT; s++)
+	{
+		if(seriesChecks[s].id == (char)payload[0]) check = &seriesChecks[s];
+	}
+	if(!check) return;
+
+	uint16_t frames = integrator_get_u16(&payload[2]);
+	uint16_t first = integrator_get_u16(&payload[10]);
+	uint16_t zones = integrator_get_u16(&payload[12]);
+	check->reported = frames;
+	check->total = integrator_get_u16(&payload[8]);
+	if(payload[1] != INTEGRATOR_SERIES_DONE || first != check->zones
+			|| length != INTEGRATOR_SERIES_HEADER_SIZE + zones * INTEGRATOR_SERIES_ZONE_SIZE)
+	{
+		check->bad++;
+		return;
+	}
+	/* Whole MLX90640 frames, two subpage periods of a second apart */
+	if(check->id == INTEGRATOR_ID_MLX90640 && frames > 1
+			&& integrator_get_u32(&payload[4]) < 2000000u * (frames - 1) - 100000u)
+	{
+		check->bad++;
+	}
+	for(uint16_t k = 0; k < zones; k++)
+	{
+		int16_t min, max;
+		float mean, variance;
+		integrator_series_get_zone(payload, k, &min, &max, &mean, &variance);
+		if(!check_series_zone(check, frames, first + k, min, max, mean, variance)) check->bad++;
+	}
+	check->zones += zones;
+}
+
+/* The stages add up to the window, which lasts the requested second of TIM2 */
+static void on_profile(const uint8_t *payload, int length)
+{
+	phase *p = &phases[current];
+	const uint32_t core_hz = HAL_RCC_GetHCLKFreq();
+	int good = length == INTEGRATOR_PROFILE_SIZE && payload[12] == INTEGRATOR_PROFILE_STAGES
+			&& integrator_get_u32(&payload[0]) == core_hz;
+
+	if(good)
+	{
+		const uint32_t window_us = integrator_get_u32(&payload[4]);
+		const uint32_t window = integrator_get_u32(&payload[8]);
+		uint32_t sum = 0;
+
+		for(uint8_t k = 0; k < INTEGRATOR_PROFILE_STAGES; k++)
+		{
+			uint32_t cycles;
+			uint16_t entries;
+			integrator_profile_get_stage(payload, k, &cycles, &entries);
+			sum += cycles;
+			p->profile_cycles[k] += cycles;
+		}
+		p->profile_total += window;
+		/* The stub counter also runs while the firmware works and virtual time stands still */
+		good = sum == window && window_us >= 1000000 && window_us < 1050000
+				&& window >= (uint64_t)window_us * (core_hz / 1000000);
+
+		/* Every sensor is read, converted and sent in every window */
+		good = good && integrator_profile_pipe_stages(payload, (uint16_t)length) == INTEGRATOR_PIPE_STAGES;
+		for(uint8_t m = 0; good && m < INTEGRATOR_PIPE_STAGES; m++)
+		{
+			uint32_t cycles;
+			uint16_t items, waits;
+			integrator_profile_get_pipe(payload, m, &cycles, &items, &waits);
+			p->pipe_cycles[m] += cycles;
+			p->pipe_waits[m] += waits;
+			good = cycles > 0 && cycles <= window && items > 0;
+		}
+	}
+	p->profile_frames++;
+	if(!good) p->profile_bad++;
+}
+
+/* Acknowledgements come in the order of the command frames */
+static void on_ack(const uint8_t *payload, int length)
+{
+	phase *p = &phases[current];
+	int good = length == INTEGRATOR_ACK_SIZE && integrator_get_u16(&payload[0]) == ackSequence
+			&& payload[2] == INTEGRATOR_ACK_OK && payload[3] > 0;
+
+	if(length == INTEGRATOR_ACK_SIZE)
+	{
+		uint32_t rtt = (uint32_t)hal_stub_now_us() - integrator_get_u32(&payload[4]);
+		if(rtt > p->ack_rtt_max_us) p->ack_rtt_max_us = rtt;
+	}
+	ackSequence++;
+	p->acks++;
+	if(!good) p->acks_bad++;
+}
+
+static void on_control(char id, const uint8_t *payload, int length)
+{
+	if(id == INTEGRATOR_ID_SERIES && current >= 0)
+	{
+		on_series(payload, length);
+		return;
+	}
+	if(id == INTEGRATOR_ID_PROFILE && current >= 0)
+	{
+		on_profile(payload, length);
+		return;
+	}
+	if(id == INTEGRATOR_ID_ACK && current >= 0)
+	{
+		on_ack(payload, length);
+		return;
+	}
+
+	if(id == INTEGRATOR_ID_CAPABILITIES && current < 0 && boot_us == 0)
+	{
+		/* Sent once the sensors are initialised: the phases start from here */
+		boot_us = hal_stub_now_us();
+		for(int p = 0; p < PHASE_COUNT; p++)
+		{
+			hal_stub_schedule(boot_us + (uint64_t)p * seconds * 1000000, open_phase, (void *)(intptr_t)p, 0);
+		}
+		hal_stub_stop_at(boot_us + (uint64_t)PHASE_COUNT * seconds * 1000000, &stop);
+	}
+	else if(id == INTEGRATOR_ID_MLX90640_EEPROM && current >= 0)
+	{
+		int good = length == 2 * INTEGRATOR_MLX90640_EEPROM_WORDS;
+		for(int w = 0; good && w < INTEGRATOR_MLX90640_EEPROM_WORDS; w++)
+		{
+			good = integrator_get_u16(&payload[2*w]) == mlxModel.words[MLX90640_EE + w];
+		}
+		phases[current].eeprom_frames++;
+		if(!good) phases[current].bad_values[integrator_sensor_slot(INTEGRATOR_ID_MLX90640)]++;
+	}
+}
+
+/* Fails the phase if a sensor sent less than expected or anything was wrong */
+static int report_phase(const phase *p)
+{
+	static const char ids[] = { INTEGRATOR_ID_VL53L5CX_1, INTEGRATOR_ID_VL53L5CX_2, INTEGRATOR_ID_AMG8833, INTEGRATOR_ID_MLX90640 };
+	/* Sensor rates set by main.c: VL53L5CX 1 Hz, AMG8833 10 Hz, MLX90640 1 subpage per second */
+	uint32_t expected[] = { seconds - 1, seconds - 1, 10 * seconds - 2, seconds - 1 };
+	uint64_t frames = 0;
+	int ok = 1;
+
+	const char *rate = strchr(p->commands, INTEGRATOR_CMD_MLX_RATE);
+	if(rate)
+	{
+		/* The new rate takes over after the subpage measured at the old one */
+		expected[3] = ((seconds - 1) << (rate[1] - '0')) / 2 - 1;
+	}
+	if(p->series)
+	{
+		/* Frames of the thermal sensors are held back during their series */
+		expected[2] = 0;
+		expected[3] = 0;
+	}
+
+	fprintf(report, "Faza %-4s (%s):", p->commands, p->name);
+	for(int s = 0; s < 4; s++)
+	{
+		uint8_t slot = integrator_sensor_slot(ids[s]);
+		fprintf(report, " %c %u", ids[s], p->frames[slot]);
+		frames += p->frames[slot];
+		if(p->frames[slot] < expected[s] || p->bad_values[slot])
+		{
+			ok = 0;
+		}
+	}
+	double firmware_ms = (double)(p->cpu_ns - p->model_ns) / 1e6;
+	fprintf(report, "\n  CPU firmware %.2f ms (%.1f us/ramke), UART %llu B, I2C1 %llu B, I2C2 %llu B\n",
+			firmware_ms, frames ? firmware_ms * 1000 / frames : 0.0, (unsigned long long)p->uart_bytes,
+			(unsigned long long)p->i2c_bytes[0], (unsigned long long)p->i2c_bytes[1]);
+	fprintf(report, "  odczyt VL53L5CX %u B/ramke\n", p->vl_read_size);
+	if(strchr(p->commands, INTEGRATOR_CMD_VL_OUTPUTS) && p->vl_read_size >= phases[0].vl_read_size)
+	{
+		fprintf(report, "  odczyt VL53L5CX nie zostal skrocony\n");
+		ok = 0;
+	}
+	if(strchr(p->commands, INTEGRATOR_CMD_TOF_FIELDS) || p->tof_field_frames)
+	{
+		fprintf(report, "  ramki z polami VL53L5CX %u\n", p->tof_field_frames);
+		if(!strchr(p->commands, INTEGRATOR_CMD_TOF_FIELDS) || p->tof_field_frames < expected[0]) ok = 0;
+	}
+	fprintf(report, "  bledy CRC %llu, resynchronizacje %llu, luki kodowania %llu",
+			(unsigned long long)p->stats.crc_errors, (unsigned long long)p->stats.resyncs,
+			(unsigned long long)p->stats.codec_gaps);
+	for(int s = 0; s < 4; s++)
+	{
+		uint8_t slot = integrator_sensor_slot(ids[s]);
+		if(p->bad_values[slot]) fprintf(report, ", bledne wartosci %c: %u", ids[s], p->bad_values[slot]);
+	}
+	fprintf(report, "\n");
+
+	if(p->stats.crc_errors || p->stats.codec_gaps) ok = 0;
+	if(strchr(p->commands, INTEGRATOR_CMD_MLX_RAW) && p->eeprom_frames != 1)
+	{
+		fprintf(report, "  ramek EEPROM MLX90640: %u, oczekiwano 1\n", p->eeprom_frames);
+		ok = 0;
+	}
+	if(p->series)
+	{
+		const uint32_t amg_sent = p->frames[integrator_sensor_slot(INTEGRATOR_ID_AMG8833)];
+		fprintf(report, "  serie:");
+		for(int s = 0; s < SERIES_COUNT; s++)
+		{
+			const series_check *check = &seriesChecks[s];
+			fprintf(report, " %c %u/%u ramek, %u/%u stref%s", check->id, check->reported, check->frames,
+					check->zones, check->total, check->bad ? ", BLEDNE" : "");
+			if(check->reported != check->frames || !check->total || check->zones != check->total || check->bad)
+			{
+				ok = 0;
+			}
+		}
+		fprintf(report, "\n");
+		/* Sent before the series started and after it ended */
+		if(amg_sent + seriesChecks[1].frames > 10 * seconds + 2)
+		{
+			fprintf(report, "  ramki AMG8833 nie byly wstrzymane w czasie serii: %u\n", amg_sent);
+			ok = 0;
+		}
+	}
+	if(strchr(p->commands, INTEGRATOR_CMD_PROFILE))
+	{
+		fprintf(report, "  budzet CPU (%u ramek T):", p->profile_frames);
+		for(uint8_t k = 0; k < INTEGRATOR_PROFILE_STAGES && p->profile_total; k++)
+		{
+			double share = 100.0 * p->profile_cycles[k] / p->profile_total;
+			if(p->profile_cycles[k]) fprintf(report, " %s %.3f%%", integrator_profile_stage_name(k), share);
+		}
+		fprintf(report, "%s\n", p->profile_bad ? ", BLEDNE" : "");
+		fprintf(report, "  zajetosc potoku:");
+		for(uint8_t m = 0; m < INTEGRATOR_PIPE_STAGES && p->profile_total; m++)
+		{
+			fprintf(report, " %s %.2f%% (oczekiwania %u)", integrator_pipe_stage_name(m),
+					100.0 * p->pipe_cycles[m] / p->profile_total, p->pipe_waits[m]);
+		}
+		fprintf(report, "\n");
+		if(p->profile_frames < seconds - 1 || p->profile_bad) ok = 0;
+	}
+	if(p->commands_sent)
+	{
+		fprintf(report, "  potwierdzenia %u/%u, RTT maks. %u us%s\n", p->acks, p->commands_sent, p->ack_rtt_max_us,
+				p->acks_bad ? ", BLEDNE" : "");
+		if(p->acks != p->commands_sent || p->acks_bad) ok = 0;
+	}
+	if(!ok) fprintf(report, "  BLAD\n");
+	return ok;
+}
+
+/* Hot paths -----------------------------------------------------------------------*/
+static double loop_ns(uint64_t start_ns, uint32_t iterations)
+{
+	return (double)(hal_stub_cpu_ns() - start_ns) / iterations;
+}
+
+static void run_loops(void)
+{
+	static VL53L5CX_Configuration dev;
+	static VL53L5CX_ResultsData results;
+	static float to[768];
+	const uint32_t vl_iterations = 100000, mlx_iterations = 2000, frame_iterations = 20000;
+	const vl53l5cx_model *vl = &vlModels[0];
+	uint64_t start;
+
+	/* The firmware was stopped in the middle of its loop */
+	hal_stub_reset_events();
+	hal_stub_set_uart_sink(NULL);
+	uart_tx_init(&huart2);
+	i2c_bus_init(&hi2c1);
+	i2c_bus_init(&hi2c2);
+
+	dev.data_read_size = vl->frame_size;
+	start = hal_stub_cpu_ns();
+	for(uint32_t i = 0; i < vl_iterations; i++)
+	{
+		memcpy(dev.temp_buffer, vl->mem[2], vl->frame_size);
+		vl53l5cx_decode_ranging_data(&dev, &results);
+	}
+	double vl_ns = loop_ns(start, vl_iterations);
+
+	const uint16_t *image = mlx90640_model_image(&mlxModel, 0);
+	start = hal_stub_cpu_ns();
+	for(uint32_t i = 0; i < mlx_iterations; i++)
+	{
+		float ta = MLX90640_SolverGetTa(image, &mlxSolver);
+		MLX90640_SolveTo(image, &mlxSolver, 0.95f, ta - 8, to);
+	}
+	double mlx_ns = loop_ns(start, mlx_iterations);
+
+	/* A slowly changing MLX90640 temperature frame */
+	double frame_ns[2];
+	for(int coded = 0; coded < 2; coded++)
+	{
+		codedFormat = coded;
+		start = hal_stub_cpu_ns();
+		for(uint32_t i = 0; i < frame_iterations; i++)
+		{
+			for(int v = 0; v < 768; v++)
+			{
+				integrator_put_i16(&txFrame[INTEGRATOR_HEADER_SIZE + 2*v], (int16_t)(2500 + v + ((v + i) % 16 == 0)));
+			}
+			send_binary_frame(INTEGRATOR_ID_MLX90640, 2*768, i);
+		}
+		frame_ns[coded] = loop_ns(start, frame_iterations);
+	}
+	codedFormat = 0;
+
+	fprintf(report, "Petle [us]: dekodowanie VL53L5CX %.2f, MLX90640 Ta+To %.2f, ramka MLX90640 binarna %.2f, kodowana %.2f\n",
+			vl_ns / 1000, mlx_ns / 1000, frame_ns[0] / 1000, frame_ns[1] / 1000);
+}
+
+/* Setup ---------------------------------------------------------------------------*/
+static uint16_t *read_words(const char *path, uint32_t *count)
+{
+	FILE *file = fopen(path, "rb");
+	if(!file)
+	{
+		perror(path);
+		exit(2);
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	uint8_t *bytes = malloc(size);
+	uint16_t *words = malloc(size);
+	if(fread(bytes, 1, size, file) != (size_t)size)
+	{
+		perror(path);
+		exit(2);
+	}
+	fclose(file);
+	*count = (uint32_t)(size / 2);
+	for(uint32_t i = 0; i < *count; i++) words[i] = bytes[2*i] | (bytes[2*i + 1] << 8);
+	free(bytes);
+	return words;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Uzycie: %s [opcje]\n"
+		"  --seconds N        czas wirtualny kazdej fazy w sekundach (domyslnie 5)\n"
+		"  --mlx-eeprom PLIK  EEPROM MLX90640 (832 slowa uint16 LE, jak w mlx90640_check)\n"
+		"  --mlx-frames PLIK  ramki MLX90640 (po 834 slowa uint16 LE), odtwarzane w kolko\n"
+		"  --capture PLIK     zapis wyjscia UART w formacie EX --replay\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{ "seconds",    required_argument, 0, 's' },
+		{ "mlx-eeprom", required_argument, 0, 'e' },
+		{ "mlx-frames", required_argument, 0, 'f' },
+		{ "capture",    required_argument, 0, 'c' },
+		{ "help",       no_argument,       0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+	const char *eeprom_path = NULL, *frames_path = NULL, *capture_path = NULL;
+	uint16_t *eeprom = NULL, *images = NULL;
+	uint32_t words = 0, image_count = 0;
+	int opt;
+
+	while((opt = getopt_long(argc, argv, "s:e:f:c:h", options, NULL)) != -1)
+	{
+		switch(opt)
+		{
+		case 's': seconds = (uint32_t)atoi(optarg); break;
+		case 'e': eeprom_path = optarg; break;
+		case 'f': frames_path = optarg; break;
+		case 'c': capture_path = optarg; break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if(seconds < 3) seconds = 3;
+
+	if(eeprom_path)
+	{
+		eeprom = read_words(eeprom_path, &words);
+		if(words < MLX90640_MODEL_EEPROM_WORDS)
+		{
+			fprintf(stderr, "%s: za krotki EEPROM\n", eeprom_path);
+			return 2;
+		}
+	}
+	if(frames_path)
+	{
+		images = read_words(frames_path, &words);
+		image_count = words / MLX90640_MODEL_FRAME_WORDS;
+	}
+	if(capture_path)
+	{
+		capture = fopen(capture_path, "wb");
+		if(!capture)
+		{
+			perror(capture_path);
+			return 2;
+		}
+		fwrite("INTCAP01", 1, 8, capture);
+	}
+
+	/* The firmware prints through _write() to the UART, the report goes to the real stdout */
+	report = fdopen(dup(fileno(stdout)), "w");
+	stdout = fopencookie(NULL, "w", (cookie_io_functions_t){ .write = firmware_stdout_write });
+	setvbuf(stdout, NULL, _IOLBF, 256);
+
+	vl53l5cx_model_init(&vlModels[0], &hi2c1, VL1_INT_Pin, 400);
+	vl53l5cx_model_init(&vlModels[1], &hi2c2, VL2_INT_Pin, 1200);
+	amg8833_model_init(&amgModel, &hi2c1);
+	mlx90640_model_init(&mlxModel, &hi2c1, eeprom, images, image_count);
+
+	if(!firmware_check_echo())
+	{
+		fprintf(report, "BLAD: ramka binarna po echu komendy zgubiona przez parser\n");
+		return 1;
+	}
+	if(!firmware_check_oversize())
+	{
+		fprintf(report, "BLAD: parser przyjal ramke dluzsza niz siatka czujnika\n");
+		return 1;
+	}
+
+	firmware_check_handlers handlers = { on_frame, on_raw, on_control };
+	firmware_check_init(&handlers);
+	hal_stub_set_uart_sink(uart_sink);
+
+	uint64_t boot_start_ns = hal_stub_cpu_ns();
+	if(setjmp(stop) == 0)
+	{
+		firmware_main();
+	}
+	close_phase();
+	current = -1;
+
+	if(boot_us == 0)
+	{
+		fprintf(report, "BLAD: firmware nie wyslalo ramki opisu czujnikow\n");
+		return 1;
+	}
+	fprintf(report, "Uruchomienie: %.3f s czasu wirtualnego, VL53L5CX oprogramowanie %u B + %u B\n",
+			boot_us / 1e6, vlModels[0].firmware_bytes, vlModels[1].firmware_bytes);
+
+	int ok = 1;
+	for(int p = 0; p < PHASE_COUNT; p++) ok &= report_phase(&phases[p]);
+	fprintf(report, "Czas CPU calego przebiegu: %.1f ms\n", (hal_stub_cpu_ns() - boot_start_ns) / 1e6);
+
+	run_loops();
+
+	if(capture) fclose(capture);
+	fprintf(report, ok ? "OK\n" : "BLAD\n");
+	fclose(report);
+	return ok ? 0 : 1;
+}
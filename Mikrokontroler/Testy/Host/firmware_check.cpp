@@ -0,0 +1,109 @@
+/**
+  ******************************************************************************
+  * @file    firmware_check.cpp
+  * @brief   FrameParser behind the C interface of firmware_check.h.
+  ******************************************************************************
+  */
+#include "firmware_check.h"
+#include "frameparser.h"
+#include "integrator_protocol.h"
+
+static FrameParser parser;
+static firmware_check_handlers handlers;
+
+void firmware_check_init(const firmware_check_handlers *new_handlers)
+{
+	handlers = *new_handlers;
+	parser.reset();
+
+	parser.setFrameHandler([](const SensorFrame &frame) {
+		if(!handlers.frame) return;
+		const TofFields &tof = frame.tof;
+		firmware_check_frame out = { frame.sensor, frame.binary, frame.sequence, frame.mcuTimeUs,
+				frame.count, frame.values, tof.fields, tof.targets, TofFields::MaxZones,
+				tof.distanceMm[0], tof.detected, tof.status[0], tof.sigmaMm[0], tof.signalKcps[0] };
+		handlers.frame(&out);
+	});
+	parser.setRawHandler([](const SensorFrame &header, const uint8_t *payload, int length) {
+		if(handlers.raw) handlers.raw(header.sensor, header.sequence, payload, length);
+	});
+	parser.setControlHandler([](char id, const uint8_t *payload, int length) {
+		if(handlers.control) handlers.control(id, payload, length);
+	});
+}
+
+void firmware_check_feed(const uint8_t *data, int length, uint64_t time_us)
+{
+	parser.setReceiveTime((int64_t)time_us);
+	parser.feed(reinterpret_cast<const char *>(data), length);
+}
+
+firmware_check_stats firmware_check_get_stats(void)
+{
+	firmware_check_stats stats = { parser.framesParsed(), parser.crcErrors(), parser.resyncs(), parser.codecGaps() };
+	return stats;
+}
+
+/*
+ * The firmware echoes bare command bytes without a line end. An echoed letter
+ * that is also a sensor id must not cost the binary frame right after it:
+ * returns 1 if every such frame is parsed without a resync.
+ */
+int firmware_check_echo(void)
+{
+	static const char echoes[] = { INTEGRATOR_ID_MLX90640, INTEGRATOR_ID_VL53L5CX_2, INTEGRATOR_ID_VL53L5CX_3,
+			INTEGRATOR_ID_VL53L5CX_4, INTEGRATOR_ID_VL53L5CX_1, INTEGRATOR_ID_AMG8833 };
+	const int count = (int)sizeof(echoes);
+	const uint16_t len = 2*INTEGRATOR_AMG8833_VALUES;
+	FrameParser echoParser;
+	uint8_t frame[INTEGRATOR_MAX_FRAME];
+	int frames = 0;
+
+	echoParser.setFrameHandler([&frames](const SensorFrame &) { frames++; });
+	for(int e = 0; e < count; e++)
+	{
+		for(int i = 0; i < INTEGRATOR_AMG8833_VALUES; i++)
+		{
+			integrator_put_i16(&frame[INTEGRATOR_HEADER_SIZE + 2*i], (int16_t)(2500 + i));
+		}
+		integrator_put_header(frame, INTEGRATOR_ID_AMG8833, len, (uint16_t)e, 0);
+		echoParser.feed(&echoes[e], 1);
+		echoParser.feed(reinterpret_cast<const char *>(frame), integrator_put_crc(frame, len));
+	}
+	return frames == count && echoParser.resyncs() == 0 && echoParser.crcErrors() == 0;
+}
+
+/*
+ * A CRC-valid uncoded frame longer than the grid of its sensor (the payload
+ * limit is that of a raw MLX90640 frame) or of odd length has to be dropped
+ * with a resync instead of overrunning SensorFrame::values: returns 1 if only
+ * the frames that fit are delivered.
+ */
+int firmware_check_oversize(void)
+{
+	static const struct { char id; uint16_t len; int valid; } cases[] = {
+		{ INTEGRATOR_ID_MLX90640, 2*INTEGRATOR_MLX90640_RAW_WORDS, 0 },
+		{ INTEGRATOR_ID_MLX90640, 2*INTEGRATOR_MLX90640_VALUES + 2, 0 },
+		{ INTEGRATOR_ID_AMG8833, 2*INTEGRATOR_AMG8833_VALUES + 2, 0 },
+		{ INTEGRATOR_ID_VL53L5CX_1, 2*INTEGRATOR_VL53L5CX_VALUES - 1, 0 },
+		{ INTEGRATOR_ID_MLX90640, 2*INTEGRATOR_MLX90640_VALUES, 1 },
+		{ INTEGRATOR_ID_VL53L5CX_1, 2*INTEGRATOR_VL53L5CX_VALUES, 1 },
+	};
+	const int count = (int)(sizeof(cases)/sizeof(cases[0]));
+	FrameParser sizeParser;
+	uint8_t frame[INTEGRATOR_MAX_FRAME] = { 0 };
+	int frames = 0, valid = 0, largest = 0;
+
+	sizeParser.setFrameHandler([&frames, &largest](const SensorFrame &parsed) {
+		frames++;
+		if(parsed.count > largest) largest = parsed.count;
+	});
+	for(int c = 0; c < count; c++)
+	{
+		integrator_put_header(frame, (uint8_t)cases[c].id, cases[c].len, (uint16_t)c, 0);
+		sizeParser.feed(reinterpret_cast<const char *>(frame), integrator_put_crc(frame, cases[c].len));
+		valid += cases[c].valid;
+	}
+	return frames == valid && largest <= INTEGRATOR_MAX_VALUES
+			&& sizeParser.resyncs() == (uint64_t)(count - valid) && sizeParser.crcErrors() == 0;
+}
@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file    firmware_check.h
+  * @brief   C interface of the host FrameParser for firmware_bench.
+  ******************************************************************************
+  * The bytes the firmware sends are decoded by the same FrameParser as in the
+  * application (EX/frameparser.cpp), so the bench fails on anything the
+  * application would drop.
+  ******************************************************************************
+  */
+#ifndef FIRMWARE_CHECK_H
+#define FIRMWARE_CHECK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A sensor frame that passed the CRC check, values as in SensorFrame */
+typedef struct
+{
+	char sensor;
+	uint8_t binary;
+	uint16_t sequence;
+	uint32_t mcu_time_us;
+	int count;
+	const float *values;
+	/* Fields of a VL53L5CX frame (TofFields), tof_fields 0 for a plain frame */
+	uint8_t tof_fields;
+	int tof_targets;
+	int tof_stride;					/* Entries between the targets of an array */
+	const int16_t *tof_distance;
+	const uint8_t *tof_detected;
+	const uint8_t *tof_status;
+	const uint16_t *tof_sigma;
+	const uint16_t *tof_signal;
+} firmware_check_frame;
+
+typedef struct
+{
+	void (*frame)(const firmware_check_frame *frame);
+	/* Raw MLX90640 and AMG8833 frames */
+	void (*raw)(char id, uint16_t sequence, const uint8_t *payload, int length);
+	/* Binary frames with any other id */
+	void (*control)(char id, const uint8_t *payload, int length);
+} firmware_check_handlers;
+
+typedef struct
+{
+	uint64_t frames;
+	uint64_t crc_errors;
+	uint64_t resyncs;
+	uint64_t codec_gaps;
+} firmware_check_stats;
+
+void firmware_check_init(const firmware_check_handlers *handlers);
+void firmware_check_feed(const uint8_t *data, int length, uint64_t time_us);
+firmware_check_stats firmware_check_get_stats(void);
+int firmware_check_echo(void);
+int firmware_check_oversize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIRMWARE_CHECK_H */
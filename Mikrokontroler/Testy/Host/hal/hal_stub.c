@@ -0,0 +1,538 @@
+/**
+  ******************************************************************************
+  * @file    hal_stub.c
+  * @brief   Stub HAL on a virtual clock, see hal_stub.h.
+  ******************************************************************************
+  * Also stands in for the CubeMX peripheral files (i2c.c, usart.c, tim.c,
+  * gpio.c, dma.c): the handles are defined here and the MX_*_Init() functions
+  * only fill in what the firmware reads back.
+  ******************************************************************************
+  */
+#include <string.h>
+#include <time.h>
+
+#include "hal_stub.h"
+#include "main.h"
+#include "dma.h"
+#include "gpio.h"
+#include "i2c.h"
+#include "tim.h"
+#include "usart.h"
+
+#define EVENT_POOL_SIZE		64
+/* Bus rates set by the timings in i2c.c */
+#define I2C1_RATE_HZ		400000
+#define I2C2_RATE_HZ		1000000
+/* Core clock set by SystemClock_Config(), HSI through the PLL */
+#define CORE_HZ				80000000u
+
+typedef struct event event;
+struct event
+{
+	uint64_t time_us;
+	hal_stub_handler handler;
+	void *arg;
+	int model;
+	event *next;
+};
+
+/* One DMA transfer in flight per bus */
+typedef struct
+{
+	I2C_HandleTypeDef *hi2c;
+	uint32_t rate_hz;
+	uint8_t busy;
+	hal_stub_device *device;
+	uint16_t reg;
+	uint8_t *data;
+	uint16_t size;
+	uint8_t write;
+} i2c_channel;
+
+static GPIO_TypeDef gpio[4];
+static TIM_TypeDef tim2;
+static I2C_TypeDef i2c[2] = { { 0 }, { 1 } };
+static USART_TypeDef usart2;
+
+GPIO_TypeDef *GPIOA = &gpio[0], *GPIOB = &gpio[1], *GPIOC = &gpio[2], *GPIOH = &gpio[3];
+TIM_TypeDef *TIM2 = &tim2;
+I2C_TypeDef *I2C1 = &i2c[0], *I2C2 = &i2c[1];
+USART_TypeDef *USART2 = &usart2;
+
+static DWT_Type dwt;
+static CoreDebug_Type core_debug;
+static DBGMCU_TypeDef dbgmcu;
+static uint8_t dwt_running;
+static uint64_t dwt_last_us, dwt_last_ns, dwt_last_model_ns;
+
+CoreDebug_Type *CoreDebug = &core_debug;
+DBGMCU_TypeDef *DBGMCU = &dbgmcu;
+
+I2C_HandleTypeDef hi2c1;
+I2C_HandleTypeDef hi2c2;
+UART_HandleTypeDef huart2;
+TIM_HandleTypeDef htim2;
+
+uint64_t hal_stub_i2c_bytes[2];
+
+static uint64_t now_us;
+static uint32_t primask;
+static uint8_t in_handler;
+static uint64_t stop_us = UINT64_MAX;
+static jmp_buf *stop_exit;
+
+static event pool[EVENT_POOL_SIZE];
+static event *free_events;
+static event *queue;
+
+static i2c_channel channels[2] = {
+	{ &hi2c1, I2C1_RATE_HZ },
+	{ &hi2c2, I2C2_RATE_HZ },
+};
+static hal_stub_device *devices;
+
+static hal_stub_uart_sink uart_sink;
+static DMA_Channel_TypeDef uart_rx_channel;
+static DMA_HandleTypeDef uart_rx_dma = { &uart_rx_channel };
+static uint8_t *uart_rx_buffer;
+static uint16_t uart_rx_size;
+/* Bytes given to hal_stub_uart_receive() at the same time, delivered by one event */
+static uint8_t uart_rx_burst[256];
+static uint16_t uart_rx_burst_len;
+
+static uint64_t model_ns;
+
+uint64_t hal_stub_cpu_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+uint64_t hal_stub_model_ns(void)
+{
+	return model_ns;
+}
+
+uint64_t hal_stub_now_us(void)
+{
+	return now_us;
+}
+
+/*
+ * CYCCNT counts the virtual time at the core clock plus the time the PC spends
+ * in the firmware (without the device models and the sink), as if it ran at
+ * the core clock. The monotonic clock is read instead of the CPU time clock,
+ * which is a system call and would slow down every stage switch. A value
+ * written while the counter is stopped is where it starts.
+ */
+DWT_Type *hal_stub_dwt(void)
+{
+	if(dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk)
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		uint64_t ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+
+		if(dwt_running)
+		{
+			uint64_t firmware_ns = ns - dwt_last_ns;
+			uint64_t models_ns = model_ns - dwt_last_model_ns;
+			firmware_ns = firmware_ns > models_ns ? firmware_ns - models_ns : 0;
+			dwt.CYCCNT += (uint32_t)((now_us - dwt_last_us) * (CORE_HZ / 1000000u) + firmware_ns * (CORE_HZ / 1000000u) / 1000u);
+		}
+		dwt_running = 1;
+		dwt_last_us = now_us;
+		dwt_last_ns = ns;
+		dwt_last_model_ns = model_ns;
+	}
+	return &dwt;
+}
+
+void hal_stub_schedule(uint64_t time_us, hal_stub_handler handler, void *arg, int model)
+{
+	if(!free_events)
+	{
+		for(int e = 0; e < EVENT_POOL_SIZE; e++)
+		{
+			pool[e].next = free_events;
+			free_events = &pool[e];
+		}
+	}
+	event *ev = free_events;
+	free_events = ev->next;
+	ev->time_us = time_us;
+	ev->handler = handler;
+	ev->arg = arg;
+	ev->model = model;
+
+	/* After the events of the same time, so they run in the order scheduled */
+	event **link = &queue;
+	while(*link && (*link)->time_us <= time_us) link = &(*link)->next;
+	ev->next = *link;
+	*link = ev;
+}
+
+static void cancel_events(void *arg)
+{
+	event **link = &queue;
+	while(*link)
+	{
+		event *ev = *link;
+		if(ev->arg == arg)
+		{
+			*link = ev->next;
+			ev->next = free_events;
+			free_events = ev;
+		}
+		else
+		{
+			link = &ev->next;
+		}
+	}
+}
+
+void hal_stub_reset_events(void)
+{
+	while(queue)
+	{
+		event *ev = queue;
+		queue = ev->next;
+		ev->next = free_events;
+		free_events = ev;
+	}
+	for(int c = 0; c < 2; c++) channels[c].busy = 0;
+	primask = 0;
+	in_handler = 0;
+	stop_us = UINT64_MAX;
+}
+
+void hal_stub_stop_at(uint64_t stop, jmp_buf *exit)
+{
+	stop_us = stop;
+	stop_exit = exit;
+}
+
+/* Runs the due events, unless interrupts are masked or one is already running */
+static void deliver(void)
+{
+	while(!primask && !in_handler && queue && queue->time_us <= now_us)
+	{
+		event *ev = queue;
+		hal_stub_handler handler = ev->handler;
+		void *arg = ev->arg;
+		int model = ev->model;
+
+		queue = ev->next;
+		ev->next = free_events;
+		free_events = ev;
+
+		uint64_t start = model ? hal_stub_cpu_ns() : 0;
+		in_handler = 1;
+		handler(arg);
+		in_handler = 0;
+		if(model) model_ns += hal_stub_cpu_ns() - start;
+	}
+}
+
+static void advance(uint64_t time_us)
+{
+	if(time_us > now_us) now_us = time_us;
+	tim2.CNT = (uint32_t)now_us;
+	if(now_us >= stop_us && stop_exit)
+	{
+		stop_us = UINT64_MAX;
+		longjmp(*stop_exit, 1);
+	}
+}
+
+/* CMSIS ---------------------------------------------------------------------*/
+void __disable_irq(void)
+{
+	primask = 1;
+}
+
+void __enable_irq(void)
+{
+	primask = 0;
+	deliver();
+}
+
+uint32_t __get_PRIMASK(void)
+{
+	return primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+	primask = priMask;
+	deliver();
+}
+
+uint32_t __get_IPSR(void)
+{
+	return in_handler ? 16 : 0;
+}
+
+/* Sleeps until the next event, at most until the next SysTick */
+void __WFI(void)
+{
+	if(queue && queue->time_us <= now_us)
+	{
+		/* Already pending: wakes at once, runs when unmasked */
+		deliver();
+		return;
+	}
+	uint64_t next = (now_us / 1000 + 1) * 1000;
+	if(queue && queue->time_us < next) next = queue->time_us;
+	advance(next);
+	deliver();
+}
+
+/* HAL -----------------------------------------------------------------------*/
+HAL_StatusTypeDef HAL_Init(void)
+{
+	now_us = 0;
+	tim2.CNT = 0;
+	return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return (uint32_t)(now_us / 1000);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	uint64_t until = now_us + (uint64_t)Delay * 1000;
+
+	for(;;)
+	{
+		deliver();
+		if(now_us >= until) break;
+		uint64_t next = until;
+		if(!primask && queue && queue->time_us < next) next = queue->time_us;
+		advance(next);
+	}
+}
+
+HAL_StatusTypeDef HAL_PWREx_ControlVoltageScaling(uint32_t VoltageScaling)
+{
+	(void)VoltageScaling;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+	(void)RCC_OscInitStruct;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+	(void)RCC_ClkInitStruct;
+	(void)FLatency;
+	return HAL_OK;
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void)
+{
+	return CORE_HZ;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	if(PinState == GPIO_PIN_SET) GPIOx->ODR |= GPIO_Pin;
+	else GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	return (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+/* I2C -----------------------------------------------------------------------*/
+void hal_stub_attach(hal_stub_device *device)
+{
+	device->next = devices;
+	devices = device;
+}
+
+static i2c_channel *find_channel(I2C_HandleTypeDef *hi2c)
+{
+	for(int c = 0; c < 2; c++)
+	{
+		if(channels[c].hi2c == hi2c) return &channels[c];
+	}
+	return 0;
+}
+
+static void i2c_done(void *arg)
+{
+	i2c_channel *channel = arg;
+	hal_stub_device *device = channel->device;
+
+	uint64_t start = hal_stub_cpu_ns();
+	int failed = channel->write
+			? device->write(device, channel->reg, channel->data, channel->size)
+			: device->read(device, channel->reg, channel->data, channel->size);
+	model_ns += hal_stub_cpu_ns() - start;
+
+	channel->busy = 0;
+	if(failed) HAL_I2C_ErrorCallback(channel->hi2c);
+	else if(channel->write) HAL_I2C_MemTxCpltCallback(channel->hi2c);
+	else HAL_I2C_MemRxCpltCallback(channel->hi2c);
+}
+
+static HAL_StatusTypeDef i2c_start(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint8_t write)
+{
+	i2c_channel *channel = find_channel(hi2c);
+	hal_stub_device *device;
+
+	if(!channel) return HAL_ERROR;
+	if(channel->busy) return HAL_BUSY;
+	for(device = devices; device; device = device->next)
+	{
+		if(device->hi2c == hi2c && device->address == DevAddress) break;
+	}
+	/* The address phase runs before the DMA starts, a NACK fails the call */
+	if(!device) return HAL_ERROR;
+
+	channel->busy = 1;
+	channel->device = device;
+	channel->reg = MemAddress;
+	channel->data = pData;
+	channel->size = Size;
+	channel->write = write;
+
+	/* 9 clocks per byte: address, register, (repeated address,) data */
+	uint32_t bytes = 1 + MemAddSize + (write ? 0 : 1) + Size;
+	uint64_t duration = ((uint64_t)bytes * 9 * 1000000 + channel->rate_hz - 1) / channel->rate_hz;
+	hal_stub_i2c_bytes[channel - channels] += bytes;
+	hal_stub_schedule(now_us + duration, i2c_done, channel, 0);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return i2c_start(hi2c, DevAddress, MemAddress, MemAddSize, pData, Size, 0);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	return i2c_start(hi2c, DevAddress, MemAddress, MemAddSize, pData, Size, 1);
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+	return HAL_OK;
+}
+
+/* Aborts the transfer in flight */
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c)
+{
+	i2c_channel *channel = find_channel(hi2c);
+
+	if(channel && channel->busy)
+	{
+		cancel_events(channel);
+		channel->busy = 0;
+	}
+	return HAL_OK;
+}
+
+/* UART ----------------------------------------------------------------------*/
+void hal_stub_set_uart_sink(hal_stub_uart_sink sink)
+{
+	uart_sink = sink;
+}
+
+static void uart_tx_done(void *arg)
+{
+	HAL_UART_TxCpltCallback(arg);
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+	if(uart_sink)
+	{
+		uint64_t start = hal_stub_cpu_ns();
+		uart_sink(pData, Size, now_us);
+		model_ns += hal_stub_cpu_ns() - start;
+	}
+	hal_stub_schedule(now_us, uart_tx_done, huart, 0);
+	return HAL_OK;
+}
+
+/* Circular mode only, as configured for USART2 RX in usart.c */
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	uart_rx_buffer = pData;
+	uart_rx_size = Size;
+	huart->hdmarx->Instance->CNDTR = Size;
+	return HAL_OK;
+}
+
+static void uart_rx_done(void *arg)
+{
+	(void)arg;
+	for(uint16_t i = 0; i < uart_rx_burst_len && uart_rx_buffer; i++)
+	{
+		uart_rx_buffer[uart_rx_size - uart_rx_channel.CNDTR] = uart_rx_burst[i];
+		if(--uart_rx_channel.CNDTR == 0) uart_rx_channel.CNDTR = uart_rx_size;
+	}
+	uart_rx_burst_len = 0;		/* Lost if the reception was not started */
+}
+
+void hal_stub_uart_receive(uint8_t byte)
+{
+	if(uart_rx_burst_len == sizeof(uart_rx_burst)) return;
+	if(uart_rx_burst_len == 0) hal_stub_schedule(now_us, uart_rx_done, NULL, 0);
+	uart_rx_burst[uart_rx_burst_len++] = byte;
+}
+
+/* CubeMX peripheral initialisation --------------------------------------------*/
+void MX_GPIO_Init(void)
+{
+	memset(gpio, 0, sizeof(gpio));
+}
+
+void MX_DMA_Init(void)
+{
+}
+
+void MX_USART2_UART_Init(void)
+{
+	huart2.Instance = USART2;
+	huart2.Init.BaudRate = 115200;
+	huart2.hdmarx = &uart_rx_dma;
+}
+
+HAL_StatusTypeDef USART2_SetBaudRate(uint32_t baudRate)
+{
+	huart2.Init.BaudRate = baudRate;
+	return HAL_OK;
+}
+
+void MX_I2C1_Init(void)
+{
+	hi2c1.Instance = I2C1;
+	hi2c1.Init.Timing = 0x00702991;
+}
+
+void MX_I2C2_Init(void)
+{
+	hi2c2.Instance = I2C2;
+	hi2c2.Init.Timing = 0x00300F38;
+}
+
+void MX_TIM2_Init(void)
+{
+	htim2.Instance = TIM2;
+	htim2.Init.Prescaler = 79;
+	htim2.Init.Period = 4294967295u;
+}
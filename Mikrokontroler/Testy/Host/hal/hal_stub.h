@@ -0,0 +1,66 @@
+/**
+  ******************************************************************************
+  * @file    hal_stub.h
+  * @brief   Control of the stub HAL: virtual clock, interrupts and devices.
+  ******************************************************************************
+  * Time only passes in __WFI() and HAL_Delay(), so a run is deterministic and
+  * independent of the speed of the PC. Interrupts are events on the virtual
+  * clock; a due event runs as soon as the firmware does not mask interrupts,
+  * with __get_IPSR() reporting handler mode.
+  *
+  * An I2C DMA transfer takes the time of its bytes at the rate the bus has in
+  * i2c.c, then the device is accessed and the completion callback runs. The
+  * UART is not modelled: a DMA transmission completes at once and its bytes
+  * go to the sink.
+  ******************************************************************************
+  */
+#ifndef HAL_STUB_H
+#define HAL_STUB_H
+
+#include <setjmp.h>
+#include <stdint.h>
+
+#include "stm32l4xx_hal.h"
+
+typedef void (*hal_stub_handler)(void *arg);
+
+/* A device on one of the buses; read and write return 0 on ACK */
+typedef struct hal_stub_device hal_stub_device;
+struct hal_stub_device
+{
+	I2C_HandleTypeDef *hi2c;
+	uint16_t address;		/* 8-bit address, as for HAL_I2C_* */
+	int (*read)(hal_stub_device *device, uint16_t reg, uint8_t *data, uint16_t size);
+	int (*write)(hal_stub_device *device, uint16_t reg, const uint8_t *data, uint16_t size);
+	void *model;
+	hal_stub_device *next;
+};
+
+/* Called with the bytes of every UART transmission */
+typedef void (*hal_stub_uart_sink)(const uint8_t *data, uint16_t size, uint64_t time_us);
+
+uint64_t hal_stub_now_us(void);
+
+/* Runs handler(arg) as an interrupt at time_us; model marks device model work */
+void hal_stub_schedule(uint64_t time_us, hal_stub_handler handler, void *arg, int model);
+
+/* The next __WFI() at or after stop_us returns through longjmp(exit, 1) */
+void hal_stub_stop_at(uint64_t stop_us, jmp_buf *exit);
+
+/* Drops the pending events and unmasks interrupts, e.g. after the longjmp */
+void hal_stub_reset_events(void);
+
+void hal_stub_attach(hal_stub_device *device);
+void hal_stub_set_uart_sink(hal_stub_uart_sink sink);
+
+/* Delivers one received byte to the circular HAL_UART_Receive_DMA() */
+void hal_stub_uart_receive(uint8_t byte);
+
+/* Host CPU time spent in the device models and the sink, in ns */
+uint64_t hal_stub_model_ns(void);
+uint64_t hal_stub_cpu_ns(void);
+
+/* Bytes moved on each bus, indexed by I2C1 = 0, I2C2 = 1 */
+extern uint64_t hal_stub_i2c_bytes[2];
+
+#endif /* HAL_STUB_H */
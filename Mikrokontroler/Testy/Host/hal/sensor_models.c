@@ -0,0 +1,605 @@
+/**
+  ******************************************************************************
+  * @file    sensor_models.c
+  * @brief   Register models of the sensors, see sensor_models.h.
+  ******************************************************************************
+  * Only the behaviour the drivers rely on is modelled: identification and
+  * status registers, the command and DCI protocol of the VL53L5CX, the frame
+  * rate registers of the AMG8833 and the status, control and RAM words of the
+  * MLX90640. Writes to anything else are stored and read back.
+  ******************************************************************************
+  */
+#include <string.h>
+
+#include "sensor_models.h"
+#include "vl53l5cx_api.h"
+#include "AMG8833.h"
+#include "MLX90640_I2C_Driver.h"
+
+/* VL53L5CX ------------------------------------------------------------------*/
+#define VL_PAGE_SELECT			0x7fff
+#define VL_OUTPUT_COUNT			12		/* Entries of the output list of vl53l5cx_start_ranging() */
+#define VL_FRAME_HEADER_SIZE	16
+#define VL_FRAME_FOOTER_SIZE	8
+#define VL_SILICON_TEMP_DEGC	30
+
+static uint32_t get_be32(const uint8_t *src)
+{
+	return ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8) | src[3];
+}
+
+static void put_le32(uint8_t *dst, uint32_t value)
+{
+	dst[0] = (uint8_t)value;
+	dst[1] = (uint8_t)(value >> 8);
+	dst[2] = (uint8_t)(value >> 16);
+	dst[3] = (uint8_t)(value >> 24);
+}
+
+/* Reverses the bytes of every word, between the host and the wire order */
+static void swap_words(uint8_t *buffer, uint32_t size)
+{
+	for(uint32_t i = 0; i + 3 < size; i += 4)
+	{
+		uint8_t t0 = buffer[i], t1 = buffer[i + 1];
+		buffer[i] = buffer[i + 3];
+		buffer[i + 1] = buffer[i + 2];
+		buffer[i + 2] = t1;
+		buffer[i + 3] = t0;
+	}
+}
+
+static uint32_t vl_block_size(uint32_t header)
+{
+	uint32_t type = header & 0xf;
+	uint32_t size = (header >> 4) & 0xfff;
+	return (type > 1 && type < 0xd) ? type * size : size;
+}
+
+int16_t vl53l5cx_model_distance(const vl53l5cx_model *model, uint32_t frame, int zone)
+{
+	return (int16_t)(model->base_mm + zone * 13 + (frame % 5) * 40);
+}
+
+uint8_t vl53l5cx_model_targets(int zone)
+{
+	return (zone % 4 == 0) ? 2 : 1;
+}
+
+int16_t vl53l5cx_model_target_distance(const vl53l5cx_model *model, uint32_t frame, int zone, int target)
+{
+	if(target >= vl53l5cx_model_targets(zone)) return 0;
+	return (int16_t)(vl53l5cx_model_distance(model, frame, zone) + target * 700);
+}
+
+uint8_t vl53l5cx_model_status(int zone, int target)
+{
+	if(target >= vl53l5cx_model_targets(zone)) return 0;
+	return (target == 0 && zone % 16 == 15) ? 4 : 5;
+}
+
+uint16_t vl53l5cx_model_sigma(int zone, int target)
+{
+	if(target >= vl53l5cx_model_targets(zone)) return 0;
+	return (uint16_t)(2 + zone % 7 + 3 * target);
+}
+
+uint32_t vl53l5cx_model_signal(int zone, int target)
+{
+	if(target >= vl53l5cx_model_targets(zone)) return 0;
+	return 900 + (uint32_t)zone * 11 - 400u * (uint32_t)target;
+}
+
+static void vl_set_cmd_status(vl53l5cx_model *model)
+{
+	/* Answer ready (byte 0 for the NVM command, byte 1 for the DCI ones), no error */
+	static const uint8_t ready[4] = { 0x02, 0x03, 0x00, 0x00 };
+	memcpy(&model->mem[2][VL53L5CX_UI_CMD_STATUS], ready, sizeof(ready));
+}
+
+/* DCI read: the requested block, with its header, at UI_CMD_START */
+static void vl_dci_read(vl53l5cx_model *model, const uint8_t *cmd)
+{
+	uint32_t idx = ((uint32_t)cmd[0] << 8) | cmd[1];
+	uint32_t size = ((uint32_t)cmd[2] << 4) | (cmd[3] >> 4);
+	uint8_t *out = &model->mem[2][VL53L5CX_UI_CMD_START];
+
+	if(size > VL53L5CX_MODEL_PAGE_SIZE - VL53L5CX_UI_CMD_START - 12) size = VL53L5CX_MODEL_PAGE_SIZE - VL53L5CX_UI_CMD_START - 12;
+	if(idx + size > sizeof(model->dci)) size = sizeof(model->dci) - idx;
+	memcpy(out, cmd, 4);
+	memcpy(&out[4], &model->dci[idx], size);
+	memset(&out[4 + size], 0, 8);
+}
+
+/* DCI write or configuration: a list of blocks closed by the footer */
+static void vl_dci_write(vl53l5cx_model *model, const uint8_t *cmd, uint32_t size)
+{
+	uint32_t end = size - VL_FRAME_FOOTER_SIZE;
+	uint32_t pos = 0;
+
+	while(pos + 4 <= end)
+	{
+		uint32_t header = get_be32(&cmd[pos]);
+		uint32_t idx = header >> 16;
+		uint32_t block = vl_block_size(header);
+
+		if(pos + 4 + block > end || idx + block > sizeof(model->dci)) break;
+		memcpy(&model->dci[idx], &cmd[pos + 4], block);
+		pos += 4 + block;
+	}
+}
+
+static void vl_tick(void *arg);
+
+static void vl_start_ranging(vl53l5cx_model *model)
+{
+	/* The firmware reports the frame size it was configured with at 0x5440 + 8 */
+	memcpy(&model->dci[0x5448], &model->dci[VL53L5CX_DCI_OUTPUT_CONFIG], 4);
+	model->frame_size = (uint16_t)get_be32(&model->dci[VL53L5CX_DCI_OUTPUT_CONFIG]);
+	if(model->frame_size > VL53L5CX_UI_CMD_STATUS) model->frame_size = 0;
+
+	uint8_t frequency = model->dci[VL53L5CX_DCI_FREQ_HZ + 2];
+	model->period_us = 1000000u / (frequency ? frequency : 1);
+	model->ranging = 1;
+	memset(model->mem[2], 0, 4);
+
+	model->next_tick_us = hal_stub_now_us() + model->period_us;
+	hal_stub_schedule(model->next_tick_us, vl_tick, model, 1);
+}
+
+static void vl_command(vl53l5cx_model *model, const uint8_t *cmd, uint32_t size)
+{
+	static const uint8_t footer[4] = { 0x00, 0x00, 0x00, 0x0f };
+
+	if(size == 4 && cmd[1] == 0x03)
+	{
+		vl_start_ranging(model);
+	}
+	else if(size >= 12 && cmd[size - 3] == 0x02)
+	{
+		vl_dci_read(model, cmd);
+	}
+	/* The offset and Xtalk calibration (footer type 3) is not kept */
+	else if(size >= 12 && memcmp(&cmd[size - 8], footer, 4) == 0 && cmd[size - 4] != 0x03)
+	{
+		vl_dci_write(model, cmd, size);
+	}
+	vl_set_cmd_status(model);
+}
+
+/* Builds the frame in the host order of vl53l5cx_decode_ranging_data(), then swaps it */
+static void vl_make_frame(vl53l5cx_model *model)
+{
+	uint8_t *frame = model->mem[2];
+	uint32_t size = model->frame_size;
+	uint32_t frame_number = model->frames;
+	uint16_t id = (uint16_t)frame_number;
+	uint32_t pos = VL_FRAME_HEADER_SIZE;
+
+	if(size < VL_FRAME_HEADER_SIZE + VL_FRAME_FOOTER_SIZE) return;
+	if(++model->streamcount == 255) model->streamcount = 0;
+
+	memset(frame, 0, size);
+	frame[0] = 0x10;
+	frame[1] = 0x05;
+	frame[2] = 0x05;
+	frame[3] = model->streamcount;
+	frame[8] = (uint8_t)(id >> 8);
+	frame[9] = (uint8_t)id;
+
+	for(int i = 0; i < VL_OUTPUT_COUNT; i++)
+	{
+		uint32_t header = get_be32(&model->dci[VL53L5CX_DCI_OUTPUT_LIST + 4*i]);
+		uint32_t enables = get_be32(&model->dci[VL53L5CX_DCI_OUTPUT_ENABLES + 4*(i / 32)]);
+		uint32_t block = vl_block_size(header);
+		uint8_t *payload = &frame[pos + 4];
+
+		if(header == 0 || !(enables & (1u << (i % 32)))) continue;
+		if(pos + 4 + block > size - VL_FRAME_FOOTER_SIZE) break;
+
+		put_le32(&frame[pos], header);
+		switch(header >> 16)
+		{
+		case VL53L5CX_METADATA_IDX:
+			payload[8] = VL_SILICON_TEMP_DEGC;
+			break;
+		case VL53L5CX_NB_TARGET_DETECTED_IDX:
+			for(uint32_t k = 0; k < block; k++) payload[k] = vl53l5cx_model_targets((int)k);
+			break;
+		case VL53L5CX_TARGET_STATUS_IDX:
+			for(uint32_t k = 0; k < block; k++)
+			{
+				payload[k] = vl53l5cx_model_status((int)(k / VL53L5CX_NB_TARGET_PER_ZONE), (int)(k % VL53L5CX_NB_TARGET_PER_ZONE));
+			}
+			break;
+		/* The blocks below in the fixed point formats of the sensor firmware, targets of a zone next to each other */
+		case VL53L5CX_DISTANCE_IDX:
+			for(uint32_t k = 0; k < block / 2; k++)
+			{
+				int16_t value = (int16_t)(vl53l5cx_model_target_distance(model, frame_number,
+						(int)(k / VL53L5CX_NB_TARGET_PER_ZONE), (int)(k % VL53L5CX_NB_TARGET_PER_ZONE)) * 4);
+				payload[2*k] = (uint8_t)value;
+				payload[2*k + 1] = (uint8_t)((uint16_t)value >> 8);
+			}
+			break;
+		case VL53L5CX_RANGE_SIGMA_MM_IDX:
+			for(uint32_t k = 0; k < block / 2; k++)
+			{
+				uint16_t value = (uint16_t)(vl53l5cx_model_sigma((int)(k / VL53L5CX_NB_TARGET_PER_ZONE),
+						(int)(k % VL53L5CX_NB_TARGET_PER_ZONE)) * 128);
+				payload[2*k] = (uint8_t)value;
+				payload[2*k + 1] = (uint8_t)(value >> 8);
+			}
+			break;
+		case VL53L5CX_SIGNAL_RATE_IDX:
+			for(uint32_t k = 0; k < block / 4; k++)
+			{
+				put_le32(&payload[4*k], vl53l5cx_model_signal((int)(k / VL53L5CX_NB_TARGET_PER_ZONE),
+						(int)(k % VL53L5CX_NB_TARGET_PER_ZONE)) * 2048);
+			}
+			break;
+		default:
+			break;
+		}
+		pos += 4 + block;
+	}
+
+	frame[size - 4] = (uint8_t)(id >> 8);
+	frame[size - 3] = (uint8_t)id;
+	swap_words(frame, size);
+	model->frames++;
+}
+
+static void vl_tick(void *arg)
+{
+	vl53l5cx_model *model = arg;
+
+	/* Stale after a stop or a restart of the ranging */
+	if(!model->ranging || hal_stub_now_us() != model->next_tick_us) return;
+
+	vl_make_frame(model);
+	model->next_tick_us += model->period_us;
+	hal_stub_schedule(model->next_tick_us, vl_tick, model, 1);
+	HAL_GPIO_EXTI_Callback(model->int_pin);
+}
+
+static uint8_t *vl_register(vl53l5cx_model *model, uint16_t reg)
+{
+	uint8_t page = model->page;
+	if(page > 2) return 0;
+	return &model->mem[page][reg & (VL53L5CX_MODEL_PAGE_SIZE - 1)];
+}
+
+static int vl_read(hal_stub_device *device, uint16_t reg, uint8_t *data, uint16_t size)
+{
+	vl53l5cx_model *model = device->model;
+
+	for(uint32_t i = 0; i < size; i++)
+	{
+		uint16_t address = (uint16_t)(reg + i);
+		uint8_t *value = vl_register(model, address);
+
+		if(address == VL_PAGE_SELECT) data[i] = model->page;
+		else data[i] = value ? *value : 0;
+	}
+	return 0;
+}
+
+static void vl_write_page0(vl53l5cx_model *model, uint16_t reg, uint8_t value)
+{
+	uint8_t *mem = model->mem[0];
+
+	switch(reg)
+	{
+	case 0x04:
+		/* New address, used from the next transfer on */
+		model->device.address = (uint16_t)value << 1;
+		break;
+	case 0x14:
+		/* MCU stop: GO2 status reports it, the ranging ends */
+		if(value & 0x01)
+		{
+			mem[0x06] |= 0x80;
+			mem[0x07] = 0x84;
+			model->ranging = 0;
+		}
+		else
+		{
+			mem[0x06] &= (uint8_t)~0x80;
+			mem[0x07] = 0;
+		}
+		break;
+	case 0x00:
+	case 0x01:
+	case 0x06:
+	case 0x07:
+		return;		/* Identification and GO2 status are read only */
+	default:
+		break;
+	}
+	mem[reg & (VL53L5CX_MODEL_PAGE_SIZE - 1)] = value;
+}
+
+static int vl_write(hal_stub_device *device, uint16_t reg, const uint8_t *data, uint16_t size)
+{
+	vl53l5cx_model *model = device->model;
+
+	if(reg == VL_PAGE_SELECT && size == 1)
+	{
+		model->page = data[0];
+		return 0;
+	}
+	if(model->page >= 0x09)
+	{
+		/* Firmware download, not executed */
+		model->firmware_bytes += size;
+		return 0;
+	}
+	if(model->page == 0)
+	{
+		for(uint32_t i = 0; i < size; i++) vl_write_page0(model, (uint16_t)(reg + i), data[i]);
+		return 0;
+	}
+	for(uint32_t i = 0; i < size; i++)
+	{
+		uint8_t *value = vl_register(model, (uint16_t)(reg + i));
+		if(value) *value = data[i];
+	}
+	if(model->page == 1)
+	{
+		model->mem[1][0x21] = 0x10;		/* Firmware access always granted */
+	}
+	else if(model->page == 2 && reg <= VL53L5CX_UI_CMD_END && (uint32_t)reg + size >= VL53L5CX_UI_CMD_END)
+	{
+		/* Commands are written so they end at UI_CMD_END */
+		vl_command(model, &model->mem[2][reg], size);
+	}
+	return 0;
+}
+
+void vl53l5cx_model_init(vl53l5cx_model *model, I2C_HandleTypeDef *hi2c, uint16_t int_pin, uint16_t base_mm)
+{
+	memset(model, 0, sizeof(*model));
+	model->device.hi2c = hi2c;
+	model->device.address = VL53L5CX_DEFAULT_I2C_ADDRESS;
+	model->device.read = vl_read;
+	model->device.write = vl_write;
+	model->device.model = model;
+	model->int_pin = int_pin;
+	model->base_mm = base_mm;
+	model->streamcount = 254;
+
+	model->mem[0][0x00] = 0xF0;		/* Device id */
+	model->mem[0][0x01] = 0x02;		/* Revision id */
+	model->mem[0][0x06] = 0x01;		/* GO2 status 0: MCU booted */
+	model->mem[0][0x09] = 0x04;		/* Power mode: wake up */
+	model->mem[1][0x21] = 0x10;
+	vl_set_cmd_status(model);
+	hal_stub_attach(&model->device);
+}
+
+/* AMG8833 -------------------------------------------------------------------*/
+int16_t amg8833_model_pixel(uint32_t frame, int pixel)
+{
+	/* The first row is below zero, so the sign of the registers is exercised */
+	return (int16_t)(80 + pixel + (frame % 4) * 4 - (pixel < 8 ? 160 : 0));
+}
+
+static void amg_tick(void *arg)
+{
+	amg8833_model *model = arg;
+	uint32_t period_us = (model->regs[AMG88xx_FPSC] & 0x01) ? 1000000 : 100000;
+
+	for(int p = 0; p < AMG88xx_PIXEL_ARRAY_SIZE; p++)
+	{
+		int16_t value = amg8833_model_pixel(model->frames, p);
+		/* 12-bit two's complement, as in the datasheet */
+		uint16_t raw = (uint16_t)value & 0x0FFF;
+		model->regs[AMG88xx_PIXEL_OFFSET + 2*p] = (uint8_t)raw;
+		model->regs[AMG88xx_PIXEL_OFFSET + 2*p + 1] = (uint8_t)(raw >> 8);
+	}
+	model->frames++;
+	hal_stub_schedule(hal_stub_now_us() + period_us, amg_tick, model, 1);
+}
+
+static int amg_read(hal_stub_device *device, uint16_t reg, uint8_t *data, uint16_t size)
+{
+	amg8833_model *model = device->model;
+
+	for(uint32_t i = 0; i < size; i++) data[i] = model->regs[(reg + i) & 0xff];
+	return 0;
+}
+
+static int amg_write(hal_stub_device *device, uint16_t reg, const uint8_t *data, uint16_t size)
+{
+	amg8833_model *model = device->model;
+
+	for(uint32_t i = 0; i < size; i++)
+	{
+		uint8_t address = (uint8_t)(reg + i);
+		if(address < AMG88xx_PIXEL_OFFSET) model->regs[address] = data[i];
+	}
+	return 0;
+}
+
+void amg8833_model_init(amg8833_model *model, I2C_HandleTypeDef *hi2c)
+{
+	memset(model, 0, sizeof(*model));
+	model->device.hi2c = hi2c;
+	model->device.address = AMG88xx_ADDRESS << 1;
+	model->device.read = amg_read;
+	model->device.write = amg_write;
+	model->device.model = model;
+	/* Frame 0 is in the registers from power on */
+	amg_tick(model);
+	hal_stub_attach(&model->device);
+}
+
+/* MLX90640 ------------------------------------------------------------------*/
+#define MLX_STATUS_SUBPAGE		0x0001
+#define MLX_STATUS_NEW_DATA		0x0008
+#define MLX_CTRL_DEFAULT		0x1901
+
+static uint16_t mlx_synthetic_images[2 * MLX90640_MODEL_FRAME_WORDS];
+
+/*
+ * Calibration of the order of the MLX90640 datasheet example, encoded the way
+ * MLX90640_ExtractParameters() decodes it (kVdd -3168, vdd25 -13088, KtPTAT
+ * 42.25, alpha about 1.2e-7, offsets about -60 and so on).
+ */
+static void mlx_synthetic_eeprom(uint16_t *ee)
+{
+	memset(ee, 0, MLX90640_MODEL_EEPROM_WORDS * sizeof(uint16_t));
+	ee[16] = 0x4220;			/* alphaPTAT 9, offset row and column scales */
+	ee[17] = (uint16_t)-60;		/* Offset reference */
+	ee[32] = 0x7005;			/* Alpha scale, per pixel scale */
+	ee[33] = 16490;				/* Alpha reference */
+	ee[48] = 5580;				/* Gain */
+	ee[49] = 12273;				/* VPTAT25 */
+	ee[50] = 0x2552;			/* KvPTAT, KtPTAT */
+	ee[51] = 0x9D67;			/* kVdd, vdd25 */
+	ee[52] = 0x4433;			/* Kv */
+	ee[53] = 0x0101;			/* Interleaved and chess corrections */
+	ee[54] = 0x5252;			/* Kta, row and column pairs */
+	ee[55] = 0x5252;
+	ee[56] = 0x2363;			/* Resolution, Kv and Kta scales */
+	ee[57] = 0xF046;			/* Compensation pixel alpha */
+	ee[58] = 0x0BB5;			/* Compensation pixel offsets -75 and -73 */
+	ee[59] = 0x0346;			/* Compensation pixel Kv and Kta */
+	ee[60] = 0xEC00;			/* KsTa, TGC */
+	ee[61] = 0xE6E6;			/* KsTo per range */
+	ee[62] = 0xE6E6;
+	ee[63] = 0x2889;			/* Corner temperatures, KsTo scale */
+	for(int p = 0; p < 768; p++)
+	{
+		int offset = (p * 13) % 15 - 7;
+		int alpha = (p * 37) % 41 - 20;
+		int kta = (p * 7) % 7 - 3;
+		uint16_t word = (uint16_t)(((offset & 0x3f) << 10) | ((alpha & 0x3f) << 4) | ((kta & 0x7) << 1));
+		/* A zero word marks a broken pixel */
+		ee[64 + p] = word ? word : 0x0400;
+	}
+}
+
+/* The two subpages of a scene with a gradient, like the frames of mlx90640_check */
+static void mlx_synthetic_frames(uint16_t *images)
+{
+	for(int n = 0; n < 2; n++)
+	{
+		uint16_t *frame = &images[n * MLX90640_MODEL_FRAME_WORDS];
+		for(int i = 0; i < 768; i++)
+			frame[i] = (uint16_t)(int16_t)(-700 + (int)((i % 32) * 97 + (i / 32) * 131 + n * 53) % 9000);
+		frame[768] = 19442;						/* VBE */
+		frame[776] = (uint16_t)(int16_t)-75;	/* cp subpage 0 */
+		frame[778] = 5780;						/* gain */
+		frame[800] = 1711;						/* VPTAT */
+		frame[808] = (uint16_t)(int16_t)-71;	/* cp subpage 1 */
+		frame[810] = (uint16_t)(int16_t)-13115;	/* vdd */
+		frame[832] = MLX_CTRL_DEFAULT;
+		frame[833] = (uint16_t)n;
+	}
+}
+
+const uint16_t *mlx90640_model_image(const mlx90640_model *model, uint32_t frame)
+{
+	return &model->images[(frame % model->image_count) * MLX90640_MODEL_FRAME_WORDS];
+}
+
+/* Copies the next image to RAM and flags it in the status register */
+static void mlx_next_subpage(mlx90640_model *model)
+{
+	const uint16_t *image = mlx90640_model_image(model, model->frames);
+	uint16_t *status = &model->words[MLX90640_STAT_REG];
+
+	model->subpage = image[833] & MLX_STATUS_SUBPAGE;
+	memcpy(&model->words[MLX90640_RAM], image, 832 * sizeof(uint16_t));
+	*status = (uint16_t)((*status & ~(MLX_STATUS_SUBPAGE | MLX_STATUS_NEW_DATA)) | MLX_STATUS_NEW_DATA | model->subpage);
+	model->frames++;
+}
+
+static void mlx_tick(void *arg)
+{
+	mlx90640_model *model = arg;
+	uint16_t ctrl = model->words[MLX90640_CTRL_REG1];
+
+	mlx_next_subpage(model);
+	/* Refresh rate code n stands for 0.5 * 2^n subpages per second */
+	hal_stub_schedule(hal_stub_now_us() + (2000000u >> ((ctrl >> 7) & 0x7)), mlx_tick, model, 1);
+}
+
+static int mlx_read(hal_stub_device *device, uint16_t reg, uint8_t *data, uint16_t size)
+{
+	mlx90640_model *model = device->model;
+	/* A subpage coming in while the RAM is read: the second half is of the new one */
+	uint32_t collision = (reg == MLX90640_RAM && model->collisions) ? size / 4u : UINT32_MAX;
+
+	for(uint32_t j = 0; j < size / 2u; j++)
+	{
+		if(j == collision)
+		{
+			model->collisions--;
+			mlx_next_subpage(model);
+		}
+		uint16_t word = model->words[(uint16_t)(reg + j)];
+		data[2*j] = (uint8_t)(word >> 8);
+		data[2*j + 1] = (uint8_t)word;
+	}
+	return 0;
+}
+
+static int mlx_write(hal_stub_device *device, uint16_t reg, const uint8_t *data, uint16_t size)
+{
+	mlx90640_model *model = device->model;
+
+	for(uint32_t j = 0; j < size / 2u; j++)
+	{
+		uint16_t address = (uint16_t)(reg + j);
+		uint16_t value = (uint16_t)((data[2*j] << 8) | data[2*j + 1]);
+
+		if(address == MLX90640_STAT_REG)
+		{
+			/* The subpage bits are read only, writing clears the new data flag */
+			model->words[address] = (uint16_t)((model->words[address] & 0x0007) | (value & 0xFFF0));
+		}
+		else if(address < MLX90640_EE || address >= MLX90640_EE + MLX90640_MODEL_EEPROM_WORDS)
+		{
+			model->words[address] = value;
+		}
+	}
+	return 0;
+}
+
+void mlx90640_model_init(mlx90640_model *model, I2C_HandleTypeDef *hi2c, const uint16_t *eeprom,
+		const uint16_t *images, uint32_t image_count)
+{
+	memset(model, 0, sizeof(*model));
+	model->device.hi2c = hi2c;
+	model->device.address = MLX90640_ADDR;
+	model->device.read = mlx_read;
+	model->device.write = mlx_write;
+	model->device.model = model;
+
+	if(eeprom)
+	{
+		memcpy(&model->words[MLX90640_EE], eeprom, MLX90640_MODEL_EEPROM_WORDS * sizeof(uint16_t));
+	}
+	else
+	{
+		mlx_synthetic_eeprom(&model->words[MLX90640_EE]);
+	}
+	if(images && image_count)
+	{
+		model->images = images;
+		model->image_count = image_count;
+	}
+	else
+	{
+		mlx_synthetic_frames(mlx_synthetic_images);
+		model->images = mlx_synthetic_images;
+		model->image_count = 2;
+	}
+	model->words[MLX90640_CTRL_REG1] = MLX_CTRL_DEFAULT;
+
+	hal_stub_schedule(2000000u >> ((MLX_CTRL_DEFAULT >> 7) & 0x7), mlx_tick, model, 1);
+	hal_stub_attach(&model->device);
+}
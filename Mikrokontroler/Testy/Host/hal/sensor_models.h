@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file    sensor_models.h
+  * @brief   Register models of the VL53L5CX, AMG8833 and MLX90640.
+  ******************************************************************************
+  * Each model is a hal_stub_device that answers the register accesses of the
+  * unmodified drivers and produces new data on the virtual clock. The data is
+  * a function of the frame number, so the received frames can be checked
+  * against the values the model had in its registers.
+  *
+  * VL53L5CX: the firmware download is accepted and dropped; the DCI commands
+  * of the driver (read, write, start ranging) run on a DCI memory image. While
+  * ranging, every period a results frame in the layout of the OUTPUT_LIST set
+  * by vl53l5cx_start_ranging() is placed at address 0 and INT is signalled
+  * through HAL_GPIO_EXTI_Callback().
+  *
+  * MLX90640: the EEPROM and the frames can be loaded from the dumps used by
+  * mlx90640_check; otherwise a calibration of the order of the datasheet
+  * example and two subpage images are synthesized.
+  ******************************************************************************
+  */
+#ifndef SENSOR_MODELS_H
+#define SENSOR_MODELS_H
+
+#include <stdint.h>
+
+#include "hal_stub.h"
+
+#define VL53L5CX_MODEL_PAGE_SIZE	0x8000
+#define MLX90640_MODEL_EEPROM_WORDS	832
+#define MLX90640_MODEL_FRAME_WORDS	834
+
+typedef struct
+{
+	hal_stub_device device;
+	uint16_t int_pin;				/* EXTI line signalled with every frame */
+	uint16_t base_mm;				/* Distance of zone 0 in frame 0 */
+	uint8_t page;					/* Selected with register 0x7fff */
+	uint8_t mem[3][VL53L5CX_MODEL_PAGE_SIZE];	/* Pages 0, 1 and 2 */
+	uint8_t dci[0x10000];			/* DCI variables, as on the wire (big-endian words) */
+	uint8_t ranging;
+	uint8_t streamcount;
+	uint16_t frame_size;
+	uint32_t period_us;
+	uint64_t next_tick_us;
+	uint32_t frames;				/* Frames produced, the last one is frames - 1 */
+	uint32_t firmware_bytes;
+} vl53l5cx_model;
+
+typedef struct
+{
+	hal_stub_device device;
+	uint8_t regs[256];
+	uint32_t frames;
+} amg8833_model;
+
+typedef struct
+{
+	hal_stub_device device;
+	uint16_t words[0x10000];		/* Register map, indexed by word address */
+	const uint16_t *images;			/* Frames cycled through, MLX90640_MODEL_FRAME_WORDS each */
+	uint32_t image_count;
+	uint8_t subpage;
+	uint32_t frames;				/* Subpages produced */
+	uint32_t collisions;			/* RAM reads still to be hit by the next subpage halfway */
+} mlx90640_model;
+
+void vl53l5cx_model_init(vl53l5cx_model *model, I2C_HandleTypeDef *hi2c, uint16_t int_pin, uint16_t base_mm);
+/* Distance of a zone in a frame, in millimetres */
+int16_t vl53l5cx_model_distance(const vl53l5cx_model *model, uint32_t frame, int zone);
+/*
+ * Per target: every fourth zone sees a second target (a wall behind glass),
+ * every sixteenth has an invalid first target. Targets not detected have
+ * distance, sigma and signal 0.
+ */
+uint8_t vl53l5cx_model_targets(int zone);
+int16_t vl53l5cx_model_target_distance(const vl53l5cx_model *model, uint32_t frame, int zone, int target);
+uint8_t vl53l5cx_model_status(int zone, int target);	/* 0 for a target not detected */
+uint16_t vl53l5cx_model_sigma(int zone, int target);	/* Millimetres */
+uint32_t vl53l5cx_model_signal(int zone, int target);	/* kcps per SPAD */
+
+void amg8833_model_init(amg8833_model *model, I2C_HandleTypeDef *hi2c);
+/* Pixel temperature in a frame, in quarters of a degree */
+int16_t amg8833_model_pixel(uint32_t frame, int pixel);
+
+/*
+ * eeprom and images may be NULL for the synthetic ones; images holds
+ * image_count frames as returned by MLX90640_GetFrameData() and must stay
+ * valid while the model is used.
+ */
+void mlx90640_model_init(mlx90640_model *model, I2C_HandleTypeDef *hi2c, const uint16_t *eeprom,
+		const uint16_t *images, uint32_t image_count);
+/* Frame copied to RAM by the given subpage tick */
+const uint16_t *mlx90640_model_image(const mlx90640_model *model, uint32_t frame);
+
+#endif /* SENSOR_MODELS_H */
@@ -0,0 +1,7 @@
+/* Device header of the stub HAL, included by platform.h */
+#ifndef STM32L4XX_STUB_H
+#define STM32L4XX_STUB_H
+
+#include "stm32l4xx_hal.h"
+
+#endif /* STM32L4XX_STUB_H */
@@ -0,0 +1,278 @@
+/**
+  ******************************************************************************
+  * @file    stm32l4xx_hal.h
+  * @brief   Stub of the STM32L4 HAL for building the firmware on a PC.
+  ******************************************************************************
+  * Declares the part of the HAL used by main.c, i2c_bus.c, uart_tx.c, uart_rx.c
+  * and the sensor drivers, and the CMSIS intrinsics they call. The implementation in
+  * hal_stub.c runs on a virtual clock; the I2C devices are the register models
+  * of sensor_models.c. This directory comes before ../Core/Inc in the include
+  * path, so the CubeMX headers pick up these definitions.
+  ******************************************************************************
+  */
+#ifndef STM32L4XX_HAL_STUB_H
+#define STM32L4XX_HAL_STUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+	HAL_OK = 0,
+	HAL_ERROR,
+	HAL_BUSY,
+	HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY		0xFFFFFFFFU
+
+/* Peripherals -------------------------------------------------------------*/
+typedef struct
+{
+	volatile uint32_t CNT;
+} TIM_TypeDef;
+
+typedef struct
+{
+	volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct
+{
+	uint32_t index;
+} I2C_TypeDef;
+
+typedef struct
+{
+	uint32_t index;
+} USART_TypeDef;
+
+/* Cycle counter; CYCCNT is brought up to date by every access through DWT */
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct
+{
+	volatile uint32_t CR;
+} DBGMCU_TypeDef;
+
+#define DWT_CTRL_CYCCNTENA_Msk			0x00000001U
+#define CoreDebug_DEMCR_TRCENA_Msk		0x01000000U
+#define DBGMCU_CR_DBG_SLEEP				0x00000001U
+
+DWT_Type *hal_stub_dwt(void);
+#define DWT					(hal_stub_dwt())
+extern CoreDebug_Type *CoreDebug;
+extern DBGMCU_TypeDef *DBGMCU;
+
+extern GPIO_TypeDef *GPIOA, *GPIOB, *GPIOC, *GPIOH;
+extern TIM_TypeDef *TIM2;
+extern I2C_TypeDef *I2C1, *I2C2;
+extern USART_TypeDef *USART2;
+
+/* Handles, with the fields the firmware reads ------------------------------*/
+typedef struct
+{
+	uint32_t Timing;
+	uint32_t OwnAddress1;
+	uint32_t AddressingMode;
+	uint32_t DualAddressMode;
+	uint32_t OwnAddress2;
+	uint32_t OwnAddress2Masks;
+	uint32_t GeneralCallMode;
+	uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef struct
+{
+	I2C_TypeDef *Instance;
+	I2C_InitTypeDef Init;
+} I2C_HandleTypeDef;
+
+typedef struct
+{
+	uint32_t BaudRate;
+	uint32_t WordLength;
+	uint32_t StopBits;
+	uint32_t Parity;
+	uint32_t Mode;
+	uint32_t HwFlowCtl;
+	uint32_t OverSampling;
+	uint32_t OneBitSampling;
+} UART_InitTypeDef;
+
+/* CNDTR counts down the bytes left until the circular buffer wraps */
+typedef struct
+{
+	volatile uint32_t CNDTR;
+} DMA_Channel_TypeDef;
+
+typedef struct
+{
+	DMA_Channel_TypeDef *Instance;
+} DMA_HandleTypeDef;
+
+typedef struct
+{
+	USART_TypeDef *Instance;
+	UART_InitTypeDef Init;
+	DMA_HandleTypeDef *hdmarx;
+	volatile uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+#define HAL_UART_ERROR_PE				0x01U
+#define HAL_UART_ERROR_NE				0x02U
+#define HAL_UART_ERROR_FE				0x04U
+#define HAL_UART_ERROR_ORE				0x08U
+
+#define __HAL_DMA_GET_COUNTER(__HANDLE__)	((__HANDLE__)->Instance->CNDTR)
+
+/* No idle line interrupt: every received byte is an event of the virtual clock */
+#define UART_IT_IDLE					0U
+#define UART_FLAG_IDLE					0U
+#define __HAL_UART_ENABLE_IT(__HANDLE__, __INTERRUPT__)	((void)(__HANDLE__))
+#define __HAL_UART_GET_FLAG(__HANDLE__, __FLAG__)		0
+#define __HAL_UART_CLEAR_IDLEFLAG(__HANDLE__)			((void)(__HANDLE__))
+
+typedef struct
+{
+	uint32_t Prescaler;
+	uint32_t CounterMode;
+	uint32_t Period;
+	uint32_t ClockDivision;
+	uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct
+{
+	TIM_TypeDef *Instance;
+	TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+typedef enum
+{
+	GPIO_PIN_RESET = 0,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0			((uint16_t)0x0001)
+#define GPIO_PIN_1			((uint16_t)0x0002)
+#define GPIO_PIN_2			((uint16_t)0x0004)
+#define GPIO_PIN_3			((uint16_t)0x0008)
+#define GPIO_PIN_4			((uint16_t)0x0010)
+#define GPIO_PIN_5			((uint16_t)0x0020)
+#define GPIO_PIN_6			((uint16_t)0x0040)
+#define GPIO_PIN_7			((uint16_t)0x0080)
+#define GPIO_PIN_8			((uint16_t)0x0100)
+#define GPIO_PIN_9			((uint16_t)0x0200)
+#define GPIO_PIN_10			((uint16_t)0x0400)
+#define GPIO_PIN_11			((uint16_t)0x0800)
+#define GPIO_PIN_12			((uint16_t)0x1000)
+#define GPIO_PIN_13			((uint16_t)0x2000)
+#define GPIO_PIN_14			((uint16_t)0x4000)
+#define GPIO_PIN_15			((uint16_t)0x8000)
+
+typedef enum
+{
+	EXTI4_IRQn = 10,
+	EXTI9_5_IRQn = 23,
+	USART2_IRQn = 38,
+	EXTI15_10_IRQn = 40
+} IRQn_Type;
+
+#define I2C_MEMADD_SIZE_8BIT		1U
+#define I2C_MEMADD_SIZE_16BIT		2U
+
+/* Clock configuration, only so SystemClock_Config() compiles ----------------*/
+typedef struct
+{
+	uint32_t PLLState;
+	uint32_t PLLSource;
+	uint32_t PLLM;
+	uint32_t PLLN;
+	uint32_t PLLP;
+	uint32_t PLLQ;
+	uint32_t PLLR;
+} RCC_PLLInitTypeDef;
+
+typedef struct
+{
+	uint32_t OscillatorType;
+	uint32_t HSIState;
+	uint32_t HSICalibrationValue;
+	RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+
+typedef struct
+{
+	uint32_t ClockType;
+	uint32_t SYSCLKSource;
+	uint32_t AHBCLKDivider;
+	uint32_t APB1CLKDivider;
+	uint32_t APB2CLKDivider;
+} RCC_ClkInitTypeDef;
+
+#define PWR_REGULATOR_VOLTAGE_SCALE1	0U
+#define RCC_OSCILLATORTYPE_HSI			0U
+#define RCC_HSI_ON						0U
+#define RCC_HSICALIBRATION_DEFAULT		0U
+#define RCC_PLL_ON						0U
+#define RCC_PLLSOURCE_HSI				0U
+#define RCC_PLLP_DIV7					0U
+#define RCC_PLLQ_DIV2					0U
+#define RCC_PLLR_DIV2					0U
+#define RCC_CLOCKTYPE_HCLK				0U
+#define RCC_CLOCKTYPE_SYSCLK			0U
+#define RCC_CLOCKTYPE_PCLK1				0U
+#define RCC_CLOCKTYPE_PCLK2				0U
+#define RCC_SYSCLKSOURCE_PLLCLK			0U
+#define RCC_SYSCLK_DIV1					0U
+#define RCC_HCLK_DIV1					0U
+#define FLASH_LATENCY_4					0U
+
+HAL_StatusTypeDef HAL_PWREx_ControlVoltageScaling(uint32_t VoltageScaling);
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+
+/* HAL functions -------------------------------------------------------------*/
+HAL_StatusTypeDef HAL_Init(void);
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_GetTick(void);
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+		uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+/* CMSIS intrinsics; interrupts are the events of the virtual clock */
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+uint32_t __get_IPSR(void);
+void __WFI(void);
+
+#endif /* STM32L4XX_HAL_STUB_H */
@@ -0,0 +1,599 @@
+/**
+  ******************************************************************************
+  * @file    integrator_sim.c
+  * @brief   Pseudo-terminal simulator of the integrator firmware.
+  ******************************************************************************
+  * Opens a pty and behaves like main.c on the board:
+  *  - boot messages and the menu,
+  *  - mode letters A..I select the sensors exactly like the main loop,
+  *  - every bare command byte is answered like process_commands() ("Flaga: x"
+  *    followed by the echoed byte), command frames get an acknowledgement
+  *    instead,
+  *  - T/U/K switch between ASCII, binary and coded binary frames, Q returns
+  *    the capability descriptor (also sent after boot), V<n>/W run the baud rate
+  *    negotiation (the pty ignores the rate itself),
+  *  - VL53L5CX, AMG8833 and MLX90640 frames with synthetic data.
+  *
+  * The commands added to the firmware after these are not simulated: the raw
+  * and subpage outputs of the thermal sensors (M, L, N, R, S), the AMG8833
+  * configuration (O), the VL53L5CX outputs and fields (Y, X), the series (J),
+  * the cycle budget (P) and the MLX90640 refresh rate (Z). A command frame
+  * holding one of them is acknowledged as INTEGRATOR_ACK_UNKNOWN, a bare
+  * byte is answered "Nieobslugiwany przypadek" like any unknown byte.
+  *
+  * The frame rates, the number and resolution of the VL53L5CX and the
+  * probability of corrupting a frame are set on the command line, so the host
+  * can be loaded far beyond the real sensors. Point the application at the
+  * printed device, e.g.
+  *
+  *   ./integrator_sim --rate 100 --corrupt 0.01 --link /tmp/ttyINT
+  *   EX --port /tmp/ttyINT
+  ******************************************************************************
+  */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "integrator_protocol.h"
+#include "integrator_crc16.h"
+#include "integrator_codec.h"
+#include "integrator_command.h"
+
+#define OUT_BUFFER_SIZE		(1 << 20)
+#define TEXT_FRAME_SIZE		8192
+#define TOF_DEADBAND_MM		5
+
+/* Same order as integrator_sensor_slot() */
+enum { SIM_VL1, SIM_VL2, SIM_AMG, SIM_MLX, SIM_VL3, SIM_VL4, SIM_SENSORS };
+
+typedef struct
+{
+	char id;
+	double rate_hz;
+	uint64_t next_due_us;
+	uint16_t sequence;
+	uint64_t sent;
+	uint64_t corrupted;
+	uint64_t overruns;
+	uint64_t bytes;
+	integrator_codec_state codec;
+	int16_t reference[INTEGRATOR_MAX_VALUES];
+} sim_sensor;
+
+static sim_sensor sensors[SIM_SENSORS] = {
+	{ .id = INTEGRATOR_ID_VL53L5CX_1, .rate_hz = 1.0 },
+	{ .id = INTEGRATOR_ID_VL53L5CX_2, .rate_hz = 1.0 },
+	{ .id = INTEGRATOR_ID_AMG8833,    .rate_hz = 1.0 },
+	{ .id = INTEGRATOR_ID_MLX90640,   .rate_hz = 1.0 },
+	{ .id = INTEGRATOR_ID_VL53L5CX_3, .rate_hz = 1.0 },
+	{ .id = INTEGRATOR_ID_VL53L5CX_4, .rate_hz = 1.0 },
+};
+
+static int master_fd = -1;
+static uint8_t out_buffer[OUT_BUFFER_SIZE];
+static size_t out_len = 0;
+
+static char flag = 'B';
+static int binary_format = 0;
+static int coded_format = 0;
+static int static_scene = 0;
+static int vl_resolution = 64;
+static int vl_count = 2;
+static double corrupt_probability = 0.0;
+static int baud_argument = 0;
+static uint32_t baud_rate = INTEGRATOR_BAUD_DEFAULT;
+static int baud_switching = 0;
+static uint16_t control_sequence = 0;
+static integrator_command_parser command_parser;
+
+static volatile sig_atomic_t running = 1;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+static int is_vl(int slot)
+{
+	return slot == SIM_VL1 || slot == SIM_VL2 || slot == SIM_VL3 || slot == SIM_VL4;
+}
+
+/* Sensors of the simulated board, --vl-count sets how many VL53L5CX it has */
+static int is_present(int slot)
+{
+	if(slot == SIM_VL3) return vl_count >= 3;
+	if(slot == SIM_VL4) return vl_count >= 4;
+	if(slot == SIM_VL2) return vl_count >= 2;
+	return 1;
+}
+
+static double random_unit(void)
+{
+	return rand() / ((double)RAND_MAX + 1.0);
+}
+
+/* Sends what fits into the pty, keeps the rest for later */
+static void flush_output(void)
+{
+	while(out_len > 0)
+	{
+		ssize_t n = write(master_fd, out_buffer, out_len);
+		if(n <= 0) break;
+		memmove(out_buffer, out_buffer + n, out_len - n);
+		out_len -= n;
+	}
+}
+
+/* Queues a whole frame or nothing, like a full transmit buffer on the board */
+static int queue_output(const void *data, size_t len)
+{
+	if(out_len + len > OUT_BUFFER_SIZE) return 0;
+	memcpy(out_buffer + out_len, data, len);
+	out_len += len;
+	return 1;
+}
+
+static void queue_text(const char *format, ...)
+{
+	char text[256];
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	if(len > 0) queue_output(text, len < (int)sizeof(text) ? (size_t)len : sizeof(text) - 1);
+}
+
+static void corrupt(uint8_t *data, size_t len, sim_sensor *sensor)
+{
+	if(corrupt_probability <= 0.0 || random_unit() >= corrupt_probability) return;
+	data[rand() % len] ^= (uint8_t)(1u << (rand() % 8));
+	sensor->corrupted++;
+}
+
+/* Synthetic readings: a moving gradient for the distances, a warm spot for the temperatures */
+static float sample_value(int slot, int index, int count, double t)
+{
+	if(static_scene) t = 0;
+
+	int width = (count == 16) ? 4 : (count == 64) ? 8 : 32;
+	int x = index % width, y = index / width;
+
+	if(is_vl(slot))
+	{
+		return (float)(800.0 + 300.0 * sin(t + 0.3 * x) + 40.0 * y + (rand() % 11) - 5);
+	}
+
+	double cx = width / 2.0 + width / 4.0 * sin(t), cy = (count / width) / 2.0;
+	double d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+	return (float)(22.0 + 12.0 * exp(-d2 / (width * 0.8)) + 0.05 * ((rand() % 21) - 10));
+}
+
+static void send_frame(int slot, uint64_t timestamp)
+{
+	sim_sensor *sensor = &sensors[slot];
+	int count = (slot == SIM_MLX) ? INTEGRATOR_MLX90640_VALUES
+			: (slot == SIM_AMG) ? INTEGRATOR_AMG8833_VALUES : vl_resolution;
+	int thermal = (slot == SIM_AMG || slot == SIM_MLX);
+	double t = timestamp / 1e6;
+
+	if(binary_format)
+	{
+		uint8_t frame[INTEGRATOR_MAX_FRAME];
+		uint8_t values[INTEGRATOR_MAX_PAYLOAD];
+		uint8_t id = sensor->id;
+		uint16_t payload_len = 2*count;
+		for(int i = 0; i < count; i++)
+		{
+			float value = sample_value(slot, i, count, t);
+			integrator_put_i16(&values[2*i], thermal ? integrator_temp_to_wire(value) : (int16_t)value);
+		}
+		if(coded_format)
+		{
+			/* Same coding as send_binary_frame() in main.c */
+			payload_len = integrator_codec_encode(&sensor->codec, thermal ? INTEGRATOR_CODEC_DELTA : INTEGRATOR_CODEC_ZONES,
+					values, count, thermal ? 0 : TOF_DEADBAND_MM, &frame[INTEGRATOR_HEADER_SIZE]);
+			id |= INTEGRATOR_ID_CODED;
+		}
+		else
+		{
+			memcpy(&frame[INTEGRATOR_HEADER_SIZE], values, payload_len);
+		}
+		integrator_put_header(frame, id, payload_len, sensor->sequence, (uint32_t)timestamp);
+		uint16_t len = integrator_put_crc(frame, payload_len);
+		corrupt(frame, len, sensor);
+		if(!queue_output(frame, len)) { sensor->overruns++; return; }
+		sensor->bytes += len;
+	}
+	else
+	{
+		/* Same text and CRC coverage as ascii_print() in main.c */
+		char text[TEXT_FRAME_SIZE];
+		int len = 0;
+		int size_field = thermal ? count * (int)sizeof(float) + 6 : count * (int)sizeof(int16_t) + 6;
+		len += snprintf(text + len, sizeof(text) - len, "%c %d ", sensor->id, size_field);
+		for(int i = 0; i < count; i++)
+		{
+			float value = sample_value(slot, i, count, t);
+			if(thermal) len += snprintf(text + len, sizeof(text) - len, "%2.2f ", value);
+			else len += snprintf(text + len, sizeof(text) - len, "%d ", (int16_t)value);
+		}
+		uint16_t crc = integrator_crc16(text, len);
+		len += snprintf(text + len, sizeof(text) - len, "%04X Y\r\n", crc);
+		corrupt((uint8_t *)text, len, sensor);
+		if(!queue_output(text, len)) { sensor->overruns++; return; }
+		sensor->bytes += len;
+	}
+	sensor->sequence++;
+	sensor->sent++;
+}
+
+static void send_baud_frame(uint32_t rate, uint8_t state)
+{
+	uint8_t frame[INTEGRATOR_HEADER_SIZE + 5 + INTEGRATOR_CRC_SIZE];
+	integrator_put_header(frame, INTEGRATOR_ID_BAUD, 5, control_sequence++, (uint32_t)now_us());
+	integrator_put_u32(&frame[INTEGRATOR_HEADER_SIZE], rate);
+	frame[INTEGRATOR_HEADER_SIZE + 4] = state;
+	queue_output(frame, integrator_put_crc(frame, 5));
+}
+
+/* Same descriptor as send_capabilities_frame() in main.c, with the simulated rates */
+static void send_capabilities_frame(void)
+{
+	uint8_t frame[INTEGRATOR_HEADER_SIZE + INTEGRATOR_CAPS_HEADER_SIZE
+			+ SIM_SENSORS * INTEGRATOR_CAPS_ENTRY_SIZE + INTEGRATOR_CRC_SIZE];
+	uint8_t *payload = &frame[INTEGRATOR_HEADER_SIZE];
+	uint8_t side = vl_resolution == 16 ? 4 : 8;
+	uint8_t count = 0;
+
+	payload[0] = INTEGRATOR_CAPS_VERSION;
+	payload[1] = INTEGRATOR_COMMAND_VERSION_MAJOR;
+	payload[2] = INTEGRATOR_COMMAND_VERSION_MINOR;
+	for(int i = 0; i < SIM_SENSORS; i++)
+	{
+		if(!is_present(i)) continue;
+		uint8_t *entry = &payload[INTEGRATOR_CAPS_HEADER_SIZE + count++ * INTEGRATOR_CAPS_ENTRY_SIZE];
+		uint16_t rate = (uint16_t)(sensors[i].rate_hz * 100 + 0.5);
+		if(i == SIM_MLX)
+			integrator_put_caps_entry(entry, sensors[i].id, INTEGRATOR_DATA_TEMP_CENTI, 32, 24, rate, INTEGRATOR_CAPS_PRESENT);
+		else if(i == SIM_AMG)
+			integrator_put_caps_entry(entry, sensors[i].id, INTEGRATOR_DATA_TEMP_CENTI, 8, 8, rate, INTEGRATOR_CAPS_PRESENT);
+		else
+			integrator_put_caps_entry(entry, sensors[i].id, INTEGRATOR_DATA_DISTANCE_MM, side, side, rate, INTEGRATOR_CAPS_PRESENT);
+	}
+	payload[3] = count;
+	const uint16_t len = INTEGRATOR_CAPS_HEADER_SIZE + count * INTEGRATOR_CAPS_ENTRY_SIZE;
+	integrator_put_header(frame, INTEGRATOR_ID_CAPABILITIES, len, control_sequence++, (uint32_t)now_us());
+	queue_output(frame, integrator_put_crc(frame, len));
+}
+
+/* Sensors read by the main loop of main.c in the given mode */
+static int mode_uses(char mode, int slot)
+{
+	if(!is_present(slot)) return 0;
+
+	switch(mode)
+	{
+	case 'A': return 1;
+	case 'B': return slot == SIM_VL1;
+	case 'C': return slot == SIM_VL2;
+	case 'D': return slot == SIM_MLX;
+	case 'E': return slot == SIM_AMG;
+	case 'F': return slot != SIM_MLX;
+	case 'G': return slot != SIM_AMG;
+	case 'H': return is_vl(slot);
+	case 'I': return slot == SIM_MLX || slot == SIM_AMG;
+	default:  return 0;
+	}
+}
+
+/* Carries out one command byte, returns 0 for a byte that is no command */
+static int run_command(uint8_t c)
+{
+	if(baud_argument)
+	{
+		int index = c - '0';
+		baud_argument = 0;
+		if(index < 0 || index >= INTEGRATOR_BAUD_RATE_COUNT)
+		{
+			send_baud_frame(baud_rate, INTEGRATOR_BAUD_REJECTED);
+			return 1;
+		}
+		const uint32_t rates[INTEGRATOR_BAUD_RATE_COUNT] = INTEGRATOR_BAUD_RATES;
+		baud_rate = rates[index];
+		baud_switching = 1;
+		send_baud_frame(baud_rate, INTEGRATOR_BAUD_SWITCHING);
+		return 1;
+	}
+
+	switch(c)
+	{
+	case 'A': case 'B': case 'C': case 'D': case 'E':
+	case 'F': case 'G': case 'H': case 'I':
+		flag = (char)c;
+		break;
+	case INTEGRATOR_CMD_FORMAT_ASCII:
+		binary_format = 0;
+		coded_format = 0;
+		break;
+	case INTEGRATOR_CMD_FORMAT_BINARY:
+		binary_format = 1;
+		coded_format = 0;
+		break;
+	case INTEGRATOR_CMD_FORMAT_CODED:
+		binary_format = 1;
+		coded_format = 1;
+		for(int i = 0; i < SIM_SENSORS; i++) integrator_codec_reset(&sensors[i].codec);
+		break;
+	case INTEGRATOR_CMD_BAUD:
+		baud_argument = 1;
+		break;
+	case INTEGRATOR_CMD_CAPABILITIES:
+		send_capabilities_frame();
+		break;
+	case INTEGRATOR_CMD_BAUD_CONFIRM:
+		if(baud_switching)
+		{
+			baud_switching = 0;
+			send_baud_frame(baud_rate, INTEGRATOR_BAUD_CONFIRMED);
+		}
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+/* Same acknowledgement as run_command_frame() and send_command_ack() in main.c */
+static void run_command_frame(void)
+{
+	uint8_t frame[INTEGRATOR_HEADER_SIZE + INTEGRATOR_ACK_SIZE + INTEGRATOR_CRC_SIZE];
+	const uint8_t *payload = integrator_command_payload(&command_parser);
+	const uint16_t len = integrator_command_length(&command_parser);
+	uint8_t status = INTEGRATOR_ACK_OK;
+	uint8_t commands = 0;
+
+	baud_argument = 0;
+	for(uint16_t i = 0; i < len; i++)
+	{
+		int argument = baud_argument;
+		if(!run_command(payload[i]))
+		{
+			status = INTEGRATOR_ACK_UNKNOWN;
+			break;
+		}
+		if(!argument) commands++;
+	}
+	if(status == INTEGRATOR_ACK_OK && baud_argument)
+	{
+		baud_argument = 0;
+		status = INTEGRATOR_ACK_INCOMPLETE;
+		commands--;
+	}
+
+	integrator_put_header(frame, INTEGRATOR_ID_ACK, INTEGRATOR_ACK_SIZE, control_sequence++, (uint32_t)now_us());
+	integrator_put_ack(&frame[INTEGRATOR_HEADER_SIZE], integrator_command_sequence(&command_parser), status, commands,
+			integrator_command_timestamp(&command_parser));
+	queue_output(frame, integrator_put_crc(frame, INTEGRATOR_ACK_SIZE));
+}
+
+static void handle_command(uint8_t c)
+{
+	switch(integrator_command_feed(&command_parser, c))
+	{
+	case INTEGRATOR_COMMAND_BYTE:
+		break;
+	case INTEGRATOR_COMMAND_FRAME:
+		run_command_frame();
+		return;
+	default:
+		return;
+	}
+
+	/* Argument bytes are not echoed, like on the board */
+	if(baud_argument)
+	{
+		run_command(c);
+		return;
+	}
+	if(!run_command(c)) queue_text("Nieobslugiwany przypadek \n");
+	queue_text("Flaga: %c\n", flag);
+	queue_output(&c, 1);
+}
+
+static void print_stats(void)
+{
+	fprintf(stderr, "tryb %c, %s:", flag, coded_format ? "kodowane" : binary_format ? "binarne" : "ASCII");
+	for(int i = 0; i < SIM_SENSORS; i++)
+	{
+		if(!is_present(i)) continue;
+		fprintf(stderr, " %c wyslane %llu (%llu B/ramke) uszkodzone %llu przepelnienia %llu;", sensors[i].id,
+				(unsigned long long)sensors[i].sent,
+				(unsigned long long)(sensors[i].sent ? sensors[i].bytes / sensors[i].sent : 0),
+				(unsigned long long)sensors[i].corrupted, (unsigned long long)sensors[i].overruns);
+	}
+	fprintf(stderr, "\n");
+}
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Uzycie: %s [opcje]\n"
+		"  --rate HZ        czestotliwosc ramek wszystkich czujnikow (domyslnie 1)\n"
+		"  --vl-rate HZ     czestotliwosc ramek VL53L5CX\n"
+		"  --amg-rate HZ    czestotliwosc ramek AMG8833\n"
+		"  --mlx-rate HZ    czestotliwosc ramek MLX90640\n"
+		"  --vl-res N       liczba stref VL53L5CX: 16 lub 64 (domyslnie 64)\n"
+		"  --vl-count N     liczba czujnikow VL53L5CX: 1..4 (domyslnie 2)\n"
+		"  --corrupt P      prawdopodobienstwo przeklamania bitu w ramce (0..1)\n"
+		"  --mode X         tryb poczatkowy A..I (domyslnie B)\n"
+		"  --binary         ramki binarne od startu\n"
+		"  --coded          ramki binarne kodowane roznicowo od startu\n"
+		"  --static         nieruchoma scena (szum bez ruchu)\n"
+		"  --link PATH      dowiazanie symboliczne do urzadzenia pty\n"
+		"  --seed N         ziarno generatora liczb losowych\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{ "rate",     required_argument, 0, 'r' },
+		{ "vl-rate",  required_argument, 0, 'v' },
+		{ "amg-rate", required_argument, 0, 'a' },
+		{ "mlx-rate", required_argument, 0, 'm' },
+		{ "vl-res",   required_argument, 0, 'z' },
+		{ "vl-count", required_argument, 0, 'n' },
+		{ "corrupt",  required_argument, 0, 'c' },
+		{ "mode",     required_argument, 0, 'f' },
+		{ "binary",   no_argument,       0, 'b' },
+		{ "coded",    no_argument,       0, 'k' },
+		{ "static",   no_argument,       0, 'q' },
+		{ "link",     required_argument, 0, 'l' },
+		{ "seed",     required_argument, 0, 's' },
+		{ "help",     no_argument,       0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+	const char *link_path = NULL;
+	unsigned seed = 1;
+	int opt;
+
+	while((opt = getopt_long(argc, argv, "r:v:a:m:z:n:c:f:bkql:s:h", options, NULL)) != -1)
+	{
+		switch(opt)
+		{
+		case 'r':
+			for(int i = 0; i < SIM_SENSORS; i++) sensors[i].rate_hz = atof(optarg);
+			break;
+		case 'v':
+			for(int i = 0; i < SIM_SENSORS; i++) if(is_vl(i)) sensors[i].rate_hz = atof(optarg);
+			break;
+		case 'a': sensors[SIM_AMG].rate_hz = atof(optarg); break;
+		case 'm': sensors[SIM_MLX].rate_hz = atof(optarg); break;
+		case 'z': vl_resolution = atoi(optarg) == 16 ? 16 : 64; break;
+		case 'n':
+			vl_count = atoi(optarg);
+			if(vl_count < 1) vl_count = 1;
+			if(vl_count > INTEGRATOR_VL53L5CX_MAX) vl_count = INTEGRATOR_VL53L5CX_MAX;
+			break;
+		case 'c': corrupt_probability = atof(optarg); break;
+		case 'f': flag = optarg[0]; break;
+		case 'b': binary_format = 1; break;
+		case 'k': binary_format = coded_format = 1; break;
+		case 'q': static_scene = 1; break;
+		case 'l': link_path = optarg; break;
+		case 's': seed = (unsigned)strtoul(optarg, NULL, 0); break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	srand(seed);
+	integrator_command_init(&command_parser);
+	for(int i = 0; i < SIM_SENSORS; i++) integrator_codec_init(&sensors[i].codec, sensors[i].reference, INTEGRATOR_MAX_VALUES);
+
+	master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0)
+	{
+		perror("posix_openpt");
+		return 1;
+	}
+	const char *slave_path = ptsname(master_fd);
+
+	/* Raw mode, and keep the slave open so the master survives the host reconnecting */
+	int slave_fd = open(slave_path, O_RDWR | O_NOCTTY);
+	struct termios tio;
+	if(slave_fd < 0 || tcgetattr(slave_fd, &tio) != 0)
+	{
+		perror(slave_path);
+		return 1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave_fd, TCSANOW, &tio);
+	fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+
+	if(link_path)
+	{
+		unlink(link_path);
+		if(symlink(slave_path, link_path) != 0) perror(link_path);
+	}
+	printf("Symulator integratora: %s%s%s\n", slave_path, link_path ? " -> " : "", link_path ? link_path : "");
+	fflush(stdout);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	queue_text("Inicjalizacja czujnika AMG8833...\nKoniec inicjalizacji\n");
+	queue_text("Inicjalizacja czujnika MLX90640...\nKoniec inicjalizacji\n");
+	send_capabilities_frame();
+	queue_text("Wybierz opcje: \nWybrana opcja: %c\n", flag);
+
+	uint64_t start = now_us();
+	uint64_t next_stats = start + 5000000;
+	for(int i = 0; i < SIM_SENSORS; i++) sensors[i].next_due_us = start;
+
+	while(running)
+	{
+		uint64_t now = now_us();
+
+		for(int i = 0; i < SIM_SENSORS; i++)
+		{
+			sim_sensor *sensor = &sensors[i];
+			if(sensor->rate_hz <= 0 || !mode_uses(flag, i)) { sensor->next_due_us = now; continue; }
+			if(now < sensor->next_due_us) continue;
+
+			send_frame(i, now);
+			sensor->next_due_us += (uint64_t)(1e6 / sensor->rate_hz);
+			/* Do not try to catch up after a stall */
+			if(sensor->next_due_us < now) sensor->next_due_us = now;
+		}
+		flush_output();
+
+		if(now >= next_stats)
+		{
+			print_stats();
+			next_stats += 5000000;
+		}
+
+		/* Sleep until the next frame is due or a command arrives */
+		uint64_t wake = next_stats;
+		for(int i = 0; i < SIM_SENSORS; i++)
+		{
+			if(sensors[i].rate_hz > 0 && mode_uses(flag, i) && sensors[i].next_due_us < wake) wake = sensors[i].next_due_us;
+		}
+		now = now_us();
+		int timeout_ms = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+		if(out_len > 0 && timeout_ms > 1) timeout_ms = 1;
+
+		struct pollfd pfd = { master_fd, POLLIN, 0 };
+		if(poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN))
+		{
+			uint8_t input[64];
+			ssize_t n = read(master_fd, input, sizeof(input));
+			for(ssize_t i = 0; i < n; i++) handle_command(input[i]);
+		}
+	}
+
+	print_stats();
+	if(link_path) unlink(link_path);
+	close(slave_fd);
+	close(master_fd);
+	return 0;
+}
@@ -0,0 +1,141 @@
+/**
+  ******************************************************************************
+  * @file    mlx90640_check.c
+  * @brief   Compares MLX90640_SolveTo with the reference MLX90640_CalculateTo.
+  ******************************************************************************
+  * Both solvers run on the same frames; the tool prints the largest absolute
+  * difference of Ta and To and the time per frame, and fails when To differs
+  * by more than MLX90640_SOLVER_TOLERANCE.
+  *
+  * The dumps are raw little-endian uint16 files: the EEPROM as read by
+  * MLX90640_DumpEE (832 words) and any number of frames as returned by
+  * MLX90640_GetFrameData (834 words each). Without dumps, a synthetic
+  * parameter set and frames with a temperature gradient are used.
+  *
+  *   make mlx90640_check && ./mlx90640_check [eeprom.bin frames.bin]
+  ******************************************************************************
+  */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "MLX90640_API.h"
+#include "MLX90640_Solver.h"
+#include "mlx90640_synthetic.h"
+
+#define EEPROM_WORDS    832
+#define FRAME_WORDS     834
+#define EMISSIVITY      0.95f
+#define TA_SHIFT        8
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t read_words(const char *path, uint16_t **words)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+	{
+		perror(path);
+		exit(2);
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	uint8_t *bytes = malloc(size);
+	*words = malloc(size);
+	if (fread(bytes, 1, size, file) != (size_t)size)
+	{
+		perror(path);
+		exit(2);
+	}
+	fclose(file);
+
+	size_t count = size / 2;
+	for (size_t i = 0; i < count; i++)
+		(*words)[i] = bytes[2*i] | (bytes[2*i + 1] << 8);
+	free(bytes);
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	static paramsMLX90640 params;
+	static mlx90640Solver solver;
+	static float reference[768], solved[768];
+	uint16_t *frames;
+	size_t frame_count;
+
+	if (argc == 3)
+	{
+		uint16_t *eeprom;
+		if (read_words(argv[1], &eeprom) < EEPROM_WORDS)
+		{
+			fprintf(stderr, "%s: za krotki zrzut EEPROM\n", argv[1]);
+			return 2;
+		}
+		if (MLX90640_ExtractParameters(eeprom, &params) != 0)
+		{
+			fprintf(stderr, "%s: bledne dane EEPROM\n", argv[1]);
+			return 2;
+		}
+		frame_count = read_words(argv[2], &frames) / FRAME_WORDS;
+	}
+	else if (argc == 1)
+	{
+		mlx90640_synthetic_params(&params);
+		frame_count = mlx90640_synthetic_frames(&frames);
+	}
+	else
+	{
+		fprintf(stderr, "uzycie: %s [eeprom.bin frames.bin]\n", argv[0]);
+		return 2;
+	}
+
+	MLX90640_PrepareSolver(&params, &solver);
+
+	/* Pixels of the subpage that has not been read yet stay NaN in both */
+	for (int i = 0; i < 768; i++)
+		reference[i] = solved[i] = NAN;
+
+	double max_ta = 0, max_to = 0, reference_s = 0, solver_s = 0;
+	float min_t = INFINITY, max_t = -INFINITY;
+	for (size_t n = 0; n < frame_count; n++)
+	{
+		uint16_t *frame = &frames[n * FRAME_WORDS];
+		double t0;
+
+		t0 = now_s();
+		float ta = MLX90640_GetTa(frame, &params);
+		MLX90640_CalculateTo(frame, &params, EMISSIVITY, ta - TA_SHIFT, reference);
+		reference_s += now_s() - t0;
+
+		t0 = now_s();
+		float solverTa = MLX90640_SolverGetTa(frame, &solver);
+		MLX90640_SolveTo(frame, &solver, EMISSIVITY, solverTa - TA_SHIFT, solved);
+		solver_s += now_s() - t0;
+
+		if (fabs(ta - solverTa) > max_ta)
+			max_ta = fabs(ta - solverTa);
+		for (int i = 0; i < 768; i++)
+		{
+			if (fabs(reference[i] - solved[i]) > max_to || isnan(solved[i]) != isnan(reference[i]))
+				max_to = isnan(solved[i]) != isnan(reference[i]) ? INFINITY : fabs(reference[i] - solved[i]);
+			if (isnan(reference[i])) continue;
+			if (reference[i] < min_t) min_t = reference[i];
+			if (reference[i] > max_t) max_t = reference[i];
+		}
+	}
+
+	printf("klatek: %zu, To od %.2f do %.2f C\n", frame_count, min_t, max_t);
+	printf("max |dTa| = %.6f C, max |dTo| = %.6f C (tolerancja %.3f C)\n", max_ta, max_to, MLX90640_SOLVER_TOLERANCE);
+	printf("referencja: %8.1f us/klatke\n", reference_s / frame_count * 1e6);
+	printf("solver    : %8.1f us/klatke (x%.1f)\n", solver_s / frame_count * 1e6, reference_s / solver_s);
+	return max_to <= MLX90640_SOLVER_TOLERANCE ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+/**
+  ******************************************************************************
+  * @file    mlx90640_synthetic.h
+  * @brief   Synthetic MLX90640 calibration and frames for the host checks.
+  ******************************************************************************
+  * Used by mlx90640_check and mlxsolver_check when no EEPROM and frame dumps
+  * are given: a parameter set of the order of the datasheet example and
+  * frames with a temperature gradient, alternating subpages and switching
+  * between the chess and the interleaved pattern.
+  ******************************************************************************
+  */
+#ifndef MLX90640_SYNTHETIC_H
+#define MLX90640_SYNTHETIC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "MLX90640_API.h"
+
+#define MLX90640_SYNTHETIC_FRAME_WORDS  834
+
+/* Calibration values of the order found in the MLX90640 datasheet example */
+static inline void mlx90640_synthetic_params(paramsMLX90640 *params)
+{
+	params->kVdd = -3168;
+	params->vdd25 = -13088;
+	params->KvPTAT = 0.002197f;
+	params->KtPTAT = 42.25f;
+	params->vPTAT25 = 12273;
+	params->alphaPTAT = 9.0f;
+	params->gainEE = 5580;
+	params->tgc = 0.0f;
+	params->cpKv = 0.375f;
+	params->cpKta = 0.004272f;
+	params->resolutionEE = 2;
+	params->calibrationModeEE = 128;
+	params->KsTa = -0.002441f;
+	params->ksTo[0] = -0.0002f;
+	params->ksTo[1] = -0.0002f;
+	params->ksTo[2] = -0.0002f;
+	params->ksTo[3] = -0.0002f;
+	params->ct[0] = -40;
+	params->ct[1] = 0;
+	params->ct[2] = 160;
+	params->ct[3] = 320;
+	for (int i = 0; i < 768; i++)
+	{
+		params->alpha[i] = 1.0e-7f * (1.1f + 0.2f * (float)((i * 37) % 100) / 100);
+		params->offset[i] = -60 + (i * 13) % 30;
+		params->kta[i] = 0.004f + 0.003f * (float)((i * 7) % 10) / 10;
+		params->kv[i] = 0.375f + 0.125f * (i % 4);
+	}
+	params->cpAlpha[0] = 4.07e-9f;
+	params->cpAlpha[1] = 3.95e-9f;
+	params->cpOffset[0] = -75;
+	params->cpOffset[1] = -73;
+	params->ilChessC[0] = 0.0625f;
+	params->ilChessC[1] = 2.0f;
+	params->ilChessC[2] = 0.0f;
+}
+
+static inline size_t mlx90640_synthetic_frames(uint16_t **frames)
+{
+	const size_t count = 64;
+	*frames = (uint16_t *)calloc(count, MLX90640_SYNTHETIC_FRAME_WORDS * sizeof(uint16_t));
+
+	for (size_t n = 0; n < count; n++)
+	{
+		uint16_t *frame = &(*frames)[n * MLX90640_SYNTHETIC_FRAME_WORDS];
+		for (int i = 0; i < 768; i++)
+			frame[i] = (uint16_t)(int16_t)(-700 + (int)((i % 32) * 97 + (i / 32) * 131 + n * 53) % 9000);
+		frame[768] = 19442 + n;                         /* VBE */
+		frame[776] = (uint16_t)(int16_t)-75;            /* cp subpage 0 */
+		frame[778] = 5780 + (n % 8);                    /* gain */
+		frame[800] = 1711;                              /* VPTAT */
+		frame[808] = (uint16_t)(int16_t)-71;            /* cp subpage 1 */
+		frame[810] = (uint16_t)(int16_t)-13115;         /* vdd */
+		frame[832] = 0x1901 | ((n & 2) ? 0 : 0x1000);   /* control register: chess or interleaved */
+		frame[833] = n & 1;
+	}
+	return count;
+}
+
+#endif /* MLX90640_SYNTHETIC_H */
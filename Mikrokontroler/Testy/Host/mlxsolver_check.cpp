@@ -0,0 +1,92 @@
+/**
+  ******************************************************************************
+  * @file    mlxsolver_check.cpp
+  * @brief   Compares every To kernel of the EX MlxSolver with MLX90640_SolveTo.
+  ******************************************************************************
+  * The scalar, SSE2 and AVX kernels (EX/mlxkernel.h) solve the synthetic
+  * frames of mlx90640_synthetic.h next to the single-precision solver of the
+  * firmware. They have to give the same Ta and To bit for bit: the kernels
+  * only reorder the pixels, not the arithmetic. A kernel the CPU or the build
+  * lacks is reported as skipped.
+  *
+  *   make mlxsolver_check && ./mlxsolver_check
+  ******************************************************************************
+  */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "mlxsolver.h"
+#include "mlx90640_synthetic.h"
+
+#define EMISSIVITY      0.95f
+#define TA_SHIFT        8
+
+/* Largest difference of To over all frames, -1 if the kernel was not run */
+static double check_kernel(MlxSolver::Isa isa, const paramsMLX90640 &params, const uint16_t *frames, size_t count)
+{
+	static paramsMLX90640 reference_params;
+	static mlx90640Solver solver;
+	static float reference[MlxSolver::Pixels];
+	static MlxSolver kernel;
+	double max_to = 0;
+
+	kernel.setParameters(params);
+	kernel.setEmissivity(EMISSIVITY);
+	kernel.setReflectedShift(TA_SHIFT);
+	kernel.setIsa(isa);
+	if (kernel.isa() != isa)
+		return -1;
+
+	reference_params = params;
+	MLX90640_PrepareSolver(&reference_params, &solver);
+	/* Pixels of the other subpage keep their value in both, MlxSolver starts from 0 */
+	for (int i = 0; i < MlxSolver::Pixels; i++)
+		reference[i] = 0.0f;
+
+	for (size_t n = 0; n < count; n++)
+	{
+		const uint16_t *frame = &frames[n * MLX90640_SYNTHETIC_FRAME_WORDS];
+		float ta = MLX90640_SolverGetTa(frame, &solver);
+		MLX90640_SolveTo(frame, &solver, EMISSIVITY, ta - TA_SHIFT, reference);
+
+		if (kernel.solve(frame) != ta)
+			return INFINITY;
+		const float *solved = kernel.temperatures();
+		for (int i = 0; i < MlxSolver::Pixels; i++)
+		{
+			double diff = std::fabs((double)solved[i] - reference[i]);
+			if (std::isnan(solved[i]) != std::isnan(reference[i]))
+				diff = INFINITY;
+			if (diff > max_to)
+				max_to = diff;
+		}
+	}
+	return max_to;
+}
+
+int main(void)
+{
+	static const MlxSolver::Isa isas[] = { MlxSolver::Isa::Scalar, MlxSolver::Isa::Sse2, MlxSolver::Isa::Avx };
+	static paramsMLX90640 params;
+	uint16_t *frames;
+	int ok = 1;
+
+	mlx90640_synthetic_params(&params);
+	size_t count = mlx90640_synthetic_frames(&frames);
+
+	printf("klatek: %zu\n", count);
+	for (MlxSolver::Isa isa : isas)
+	{
+		double max_to = check_kernel(isa, params, frames, count);
+		if (max_to < 0)
+			printf("%-6s: pominiete, brak wsparcia\n", MlxSolver::isaName(isa));
+		else
+			printf("%-6s: max |dTo| = %g C%s\n", MlxSolver::isaName(isa), max_to, max_to != 0 ? ", BLAD" : "");
+		if (max_to > 0)
+			ok = 0;
+	}
+	free(frames);
+	printf(ok ? "OK\n" : "BLAD\n");
+	return ok ? 0 : 1;
+}